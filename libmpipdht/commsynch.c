@@ -1,65 +1,116 @@
 #include <pdht.h>
   
-#define PDHT_COUNTER_HOLDER 1
+#define PDHT_COUNTER_HOLDER 0
 
 extern pdht_context_t *c;
 
 void pdht_barrier(void){
-  MPI_Barrier(c->split_comm);
+  MPI_Barrier(c->comm);
 }
 
 
 
 void pdht_fence(pdht_t *dht){
-  MPI_Barrier(c->split_comm);
+  // our batched puts are all applied once this returns
+  pdht_put_flush(dht);
+  MPI_Barrier(c->comm);
+
+  // grown partitions are read at their new addresses from here on
+  pdht_rma_refresh(dht);
 }
 
 
 
-int pdht_counter_init(pdht_t *ht, uint64_t initval){
-  char sendBuf[sizeof(message_t) + sizeof(uint64_t)];
-  message_t *msg_init = (message_t *)sendBuf;
-  assert(ht->counter_count < PDHT_MAX_COUNTERS);
+/**
+ * pdht_counter_create - exposes a table's counters in an MPI window
+ *   collective, called from pdht_create(). increments are MPI_Fetch_and_op
+ *   on the holder's window, so its server thread stays out of the way
+ * @param ht - hash table
+ */
+void pdht_counter_create(pdht_t *ht) {
+  MPI_Aint size = c->rank == PDHT_COUNTER_HOLDER ? PDHT_MAX_COUNTERS * sizeof(uint64_t) : 0;
+  int ret, ok;
+
+  MPI_Comm_set_errhandler(c->comm, MPI_ERRORS_RETURN);
+  ret = MPI_Win_allocate(size, sizeof(uint64_t), MPI_INFO_NULL, c->comm, &ht->counters, &ht->counter_win);
+  MPI_Comm_set_errhandler(c->comm, MPI_ERRORS_ARE_FATAL);
+
+  ht->counter_rma = ret == MPI_SUCCESS;
+  pdht_allreduce(&ht->counter_rma, &ok, PdhtReduceOpMin, IntType, 1);
+
+  if (!ok) {
+    if (ret == MPI_SUCCESS)
+      MPI_Win_free(&ht->counter_win);
+    ht->counter_rma = 0;
+    ht->counters = calloc(PDHT_MAX_COUNTERS, sizeof(uint64_t));
+    if (c->rank == 0)
+      printf("pdht_counter_create: no counter window, counters will be two-sided\n");
+    return;
+  }
 
-  msg_init->type = pdhtCounterInit;
-  memcpy(&msg_init->key, &initval, sizeof(uint64_t));
-  msg_init->rank = c->rank;
-  int i;
-  for(i = 0; i < c->dhtcount; i++){
-    if(c->hts[i] == ht) break;
+  if (c->rank == PDHT_COUNTER_HOLDER)
+    memset(ht->counters, 0, size);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, ht->counter_win);
+}
+
+
+
+/**
+ * pdht_counter_destroy - releases a table's counters
+ *   collective, called from pdht_free()
+ * @param ht - hash table
+ */
+void pdht_counter_destroy(pdht_t *ht) {
+  if (ht->counter_rma) {
+    MPI_Win_unlock_all(ht->counter_win);
+    MPI_Win_free(&ht->counter_win);
+  } else {
+    free(ht->counters);
   }
-  
-  msg_init->ht_index = i;
-  if(c->rank == PDHT_COUNTER_HOLDER){
-    ht->counters[ht->counter_count] = initval;
+  ht->counters = NULL;
+}
+
+
+
+/**
+ * pdht_counter_set - sets a counter on the holder, called by the holder only
+ */
+static void pdht_counter_set(pdht_t *ht, int counter, uint64_t val) {
+  if (ht->counter_rma) {
+    // the window's own atomics, so it doesn't race with remote fetch-and-ops
+    MPI_Accumulate(&val, 1, MPI_UINT64_T, PDHT_COUNTER_HOLDER, counter, 1, MPI_UINT64_T, MPI_REPLACE, ht->counter_win);
+    MPI_Win_flush(PDHT_COUNTER_HOLDER, ht->counter_win);
+  } else {
+    pthread_mutex_lock(ht->table_lock);
+    ht->counters[counter] = val;
+    pthread_mutex_unlock(ht->table_lock);
   }
-  MPI_Ssend(msg_init, sizeof(message_t) + sizeof(uint64_t), MPI_CHAR, PDHT_COUNTER_HOLDER, PDHT_TAG_COMMAND, MPI_COMM_WORLD);
-  
-  return ht->counter_count++;
+}
+
+
+
+/*
+ * pdht_counter_init - collectively initializes a new atomic counter
+ */
+int pdht_counter_init(pdht_t *ht, uint64_t initval){
+  int cindex;
+
+  assert(ht->counter_count < PDHT_MAX_COUNTERS);
+  cindex = ht->counter_count++;
+
+  if(c->rank == PDHT_COUNTER_HOLDER)
+    pdht_counter_set(ht, cindex, initval);
+
+  // no increments before the holder has the initial value
+  pdht_barrier();
+  return cindex;
 }
 
 
 
 void pdht_counter_reset(pdht_t *ht, int counter){
-  char sendBuf[sizeof(message_t) + sizeof(int)];
-  
-  if(c->rank == 0){
-    message_t *msg_reset = (message_t *)sendBuf;
-    msg_reset->type = pdhtCounterReset;
-    msg_reset->rank = c->rank;
-    
-    int i;
-    for(i = 0; i < c->dhtcount; i++){
-      if(c->hts[i] == ht) break;
-    }
-    
-
-    msg_reset->ht_index = i;
-    msg_reset->mbits = 0;
-    memcpy(&msg_reset->key, &counter, sizeof(int));
-    
-    MPI_Ssend(msg_reset, sizeof(sendBuf), MPI_CHAR, PDHT_COUNTER_HOLDER, PDHT_TAG_COMMAND, MPI_COMM_WORLD);
-  }
+  if(c->rank == PDHT_COUNTER_HOLDER)
+    pdht_counter_set(ht, counter, 0);
   pdht_barrier();
 }
 
@@ -72,24 +123,23 @@ uint64_t pdht_counter_inc(pdht_t *ht, int counter, uint64_t val){
   MPI_Status status;
 
   message_t *inc_message;
+
+  if (ht->counter_rma) {
+    MPI_Fetch_and_op(&val, &counter_val, MPI_UINT64_T, PDHT_COUNTER_HOLDER, counter, MPI_SUM, ht->counter_win);
+    MPI_Win_flush(PDHT_COUNTER_HOLDER, ht->counter_win);
+    return counter_val;
+  }
   
   inc_message = (message_t *)sendBuf;
   inc_message->type = pdhtCounterInc;
   inc_message->rank = c->rank;
-  
-  int i;
-  for(i = 0; i < c->dhtcount; i++){
-    if(c->hts[i] == ht) break;
-  }
-  inc_message->ht_index = i;
+  inc_message->ht_index = ht->index;
   inc_message->mbits = val; //yea i get this isn't the best but it'll work without wasting that space
   memcpy(inc_message->key, &counter, sizeof(int));
   
-  MPI_Send(inc_message, sizeof(sendBuf), MPI_CHAR, PDHT_COUNTER_HOLDER, PDHT_TAG_COMMAND, MPI_COMM_WORLD);
+  MPI_Send(inc_message, sizeof(sendBuf), MPI_CHAR, PDHT_COUNTER_HOLDER, PDHT_TAG_COMMAND, c->comm);
   
-  MPI_Recv(&counter_val, 1, MPI_UNSIGNED_LONG, PDHT_COUNTER_HOLDER, PDHT_COUNTER_REPLY, MPI_COMM_WORLD, &status);
+  MPI_Recv(&counter_val, 1, MPI_UNSIGNED_LONG, PDHT_COUNTER_HOLDER, PDHT_COUNTER_REPLY, c->comm, &status);
 
   return counter_val;
 }
-
-
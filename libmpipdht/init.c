@@ -1,14 +1,13 @@
 #include <pdht.h>
 #include <execinfo.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <signal.h>
 
-#define MAIN_COLOR 0
-#define SERVER_COLOR 1
-
 /* local protos */
 void *pdht_comm(void *arg);
-void free_entries(pdht_t *dht);
+
+#define PDHT_SERVER_SPIN 64 // empty probes before the server thread yields the CPU
 
 
 // global pdht context
@@ -16,20 +15,28 @@ pdht_context_t *c = NULL;
 
 /**
  * pdht_init - initializes PDHT system
+ *   every rank owns a partition of each table, a server thread on every rank
+ *   answers requests for it, so MPI must be able to take calls from both threads
  */
 void pdht_init() {
-  int result;
   int my_rank;
   int size;
+  int initialized, provided;
 
-  MPI_Init(NULL, NULL);
+  MPI_Initialized(&initialized);
+  if (!initialized) {
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided);
+  } else {
+    MPI_Query_thread(&provided);
+  }
+  if (provided < MPI_THREAD_MULTIPLE) {
+    fprintf(stderr, "pdht_init: MPI library does not support MPI_THREAD_MULTIPLE (provided: %d)\n", provided);
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
   
   MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
   MPI_Comm_size(MPI_COMM_WORLD,&size);
-  char pname[MPI_MAX_PROCESSOR_NAME];
-  int nlen;
-  //MPI_Get_processor_name(pname, &nlen);
-  //printf("%d: %s\n", my_rank, pname);
+
   // setup global context
   c = (pdht_context_t *)malloc(sizeof(pdht_context_t));
   memset(c, 0, sizeof(pdht_context_t));
@@ -39,44 +46,22 @@ void pdht_init() {
   c->rank = my_rank;
   c->maxbufsize = 0;
   c->pid = getpid();
-  if(!c->reply_buf){
-    c->reply_buf = malloc(sizeof(int));
-  }
-  if(c->rank % 2){
-    MPI_Comm_split(MPI_COMM_WORLD, SERVER_COLOR, c->rank, &(c->split_comm));
-  }
-  else{
-    MPI_Comm_split(MPI_COMM_WORLD, MAIN_COLOR, c->rank, &(c->split_comm));
-  }
-#if 0
-  // define  message datatype for MPI
-  const int nitems = 3;
-  int blocklengths[4] = {1,1,1,1};
-  MPI_Datatype types[4] = {MPI_INT,MPI_INT,MPI_INT,MPI_UNSIGNED_LONG};
-  MPI_Datatype mpi_msg_type;
-  MPI_Aint offsets[4];
-
-  offsets[0] = offsetof(message_t,type);
-  offsets[1] = offsetof(message_t,rank);
-  offsets[2] = offsetof(message_t,ht_index);
-  offsets[3] = offsetof(message_t,mbits);
-  MPI_Type_create_struct(nitems,blocklengths, offsets, types, &mpi_msg_type);
-  MPI_Type_commit(&mpi_msg_type);
-
-  c->msgType = mpi_msg_type;
-#endif 
+  c->mpi_owner = !initialized;
+
+  // keep our traffic and collectives apart from the application's
+  MPI_Comm_dup(MPI_COMM_WORLD, &c->comm);
+
+  pthread_create(&c->comm_tid, NULL, pdht_comm, NULL);
 }
 
 
 
 /**
- * pdht_create -- allocates a new dht
+ * pdht_create -- collectively allocates a new dht
  * @returns the newly minted dht
  */
 pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
   pdht_t *dht;
-
-  ht_t *ht = NULL;
   int htbuflen;
 
   pthread_mutex_t *lock = malloc(sizeof(pthread_mutex_t));
@@ -84,45 +69,36 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
   pthread_mutex_init(lock,NULL);
 
   dht = (pdht_t *)calloc(1,sizeof(pdht_t));
-  dht->ht = ht;
   dht->elemsize = elemsize;
   dht->hashfn = pdht_hash;
   dht->keysize = keysize;
   dht->ptl.nptes = 1;
-  dht->uthash_lock = lock;
+  dht->table_lock = lock;
+  dht->recsize = (sizeof(uint64_t) + PDHT_MAXKEYSIZE + elemsize + 7) & ~7;
 
   if (!c){
     pdht_init();
   }
+  pdht_table_init(dht);
 
-  if(c->dhtcount == 1){
-    //send request to my comm process to make me a new ht
-    int target_rank = c->rank + 1;
-    int buflen = sizeof(message_t) + 2 * (sizeof(int));
-    char buf[buflen];
-
-    message_t *msg;
-    
-    msg = (message_t *)buf;
-    
-    msg->type = pdhtCreateHt;
-    msg->rank = c->rank;
-    msg->ht_index = 0;
-    
-    memcpy(msg->key, &keysize, sizeof(int));
-    memcpy(msg->key + sizeof(int), &elemsize, sizeof(int));
-
-    MPI_Ssend(buf, buflen, MPI_CHAR, target_rank, PDHT_TAG_COMMAND, MPI_COMM_WORLD);
-    MPI_Barrier(MPI_COMM_WORLD);
+  if (c->dhtcount >= PDHT_MAX_TABLES) {
+    fprintf(stderr, "pdht_create: too many tables (max: %d)\n", PDHT_MAX_TABLES);
+    MPI_Abort(MPI_COMM_WORLD, -1);
   }
 
-  c->hts[c->dhtcount] = dht;
+  // tables are created and freed collectively, so the slot is the same everywhere
+  dht->index = c->dhtcount;
+  __atomic_store_n(&c->hts[dht->index], dht, __ATOMIC_SEQ_CST);
   c->dhtcount++;
   htbuflen = sizeof(message_t) + PDHT_MAXKEYSIZE + elemsize;
   c->maxbufsize = c->maxbufsize >= htbuflen ?  c->maxbufsize : htbuflen;
-  if (c->rank % 2){
-    pdht_comm(NULL);
-  }
+
+  // expose our partition for one-sided gets and counters, this syncs everyone up too
+  pdht_rma_init(dht);
+  pdht_counter_create(dht);
+
+  // nobody sends to the new table until everyone has it
+  pdht_barrier();
   return dht;
 }
 
@@ -130,65 +106,62 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
 
 /**
  * pdht_comm -- target-side communication thread for MPI PDHT
+ *   serves gets, puts and counter updates for this rank's partitions
  * @param arg - unused
  */
 void *pdht_comm(void *arg) {
   pdht_t *dht = NULL;
-  //char msgbuf[c->maxbufsize];
   MPI_Status status;
+  MPI_Message mpimsg;
   int requester;
-  char *iter;
-  ht_t *instance;
-  uint64_t mbits;
-  int flag = 1;
   char *buf = NULL, *tbuf = NULL;
+  char *msgbuf = NULL;
   message_t *msg = NULL;
   reply_t *reply = NULL;
-  int buflen;
+  int buflen = 0, msglen = 0;
   int need;
-  int offset;
-  int index;
   int *counter_index;
   uint64_t increment;
   unsigned long counter_value;
-  uint64_t initval;
-  
-  int target;
-  int *keysize;
-  int *elemsize;
-  int htbuflen;
-  int last;
-  int put_reply;
+  char *rec;
+  int64_t cswap[2], swapval;
+  int found, idle = 0;
 
-  MPI_Request *requests = calloc(sizeof(MPI_Request), c->size / 2);
-  char *bufs = calloc(c->maxbufsize, c->size / 2);
-  
-  char *msgbuf;// = calloc(c->maxbufsize, 1);
-
-  for(int i = 0; i < c->size / 2; i++){
-    offset = i * c->maxbufsize;
-    target = i * 2;
-    MPI_Irecv(bufs + offset, c->maxbufsize, MPI_CHAR, target, PDHT_TAG_COMMAND, MPI_COMM_WORLD, &requests[i]);
-  }
   while(c->thread_active) {
-    MPI_Waitany(c->size / 2, requests, &index, &status);
-    offset = index * c->maxbufsize;
-    last = index;
-    msgbuf = bufs + offset;
+    // blocking probes spin inside MPI, back off so the application thread gets the core
+    MPI_Improbe(MPI_ANY_SOURCE, PDHT_TAG_COMMAND, c->comm, &found, &mpimsg, &status);
+    if (!found) {
+      if (++idle >= PDHT_SERVER_SPIN)
+        sched_yield();
+      continue;
+    }
+    idle = 0;
+
+    // tables may have grown since the last request, size the buffer to each message
+    MPI_Get_count(&status, MPI_CHAR, &need);
+    if (need > msglen) {
+      tbuf = realloc(msgbuf, need);
+      if (!tbuf) {
+        printf("%d: realloc failure. game over.\n", c->rank); fflush(stdout);
+        MPI_Abort(MPI_COMM_WORLD, -1);
+      }
+      msgbuf = tbuf;
+      msglen = need;
+    }
+    MPI_Mrecv(msgbuf, need, MPI_CHAR, &mpimsg, &status);
+
     msg = (message_t *)msgbuf; // cast to access message fields
-    dht = c->hts[msg->ht_index];
-    requester = msg->rank;
-    switch (msg->type) {
-      case pdhtStop:
-        // game over, go home
-        for(int i = 0; i < c->size / 2; i++){
-          if(i != index){
-            MPI_Cancel(&requests[i]);
-          }
-        }
-        MPI_Finalize();
-        goto done;
+    requester = status.MPI_SOURCE;
+    if (msg->type == pdhtStop)
+      break; // game over, go home
+
+    dht = __atomic_load_n(&c->hts[msg->ht_index], __ATOMIC_SEQ_CST);
+    if (!dht) {
+      printf("%d: request from %d for unknown table %d. game over.\n", c->rank, requester, msg->ht_index);
+      MPI_Abort(MPI_COMM_WORLD, -1);
+    }
 
+    switch (msg->type) {
       case pdhtGet:
         // get request, search for entry and send reply to requestor
         // make sure MPI send buffer is big enough
@@ -200,100 +173,99 @@ void *pdht_comm(void *arg) {
             MPI_Abort(MPI_COMM_WORLD, -1);
           }
           buf = tbuf;
-
+          buflen = need;
         }
-        buflen = need;
 
         reply = (reply_t *)buf; // cast so we can set header values
-       
-        HASH_FIND(hh, dht->ht, &(msg->mbits), sizeof(unsigned long), instance);
-
-        if (instance) {
-      // found entry
-          reply->status = 1; 
-          memcpy(&reply->key, instance->value, PDHT_MAXKEYSIZE + dht->elemsize);
-        } else {
-          // not found
-          reply->status = 0;
-        }
-        MPI_Send(buf,buflen,MPI_CHAR,requester,PDHT_TAG_REPLY,MPI_COMM_WORLD);
+        pdht_local_get(dht, msg->mbits, reply);
+        reply->reqid = msg->reqid;
+        MPI_Send(buf,need,MPI_CHAR,requester,
+                 msg->reqid == PDHT_NULL_HANDLE ? PDHT_TAG_REPLY : PDHT_TAG_NBREPLY,c->comm);
         break;
 
 
       case pdhtPut:
-        // put request, check for existence and add/overwrite as needed
-        
-        HASH_FIND(hh, dht->ht ,&msg->mbits, sizeof(unsigned long), instance);
-        
-        if (!instance) {
-          // new entry -- create new HT entry
-          instance = (ht_t*)calloc(1,sizeof(ht_t));
-          instance->key = msg->mbits;
-          instance->value = malloc(PDHT_MAXKEYSIZE + dht->elemsize);
-
-          HASH_ADD(hh, dht->ht, key, sizeof(unsigned long), instance);  
+        // batch of puts, add/overwrite as needed and ack the lot
+        pthread_mutex_lock(dht->table_lock);
+        for (uint64_t i=0; i < msg->mbits; i++) {
+          rec = msg->key + i * dht->recsize; // pointer math
+          pdht_table_store(dht, *(uint64_t *)rec, rec + sizeof(uint64_t));
         }
-        // update HT entry with PUT data
-        memcpy(instance->value,msg->key,PDHT_MAXKEYSIZE + dht->elemsize);
-        MPI_Send(&put_reply, 1, MPI_INT, requester, PDHT_TAG_REPLY, MPI_COMM_WORLD);
-        // send ack to requestor
-        //MPI_Send(&flag,sizeof(int),MPI_INT,requester,PDHT_TAG_ACK,MPI_COMM_WORLD);
-        break;
+        pthread_mutex_unlock(dht->table_lock);
 
-      case pdhtCounterReset:
-        //reset counter
-        counter_index = (int *)(msg->key);
-        dht->counters[*counter_index] = 0;
+        MPI_Send(&msg->mbits, 1, MPI_UINT64_T, requester, PDHT_TAG_ACK, c->comm);
         break;
 
       case pdhtCounterInc:
         increment = msg->mbits;
         counter_index = (int *)(msg->key);
+        pthread_mutex_lock(dht->table_lock);
         counter_value = dht->counters[*counter_index];
-        MPI_Send(&counter_value, 1, MPI_UNSIGNED_LONG, msg->rank, PDHT_COUNTER_REPLY, MPI_COMM_WORLD);
         dht->counters[*counter_index] += increment;
+        pthread_mutex_unlock(dht->table_lock);
+        MPI_Send(&counter_value, 1, MPI_UNSIGNED_LONG, requester, PDHT_COUNTER_REPLY, c->comm);
         break;
 
-      case pdhtCounterInit:
-        if(msg->rank == 0){
-          initval = *(uint64_t *)(msg->key);
-          dht->counters[dht->counter_count] = initval;
-          dht->counter_count++;
-        }
+      case pdhtCswap:
+        // key | offset | compare | new, reply with status and the prior value
+        rec = msg->key + PDHT_MAXKEYSIZE; // pointer math
+        memcpy(&cswap[1], rec + sizeof(uint64_t), sizeof(int64_t));
+        memcpy(&swapval, rec + sizeof(uint64_t) + sizeof(int64_t), sizeof(int64_t));
+        pthread_mutex_lock(dht->table_lock);
+        cswap[0] = pdht_table_cswap(dht, msg->mbits, msg->key, *(uint64_t *)rec, &cswap[1], swapval);
+        pthread_mutex_unlock(dht->table_lock);
+        MPI_Send(cswap, 2, MPI_INT64_T, requester, PDHT_TAG_REPLY, c->comm);
         break;
 
-      case pdhtCreateHt:
-        
-        keysize  = (int *)(msgbuf + sizeof(message_t));
-        elemsize = (int *)(msgbuf + sizeof(message_t) + sizeof(int));
+      default:
+        printf("%d: unknown request type %d from %d\n", c->rank, msg->type, requester);
+        break;
+    }
+  }
 
-        dht = (pdht_t *)calloc(1,sizeof(pdht_t));
+  if (buf) free(buf);
+  if (msgbuf) free(msgbuf);
+  return NULL;
+}
 
-        ht_t *ht = NULL;
-        dht->ht = ht;
-        dht->elemsize = *elemsize;
-        dht->hashfn = pdht_hash;
-        dht->keysize = *keysize;
-        dht->ptl.nptes = 1;
 
-        c->hts[c->dhtcount] = dht;
-        c->dhtcount++;
 
-        htbuflen = sizeof(message_t) + PDHT_MAXKEYSIZE + *elemsize;
-        c->maxbufsize = c->maxbufsize >= htbuflen ?  c->maxbufsize : htbuflen;
-        bufs = realloc(bufs, c->size / 2 * c->maxbufsize);
-        //msgbuf = realloc(msgbuf, c->maxbufsize);
-	MPI_Barrier(MPI_COMM_WORLD);
-        break;
-    }
-    MPI_Irecv(bufs + offset, c->maxbufsize, MPI_CHAR, last * 2, PDHT_TAG_COMMAND, MPI_COMM_WORLD, &requests[last]);
+/**
+ * pdht_local_get - looks up an entry in this rank's partition
+ *   called by the server thread and by the owner itself
+ * @param dht - hash table
+ * @param mbits - hashed key
+ * @param reply - filled with status, key and value
+ */
+void pdht_local_get(pdht_t *dht, uint64_t mbits, reply_t *reply) {
+  void *kv;
+
+  pthread_mutex_lock(dht->table_lock);
+  kv = pdht_table_find(dht, mbits);
+  if (kv) {
+    // found entry
+    reply->status = 1; 
+    memcpy(&reply->key, kv, PDHT_MAXKEYSIZE + dht->elemsize);
+  } else {
+    // not found
+    reply->status = 0;
   }
-done:
-  if (buf) free(buf);
+  pthread_mutex_unlock(dht->table_lock);
+}
+
 
 
-  //MPI_Finalize();
-  exit(0);
+/**
+ * pdht_local_put - adds or overwrites an entry in this rank's partition
+ *   called by the server thread and by the owner itself
+ * @param dht - hash table
+ * @param mbits - hashed key
+ * @param kv - key (padded to PDHT_MAXKEYSIZE) followed by the value
+ */
+void pdht_local_put(pdht_t *dht, uint64_t mbits, void *kv) {
+  pthread_mutex_lock(dht->table_lock);
+  pdht_table_store(dht, mbits, kv);
+  pthread_mutex_unlock(dht->table_lock);
 }
 
 
@@ -303,62 +275,54 @@ done:
  */
 void pdht_fini() {
   message_t msg;
-  int target_rank;
-  // force comm thread out of service loop
-  c->thread_active = 0;
+
+  // everyone is done talking to our server thread
+  pdht_barrier();
+
   // send comm thread game over message
+  c->thread_active = 0;
   msg.type = pdhtStop;
   msg.ht_index = 0;
   msg.rank = c->rank;
-  
-  target_rank = c->rank + 1;
-  
-  MPI_Ssend(&msg, sizeof(message_t), MPI_CHAR, target_rank, 1, MPI_COMM_WORLD);
-  MPI_Finalize();
-  if(c->reply_buf){
-    free(c->reply_buf);
-  }
+  MPI_Send(&msg, sizeof(message_t), MPI_CHAR, c->rank, PDHT_TAG_COMMAND, c->comm);
+  pthread_join(c->comm_tid, NULL);
+
+  pdht_nb_fini();
+  MPI_Comm_free(&c->comm);
+  if (c->mpi_owner)
+    MPI_Finalize();
   free(c);
+  c = NULL;
 }
 
 
 
-/*
- * free_entries - clean up target-side HT for a PDHT
- * @param dht - ht to clean out
- */
-void free_entries(pdht_t *dht){
-  ht_t *cur, *tmp;
-  HASH_ITER(hh,dht->ht,cur,tmp){
-    HASH_DEL(dht->ht,cur);
-    free(cur);
-  }
-}
-
-
 /**
- * pdht_free - release all resources with a PDHT
+ * pdht_free - collectively release all resources with a PDHT
  * @param dht - ht to free
  */
 void pdht_free(pdht_t *dht) {
-  int dht_index;
-  int i;
+  // our gets and puts are done and nobody is still reading or writing our partition
+  pdht_waitall();
+  pdht_fence(dht);
 
-  // bookkeep on ht list
-  for(i = 0;i < c->dhtcount;i++){
-    if(c->hts[i] == dht){
-      break;
-    }
-  }
-  while(i < c->dhtcount){
-    c->hts[i] = c->hts[i+1];
-    i++;
-  }
+  // bookkeep on ht list, trailing free slots can be reused
+  __atomic_store_n(&c->hts[dht->index], NULL, __ATOMIC_SEQ_CST);
+  while ((c->dhtcount > 0) && (c->hts[c->dhtcount - 1] == NULL))
+    c->dhtcount--;
 
   // clean out target side entries
-  free_entries(dht);
+  for (int i=0; dht->aggr && i < c->size; i++) {
+    free(dht->aggr[i].buf[0]);
+    free(dht->aggr[i].buf[1]);
+  }
+  free(dht->aggr);
+  pdht_counter_destroy(dht);
+  pdht_rma_fini(dht);
+  pdht_table_fini(dht);
+  pthread_mutex_destroy(dht->table_lock);
+  free(dht->table_lock);
   free(dht);
-  c->dhtcount--;
   if(c->dhtcount == 0){
     pdht_fini();
   }
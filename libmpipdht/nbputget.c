@@ -0,0 +1,271 @@
+#include <pdht.h>
+
+extern pdht_context_t *c;
+
+/*
+ * non-blocking gets: a get that has to ask the owner takes an entry from a
+ * preallocated pool, posts the receive for the reply and sends the request,
+ * both without blocking. the request carries the entry's index and the owner
+ * echoes it in the reply, so a reply is handed to the entry named in it rather
+ * than to whichever receive it landed in. completion is polled with
+ * MPI_Testsome over the pool's receives.
+ *
+ * gets answered by our own partition finish right away. remote gets always
+ * go through the pool rather than a one-sided read: pdht_rma_get() waits for
+ * its MPI_Get, so it would finish the get before pdht_nbget() returned and
+ * leave nothing to overlap.
+ */
+
+static int  pdht_nb_alloc(void);
+static void pdht_nb_progress(int block);
+
+
+
+/**
+ * pdht_nbput - puts or overwrites an entry in the global hash table
+ *   puts are already batched and acked at the next pdht_fence(), so the
+ *   handle is complete as soon as the entry is queued
+ *   @param key - hash table key
+ *   @param value - value for table entry (copied)
+ *   @returns handle for completion operations
+ */
+pdht_handle_t pdht_nbput(pdht_t *dht, void *key, void *value) {
+  pdht_nbreq_t *req;
+  int h;
+
+  h = pdht_nb_alloc();
+  if (h == PDHT_NULL_HANDLE)
+    return PDHT_NULL_HANDLE;
+
+  req = &c->nbpool[h];
+  req->dht    = dht;
+  req->rank   = c->rank;
+  req->status = pdht_put(dht, key, value);
+  req->state  = PDHT_NB_DONE;
+  return h;
+}
+
+
+
+/**
+ * pdht_nbget - gets an entry from the global hash table without waiting for it
+ *   @param key - hash table key (copied)
+ *   @param value - buffer for the value, must stay valid until the get completes
+ *   @returns handle for completion operations, PDHT_NULL_HANDLE if every
+ *            pool entry is waiting on pdht_test()/pdht_wait()
+ */
+pdht_handle_t pdht_nbget(pdht_t *dht, void *key, void *value) {
+  ptl_process_t rank;
+  uint64_t mbits;
+  uint32_t ptindex;
+  message_t *msg;
+  reply_t *reply;
+  pdht_nbreq_t *req;
+  int need, h;
+
+  h = pdht_nb_alloc();
+  if (h == PDHT_NULL_HANDLE)
+    return PDHT_NULL_HANDLE;
+
+  req = &c->nbpool[h];
+  dht->hashfn(dht,key,&mbits,&ptindex,&rank);
+  req->dht   = dht;
+  req->rank  = rank.rank;
+  req->value = value;
+  memset(req->key, 0, PDHT_MAXKEYSIZE);
+  memcpy(req->key, key, dht->keysize);
+
+  if (req->rank == c->rank) {
+    req->status = pdht_get(dht, key, value);
+    req->state  = PDHT_NB_DONE;
+    return h;
+  }
+
+  need = sizeof(reply_t) + dht->elemsize;
+  if (req->rlen < need) {
+    req->rbuf = realloc(req->rbuf, need);
+    if (!req->rbuf) {
+      printf("%d: pdht_nbget: realloc failure. game over.\n", c->rank); fflush(stdout);
+      MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+    req->rlen = need;
+  }
+  reply = (reply_t *)req->rbuf;
+  reply->reqid = PDHT_NULL_HANDLE;
+
+  // receive first, so the reply never waits in the unexpected queue
+  MPI_Irecv(req->rbuf, need, MPI_CHAR, req->rank, PDHT_TAG_NBREPLY, c->comm, &c->nbrecv[h]);
+
+  msg = &req->msg;
+  msg->type     = pdhtGet;
+  msg->rank     = c->rank;
+  msg->ht_index = dht->index;
+  msg->reqid    = h;
+  msg->mbits    = mbits;
+  MPI_Isend(msg, sizeof(message_t), MPI_CHAR, req->rank, PDHT_TAG_COMMAND, c->comm, &req->sreq);
+
+  req->state = PDHT_NB_BUSY;
+  c->nbbusy++;
+  return h;
+}
+
+
+
+/**
+ * pdht_test - checks status of a non-blocking put/get operation
+ *   the handle is released once this returns anything but Pending
+ * @param h handle of pending operation
+ * @returns status of operation, Pending if it's still in flight
+ */
+pdht_status_t pdht_test(pdht_handle_t h) {
+  pdht_nbreq_t *req;
+
+  if ((h < 0) || (h >= PDHT_NB_REQS) || !c->nbpool)
+    return PdhtStatusError;
+
+  req = &c->nbpool[h];
+  if (req->state == PDHT_NB_BUSY)
+    pdht_nb_progress(0);
+  if (req->state != PDHT_NB_DONE)
+    return req->state == PDHT_NB_BUSY ? PdhtStatusPending : PdhtStatusError;
+
+  req->state = PDHT_NB_FREE;
+  return req->status;
+}
+
+
+
+/**
+ * pdht_wait - blocks process until a non-blocking operation completes
+ *   and releases its handle
+ * @param h handle of pending operation
+ * @returns status of operation
+ */
+pdht_status_t pdht_wait(pdht_handle_t h) {
+  if ((h < 0) || (h >= PDHT_NB_REQS) || !c->nbpool)
+    return PdhtStatusError;
+
+  while (c->nbpool[h].state == PDHT_NB_BUSY)
+    pdht_nb_progress(1);
+  return pdht_test(h);
+}
+
+
+
+/**
+ * pdht_waitrank - blocks process until all non-blocking operations wrt one process rank
+ *   complete, and releases their handles
+ * @param rank - owner rank
+ * @returns Error if any of the operations failed, OK otherwise
+ */
+pdht_status_t pdht_waitrank(int rank) {
+  pdht_status_t ret = PdhtStatusOK;
+
+  for (int h=0; c->nbpool && h < PDHT_NB_REQS; h++) {
+    if ((c->nbpool[h].state != PDHT_NB_FREE) && (c->nbpool[h].rank == rank))
+      if (pdht_wait(h) == PdhtStatusError)
+        ret = PdhtStatusError;
+  }
+  return ret;
+}
+
+
+
+/**
+ * pdht_waitall - blocks process until all non-blocking operations complete
+ *   and releases their handles
+ * @returns Error if any of the operations failed, OK otherwise
+ */
+pdht_status_t pdht_waitall(void) {
+  pdht_status_t ret = PdhtStatusOK;
+
+  for (int h=0; c->nbpool && h < PDHT_NB_REQS; h++) {
+    if (c->nbpool[h].state != PDHT_NB_FREE)
+      if (pdht_wait(h) == PdhtStatusError)
+        ret = PdhtStatusError;
+  }
+  return ret;
+}
+
+
+
+/**
+ * pdht_nb_fini - releases the request pool, nothing is in flight by now
+ */
+void pdht_nb_fini(void) {
+  if (!c->nbpool)
+    return;
+
+  for (int h=0; h < PDHT_NB_REQS; h++)
+    free(c->nbpool[h].rbuf);
+  free(c->nbpool);
+  free(c->nbrecv);
+  c->nbpool = NULL;
+  c->nbrecv = NULL;
+}
+
+
+
+/**
+ * pdht_nb_alloc - finds a free pool entry
+ *   an entry is only reusable once its receive has completed too
+ * @returns pool index, or PDHT_NULL_HANDLE if all are held by the caller
+ */
+static int pdht_nb_alloc(void) {
+  if (!c->nbpool) {
+    c->nbpool = calloc(PDHT_NB_REQS, sizeof(pdht_nbreq_t));
+    c->nbrecv = malloc(PDHT_NB_REQS * sizeof(MPI_Request));
+    for (int h=0; h < PDHT_NB_REQS; h++)
+      c->nbrecv[h] = MPI_REQUEST_NULL;
+  }
+
+  for (;;) {
+    for (int h=0; h < PDHT_NB_REQS; h++)
+      if ((c->nbpool[h].state == PDHT_NB_FREE) && (c->nbrecv[h] == MPI_REQUEST_NULL))
+        return h;
+    if (c->nbbusy == 0)
+      return PDHT_NULL_HANDLE;
+    pdht_nb_progress(1);
+  }
+}
+
+
+
+/**
+ * pdht_nb_progress - completes gets whose replies have arrived
+ * @param block - wait for at least one reply
+ */
+static void pdht_nb_progress(int block) {
+  int idx[PDHT_NB_REQS];
+  pdht_nbreq_t *req;
+  reply_t *reply;
+  int n;
+
+  if (block)
+    MPI_Waitsome(PDHT_NB_REQS, c->nbrecv, &n, idx, MPI_STATUSES_IGNORE);
+  else
+    MPI_Testsome(PDHT_NB_REQS, c->nbrecv, &n, idx, MPI_STATUSES_IGNORE);
+
+  for (int i=0; (n != MPI_UNDEFINED) && (i < n); i++) {
+    reply = (reply_t *)c->nbpool[idx[i]].rbuf;
+    if ((reply->reqid < 0) || (reply->reqid >= PDHT_NB_REQS) ||
+        (c->nbpool[reply->reqid].state != PDHT_NB_BUSY)) {
+      printf("%d: pdht_nb_progress: reply for unknown request %d. game over.\n", c->rank, reply->reqid);
+      MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+    req = &c->nbpool[reply->reqid];
+
+    if (reply->status == 0)
+      req->status = PdhtStatusNotFound;
+    else if (memcmp(&reply->key, req->key, req->dht->keysize) != 0)
+      req->status = PdhtStatusCollision;
+    else {
+      memcpy(req->value, &reply->value, req->dht->elemsize);
+      req->status = PdhtStatusOK;
+    }
+    // the owner has answered, so this can't block
+    MPI_Wait(&req->sreq, MPI_STATUS_IGNORE);
+    req->state = PDHT_NB_DONE;
+    c->nbbusy--;
+  }
+}
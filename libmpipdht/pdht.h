@@ -9,7 +9,6 @@
 #include <unistd.h>
 
 #include <portals4.h>
-#include "uthash.h"
 #include "mpi.h"
 
 /* timer definitions */
@@ -30,6 +29,13 @@ typedef struct pdht_timer_s pdht_timer_t;
 #define PDHT_MAXKEYSIZE 32
 #define PDHT_MAX_COUNTERS 20
 
+#define PDHT_TABLE_INIT_BITS 10                    // initial partition size is 2^bits slots
+#define PDHT_TABLE_STRIDE    0x9e3779b97f4a7c15ULL // mixes match bits into a home slot
+#define PDHT_RMA_SLOTS       4    // slots fetched by one RMA get, covers most probe runs at 3/4 load
+#define PDHT_RMA_RETRIES     16   // re-reads of a slot run torn by the owner before asking it instead
+#define PDHT_AGGR_BYTES      16384 // put batch size per destination
+#define PDHT_NB_REQS         256   // non-blocking gets in flight per process
+
 #define PDHT_START_ATIMER(TMR) TMR.last   = MPI_Wtime();
 #define PDHT_STOP_ATIMER(TMR) do {\
                                   TMR.temp = MPI_Wtime();\
@@ -69,7 +75,7 @@ struct pdht_s; // forward ref
 typedef void (*pdht_hashfunc)(struct pdht_s *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank);
 
 // message types
-typedef enum { pdhtGet, pdhtPut, pdhtStop, pdhtCounterInit, pdhtCounterReset, pdhtCounterInc, pdhtCreateHt } msg_type;
+typedef enum { pdhtGet, pdhtPut, pdhtStop, pdhtCounterInc, pdhtCswap } msg_type; // pdhtPut carries a batch, see pdht_aggr_t
 
 enum pdht_datatype_e {
   IntType,
@@ -94,26 +100,65 @@ struct pdht_context_s {
   int            size;  
   struct pdht_s *hts[PDHT_MAX_TABLES]; // active HTs
   int            dhtcount;             // # active HTs
-  pthread_t      comm_tid;             // tid of comm thread
-  int            thread_active;        // comm thread status
+  pthread_t      comm_tid;             // tid of server thread
+  int            thread_active;        // server thread status
   MPI_Datatype   msgType;              // registered MPI datatype for structured comms
   int            maxbufsize;           // maximum MPI receive buffer size for all HTs
-  MPI_Comm       split_comm;
+  MPI_Comm       comm;                 // private communicator for PDHT requests and collectives
+  int            mpi_owner;            // we initialized MPI, so we finalize it
   int            pid;
-  int           *reply_buf;
+  struct pdht_nbreq_s *nbpool;        // non-blocking gets (allocated on first use)
+  MPI_Request   *nbrecv;               // reply receives, one per pool entry
+  int            nbbusy;               // entries waiting for a reply
 };
 typedef struct pdht_context_s pdht_context_t;
 
 extern pdht_context_t *c;
 
-/* MPI private UTHASH HT entry structure */
-struct ht_s{
-  uint64_t key;
-  void *value;
-  UT_hash_handle hh;
-  
+/* partition slot, key (padded to PDHT_MAXKEYSIZE), value and a uint64_t tail
+ * version follow inline. head == tail unless the owner is writing the slot (table.c) */
+struct pdht_slot_s{
+  uint64_t head;
+  uint64_t mbits;
+  uint64_t used;          // PDHT_SLOT_*
+  char     kv[0];
+};
+typedef struct pdht_slot_s pdht_slot_t;
+
+#define PDHT_SLOT_EMPTY 0
+#define PDHT_SLOT_USED  1
+#define PDHT_SLOT_MOVED 2 // slot of an array replaced since the last fence
+
+/* slot array replaced by a bigger one, still exposed until the next fence (rma.c) */
+struct pdht_retired_s{
+  char                  *slots;
+  struct pdht_retired_s *next;
 };
-typedef struct ht_s ht_t;
+
+/* one-sided access to every rank's partition (rma.c) */
+struct pdht_rma_s{
+  MPI_Win                win;
+  int                    enabled;
+  MPI_Aint              *base;    // slot array address on each rank, as of the last fence
+  unsigned              *bits;    // log2(nslots) on each rank, as of the last fence
+  char                  *buf;     // fetched slots
+  struct pdht_retired_s *retired; // our replaced slot arrays
+};
+typedef struct pdht_rma_s pdht_rma_t;
+
+
+/* per-destination put batching: a message_t (mbits holds the record count)
+ * followed by (mbits, key + value) records. the owner acks each batch with
+ * its record count, pdht_fence() waits for every put to be acked (putget.c) */
+struct pdht_aggr_s{
+  char        *buf[2];   // one filling, one possibly in flight
+  int          fill;     // buffer being filled
+  int          len;      // bytes used in the filling buffer
+  MPI_Request  req;      // send of the other buffer
+  uint64_t     sent;     // puts sent since the last fence
+  uint64_t     acked;    // puts the owner has applied
+};
+typedef struct pdht_aggr_s pdht_aggr_t;
 
 
 /* request message structure for PDHT ops */
@@ -121,6 +166,7 @@ struct message_s {
   msg_type         type;
   int              rank;
   int              ht_index;
+  int              reqid;   // echoed in the reply, PDHT_NULL_HANDLE for blocking gets
   ptl_match_bits_t mbits;
   char             key[0];  // optional payload for put requests
 };
@@ -129,6 +175,7 @@ typedef struct message_s message_t;
 
 /* reply message structure (for casting) */
 struct reply_s {
+  int              reqid;   // from the request
   char             status;  // found / not found bit
   char             key[PDHT_MAXKEYSIZE];
   char             value[0];
@@ -140,7 +187,30 @@ typedef struct reply_s reply_t;
 #define PDHT_TAG_REPLY      2
 #define PDHT_TAG_ACK        3
 #define PDHT_COUNTER_REPLY  4
-#define PDHT_CREATE_HT      5 
+#define PDHT_TAG_NBREPLY    5
+
+/* non-blocking get, handles index the request pool (nbputget.c) */
+#define PDHT_NULL_HANDLE -1
+typedef int pdht_handle_t;
+
+struct pdht_nbreq_s{
+  int              state;    // PDHT_NB_*
+  int              rank;     // owner being asked
+  struct pdht_s   *dht;
+  void            *value;    // caller's buffer
+  int              status;   // pdht_status_t of a finished get
+  MPI_Request      sreq;     // request send
+  message_t        msg;      // request
+  char            *rbuf;     // reply buffer, its receive is c->nbrecv[handle]
+  int              rlen;
+  char             key[PDHT_MAXKEYSIZE];
+};
+typedef struct pdht_nbreq_s pdht_nbreq_t;
+
+#define PDHT_NB_FREE 0
+#define PDHT_NB_BUSY 1 // waiting for the reply
+#define PDHT_NB_DONE 2 // finished, waiting for pdht_test()/pdht_wait()
+
 
 /* fake tuning structure to not break regular PDHT benches/apps */
 //tuning stuff that is not used
@@ -169,19 +239,39 @@ typedef struct pdht_config_s pdht_config_t;
 
 /* MPI implementation for a PDHT table */
 struct pdht_s{
-  ht_t          *ht;
+  char          *slots;         // open addressed partition, nslots * slotsize bytes
+  uint64_t       nslots;
+  uint64_t       used;
+  unsigned       slotsize;
+  unsigned       slotbits;      // log2(nslots)
   pdht_hashfunc  hashfn;
   unsigned       elemsize;
   unsigned       keysize;
   int            fuckups;
   pdht_ptl_t     ptl;
-  pthread_mutex_t *uthash_lock;
-  uint64_t       counters[PDHT_MAX_COUNTERS];//only used by rank 0
+  pthread_mutex_t *table_lock;  // guards the partition and counters
+  uint64_t      *counters;      // PDHT_MAX_COUNTERS, only used by rank 0
   int            counter_count;
+  MPI_Win        counter_win;   // exposes counters for MPI_Fetch_and_op
+  int            counter_rma;   // counter_win is usable, else the holder's server thread counts
+  int            index;         // slot in c->hts, same on every rank
+  pdht_rma_t     rma;
+  pdht_aggr_t   *aggr;          // put batches, one per destination (allocated on first use)
+  unsigned       recsize;       // size of one batched put record
 };
 typedef struct pdht_s pdht_t;
 
 
+/* local iteration over a table's partition (table.c) */
+struct pdht_iter_s {
+  pdht_t   *dht;
+  char     *slots;   // slot array being walked, taken under the table lock
+  uint64_t  nslots;
+  uint64_t  slot;
+};
+typedef struct pdht_iter_s pdht_iter_t;
+
+
 /* legacy/compatibility definitions */
 enum pdht_mode_e{
   PdhtModeStrict,
@@ -200,7 +290,8 @@ enum pdht_status_e{
   PdhtStatusOK,
   PdhtStatusError,
   PdhtStatusNotFound,
-  PdhtStatusCollision
+  PdhtStatusCollision,
+  PdhtStatusPending    // non-blocking operation still in flight
 };
 typedef enum pdht_status_e pdht_status_t;
 
@@ -214,10 +305,25 @@ pdht_status_t pdht_put(pdht_t *dht, void *key, void *value);
 pdht_status_t pdht_get(pdht_t *dht, void *key, void *value);
 pdht_status_t pdht_update(pdht_t *dht, void *key, void *value);
 pdht_status_t pdht_persistent_get(pdht_t *dht, void *key, void *value);
+pdht_status_t pdht_insert(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex, void *key, void *value);
+pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new);
+pdht_handle_t pdht_nbput(pdht_t *dht, void *key, void *value);
+pdht_handle_t pdht_nbget(pdht_t *dht, void *key, void *value);
+pdht_status_t pdht_test(pdht_handle_t h);
+pdht_status_t pdht_wait(pdht_handle_t h);
+pdht_status_t pdht_waitrank(int rank);
+pdht_status_t pdht_waitall(void);
 
 //commsynch
+//iteration over the local part of a table (after a fence)
+pdht_status_t pdht_iterate(pdht_t *dht, pdht_iter_t *it);
+int pdht_hasnext(pdht_iter_t *it);
+void *pdht_getnext(pdht_iter_t *it, void **key);
+
 void pdht_barrier(void);
 void pdht_fence(pdht_t *dht);
+void pdht_counter_create(pdht_t *ht);
+void pdht_counter_destroy(pdht_t *ht);
 int pdht_counter_init(pdht_t *ht, uint64_t initval);
 void pdht_counter_reset(pdht_t *ht, int counter);
 uint64_t pdht_counter_inc(pdht_t *ht, int counter, uint64_t val);
@@ -231,6 +337,47 @@ void    pdht_print_active(pdht_t *dht, void kprinter(void *key), void vprinter(v
 double  pdht_average_time(pdht_t *dht, pdht_timer_t timer);
 void    pdht_allreduce(void *in, void *out, pdht_reduceop_t op, pdht_datatype_t type, int elems);
 
+//server side (init.c)
+void pdht_local_get(pdht_t *dht, uint64_t mbits, reply_t *reply);
+void pdht_local_put(pdht_t *dht, uint64_t mbits, void *kv);
+
+//partition storage (table.c)
+void  pdht_table_init(pdht_t *dht);
+void  pdht_table_fini(pdht_t *dht);
+void *pdht_table_find(pdht_t *dht, uint64_t mbits);
+void  pdht_table_store(pdht_t *dht, uint64_t mbits, void *kv);
+pdht_status_t pdht_table_cswap(pdht_t *dht, uint64_t mbits, void *key, size_t offset, int64_t *old, int64_t new);
+
+//non-blocking gets (nbputget.c)
+void pdht_nb_fini(void);
+
+//put batching (putget.c)
+void pdht_put_flush(pdht_t *dht);
+
+//one-sided gets (rma.c)
+void          pdht_rma_init(pdht_t *dht);
+void          pdht_rma_fini(pdht_t *dht);
+void          pdht_rma_expose(pdht_t *dht, char *slots, uint64_t nslots);
+void          pdht_rma_retire(pdht_t *dht, char *slots, uint64_t nslots);
+void          pdht_rma_refresh(pdht_t *dht);
+pdht_status_t pdht_rma_get(pdht_t *dht, void *key, uint64_t mbits, int rank, void *value);
+
+/**
+ * pdht_slot_home - first slot to probe for a set of match bits in a 2^bits slot array
+ *   custom hash functions often hand back the key itself, mix the bits so
+ *   keys with a common residue (e.g. key % size == rank) still spread out
+ */
+static inline uint64_t pdht_slot_home(uint64_t mbits, unsigned bits) {
+  return (mbits * PDHT_TABLE_STRIDE) >> (64 - bits);
+}
+
+/**
+ * pdht_slot_tail - tail version of a slot
+ */
+static inline uint64_t *pdht_slot_tail(pdht_t *dht, pdht_slot_t *s) {
+  return (uint64_t *)((char *)s + dht->slotsize - sizeof(uint64_t)); // pointer math
+}
+
 //hash
 void pdht_sethash(pdht_t *dht,pdht_hashfunc hfun);
 void pdht_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank);
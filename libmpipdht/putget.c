@@ -17,37 +17,41 @@ pdht_status_t pdht_get(pdht_t *dht, void *key, void *value){
   char rbuf[sizeof(reply_t) + dht->elemsize]; 
   message_t *msg;
   reply_t *reply;
-  ht_t *instance;
   MPI_Status status;
   int ret;
   int target_rank;
 
   dht->hashfn(dht,key,&mbits,&ptindex,&rank); //hashing
 
-  
-  target_rank = rank.rank + (1 - rank.rank % 2);
+  // every rank serves its own partition
+  target_rank = rank.rank;
 
   msg = (message_t *)buf;
   msg->type = pdhtGet;
-
-  for(int i = 0;i < c->dhtcount;i++){
-    if(dht == c->hts[i]){
-      msg->ht_index = i;
-    }
-  }
+  msg->ht_index = dht->index;
   msg->rank = c->rank;
+  msg->reqid = PDHT_NULL_HANDLE;
   msg->mbits = mbits;
-  // go ask remote for the element
-  MPI_Send(msg, sizeof(message_t), MPI_CHAR, target_rank, PDHT_TAG_COMMAND, MPI_COMM_WORLD); 
+  reply = (reply_t *)rbuf;
 
-  //MPI_Send(&mbits,sizeof(mbits),MPI_UNSIGNED_LONG_LONG,rank.rank,2,MPI_COMM_WORLD);//matchbits of the thing i want
+  if (target_rank == c->rank) {
+    // our own partition, no need to bother the server thread
+    pdht_local_get(dht, mbits, reply);
+  } else {
+    // read it straight out of the owner's window if we can
+    ret = pdht_rma_get(dht, key, mbits, target_rank, value);
+    if (ret != PdhtStatusError)
+      return ret;
 
-  ret = MPI_Recv(rbuf, sizeof(rbuf), MPI_CHAR, target_rank, PDHT_TAG_REPLY,
-                 MPI_COMM_WORLD,&status);
+    // go ask remote for the element
+    MPI_Send(msg, sizeof(message_t), MPI_CHAR, target_rank, PDHT_TAG_COMMAND, c->comm); 
 
-  assert(ret == MPI_SUCCESS);
+    ret = MPI_Recv(rbuf, sizeof(rbuf), MPI_CHAR, target_rank, PDHT_TAG_REPLY,
+                   c->comm,&status);
+
+    assert(ret == MPI_SUCCESS);
+  }
 
-  reply = (reply_t *)rbuf;
   if (reply->status == 0) 
     return PdhtStatusNotFound;
 
@@ -61,8 +65,64 @@ pdht_status_t pdht_get(pdht_t *dht, void *key, void *value){
 
 
 
+/**
+ * pdht_aggr_send - sends the filling batch to its owner, caller has checked it's not empty
+ * @param dht - hash table
+ * @param dest - owner rank
+ */
+static void pdht_aggr_send(pdht_t *dht, int dest) {
+  pdht_aggr_t *ag = &dht->aggr[dest];
+  message_t *msg = (message_t *)ag->buf[ag->fill];
+
+  msg->type     = pdhtPut;
+  msg->rank     = c->rank;
+  msg->ht_index = dht->index;
+  msg->mbits    = (ag->len - sizeof(message_t)) / dht->recsize;
+  ag->sent     += msg->mbits;
+
+  // the other buffer must be done before we fill it again
+  MPI_Wait(&ag->req, MPI_STATUS_IGNORE);
+  MPI_Isend(msg, ag->len, MPI_CHAR, dest, PDHT_TAG_COMMAND, c->comm, &ag->req);
+  ag->fill = !ag->fill;
+  ag->len  = sizeof(message_t);
+}
+
+
+
+/**
+ * pdht_put_flush - sends every partial batch and waits for all puts to be acked
+ * @param dht - hash table
+ */
+void pdht_put_flush(pdht_t *dht) {
+  pdht_aggr_t *ag;
+  uint64_t n;
+
+  if (!dht->aggr)
+    return;
+
+  for (int i=0; i < c->size; i++) {
+    ag = &dht->aggr[i];
+    if (ag->len > sizeof(message_t))
+      pdht_aggr_send(dht, i);
+  }
+
+  for (int i=0; i < c->size; i++) {
+    ag = &dht->aggr[i];
+    if (!ag->buf[0])
+      continue;
+    MPI_Wait(&ag->req, MPI_STATUS_IGNORE);
+    while (ag->acked < ag->sent) {
+      MPI_Recv(&n, 1, MPI_UINT64_T, i, PDHT_TAG_ACK, c->comm, MPI_STATUS_IGNORE);
+      ag->acked += n;
+    }
+  }
+}
+
+
+
 /**
  * pdht_put - adds an entry to the global hash table
+ *   remote puts are batched per owner, they are visible everywhere after pdht_fence()
  *   @param key - hash table key
  *   @param ksize - size of key
  *   @param value - value for table entry
@@ -72,34 +132,51 @@ pdht_status_t pdht_put(pdht_t *dht, void *key, void *value){
   ptl_process_t rank;
   uint64_t mbits;
   uint32_t ptindex;
-  ht_t *instance;
-  message_t *msg;
-  MPI_Status status;
-  int flag;
+  pdht_aggr_t *ag;
+  char *rec;
   int target_rank;
-  char sbuf[sizeof(message_t) + PDHT_MAXKEYSIZE + dht->elemsize];
 
   dht->hashfn(dht,key,&mbits,&ptindex,&rank);
+  target_rank = rank.rank;
 
+  if (target_rank == c->rank) {
+    char kv[PDHT_MAXKEYSIZE + dht->elemsize];
+    memcpy(kv, key, dht->keysize);
+    memcpy(kv + PDHT_MAXKEYSIZE, value, dht->elemsize);
+    pdht_local_put(dht, mbits, kv);
+    return PdhtStatusOK;
+  }
 
-  // prepare command message
-  msg = (message_t *)sbuf;
-  msg->type = pdhtPut;
-  msg->rank = c->rank;
-  msg->mbits= mbits;
+  if (!dht->aggr)
+    dht->aggr = calloc(c->size, sizeof(pdht_aggr_t));
+  ag = &dht->aggr[target_rank];
+  if (!ag->buf[0]) {
+    ag->buf[0] = malloc(PDHT_AGGR_BYTES);
+    ag->buf[1] = malloc(PDHT_AGGR_BYTES);
+    ag->req    = MPI_REQUEST_NULL;
+    ag->len    = sizeof(message_t);
+  }
 
-  target_rank = rank.rank + (1 - rank.rank % 2);
-  for(int i = 0;i < c->dhtcount;i++){
-    if(dht == c->hts[i]){
-      msg->ht_index = i;
+  // large values may not fit PDHT_AGGR_BYTES twice, send what we have first
+  if (ag->len + dht->recsize > PDHT_AGGR_BYTES) {
+    if (ag->len > sizeof(message_t))
+      pdht_aggr_send(dht, target_rank);
+    if (sizeof(message_t) + dht->recsize > PDHT_AGGR_BYTES) {
+      MPI_Wait(&ag->req, MPI_STATUS_IGNORE);
+      ag->buf[0] = realloc(ag->buf[0], sizeof(message_t) + dht->recsize);
+      ag->buf[1] = realloc(ag->buf[1], sizeof(message_t) + dht->recsize);
     }
   }
-  memcpy(msg->key, key, dht->keysize);
-  memcpy(msg->key + PDHT_MAXKEYSIZE, value, dht->elemsize);
-  // send command message to target
-  MPI_Send(sbuf, sizeof(sbuf), MPI_CHAR, target_rank,
-           PDHT_TAG_COMMAND ,MPI_COMM_WORLD);
-  MPI_Recv(c->reply_buf, 1, MPI_INT, target_rank, PDHT_TAG_REPLY, MPI_COMM_WORLD, &status);
+
+  rec = ag->buf[ag->fill] + ag->len; // pointer math
+  memcpy(rec, &mbits, sizeof(uint64_t));
+  memset(rec + sizeof(uint64_t), 0, PDHT_MAXKEYSIZE);
+  memcpy(rec + sizeof(uint64_t), key, dht->keysize);
+  memcpy(rec + sizeof(uint64_t) + PDHT_MAXKEYSIZE, value, dht->elemsize);
+  ag->len += dht->recsize;
+
+  if (ag->len + dht->recsize > PDHT_AGGR_BYTES)
+    pdht_aggr_send(dht, target_rank);
   return PdhtStatusOK;
 }
 
@@ -113,3 +190,79 @@ pdht_status_t pdht_persistent_get(pdht_t *dht, void *key, void *value){
 pdht_status_t pdht_update(pdht_t *dht, void *key, void *value){
   return pdht_put(dht,key,value);
 }
+
+
+
+/**
+ * pdht_insert - inserts an entry we own, with its hash already computed
+ *  @param bits - hashed key
+ *  @param ptindex - unused
+ *  @param key - hash table key
+ *  @param value - value for table entry
+ *  @returns status of operation
+ */
+pdht_status_t pdht_insert(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex, void *key, void *value) {
+  char kv[PDHT_MAXKEYSIZE + dht->elemsize];
+
+  memset(kv, 0, PDHT_MAXKEYSIZE);
+  memcpy(kv, key, dht->keysize);
+  memcpy(kv + PDHT_MAXKEYSIZE, value, dht->elemsize);
+  pdht_local_put(dht, bits, kv);
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_atomic_cswap - atomic compare/swap on a 64-bit word inside an entry
+ *   done by the owner, under the same lock as its puts
+ * @param ht - a PDHT hash table
+ * @param key - the key of the value to atomically update
+ * @param offset - offset inside the hash table entry to modify
+ * @param old - compare value in, copyout of the remote value _prior_ to the swap
+ * @param new - new value to swap into HT entry
+ * @returns OK, NotFound if there is no such entry, Error for a bad offset
+ */
+pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new) {
+  char buf[sizeof(message_t) + PDHT_MAXKEYSIZE + sizeof(uint64_t) + 2*sizeof(int64_t)];
+  ptl_process_t rank;
+  uint64_t mbits, off = offset;
+  uint32_t ptindex;
+  message_t *msg;
+  int64_t reply[2];
+  char *p;
+  pdht_status_t ret;
+
+  ht->hashfn(ht,key,&mbits,&ptindex,&rank);
+
+  if (rank.rank == c->rank) {
+    pthread_mutex_lock(ht->table_lock);
+    ret = pdht_table_cswap(ht, mbits, key, offset, old, new);
+    pthread_mutex_unlock(ht->table_lock);
+    return ret;
+  }
+
+  // our batched puts to the owner go first
+  if (ht->aggr && (ht->aggr[rank.rank].len > sizeof(message_t)))
+    pdht_aggr_send(ht, rank.rank);
+
+  // key | offset | compare | new
+  msg = (message_t *)buf;
+  msg->type     = pdhtCswap;
+  msg->rank     = c->rank;
+  msg->ht_index = ht->index;
+  msg->reqid    = PDHT_NULL_HANDLE;
+  msg->mbits    = mbits;
+  p = msg->key;
+  memset(p, 0, PDHT_MAXKEYSIZE);
+  memcpy(p, key, ht->keysize);        p += PDHT_MAXKEYSIZE;
+  memcpy(p, &off, sizeof(uint64_t));  p += sizeof(uint64_t);
+  memcpy(p, old, sizeof(int64_t));    p += sizeof(int64_t);
+  memcpy(p, &new, sizeof(int64_t));
+
+  MPI_Send(buf, sizeof(buf), MPI_CHAR, rank.rank, PDHT_TAG_COMMAND, c->comm);
+  MPI_Recv(reply, 2, MPI_INT64_T, rank.rank, PDHT_TAG_REPLY, c->comm, MPI_STATUS_IGNORE);
+
+  *old = reply[1];
+  return (pdht_status_t)reply[0];
+}
@@ -0,0 +1,213 @@
+#include <pdht.h>
+
+extern pdht_context_t *c;
+
+/*
+ * one-sided gets: every rank's slot array is attached to a dynamic MPI window,
+ * and a get fetches the run of slots starting at the key's home with MPI_Get,
+ * without the owner's server thread. puts stay two-sided.
+ *
+ * slot array addresses are exchanged collectively, at create and at every
+ * fence. an owner that grows its array keeps the old one attached until the
+ * next fence with every slot marked moved, so readers with stale addresses
+ * are sent to the owner rather than reading values it no longer updates.
+ */
+
+
+
+/**
+ * pdht_rma_init - creates the window and exposes our partition
+ *   collective, called from pdht_create()
+ * @param dht - hash table
+ */
+void pdht_rma_init(pdht_t *dht) {
+  int *model, flag, ret;
+
+  // not every RMA component does dynamic windows (e.g. Open MPI on a single rank)
+  MPI_Comm_set_errhandler(c->comm, MPI_ERRORS_RETURN);
+  ret = MPI_Win_create_dynamic(MPI_INFO_NULL, c->comm, &dht->rma.win);
+  MPI_Comm_set_errhandler(c->comm, MPI_ERRORS_ARE_FATAL);
+
+  // the owner updates slots with plain stores, remote gets have to see them
+  dht->rma.enabled = 0;
+  if (ret == MPI_SUCCESS) {
+    MPI_Win_get_attr(dht->rma.win, MPI_WIN_MODEL, &model, &flag);
+    dht->rma.enabled = flag && (*model == MPI_WIN_UNIFIED);
+  }
+  pdht_allreduce(&dht->rma.enabled, &flag, PdhtReduceOpMin, IntType, 1);
+
+  if (!flag) {
+    if (ret == MPI_SUCCESS)
+      MPI_Win_free(&dht->rma.win);
+    dht->rma.enabled = 0;
+    if ((c->rank == 0) && (c->size > 1))
+      printf("pdht_rma_init: no dynamic window with unified memory, gets will be two-sided\n");
+    return;
+  }
+
+  dht->rma.base = calloc(c->size, sizeof(MPI_Aint));
+  dht->rma.bits = calloc(c->size, sizeof(unsigned));
+  dht->rma.buf  = malloc(PDHT_RMA_SLOTS * dht->slotsize);
+
+  pthread_mutex_lock(dht->table_lock);
+  pdht_rma_expose(dht, dht->slots, dht->nslots);
+  pthread_mutex_unlock(dht->table_lock);
+
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, dht->rma.win);
+  pdht_rma_refresh(dht);
+}
+
+
+
+/**
+ * pdht_rma_fini - releases the window
+ *   collective, called from pdht_free()
+ * @param dht - hash table
+ */
+void pdht_rma_fini(pdht_t *dht) {
+  struct pdht_retired_s *r;
+
+  if (!dht->rma.enabled)
+    return;
+
+  MPI_Win_unlock_all(dht->rma.win);
+  MPI_Win_detach(dht->rma.win, dht->slots);
+  while ((r = dht->rma.retired) != NULL) {
+    dht->rma.retired = r->next;
+    MPI_Win_detach(dht->rma.win, r->slots);
+    free(r->slots);
+    free(r);
+  }
+  MPI_Win_free(&dht->rma.win);
+
+  free(dht->rma.base);
+  free(dht->rma.bits);
+  free(dht->rma.buf);
+  dht->rma.enabled = 0;
+}
+
+
+
+/**
+ * pdht_rma_expose - attaches a slot array to the window, caller holds the table lock
+ * @param dht - hash table
+ * @param slots - slot array
+ * @param nslots - number of slots
+ */
+void pdht_rma_expose(pdht_t *dht, char *slots, uint64_t nslots) {
+  if (dht->rma.enabled)
+    MPI_Win_attach(dht->rma.win, slots, nslots * dht->slotsize);
+}
+
+
+
+/**
+ * pdht_rma_retire - queues a replaced slot array for release at the next fence
+ *   caller holds the table lock
+ * @param dht - hash table
+ * @param slots - slot array
+ * @param nslots - number of slots
+ */
+void pdht_rma_retire(pdht_t *dht, char *slots, uint64_t nslots) {
+  struct pdht_retired_s *r;
+
+  if (!dht->rma.enabled) {
+    free(slots);
+    return;
+  }
+
+  r = malloc(sizeof(struct pdht_retired_s));
+  r->slots = slots;
+  r->next  = dht->rma.retired;
+  dht->rma.retired = r;
+}
+
+
+
+/**
+ * pdht_rma_refresh - exchanges slot array addresses and drops retired arrays
+ *   collective, called from pdht_create() and pdht_fence()
+ * @param dht - hash table
+ */
+void pdht_rma_refresh(pdht_t *dht) {
+  struct pdht_retired_s *r;
+  MPI_Aint base;
+  unsigned bits;
+
+  if (!dht->rma.enabled)
+    return;
+
+  pthread_mutex_lock(dht->table_lock);
+  MPI_Get_address(dht->slots, &base);
+  bits = dht->slotbits;
+  r = dht->rma.retired;
+  dht->rma.retired = NULL;
+  pthread_mutex_unlock(dht->table_lock);
+
+  // once everyone has the new addresses, nobody reads the old arrays
+  MPI_Allgather(&base, 1, MPI_AINT, dht->rma.base, 1, MPI_AINT, c->comm);
+  MPI_Allgather(&bits, 1, MPI_UNSIGNED, dht->rma.bits, 1, MPI_UNSIGNED, c->comm);
+
+  while (r) {
+    struct pdht_retired_s *next = r->next;
+    MPI_Win_detach(dht->rma.win, r->slots);
+    free(r->slots);
+    free(r);
+    r = next;
+  }
+}
+
+
+
+/**
+ * pdht_rma_get - reads an entry out of a remote partition
+ * @param dht - hash table
+ * @param key - key to find
+ * @param mbits - hashed key
+ * @param rank - owner of key
+ * @param value - buffer for the value
+ * @returns OK or NotFound, Error if the owner has to be asked instead
+ */
+pdht_status_t pdht_rma_get(pdht_t *dht, void *key, uint64_t mbits, int rank, void *value) {
+  unsigned bits;
+  uint64_t home, n;
+  pdht_slot_t *s;
+  int torn;
+
+  if (!dht->rma.enabled)
+    return PdhtStatusError;
+
+  // probe runs don't wrap, the owner handles the rare run past the end
+  bits = dht->rma.bits[rank];
+  home = pdht_slot_home(mbits, bits);
+  n = (1UL << bits) - home;
+  n = n < PDHT_RMA_SLOTS ? n : PDHT_RMA_SLOTS;
+
+  for (int retry=0; retry < PDHT_RMA_RETRIES; retry++) {
+    MPI_Get(dht->rma.buf, n * dht->slotsize, MPI_BYTE, rank, dht->rma.base[rank] + home * dht->slotsize,
+            n * dht->slotsize, MPI_BYTE, dht->rma.win);
+    MPI_Win_flush_local(rank, dht->rma.win);
+
+    torn = 0;
+    for (uint64_t i=0; i < n; i++) {
+      s = (pdht_slot_t *)(dht->rma.buf + i * dht->slotsize); // pointer math
+      if (s->head != *pdht_slot_tail(dht, s)) {
+        torn = 1;
+        break;
+      }
+      if (s->used == PDHT_SLOT_EMPTY)
+        return PdhtStatusNotFound;
+      if (s->used == PDHT_SLOT_MOVED)
+        return PdhtStatusError;
+      if (s->mbits == mbits) {
+        if (memcmp(s->kv, key, dht->keysize) != 0)
+          return PdhtStatusCollision;
+        memcpy(value, s->kv + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
+        return PdhtStatusOK;
+      }
+    }
+    if (!torn)
+      return PdhtStatusError; // probe run is longer than our read
+  }
+  return PdhtStatusError;
+}
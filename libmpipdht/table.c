@@ -0,0 +1,275 @@
+#include <pdht.h>
+#include <stddef.h>
+
+extern pdht_context_t *c;
+
+/*
+ * target-side partition storage: a flat open addressed array keyed by match
+ * bits. every slot holds the key (padded to PDHT_MAXKEYSIZE) and the value
+ * inline, so a lookup touches one cache line run and an insert allocates
+ * nothing until the array grows.
+ *
+ * other ranks read the array with one-sided gets (rma.c), so every write is
+ * bracketed by the slot's versions: the tail moves first, then the contents,
+ * then the head catches up. a reader that sees head != tail reads again.
+ */
+
+static void pdht_table_grow(pdht_t *dht);
+
+
+
+/**
+ * pdht_table_init - allocates the slot array for a table
+ * @param dht - hash table
+ */
+void pdht_table_init(pdht_t *dht) {
+  dht->slotsize = sizeof(pdht_slot_t) + PDHT_MAXKEYSIZE + dht->elemsize + sizeof(uint64_t);
+  dht->slotsize = (dht->slotsize + 7) & ~7; // keep headers and tails aligned
+  dht->slotbits = PDHT_TABLE_INIT_BITS;
+  dht->nslots   = 1UL << dht->slotbits;
+  dht->used     = 0;
+  dht->slots    = calloc(dht->nslots, dht->slotsize);
+  if (!dht->slots) {
+    printf("%d: pdht_table_init: calloc failure. game over.\n", c->rank); fflush(stdout);
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+}
+
+
+
+/**
+ * pdht_table_fini - releases the slot array for a table
+ * @param dht - hash table
+ */
+void pdht_table_fini(pdht_t *dht) {
+  free(dht->slots);
+  dht->slots  = NULL;
+  dht->nslots = 0;
+  dht->used   = 0;
+}
+
+
+
+/**
+ * pdht_table_slot - returns a slot by index
+ */
+static inline pdht_slot_t *pdht_table_slot(pdht_t *dht, char *slots, uint64_t i) {
+  return (pdht_slot_t *)(slots + i * dht->slotsize); // pointer math
+}
+
+
+
+/**
+ * pdht_table_write_begin - opens a write to a slot that remote ranks may be reading
+ */
+static inline void pdht_table_write_begin(pdht_t *dht, pdht_slot_t *s) {
+  uint64_t *tail = pdht_slot_tail(dht, s);
+
+  __atomic_store_n(tail, *tail + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE); // keep the slot writes that follow behind the tail bump
+}
+
+
+
+/**
+ * pdht_table_write_end - closes a write opened with pdht_table_write_begin()
+ */
+static inline void pdht_table_write_end(pdht_t *dht, pdht_slot_t *s) {
+  __atomic_store_n(&s->head, *pdht_slot_tail(dht, s), __ATOMIC_RELEASE);
+}
+
+
+
+/**
+ * pdht_table_find - finds the key/value of an entry, caller holds the table lock
+ * @param dht - hash table
+ * @param mbits - hashed key
+ * @returns pointer to key + value, or NULL if not present
+ */
+void *pdht_table_find(pdht_t *dht, uint64_t mbits) {
+  uint64_t mask = dht->nslots - 1;
+  uint64_t i = pdht_slot_home(mbits, dht->slotbits);
+  pdht_slot_t *s;
+
+  for (s = pdht_table_slot(dht, dht->slots, i); s->used; s = pdht_table_slot(dht, dht->slots, i)) {
+    if (s->mbits == mbits)
+      return s->kv;
+    i = (i + 1) & mask;
+  }
+  return NULL;
+}
+
+
+
+/**
+ * pdht_table_store - adds or overwrites an entry, caller holds the table lock
+ * @param dht - hash table
+ * @param mbits - hashed key
+ * @param kv - key (padded to PDHT_MAXKEYSIZE) followed by the value
+ */
+void pdht_table_store(pdht_t *dht, uint64_t mbits, void *kv) {
+  uint64_t mask, i;
+  pdht_slot_t *s;
+
+  // keep the table at most 3/4 full so probe runs stay short
+  if (4 * (dht->used + 1) > 3 * dht->nslots)
+    pdht_table_grow(dht);
+
+  mask = dht->nslots - 1;
+  i = pdht_slot_home(mbits, dht->slotbits);
+  for (s = pdht_table_slot(dht, dht->slots, i); s->used; s = pdht_table_slot(dht, dht->slots, i)) {
+    if (s->mbits == mbits)
+      break;
+    i = (i + 1) & mask;
+  }
+
+  pdht_table_write_begin(dht, s);
+  if (!s->used) {
+    s->used  = PDHT_SLOT_USED;
+    s->mbits = mbits;
+    dht->used++;
+  }
+  memcpy(s->kv, kv, PDHT_MAXKEYSIZE + dht->elemsize);
+  pdht_table_write_end(dht, s);
+}
+
+
+
+/**
+ * pdht_table_grow - doubles the slot array and rehashes every entry
+ *   remote ranks keep reading the old array until the next fence, all of
+ *   its slots are marked so those reads are sent to the owner instead
+ * @param dht - hash table
+ */
+static void pdht_table_grow(pdht_t *dht) {
+  char *old = dht->slots;
+  uint64_t oldn = dht->nslots;
+  pdht_slot_t *s, *n;
+  uint64_t mask, i;
+  char *slots;
+
+  slots = calloc(oldn << 1, dht->slotsize);
+  if (!slots) {
+    printf("%d: pdht_table_grow: calloc failure (%lu slots). game over.\n", c->rank, oldn << 1); fflush(stdout);
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+
+  mask = (oldn << 1) - 1;
+  for (uint64_t j=0; j < oldn; j++) {
+    s = pdht_table_slot(dht, old, j);
+    if (s->used) {
+      i = pdht_slot_home(s->mbits, dht->slotbits + 1);
+      for (n = pdht_table_slot(dht, slots, i); n->used; n = pdht_table_slot(dht, slots, i))
+        i = (i + 1) & mask;
+      memcpy(n, s, dht->slotsize);
+    }
+    // later stores only reach the new array, so no old slot may answer a remote get
+    pdht_table_write_begin(dht, s);
+    s->used = PDHT_SLOT_MOVED;
+    pdht_table_write_end(dht, s);
+  }
+
+  pdht_rma_expose(dht, slots, oldn << 1);
+  dht->slots = slots;
+  dht->slotbits++;
+  dht->nslots = oldn << 1;
+  pdht_rma_retire(dht, old, oldn);
+}
+
+
+
+/**
+ * pdht_table_cswap - compare and swap on a 64-bit word of an entry, caller holds the table lock
+ * @param dht - hash table
+ * @param mbits - hashed key
+ * @param key - key of the entry
+ * @param offset - offset of the word inside the value
+ * @param old - compare value in, value prior to the swap out
+ * @param new - value to swap in
+ * @returns OK, NotFound if there is no such entry, Error for a bad offset
+ */
+pdht_status_t pdht_table_cswap(pdht_t *dht, uint64_t mbits, void *key, size_t offset, int64_t *old, int64_t new) {
+  pdht_slot_t *s;
+  int64_t cur;
+  char *kv;
+
+  kv = pdht_table_find(dht, mbits);
+  if ((!kv) || (memcmp(kv, key, dht->keysize) != 0))
+    return PdhtStatusNotFound;
+  if (offset + sizeof(int64_t) > dht->elemsize)
+    return PdhtStatusError;
+
+  memcpy(&cur, kv + PDHT_MAXKEYSIZE + offset, sizeof(int64_t)); // pointer math
+  if (cur == *old) {
+    s = (pdht_slot_t *)(kv - offsetof(pdht_slot_t, kv)); // pointer math
+    pdht_table_write_begin(dht, s);
+    memcpy(kv + PDHT_MAXKEYSIZE + offset, &new, sizeof(int64_t));
+    pdht_table_write_end(dht, s);
+  }
+  *old = cur;
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_iterate - construct an iterator over the local part of a hash table
+ *   meant for after a fence: the server thread may still store puts from
+ *   other ranks, and one that grows the table ends the walk (with a warning)
+ *  @param dht hash table structure
+ *  @param it a PDHT iterator structure
+ *  @returns status of creation operation
+ */
+pdht_status_t pdht_iterate(pdht_t *dht, pdht_iter_t *it) {
+  pthread_mutex_lock(dht->table_lock);
+  it->dht    = dht;
+  it->slots  = dht->slots;
+  it->nslots = dht->nslots;
+  it->slot   = 0;
+  pthread_mutex_unlock(dht->table_lock);
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_hasnext - checks to see if there is another local entry
+ * @param it a PDHT iterator structure
+ * @returns 1 if next entry is valid, 0 otherwise
+ */
+int pdht_hasnext(pdht_iter_t *it) {
+  pdht_t *dht = it->dht;
+  int more;
+
+  pthread_mutex_lock(dht->table_lock);
+  if (dht->slots != it->slots) {
+    // rehashed under us, the array we were walking may already be gone
+    if (it->slot < it->nslots)
+      printf("%d: pdht_hasnext: table grew during iteration, stopping early\n", c->rank);
+    it->slot = it->nslots;
+  }
+  while ((it->slot < it->nslots) && (pdht_table_slot(dht, it->slots, it->slot)->used != PDHT_SLOT_USED))
+    it->slot++;
+  more = it->slot < it->nslots;
+  pthread_mutex_unlock(dht->table_lock);
+  return more;
+}
+
+
+
+/**
+ * pdht_getnext - returns the next local entry
+ * @param it a PDHT iterator structure
+ * @param key if non-NULL, set to the entry's key
+ * @returns pointer to the entry's value, NULL when done
+ */
+void *pdht_getnext(pdht_iter_t *it, void **key) {
+  pdht_slot_t *s;
+
+  if (!pdht_hasnext(it))
+    return NULL;
+  s = pdht_table_slot(it->dht, it->slots, it->slot++);
+  if (key)
+    *key = s->kv;
+  return s->kv + PDHT_MAXKEYSIZE; // pointer math
+}
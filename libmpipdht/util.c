@@ -20,12 +20,13 @@ int eprintf(const char *format, ...) {
 
 
 void pdht_print_all(pdht_t *dht){
-  ht_t *s;
+  pdht_slot_t *s;
   char buf[PDHT_MAXKEYSIZE + dht->elemsize];
-  int key;
-  int value;
-  for(s = dht->ht;s != NULL;s = (ht_t*)(s->hh.next)){
-    memcpy(buf,s->value,PDHT_MAXKEYSIZE + dht->elemsize);
+  for(uint64_t i = 0;i < dht->nslots;i++){
+    s = (pdht_slot_t *)(dht->slots + i * dht->slotsize);
+    if (!s->used)
+      continue;
+    memcpy(buf,s->kv,PDHT_MAXKEYSIZE + dht->elemsize);
     printf("c->rank : %d key : %d value : %d \n",c->rank, *(int*)buf,*(int*)(buf+PDHT_MAXKEYSIZE));
   }
 }
@@ -46,8 +47,8 @@ void pdht_print_active(pdht_t *dht, void kprinter(void *key), void vprinter(void
 double pdht_average_time(pdht_t *dht, pdht_timer_t timer){
   double global_sum;
   
-  MPI_Reduce(&(timer.total), &global_sum, 1, MPI_DOUBLE, MPI_SUM, 0, c->split_comm);
-  return global_sum * 1000 / (c->size / 2);
+  MPI_Reduce(&(timer.total), &global_sum, 1, MPI_DOUBLE, MPI_SUM, 0, c->comm);
+  return global_sum * 1000 / c->size;
 }
 
 
@@ -79,5 +80,5 @@ void pdht_allreduce(void *in, void *out, pdht_reduceop_t op, pdht_datatype_t typ
       data_type = MPI_DOUBLE;
       break;
   }
-  MPI_Allreduce(in, out, elems, data_type, op_type, c->split_comm);
+  MPI_Allreduce(in, out, elems, data_type, op_type, c->comm);
 }
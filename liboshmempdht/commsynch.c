@@ -0,0 +1,170 @@
+/***********************************************************/
+/*                                                         */
+/*  commsynch.c - PDHT OpenSHMEM backend synchronization   */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+#define PDHT_COUNTER_HOLDER 0
+
+// symmetric scratch for reductions, pSync arrays alternate between calls
+static long   pdht_red_src[PDHT_OSHMEM_REDUCE_MAX];
+static long   pdht_red_dst[PDHT_OSHMEM_REDUCE_MAX];
+static long   pdht_red_wrk[PDHT_OSHMEM_REDUCE_MAX / 2 + SHMEM_REDUCE_MIN_WRKDATA_SIZE];
+static long   pdht_red_sync[2][SHMEM_REDUCE_SYNC_SIZE];
+static int    pdht_red_next = -1;
+
+static void pdht_reduce_chunk(void *in, void *out, pdht_reduceop_t op, pdht_datatype_t type, int elems);
+
+
+
+/**
+ * pdht_barrier - blocks until every PE has arrived and its puts are complete
+ */
+void pdht_barrier(void) {
+  shmem_barrier_all();
+}
+
+
+
+/**
+ * pdht_fence - waits until all puts from all PEs have been applied
+ *   tables that are getting full are grown here, on every PE at once
+ * @param dht hash table
+ */
+void pdht_fence(pdht_t *dht) {
+  shmem_quiet();
+  shmem_barrier_all();
+  pdht_table_resize(dht);
+}
+
+
+
+/**
+ * pdht_reduce_chunk - one shmem reduction of at most PDHT_OSHMEM_REDUCE_MAX elements
+ *   chars are widened to ints, there are no char reductions
+ */
+static void pdht_reduce_chunk(void *in, void *out, pdht_reduceop_t op, pdht_datatype_t type, int elems) {
+  long *sync;
+
+  if (pdht_red_next < 0) {
+    for (int i=0; i < SHMEM_REDUCE_SYNC_SIZE; i++)
+      pdht_red_sync[0][i] = pdht_red_sync[1][i] = SHMEM_SYNC_VALUE;
+    pdht_red_next = 0;
+    shmem_barrier_all();
+  }
+  sync = pdht_red_sync[pdht_red_next];
+  pdht_red_next = !pdht_red_next;
+
+#define PDHT_REDUCE_TO_ALL(T, N) do {                                                              \
+    T *s = (T *)pdht_red_src, *d = (T *)pdht_red_dst, *w = (T *)pdht_red_wrk;                   \
+    switch (op) {                                                                               \
+      case PdhtReduceOpSum: shmem_##N##_sum_to_all(d, s, elems, 0, 0, c->size, w, sync); break; \
+      case PdhtReduceOpMin: shmem_##N##_min_to_all(d, s, elems, 0, 0, c->size, w, sync); break; \
+      case PdhtReduceOpMax: shmem_##N##_max_to_all(d, s, elems, 0, 0, c->size, w, sync); break; \
+    }                                                                                           \
+  } while (0)
+
+  switch (type) {
+    case IntType:
+      memcpy(pdht_red_src, in, elems * sizeof(int));
+      PDHT_REDUCE_TO_ALL(int, int);
+      memcpy(out, pdht_red_dst, elems * sizeof(int));
+      break;
+    case LongType:
+      memcpy(pdht_red_src, in, elems * sizeof(long));
+      PDHT_REDUCE_TO_ALL(long, long);
+      memcpy(out, pdht_red_dst, elems * sizeof(long));
+      break;
+    case DoubleType:
+      memcpy(pdht_red_src, in, elems * sizeof(double));
+      PDHT_REDUCE_TO_ALL(double, double);
+      memcpy(out, pdht_red_dst, elems * sizeof(double));
+      break;
+    case CharType:
+    case BoolType:
+      for (int i=0; i < elems; i++)
+        ((int *)pdht_red_src)[i] = ((char *)in)[i];
+      PDHT_REDUCE_TO_ALL(int, int);
+      for (int i=0; i < elems; i++)
+        ((char *)out)[i] = ((int *)pdht_red_dst)[i];
+      break;
+  }
+#undef PDHT_REDUCE_TO_ALL
+}
+
+
+
+/**
+ * pdht_allreduce - reduces values from all PEs and returns the result to all
+ * @param in local contribution
+ * @param out reduced result
+ * @param op reduction operator
+ * @param type element type
+ * @param elems number of elements
+ * @returns status of operation
+ */
+pdht_status_t pdht_allreduce(void *in, void *out, pdht_reduceop_t op, pdht_datatype_t type, int elems) {
+  int tsize = pdht_typesize(type), n;
+
+  for (int i=0; i < elems; i += n) {
+    n = elems - i < PDHT_OSHMEM_REDUCE_MAX ? elems - i : PDHT_OSHMEM_REDUCE_MAX;
+    pdht_reduce_chunk((char *)in + i * tsize, (char *)out + i * tsize, op, type, n); // pointer math
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/*
+ * pdht_counter_init - collectively initializes a new atomic counter for a hash table
+ * @param ht - a PDHT hash table
+ * @param initval - initial counter value
+ * @returns index of the new counter
+ */
+int pdht_counter_init(pdht_t *ht, int initval) {
+  int cindex;
+
+  if (ht->counter_count >= PDHT_MAX_COUNTERS) {
+    pdht_dprintf("pdht_counter_init: out of counters (max: %d)\n", PDHT_MAX_COUNTERS);
+    return -1;
+  }
+  cindex = ht->counter_count++;
+
+  if (c->rank == PDHT_COUNTER_HOLDER)
+    shmem_ulong_atomic_set(&ht->counters[cindex], (unsigned long)initval, PDHT_COUNTER_HOLDER);
+
+  // no increments before the holder has the initial value
+  shmem_barrier_all();
+  return cindex;
+}
+
+
+
+/**
+ * pdht_counter_reset - collectively reset an HT atomic counter
+ * @param ht - a hash table
+ * @param counter - which counter to reset
+ */
+void pdht_counter_reset(pdht_t *ht, int counter) {
+  if (c->rank == PDHT_COUNTER_HOLDER)
+    shmem_ulong_atomic_set(&ht->counters[counter], 0, PDHT_COUNTER_HOLDER);
+  shmem_barrier_all();
+}
+
+
+
+/**
+ * pdht_counter_inc - increments a counter by a given value
+ * @param ht a hash table
+ * @param counter index of the counter to modify
+ * @param val amount to increment counter by
+ * @returns existing counter value
+ */
+uint64_t pdht_counter_inc(pdht_t *ht, int counter, uint64_t val) {
+  return shmem_ulong_atomic_fetch_add(&ht->counters[counter], val, PDHT_COUNTER_HOLDER);
+}
@@ -0,0 +1,117 @@
+/***********************************************************/
+/*                                                         */
+/*  init.c - PDHT OpenSHMEM backend init/teardown          */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * PE numbers and counts come from OpenSHMEM, run with oshrun (or the
+ * launcher of your SHMEM library). tables live in the symmetric heap, so
+ * its size (SHMEM_SYMMETRIC_SIZE) bounds how far they can grow.
+ */
+
+static void pdht_init(void);
+
+// global pdht context
+pdht_context_t *c = NULL;
+
+// pdht_tune() may come before the first pdht_create()
+static unsigned long pdht_maxentries = PDHT_OSHMEM_DEFAULT_ENTRIES;
+
+
+
+/**
+ * pdht_init - initializes PDHT system
+ */
+static void pdht_init(void) {
+  shmem_init();
+
+  c = (pdht_context_t *)calloc(1, sizeof(pdht_context_t));
+  c->rank       = shmem_my_pe();
+  c->size       = shmem_n_pes();
+  c->maxentries = pdht_maxentries;
+}
+
+
+
+/**
+ * pdht_tune - sets the per PE entry count new tables are sized for
+ *   tables grow at fence time, this only saves the early doublings
+ * @param opts - options mask
+ * @param config - configuration
+ */
+void pdht_tune(unsigned opts, pdht_config_t *config) {
+  if ((opts & PDHT_TUNE_ENTRY) && (config->maxentries > 0))
+    pdht_maxentries = config->maxentries;
+  if (c)
+    c->maxentries = pdht_maxentries;
+}
+
+
+
+/**
+ * pdht_create -- collectively allocates a new dht
+ * @returns the newly minted dht
+ */
+pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
+  pdht_t *dht;
+
+  if (!c)
+    pdht_init();
+
+  if ((keysize > PDHT_MAXKEYSIZE) || (c->dhtcount >= PDHT_MAX_TABLES)) {
+    pdht_dprintf("pdht_create: keysize (%d) or table count (%d) too large\n", keysize, c->dhtcount);
+    return NULL;
+  }
+
+  dht = (pdht_t *)calloc(1, sizeof(pdht_t));
+  dht->keysize   = keysize;
+  dht->elemsize  = elemsize;
+  dht->hashfn    = pdht_hash;
+  dht->ptl.nptes = 1;
+  dht->index     = c->dhtcount;
+
+  // symmetric allocations are collective and complete everywhere on return
+  pdht_table_init(dht, 2 * c->maxentries);
+  dht->counters = shmem_calloc(PDHT_MAX_COUNTERS, sizeof(unsigned long));
+  if (!dht->counters) {
+    pdht_dprintf("pdht_create: unable to allocate counters\n");
+    exit(1);
+  }
+
+  c->hts[dht->index] = dht;
+  c->dhtcount++;
+  return dht;
+}
+
+
+
+/**
+ * pdht_free -- collectively frees a dht
+ * @param dht - dht to free
+ */
+void pdht_free(pdht_t *dht) {
+  // shmem_free() waits for everyone, so nobody is still reading our table
+  pdht_fence(dht);
+
+  c->hts[dht->index] = NULL;
+  while ((c->dhtcount > 0) && (c->hts[c->dhtcount - 1] == NULL))
+    c->dhtcount--;
+
+  shmem_free(dht->counters);
+  pdht_table_fini(dht);
+  free(dht);
+
+  if (c->dhtcount == 0) {
+    free(c);
+    c = NULL;
+    shmem_finalize();
+  }
+}
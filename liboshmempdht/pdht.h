@@ -0,0 +1,211 @@
+/********************************************************/
+/*                                                      */
+/*  pdht.h - PDHT OpenSHMEM backend public interface    */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#pragma once
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* timer definitions */
+struct pdht_timer_s{
+  double total;
+  double last;
+  double temp;
+};
+typedef struct pdht_timer_s pdht_timer_t;
+
+#define PDHT_MAX_TABLES   20
+#define PDHT_MAXKEYSIZE   32
+#define PDHT_MAX_COUNTERS 20
+
+#define PDHT_START_ATIMER(TMR) TMR.last   = pdht_wtime();
+#define PDHT_STOP_ATIMER(TMR) do {\
+                                  TMR.temp = pdht_wtime();\
+                                  TMR.total += (TMR.temp - TMR.last);\
+                                } while (0)
+// PDHT_READ_TIMER returns elapsed time in nanoseconds
+#define PDHT_READ_ATIMER(TMR)  1000000000L * (TMR.total)
+#define PDHT_READ_ATIMER_USEC(TMR)  PDHT_READ_ATIMER(TMR)/1000.0
+#define PDHT_READ_ATIMER_MSEC(TMR)  PDHT_READ_ATIMER(TMR)/(double)1e6
+#define PDHT_READ_ATIMER_SEC(TMR)   PDHT_READ_ATIMER(TMR)/(double)1e9
+#define PDHT_INIT_ATIMER(TMR) do { TMR.total = 0;} while (0)
+
+
+/* Portals defs for API exposed details (see hash function), no Portals needed here */
+typedef uint64_t ptl_match_bits_t;
+struct ptl_process_s { uint64_t rank; };
+typedef struct ptl_process_s ptl_process_t;
+typedef struct pdht_ptl_s { int nptes; } pdht_ptl_t;
+
+
+
+/* OpenSHMEM implementation details */
+
+// options for local access optimizations
+enum pdht_local_gets_e{
+  PdhtRegular,
+  PdhtSearchLocal
+};
+typedef enum pdht_local_gets_e pdht_local_gets_t;
+
+
+struct pdht_s; // forward ref
+
+// hash function proto
+typedef void (*pdht_hashfunc)(struct pdht_s *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank);
+
+enum pdht_datatype_e {
+  IntType,
+  LongType,
+  DoubleType,
+  CharType,
+  BoolType
+};
+typedef enum pdht_datatype_e pdht_datatype_t;
+
+enum pdht_reduceop_e{
+  PdhtReduceOpSum,
+  PdhtReduceOpMin,
+  PdhtReduceOpMax
+};
+typedef enum pdht_reduceop_e pdht_reduceop_t;
+
+
+/* global context structure */
+struct pdht_context_s {
+  int            rank;                 // shmem_my_pe()
+  int            size;                 // shmem_n_pes()
+  struct pdht_s *hts[PDHT_MAX_TABLES]; // active HTs
+  int            dhtcount;             // # active HTs
+  unsigned long  maxentries;           // per PE entry hint for new tables (pdht_tune)
+};
+typedef struct pdht_context_s pdht_context_t;
+
+extern pdht_context_t *c;
+
+
+/* fake tuning structure to not break regular PDHT benches/apps */
+//only maxentries is used, to size new tables
+#define PDHT_TUNE_NPTES     0x01
+#define PDHT_TUNE_PMODE     0x02
+#define PDHT_TUNE_ENTRY     0x04
+#define PDHT_TUNE_PENDQ     0x08
+#define PDHT_TUNE_PTOPT     0x10
+#define PDHT_TUNE_QUIET     0x20
+#define PDHT_TUNE_GETS      0x40
+#define PDHT_TUNE_RANK      0x80
+#define PDHT_TUNE_ALL       0xffffffff
+struct pdht_config_s{
+  int pendmode;
+  long unsigned maxentries;
+  int quiet;
+  pdht_local_gets_t local_gets;
+  long unsigned pendq_size;
+  long unsigned ptalloc_opts;
+  int nptes;
+#define PDHT_DEFAULT_RANK_HINT -1
+  int rank;
+};
+typedef struct pdht_config_s pdht_config_t;
+
+
+/* OpenSHMEM implementation for a PDHT table */
+struct pdht_s{
+  pdht_hashfunc  hashfn;
+  unsigned       elemsize;
+  unsigned       keysize;
+  int            index;        // position in c->hts[], the same on every PE
+  pdht_ptl_t     ptl;
+  char          *slots;        // symmetric open addressing table, nslots * slotsize bytes on every PE
+  uint64_t       nslots;       // the same on every PE
+  unsigned       slotbits;     // log2(nslots)
+  unsigned       slotsize;     // state | mbits | key | value, 8 byte aligned
+  unsigned       valoff;       // offset of the value in a slot
+  unsigned long *used;         // symmetric, slots claimed in our table (by any PE)
+  unsigned long *counters;     // symmetric, PDHT_MAX_COUNTERS, only used on PE 0
+  int            counter_count;
+  char          *probe;        // slots fetched from an owner
+  uint64_t       puts;
+  uint64_t       gets;
+  uint64_t       notfound;
+};
+typedef struct pdht_s pdht_t;
+
+
+/* local iteration */
+struct pdht_iter_s {
+  pdht_t   *dht;
+  uint64_t  slot;
+};
+typedef struct pdht_iter_s pdht_iter_t;
+
+
+/* legacy/compatibility definitions */
+enum pdht_mode_e{
+  PdhtModeStrict,
+  PdhtModeBundled,
+  PdhtModeAsync
+};
+typedef enum pdht_mode_e pdht_mode_t;
+
+enum pdht_pmode_e{
+  PdhtPendingPoll,
+  PdhtPendingTrig
+};
+typedef enum pdht_pmode_e pdht_pmode_t;
+
+enum pdht_status_e{
+  PdhtStatusOK,
+  PdhtStatusError,
+  PdhtStatusNotFound,
+  PdhtStatusCollision
+};
+typedef enum pdht_status_e pdht_status_t;
+
+//declaring functions the user can use
+pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode);
+void pdht_free(pdht_t *dht);
+void pdht_tune(unsigned opts, pdht_config_t *config);
+
+//putget ops
+pdht_status_t pdht_put(pdht_t *dht, void *key, void *value);
+pdht_status_t pdht_add(pdht_t *dht, void *key, void *value);
+pdht_status_t pdht_get(pdht_t *dht, void *key, void *value);
+pdht_status_t pdht_update(pdht_t *dht, void *key, void *value);
+pdht_status_t pdht_persistent_get(pdht_t *dht, void *key, void *value);
+pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new);
+
+//commsynch
+void pdht_barrier(void);
+void pdht_fence(pdht_t *dht);
+pdht_status_t pdht_allreduce(void *in, void *out, pdht_reduceop_t op, pdht_datatype_t type, int elems);
+int pdht_counter_init(pdht_t *ht, int initval);
+void pdht_counter_reset(pdht_t *ht, int counter);
+uint64_t pdht_counter_inc(pdht_t *ht, int counter, uint64_t val);
+
+//iteration over the local part of a table (after a fence)
+pdht_status_t pdht_iterate(pdht_t *dht, pdht_iter_t *it);
+int pdht_hasnext(pdht_iter_t *it);
+void *pdht_getnext(pdht_iter_t *it, void **key);
+
+//util
+void    pdht_print_stats(pdht_t *dht);
+int     eprintf(const char *format, ...);
+double  pdht_average_time(pdht_t *dht, pdht_timer_t timer);
+double  pdht_wtime(void);
+
+//hash
+void pdht_sethash(pdht_t *dht,pdht_hashfunc hfun);
+void pdht_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank);
@@ -0,0 +1,52 @@
+/***********************************************************/
+/*                                                         */
+/*  pdht_impl.h - PDHT OpenSHMEM backend private protos    */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#pragma once
+
+#include <pdht.h>
+#include <shmem.h>
+
+#define PDHT_OSHMEM_MIN_SLOTS       1024   // smallest table, per PE
+#define PDHT_OSHMEM_DEFAULT_ENTRIES 32768  // per PE entries a table is sized for without pdht_tune()
+#define PDHT_OSHMEM_PROBE           4      // slots fetched per probe step
+#define PDHT_OSHMEM_REDUCE_MAX      64     // elements per shmem reduction
+#define PDHT_OSHMEM_STRIDE          0x9e3779b97f4a7c15ULL // fibonacci hashing, for the home slot
+
+#define pdht_dprintf(...) pdht_dbg_printf(__VA_ARGS__)
+
+// slot states, every slot starts with one
+#define PDHT_SLOT_EMPTY 0UL
+#define PDHT_SLOT_BUSY  1UL // claimed, key/value being written by the claimer
+#define PDHT_SLOT_FULL  2UL
+
+// slot layout: | state | mbits | key (8 byte aligned) | value |
+#define PDHT_SLOT(dht, base, i)  ((base) + (size_t)(i) * (dht)->slotsize)
+#define PDHT_SLOT_STATE(s)       ((unsigned long *)(s))
+#define PDHT_SLOT_MBITS(s)       (*(uint64_t *)((s) + sizeof(uint64_t)))
+#define PDHT_SLOT_KEY(s)         ((s) + 2 * sizeof(uint64_t))
+#define PDHT_SLOT_VAL(dht, s)    ((s) + (dht)->valoff)
+
+/**
+ * pdht_slot_home - first probe position for a key, the same on every PE
+ *   the low bits of mbits picked the PE, the multiply spreads the rest
+ */
+static inline uint64_t pdht_slot_home(pdht_t *dht, uint64_t mbits) {
+  return (mbits * PDHT_OSHMEM_STRIDE) >> (64 - dht->slotbits);
+}
+
+// table.c - symmetric open addressing tables
+void          pdht_table_init(pdht_t *dht, uint64_t nslots);
+void          pdht_table_fini(pdht_t *dht);
+int64_t       pdht_table_probe(pdht_t *dht, ptl_match_bits_t mbits, void *key, int pe, int claim, int *fresh,
+                               char **copy);
+void          pdht_table_resize(pdht_t *dht);
+
+// util.c
+int           pdht_dbg_printf(const char *format, ...);
+int           pdht_typesize(pdht_datatype_t type);
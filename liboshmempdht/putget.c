@@ -0,0 +1,164 @@
+/***********************************************************/
+/*                                                         */
+/*  putget.c - PDHT OpenSHMEM backend put/get operations   */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+static pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value);
+
+
+
+/**
+ * pdht_do_put - inserts or overwrites an entry in its owner's table
+ *   the owner isn't involved, puts are visible everywhere after pdht_fence()
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation, Error if the owner's table is full
+ */
+static pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value) {
+  ptl_match_bits_t mbits;
+  ptl_process_t rank;
+  uint32_t ptindex;
+  int64_t slot;
+  char *s, *copy;
+  int fresh;
+
+  dht->hashfn(dht, key, &mbits, &ptindex, &rank);
+
+  slot = pdht_table_probe(dht, mbits, key, rank.rank, 1, &fresh, &copy);
+  if (slot < 0) {
+    pdht_dprintf("pdht_put: table on %lu is full, fence more often or raise maxentries\n", rank.rank);
+    return PdhtStatusError;
+  }
+
+  s = PDHT_SLOT(dht, dht->slots, slot);
+  shmem_putmem(PDHT_SLOT_VAL(dht, s), value, dht->elemsize, rank.rank);
+
+  if (fresh) {
+    // key and value land before anyone can see the slot
+    shmem_fence();
+    shmem_ulong_atomic_set(PDHT_SLOT_STATE(s), PDHT_SLOT_FULL, rank.rank);
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_put - adds an entry to the global hash table
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_put(pdht_t *dht, void *key, void *value) {
+  dht->puts++;
+  return pdht_do_put(dht, key, value);
+}
+
+
+
+/**
+ * pdht_add - adds an entry in the global hash table
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_add(pdht_t *dht, void *key, void *value) {
+  dht->puts++;
+  return pdht_do_put(dht, key, value);
+}
+
+
+
+/**
+ * pdht_update - overwrites an entry in the global hash table
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_update(pdht_t *dht, void *key, void *value) {
+  dht->puts++;
+  return pdht_do_put(dht, key, value);
+}
+
+
+
+/**
+ * pdht_get - gets an entry from the global hash table
+ *   reads the owner's slots directly, one shmem_getmem() per PDHT_OSHMEM_PROBE slots
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_get(pdht_t *dht, void *key, void *value) {
+  ptl_match_bits_t mbits;
+  ptl_process_t rank;
+  uint32_t ptindex;
+  char *copy;
+  int fresh;
+
+  dht->gets++;
+  dht->hashfn(dht, key, &mbits, &ptindex, &rank);
+
+  if (pdht_table_probe(dht, mbits, key, rank.rank, 0, &fresh, &copy) < 0) {
+    dht->notfound++;
+    return PdhtStatusNotFound;
+  }
+  memcpy(value, PDHT_SLOT_VAL(dht, copy), dht->elemsize);
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_persistent_get - gets an entry, waiting for it to be added if needed
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_persistent_get(pdht_t *dht, void *key, void *value) {
+  struct timespec ts = { 0, 100000 };
+  pdht_status_t ret;
+
+  while ((ret = pdht_get(dht, key, value)) == PdhtStatusNotFound)
+    nanosleep(&ts, NULL);
+  return ret;
+}
+
+
+
+/**
+ * pdht_atomic_cswap - atomic compare/swap on a 64-bit word inside an entry
+ * @param ht - a PDHT hash table
+ * @param key - the key of the value to atomically update
+ * @param offset - offset inside the hash table entry to modify (8 byte aligned)
+ * @param old - compare value in, copyout of the remote value _prior_ to the swap
+ * @param new - new value to swap into HT entry
+ * @returns OK, NotFound if there is no such entry, Error for a bad offset
+ */
+pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new) {
+  ptl_match_bits_t mbits;
+  ptl_process_t rank;
+  uint32_t ptindex;
+  int64_t slot;
+  char *s, *copy;
+  int fresh;
+
+  if ((offset % sizeof(int64_t)) || (offset + sizeof(int64_t) > ht->elemsize))
+    return PdhtStatusError;
+
+  ht->hashfn(ht, key, &mbits, &ptindex, &rank);
+
+  slot = pdht_table_probe(ht, mbits, key, rank.rank, 0, &fresh, &copy);
+  if (slot < 0)
+    return PdhtStatusNotFound;
+
+  s = PDHT_SLOT(ht, ht->slots, slot);
+  *old = shmem_long_atomic_compare_swap((long *)(PDHT_SLOT_VAL(ht, s) + offset), *old, new, rank.rank);
+  return PdhtStatusOK;
+}
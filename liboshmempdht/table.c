@@ -0,0 +1,230 @@
+/***********************************************************/
+/*                                                         */
+/*  table.c - PDHT OpenSHMEM backend symmetric tables      */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * every PE's part of a PDHT is a linear probing table in the symmetric heap,
+ * the same size on every PE, so any PE can find a key's slots on its owner
+ * and read them with shmem_getmem() without the owner's involvement.
+ *
+ * an insert claims an empty slot with a compare and swap on its state
+ * (EMPTY -> BUSY), writes mbits, key and value, and publishes the slot with
+ * a shmem_fence() and an atomic store of FULL. readers that run into a BUSY
+ * slot read it again until it's published. slots are never freed.
+ *
+ * a table can only be grown collectively (shmem_calloc), so it is checked at
+ * every pdht_fence() and doubled on every PE once any PE is half full.
+ */
+
+static uint64_t pdht_table_pow2(uint64_t n);
+
+
+
+/**
+ * pdht_table_pow2 - smallest power of two >= n
+ */
+static uint64_t pdht_table_pow2(uint64_t n) {
+  uint64_t p = 1;
+
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+
+
+/**
+ * pdht_table_init - collectively allocates the symmetric table for a new PDHT
+ * @param dht hash table
+ * @param nslots per PE slot count hint
+ */
+void pdht_table_init(pdht_t *dht, uint64_t nslots) {
+  dht->valoff   = 2 * sizeof(uint64_t) + ((dht->keysize + 7) & ~7);
+  dht->slotsize = dht->valoff + ((dht->elemsize + 7) & ~7);
+  dht->nslots   = pdht_table_pow2(nslots < PDHT_OSHMEM_MIN_SLOTS ? PDHT_OSHMEM_MIN_SLOTS : nslots);
+  dht->slotbits = __builtin_ctzl(dht->nslots);
+
+  dht->slots = shmem_calloc(dht->nslots, dht->slotsize);
+  dht->used  = shmem_calloc(1, sizeof(unsigned long));
+  dht->probe = malloc(PDHT_OSHMEM_PROBE * dht->slotsize);
+  if ((!dht->slots) || (!dht->used) || (!dht->probe)) {
+    pdht_dprintf("pdht_table_init: unable to allocate %lu slots, raise SHMEM_SYMMETRIC_SIZE?\n", dht->nslots);
+    exit(1);
+  }
+}
+
+
+
+/**
+ * pdht_table_fini - collectively releases the symmetric table
+ * @param dht hash table
+ */
+void pdht_table_fini(pdht_t *dht) {
+  shmem_free(dht->slots);
+  shmem_free(dht->used);
+  free(dht->probe);
+  dht->slots = NULL;
+}
+
+
+
+/**
+ * pdht_table_probe - walks a key's probe run on its owner
+ * @param dht hash table
+ * @param mbits match bits of the key
+ * @param key the key
+ * @param pe owner of the key
+ * @param claim claim an empty slot for the key if it isn't there
+ * @param fresh set if the slot was claimed, the caller writes the value and publishes it
+ * @param copy set to our copy of an existing slot (in dht->probe)
+ * @returns slot index, or -1 if the key isn't there (or there's no room for it)
+ */
+int64_t pdht_table_probe(pdht_t *dht, ptl_match_bits_t mbits, void *key, int pe, int claim, int *fresh, char **copy) {
+  uint64_t mask = dht->nslots - 1;
+  uint64_t home = pdht_slot_home(dht, mbits), scanned = 0, i, n;
+  char hdr[sizeof(uint64_t) + PDHT_MAXKEYSIZE];
+  unsigned long state;
+  char *s, *rs;
+
+  *fresh = 0;
+  *copy  = NULL;
+  while (scanned < dht->nslots) {
+    // fetch a run of slots, probe runs wrap around the end of the table
+    i = (home + scanned) & mask;
+    n = dht->nslots - i;
+    n = n < PDHT_OSHMEM_PROBE ? n : PDHT_OSHMEM_PROBE;
+    shmem_getmem(dht->probe, PDHT_SLOT(dht, dht->slots, i), n * dht->slotsize, pe);
+
+    for (uint64_t j=0; j < n; j++) {
+      s = PDHT_SLOT(dht, dht->probe, j);
+
+      if (*PDHT_SLOT_STATE(s) == PDHT_SLOT_BUSY)
+        break; // being written, read it again
+
+      if (*PDHT_SLOT_STATE(s) == PDHT_SLOT_EMPTY) {
+        if (!claim)
+          return -1;
+
+        rs = PDHT_SLOT(dht, dht->slots, i + j);
+        state = shmem_ulong_atomic_compare_swap(PDHT_SLOT_STATE(rs), PDHT_SLOT_EMPTY, PDHT_SLOT_BUSY, pe);
+        if (state != PDHT_SLOT_EMPTY)
+          break; // somebody beat us to it, read it again
+
+        // mbits | key now, the caller follows with the value
+        memcpy(hdr, &mbits, sizeof(uint64_t));
+        memcpy(hdr + sizeof(uint64_t), key, dht->keysize);
+        shmem_putmem(&PDHT_SLOT_MBITS(rs), hdr, sizeof(uint64_t) + dht->keysize, pe);
+        shmem_ulong_atomic_fetch_inc(dht->used, pe);
+        *fresh = 1;
+        return i + j;
+      }
+
+      if ((PDHT_SLOT_MBITS(s) == mbits) && (memcmp(PDHT_SLOT_KEY(s), key, dht->keysize) == 0)) {
+        *copy = s;
+        return i + j;
+      }
+
+      scanned++;
+    }
+  }
+  return -1;
+}
+
+
+
+/**
+ * pdht_table_resize - collectively grows every PE's table once any is half full
+ *   called from pdht_fence(), after everyone's puts are complete
+ * @param dht hash table
+ */
+void pdht_table_resize(pdht_t *dht) {
+  long used, maxused;
+  uint64_t nslots, mask, k;
+  char *old = dht->slots, *s, *d;
+  uint64_t oldn = dht->nslots;
+
+  used = shmem_ulong_atomic_fetch(dht->used, c->rank);
+  pdht_allreduce(&used, &maxused, PdhtReduceOpMax, LongType, 1);
+  if (2 * (uint64_t)maxused <= dht->nslots)
+    return;
+
+  nslots = pdht_table_pow2(2 * maxused + 1);
+  dht->slots = shmem_calloc(nslots, dht->slotsize);
+  if (!dht->slots) {
+    pdht_dprintf("pdht_table_resize: unable to grow table to %lu slots, raise SHMEM_SYMMETRIC_SIZE?\n", nslots);
+    exit(1);
+  }
+  dht->nslots   = nslots;
+  dht->slotbits = __builtin_ctzl(nslots);
+  mask = nslots - 1;
+
+  // nobody else is touching our table until the barrier in shmem_free()
+  for (uint64_t j=0; j < oldn; j++) {
+    s = PDHT_SLOT(dht, old, j);
+    if (*PDHT_SLOT_STATE(s) != PDHT_SLOT_FULL)
+      continue;
+    k = pdht_slot_home(dht, PDHT_SLOT_MBITS(s));
+    while (*PDHT_SLOT_STATE(PDHT_SLOT(dht, dht->slots, k)) != PDHT_SLOT_EMPTY)
+      k = (k + 1) & mask;
+    d = PDHT_SLOT(dht, dht->slots, k);
+    memcpy(d, s, dht->slotsize);
+  }
+  shmem_free(old);
+}
+
+
+
+/**
+ * pdht_iterate() - construct an iterator over the local part of a hash table
+ *  @param dht hash table structure
+ *  @param it a PDHT iterator structure
+ *  @returns status of creation operation
+ */
+pdht_status_t pdht_iterate(pdht_t *dht, pdht_iter_t *it) {
+  it->dht  = dht;
+  it->slot = 0;
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_hasnext - checks to see if there is another local entry
+ * @param it a PDHT iterator structure
+ * @returns 1 if next entry is valid, 0 otherwise
+ */
+int pdht_hasnext(pdht_iter_t *it) {
+  pdht_t *dht = it->dht;
+
+  while ((it->slot < dht->nslots) && (*PDHT_SLOT_STATE(PDHT_SLOT(dht, dht->slots, it->slot)) != PDHT_SLOT_FULL))
+    it->slot++;
+  return it->slot < dht->nslots;
+}
+
+
+
+/**
+ * pdht_getnext - returns the next local entry
+ * @param it a PDHT iterator structure
+ * @param key if non-NULL, set to the entry's key
+ * @returns pointer to the entry's value, NULL when done
+ */
+void *pdht_getnext(pdht_iter_t *it, void **key) {
+  char *s;
+
+  if (!pdht_hasnext(it))
+    return NULL;
+  s = PDHT_SLOT(it->dht, it->dht->slots, it->slot++);
+  if (key)
+    *key = PDHT_SLOT_KEY(s);
+  return PDHT_SLOT_VAL(it->dht, s);
+}
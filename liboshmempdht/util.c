@@ -0,0 +1,104 @@
+/***********************************************************/
+/*                                                         */
+/*  util.c - PDHT OpenSHMEM backend utility functions      */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * eprintf - error printing wrapper, only prints on PE 0
+ * @returns number of bytes written to stdout
+ */
+int eprintf(const char *format, ...) {
+  va_list ap;
+  int ret;
+
+  if (c->rank == 0) {
+    va_start(ap, format);
+    ret = vfprintf(stdout, format, ap);
+    va_end(ap);
+    fflush(stdout);
+    return ret;
+  }
+  else
+    return 0;
+}
+
+
+
+/**
+ * pdht_dbg_printf - PE-tagged debug output
+ * @returns number of bytes written to stdout
+ */
+int pdht_dbg_printf(const char *format, ...) {
+  va_list ap;
+  int ret;
+
+  fprintf(stdout, "%d: ", c ? c->rank : -1);
+  va_start(ap, format);
+  ret = vfprintf(stdout, format, ap);
+  va_end(ap);
+  fflush(stdout);
+  return ret;
+}
+
+
+
+/**
+ * pdht_wtime - wall clock time in seconds
+ */
+double pdht_wtime(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+
+/**
+ * pdht_print_stats - prints operation counts and table sizes
+ * @param dht hash table
+ */
+void pdht_print_stats(pdht_t *dht) {
+  long in[4] = { dht->puts, dht->gets, dht->notfound, *dht->used }, out[4];
+
+  pdht_allreduce(in, out, PdhtReduceOpSum, LongType, 4);
+  eprintf("pdht stats: puts: %ld gets: %ld notfound: %ld entries: %ld (%lu slots per PE)\n",
+      out[0], out[1], out[2], out[3], dht->nslots);
+}
+
+
+
+/**
+ * pdht_average_time - average of a timer across all PEs
+ * @param dht hash table
+ * @param timer timer to average
+ * @returns average time in milliseconds
+ */
+double pdht_average_time(pdht_t *dht, pdht_timer_t timer) {
+  double global_sum;
+
+  pdht_allreduce(&timer.total, &global_sum, PdhtReduceOpSum, DoubleType, 1);
+  return global_sum * 1000 / c->size;
+}
+
+
+
+/**
+ * pdht_typesize - size of one element of a reduction datatype
+ */
+int pdht_typesize(pdht_datatype_t type) {
+  switch (type) {
+    case IntType:    return sizeof(int);
+    case LongType:   return sizeof(long);
+    case DoubleType: return sizeof(double);
+    case CharType:   return sizeof(char);
+    case BoolType:   return sizeof(char);
+  }
+  return 0;
+}
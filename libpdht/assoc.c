@@ -7,37 +7,395 @@
 /*                                                      */
 /********************************************************/
 
-#include <pdht.h>
+#include <alloca.h>
+#include <pdht_impl.h>
 
 /**
  * @file
- * 
+ *
  * portals distributed hash table associative operations
+ *
+ * an accumulate is a PtlAtomic straight into the active ME (or bucket/direct
+ * slot) holding the key, applied by the target NI without the owner's
+ * progress engine. the operand is copied into a per-thread ring so the call
+ * returns as soon as the atomic is issued. every ring slot waits for its own
+ * ACK: a failed ACK means the entry lives under collision chain bits, so the
+ * chain is probed and the atomic reissued from the same slot. pdht_fence()
+ * drains every thread's ring, so accumulates are complete (and visible to
+ * gets) once it returns. threads should not be accumulating into a table
+ * while another thread fences it.
  */
 
+struct _pdht_acc_s {
+  int               busy;       // waiting for an ACK
+  ptl_process_t     rank;       // owner of key
+  uint32_t          ptindex;    // PTE pair of key
+  ptl_match_bits_t  mbits;      // bits the atomic was sent to
+  ptl_size_t        roffset;    // offset of the operand inside the target ME
+  ptl_size_t        len;        // operand bytes
+  ptl_op_t          op;
+  ptl_datatype_t    type;
+  char              key[PDHT_MAXKEYSIZE];
+  char              operand[0];
+};
+typedef struct _pdht_acc_s _pdht_acc_t;
 
-/** 
+static pdht_status_t pdht_acc_issue(pdht_t *dht, pdht_tctx_t *tc, _pdht_acc_t *a);
+static int           pdht_acc_complete(pdht_t *dht, pdht_tctx_t *tc, int block);
+static pdht_status_t pdht_acc_direct(pdht_t *dht, pdht_tctx_t *tc, _pdht_acc_t *a);
+
+
+
+/**
+ * pdht_acc_slotsize - bytes per accumulate ring slot
+ */
+static inline size_t pdht_acc_slotsize(pdht_t *dht) {
+  return (sizeof(_pdht_acc_t) + dht->elemsize + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+
+
+/**
+ * pdht_acc_slot - returns a ring slot by index
+ */
+static inline _pdht_acc_t *pdht_acc_slot(pdht_t *dht, pdht_tctx_t *tc, unsigned i) {
+  return (_pdht_acc_t *)((char *)tc->accring + i * pdht_acc_slotsize(dht)); // pointer math
+}
+
+
+
+/**
+ * pdht_acc_init - sets up a thread context's accumulate ring
+ * @param dht - hash table data structure
+ * @param tc - communication context being created
+ */
+void pdht_acc_init(pdht_t *dht, pdht_tctx_t *tc) {
+  ptl_md_t md;
+  int ret;
+
+  tc->accring = calloc(PDHT_ACC_RING, pdht_acc_slotsize(dht));
+  if (!tc->accring) {
+    pdht_dprintf("pdht_acc_init: calloc error: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  // one ACK event per accumulate, so the ring never outruns the queue
+  ret = PtlEQAlloc(dht->ptl.lni, PDHT_ACC_RING, &tc->acceq);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_acc_init: PtlEQAlloc failure\n");
+    exit(1);
+  }
+
+  md.start     = tc->accring;
+  md.length    = PDHT_ACC_RING * pdht_acc_slotsize(dht);
+  md.options   = PTL_MD_EVENT_SEND_DISABLE;
+  md.eq_handle = tc->acceq;
+  md.ct_handle = PTL_CT_NONE;
+
+  ret = PtlMDBind(dht->ptl.lni, &md, &tc->accmd);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_acc_init: PtlMDBind failure\n");
+    exit(1);
+  }
+  tc->accnext = 0;
+  tc->accbusy = 0;
+}
+
+
+
+/**
+ * pdht_acc_free - waits for a thread context's accumulates and releases its ring
+ * @param dht - hash table data structure
+ * @param tc - communication context being released
+ */
+void pdht_acc_free(pdht_t *dht, pdht_tctx_t *tc) {
+  while (tc->accbusy > 0)
+    pdht_acc_complete(dht, tc, 1);
+
+  PtlMDRelease(tc->accmd);
+  PtlEQFree(tc->acceq);
+  free(tc->accring);
+  tc->accring = NULL;
+}
+
+
+
+/**
+ * pdht_acc_flush - waits until every thread's accumulates have been applied
+ *   called from pdht_fence()
+ * @param dht - hash table data structure
+ */
+void pdht_acc_flush(pdht_t *dht) {
+  pdht_tctx_t *tc;
+
+  for (int i=0; i < PDHT_MAX_THREADS; i++) {
+    tc = dht->ptl.tctx[i];
+    while (tc && (tc->accbusy > 0))
+      pdht_acc_complete(dht, tc, 1);
+  }
+}
+
+
+
+/**
+ * pdht_acc_typesize - size of one element of an atomic datatype
+ */
+int pdht_acc_typesize(pdht_datatype_t type) {
+  switch (type) {
+    case IntType:    return sizeof(int32_t);
+    case LongType:   return sizeof(int64_t);
+    case DoubleType: return sizeof(double);
+    case CharType:   return sizeof(int8_t);
+    case BoolType:   return sizeof(uint8_t);
+  }
+  return 0;
+}
+
+
+
+/**
+ * pdht_acc_ptltype - Portals atomic datatype for a PDHT datatype
+ */
+ptl_datatype_t pdht_acc_ptltype(pdht_datatype_t type) {
+  switch (type) {
+    case IntType:    return PTL_INT32_T;
+    case LongType:   return PTL_INT64_T;
+    case DoubleType: return PTL_DOUBLE;
+    case CharType:   return PTL_INT8_T;
+    case BoolType:   return PTL_UINT8_T;
+  }
+  return PTL_INT64_T;
+}
+
+
+
+/**
+ * pdht_acc_ptlop - Portals atomic operation for a PDHT associative operator
+ */
+ptl_op_t pdht_acc_ptlop(pdht_oper_t op) {
+  switch (op) {
+    case AssocOpAdd:  return PTL_SUM;
+    case AssocOpMin:  return PTL_MIN;
+    case AssocOpMax:  return PTL_MAX;
+    case AssocOpProd: return PTL_PROD;
+    case AssocOpBand: return PTL_BAND;
+    case AssocOpBor:  return PTL_BOR;
+    case AssocOpBxor: return PTL_BXOR;
+    case AssocOpSwap: return PTL_SWAP;
+  }
+  return PTL_SUM;
+}
+
+
+
+/**
+ * pdht_acc_check - checks that an operator applies to a datatype
+ *   Portals has no bitwise operations on floating point
+ * @returns 1 if valid, 0 otherwise
+ */
+int pdht_acc_check(pdht_datatype_t type, pdht_oper_t op) {
+  if ((type == DoubleType) && ((op == AssocOpBand) || (op == AssocOpBor) || (op == AssocOpBxor)))
+    return 0;
+  return 1;
+}
+
+
+
+/**
  * pdht_acc() - associative accumulate operation into a hashed object
+ *   returns once the atomic is issued, it is applied by the next pdht_fence().
+ *   accumulates into keys that don't exist are dropped and counted as notfound.
  *   @param key key of hash table entry to accumulate into
+ *   @param offset byte offset of a single element inside the entry, or
+ *          PDHT_ACC_ALL to accumulate elementwise into the whole entry
  *   @param type data type of the object
  *   @param op operation to perform
- *   @param value to accumulate into entry
+ *   @param value to accumulate into entry (one element, or a whole entry)
+ *   @returns status of operation
  */
-pdht_status_t pdht_acc(pdht_t *dht, void *key, pdht_datatype_t type, pdht_oper_t op, void *value) {
-  // this is being ignored right now
-  return PdhtStatusOK;
+pdht_status_t pdht_acc(pdht_t *dht, void *key, size_t offset, pdht_datatype_t type, pdht_oper_t op, void *value) {
+  return pdht_nbacc(dht, key, offset, type, op, value) == PDHT_NULL_HANDLE ? PdhtStatusError : PdhtStatusOK;
 }
 
 
 
-/** 
+/**
  * pdht_nbacc() - non-blocking associative accumulate operation into a hashed object
  *   @param key key of hash table entry to accumulate into
+ *   @param offset byte offset of a single element inside the entry, or PDHT_ACC_ALL
  *   @param type data type of the object
  *   @param op operation to perform
  *   @param value to accumulate into entry
+ *   @returns handle of the accumulate, which completes at the next pdht_fence(),
+ *            PDHT_NULL_HANDLE if it could not be issued
  */
-pdht_handle_t pdht_nbacc(pdht_t *dht, void *key, pdht_datatype_t type, pdht_oper_t op, void *value) {
-  // this is being ignored right now
+pdht_handle_t pdht_nbacc(pdht_t *dht, void *key, size_t offset, pdht_datatype_t type, pdht_oper_t op, void *value) {
+  pdht_tctx_t *tc = pdht_tctx(dht);
+  ptl_match_bits_t mbits;
+  ptl_process_t rank;
+  uint32_t ptindex;
+  ptl_size_t len, eoffset = 0;
+  _pdht_acc_t *a;
+  unsigned h;
+  int tsize = pdht_acc_typesize(type);
+
+  len = tsize;
+  if (offset == PDHT_ACC_ALL) {
+    offset = 0;
+    len = dht->elemsize;
+  }
+  if ((offset + len > dht->elemsize) || (len % tsize) || (len > c->ptl.ni_limits.max_atomic_size)) {
+    pdht_dprintf("pdht_acc: bad accumulate (offset: %lu, %lu bytes of %d-byte elements, max: %lu)\n",
+        offset, len, tsize, c->ptl.ni_limits.max_atomic_size);
+    return PDHT_NULL_HANDLE;
+  }
+  // a swap that doesn't return the old value is just pdht_update()
+  if ((op == AssocOpSwap) || !pdht_acc_check(type, op)) {
+    pdht_dprintf("pdht_acc: operator %d does not apply to type %d\n", op, type);
+    return PDHT_NULL_HANDLE;
+  }
+
+  dht->stats.updates++;
+  pdht_hashkey(dht, key, &mbits, &ptindex, &rank);
+
+  // bucketed and direct entries live at some slot offset inside a shared ME/LE
+  if (dht->layout != PdhtLayoutEntry) {
+    if (pdht_locate(dht, key, mbits, ptindex, rank, &mbits, &eoffset, alloca(PDHT_MAXKEYSIZE + dht->elemsize)) != PdhtStatusOK)
+      return PDHT_NULL_HANDLE;
+  }
+
+  // find a free ring slot, waiting for ACKs if every slot is in flight
+  while (tc->accbusy == PDHT_ACC_RING)
+    pdht_acc_complete(dht, tc, 1);
+  while (pdht_acc_slot(dht, tc, tc->accnext)->busy)
+    tc->accnext = (tc->accnext + 1) % PDHT_ACC_RING;
+  h = tc->accnext;
+  tc->accnext = (tc->accnext + 1) % PDHT_ACC_RING;
+
+  a = pdht_acc_slot(dht, tc, h);
+  a->rank    = rank;
+  a->ptindex = ptindex;
+  a->mbits   = mbits;
+  a->roffset = eoffset + PDHT_MAXKEYSIZE + offset;
+  a->len     = len;
+  a->op      = pdht_acc_ptlop(op);
+  a->type    = pdht_acc_ptltype(type);
+  memcpy(a->key, key, dht->keysize);
+  memcpy(a->operand, value, len);
+
+  if (mbits == __PDHT_DIRECT_BITS)
+    return pdht_acc_direct(dht, tc, a) == PdhtStatusOK ? h : PDHT_NULL_HANDLE;
+
+  if (pdht_acc_issue(dht, tc, a) != PdhtStatusOK)
+    return PDHT_NULL_HANDLE;
+  return h;
+}
+
+
+
+/**
+ * pdht_acc_issue - sends the atomic for a ring slot
+ * @param dht - hash table data structure
+ * @param tc - calling thread's context
+ * @param a - filled in ring slot
+ * @returns status of operation
+ */
+static pdht_status_t pdht_acc_issue(pdht_t *dht, pdht_tctx_t *tc, _pdht_acc_t *a) {
+  int ret;
+
+  ret = PtlAtomic(tc->accmd, a->operand - (char *)tc->accring, a->len, PTL_ACK_REQ, a->rank,
+      dht->ptl.getindex[a->ptindex], a->mbits, a->roffset, a, 0, a->op, a->type);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_acc: PtlAtomic(rank: %d) failed: %s\n", a->rank.rank, pdht_ptl_error(ret));
+    return PdhtStatusError;
+  }
+
+  if (!a->busy) {
+    a->busy = 1;
+    tc->accbusy++;
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_acc_complete - retires accumulates whose ACKs have arrived
+ *   an ACK that failed to match is retried against the key's collision chain
+ * @param dht - hash table data structure
+ * @param tc - context whose ring to drain
+ * @param block - wait for at least one ACK
+ * @returns number of ACKs handled
+ */
+static int pdht_acc_complete(pdht_t *dht, pdht_tctx_t *tc, int block) {
+  ptl_match_bits_t bits;
+  ptl_event_t ev;
+  _pdht_acc_t *a;
+  int ret, n = 0;
+
+  for (;;) {
+    ret = PtlEQGet(tc->acceq, &ev);
+    if (ret == PTL_EQ_EMPTY) {
+      if ((!block) || (n > 0))
+        return n;
+      if (!c->progress_manual)
+        ret = PtlEQWait(tc->acceq, &ev);
+      else {
+        pdht_progress_yield();
+        continue;
+      }
+    }
+    if ((ret != PTL_OK) && (ret != PTL_EQ_DROPPED)) {
+      pdht_dprintf("pdht_acc: PtlEQGet error: %s\n", pdht_ptl_error(ret));
+      exit(1);
+    }
+    if (ev.type != PTL_EVENT_ACK)
+      continue;
+    n++;
+
+    a = (_pdht_acc_t *)ev.user_ptr;
+    if (ev.ni_fail_type != PTL_NI_OK) {
+      // entry may live under a collision chain probe slot, not the primary bits
+      if ((dht->layout == PdhtLayoutEntry) && !(a->mbits & __PDHT_PROBE_BIT)) {
+        if (pdht_probe(dht, a->key, a->mbits, a->ptindex, a->rank, &bits, alloca(PDHT_MAXKEYSIZE + dht->elemsize)) == PdhtStatusOK) {
+          a->mbits = bits;
+          if (pdht_acc_issue(dht, tc, a) == PdhtStatusOK)
+            continue;
+        }
+      } else
+        dht->stats.notfound++;
+    }
+    a->busy = 0;
+    tc->accbusy--;
+  }
+}
+
+
+
+/**
+ * pdht_acc_direct - accumulates into a direct layout slot
+ *   locating the slot already cost a round trip, so this one waits for its ACK
+ * @param dht - hash table data structure
+ * @param tc - calling thread's context
+ * @param a - filled in ring slot
+ * @returns status of operation
+ */
+static pdht_status_t pdht_acc_direct(pdht_t *dht, pdht_tctx_t *tc, _pdht_acc_t *a) {
+  ptl_ct_event_t current, ctevent;
+  int ret;
+
+  PtlCTGet(tc->dmdct, &current);
+  ret = PtlAtomic(tc->dmd, (ptl_size_t)a->operand, a->len, PTL_ACK_REQ, a->rank,
+      dht->ptl.dindex, 0, a->roffset, NULL, 0, a->op, a->type);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_acc: direct PtlAtomic(rank: %d) failed: %s\n", a->rank.rank, pdht_ptl_error(ret));
+    return PdhtStatusError;
+  }
+
+  ret = pdht_progress_ct_wait(tc->dmdct, current.success + current.failure + 1, &ctevent);
+  if ((ret != PTL_OK) || (ctevent.failure > current.failure)) {
+    pdht_dprintf("pdht_acc: direct accumulate to rank %d failed\n", a->rank.rank);
+    return PdhtStatusError;
+  }
   return PdhtStatusOK;
 }
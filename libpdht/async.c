@@ -0,0 +1,600 @@
+/********************************************************/
+/*                                                      */
+/*  async.c - PDHT callback-based asynchronous ops      */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table callback-based asynchronous operations
+ *
+ * pdht_get_async() and pdht_put_async() issue the operation on a per-table
+ * MD whose event queue is served by the progress engine, and return right
+ * away. the completion callback runs on the progress thread serving the
+ * table's async queue (or inside pdht_progress() with PdhtProgressManual),
+ * so a callback can issue the next dependent lookup and an application can
+ * keep many such chains in flight without batching them by hand. callbacks
+ * may issue more async operations, but must not block (pdht_get(),
+ * pdht_fence(), pdht_async_wait(), ...) since they run on the engine.
+ *
+ * gets are chained from pdht_async_event(), one read at a time: a collision
+ * chain is walked by re-issuing against the next probe slot, and on the
+ * bucket and direct layouts the bucket or key neighborhood is read first and
+ * only keys that overflowed it cost a second read of their own ME. direct
+ * neighborhood reads go to the non-matching NI, whose queue can't join the
+ * poll set, so pdht_async_deliver() drains it and the engine doesn't block
+ * while any are out. gets that need no network (same-node owners, local
+ * searches) are answered from the owner's index and only their callback is
+ * deferred to the progress engine.
+ *
+ * puts refused by flow control wait out a backoff (PDHT_ASYNC_RETRY_NS,
+ * doubling) on a retry list instead of hitting the disabled PTE again
+ * straight away, so the target gets a chance to refill its pending queue.
+ */
+
+static _pdht_async_t *pdht_async_alloc(pdht_t *dht, void *key, pdht_async_cb cb, void *arg);
+static int pdht_async_issue(_pdht_async_t *req);
+static void pdht_async_reply(_pdht_async_t *req);
+static pdht_status_t pdht_async_local(_pdht_async_t *req);
+static void pdht_async_backoff(_pdht_async_t *req);
+static int pdht_async_retry(pdht_t *dht);
+static int pdht_async_drain(pdht_t *dht);
+static void pdht_async_push(_pdht_async_t **list, _pdht_async_t *req);
+static void pdht_async_defer(_pdht_async_t *req, pdht_status_t status);
+static void pdht_async_complete(_pdht_async_t *req, pdht_status_t status);
+static u_int64_t pdht_async_now(void);
+
+
+
+/**
+ * pdht_async_init - creates the MD and event queue for async operations on a table
+ * @param dht - hash table data structure
+ */
+void pdht_async_init(pdht_t *dht) {
+  ptl_md_t md;
+  int ret;
+
+  ret = PtlEQAlloc(dht->ptl.lni, PDHT_ASYNC_EQ_SIZE, &dht->ptl.asynceq);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_async_init: PtlEQAlloc failure: %s\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+
+  // one ACK or REPLY event per operation, user_ptr carries the request
+  md.start     = NULL;
+  md.length    = PTL_SIZE_MAX;
+  md.options   = PTL_MD_EVENT_SEND_DISABLE;
+  md.eq_handle = dht->ptl.asynceq;
+  md.ct_handle = PTL_CT_NONE;
+
+  ret = PtlMDBind(dht->ptl.lni, &md, &dht->ptl.asyncmd);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_async_init: PtlMDBind failure: %s\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+
+  if (dht->layout == PdhtLayoutDirect) {
+    // neighborhood reads go through the non-matching NI (see pdht_direct_init())
+    ret = PtlEQAlloc(c->ptl.nni, PDHT_ASYNC_EQ_SIZE, &dht->ptl.dasynceq);
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_async_init: PtlEQAlloc (direct) failure: %s\n", pdht_ptl_error(ret));
+      exit(1);
+    }
+
+    md.eq_handle = dht->ptl.dasynceq;
+    ret = PtlMDBind(c->ptl.nni, &md, &dht->ptl.dasyncmd);
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_async_init: PtlMDBind (direct) failure: %s\n", pdht_ptl_error(ret));
+      exit(1);
+    }
+  }
+
+  dht->asyncpending = 0;
+  dht->asyncwait    = 0;
+  dht->asyncdone    = NULL;
+  dht->asyncretry   = NULL;
+}
+
+
+
+/**
+ * pdht_async_fini - releases the async MD and event queue
+ *   all async operations have completed (pdht_async_wait()) and the progress
+ *   engine has dropped the table by now
+ * @param dht - hash table data structure
+ */
+void pdht_async_fini(pdht_t *dht) {
+  PtlMDRelease(dht->ptl.asyncmd);
+  PtlEQFree(dht->ptl.asynceq);
+  if (dht->layout == PdhtLayoutDirect) {
+    PtlMDRelease(dht->ptl.dasyncmd);
+    PtlEQFree(dht->ptl.dasynceq);
+  }
+}
+
+
+
+/**
+ * pdht_get_async - gets an entry from the global hash table, calls back on completion
+ *   @param key - hash table key (copied, may be reused once this returns)
+ *   @param value - buffer for the value, must stay valid until the callback runs
+ *   @param cb - completion callback, gets the key, value buffer and status
+ *   @param arg - passed through to cb
+ *   @returns OK if the get was issued, Error otherwise (cb will not run)
+ */
+pdht_status_t pdht_get_async(pdht_t *dht, void *key, void *value, pdht_async_cb cb, void *arg) {
+  _pdht_async_t *req = pdht_async_alloc(dht, key, cb, arg);
+
+  req->op    = PdhtAsyncGet;
+  req->value = value;
+  pdht_hashkey(dht, key, &req->mbits, &req->ptindex, &req->rank);
+
+  dht->stats.gets++;
+  dht->stats.ptcounts[req->ptindex]++;
+
+  // same-node owner, a load away (misses still ask the owner)
+  if (dht->shmpeers && dht->shmpeers[req->rank.rank] &&
+      (pdht_shm_get(dht, key, req->mbits, req->rank, value) == PdhtStatusOK)) {
+    dht->stats.shmops++;
+    pdht_async_defer(req, PdhtStatusOK);
+    return PdhtStatusOK;
+  }
+
+  // our own entry, answered from the owner index rather than a match list search
+  if ((req->rank.rank == (ptl_rank_t)c->rank) && (dht->local_get == PdhtSearchLocal) &&
+      (dht->ptl.ptalloc_opts == PTL_PT_MATCH_UNORDERED)) {
+    pdht_async_defer(req, pdht_async_local(req));
+    return PdhtStatusOK;
+  }
+
+  // bucket and direct layouts read the bucket or neighborhood first, see pdht_async_reply()
+  if (dht->layout == PdhtLayoutBucket)
+    req->stage = PdhtAsyncBucket;
+  else if (dht->layout == PdhtLayoutDirect)
+    req->stage = PdhtAsyncNbhd;
+
+  if (pdht_async_issue(req) != PTL_OK) {
+    pdht_dprintf("pdht_get_async: PtlGet(rank: %d, ptindex: %d) failed\n", req->rank.rank, req->ptindex);
+    __atomic_sub_fetch(&dht->asyncpending, 1, __ATOMIC_RELEASE);
+    free(req);
+    return PdhtStatusError;
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_put_async - adds an entry to the global hash table, calls back on completion
+ *   the entry is visible everywhere after the next pdht_fence(), as with pdht_put()
+ *   @param key - hash table key (copied)
+ *   @param value - value for table entry (copied)
+ *   @param cb - completion callback, gets the key, a copy of the value and status
+ *   @param arg - passed through to cb
+ *   @returns OK if the put was issued, Error otherwise (cb will not run)
+ */
+pdht_status_t pdht_put_async(pdht_t *dht, void *key, void *value, pdht_async_cb cb, void *arg) {
+  _pdht_async_t *req = pdht_async_alloc(dht, key, cb, arg);
+  ptl_me_t *mep;
+  char *kval;
+
+  req->op = PdhtAsyncPut;
+  pdht_hashkey(dht, key, &req->mbits, &req->ptindex, &req->rank);
+
+  dht->stats.puts++;
+  dht->stats.rankputs[req->rank.rank]++;
+
+  // same wire format as pdht_put(), see pdht_do_put()
+  if (dht->pmode == PdhtPendingTrig) {
+    mep = (ptl_me_t *)req->data;
+    kval = req->data + sizeof(ptl_me_t);
+    mep->match_bits  = req->mbits;
+    mep->ignore_bits = 0;
+    mep->min_free    = 0;
+    req->loffset = (ptl_size_t)&mep->match_bits; // only send from match_bits field and beyond
+    req->len     = (sizeof(ptl_me_t) - offsetof(ptl_me_t, match_bits)) + PDHT_MAXKEYSIZE + dht->elemsize;
+  } else {
+    kval = req->data;
+    req->loffset = (ptl_size_t)kval;
+    req->len     = PDHT_MAXKEYSIZE + dht->elemsize;
+  }
+  memcpy(kval, req->key, PDHT_MAXKEYSIZE);
+  memcpy(kval + PDHT_MAXKEYSIZE, value, dht->elemsize); // pointer math
+  req->value = kval + PDHT_MAXKEYSIZE;
+
+  __atomic_add_fetch(&dht->stats.pendputs, 1, __ATOMIC_RELAXED); // counted once, even if flow control makes us retry
+
+  if (pdht_async_issue(req) != PTL_OK) {
+    pdht_dprintf("pdht_put_async: PtlPut(rank: %d, ptindex: %d) failed\n", req->rank.rank, req->ptindex);
+    __atomic_sub_fetch(&dht->stats.pendputs, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&dht->asyncpending, 1, __ATOMIC_RELEASE);
+    free(req);
+    return PdhtStatusError;
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_async_wait - waits until every async operation on a table has called back
+ *   drives progress while waiting. must not be called from a callback.
+ * @param dht - hash table data structure
+ */
+void pdht_async_wait(pdht_t *dht) {
+  while (__atomic_load_n(&dht->asyncpending, __ATOMIC_ACQUIRE) > 0)
+    pdht_progress_yield();
+}
+
+
+
+/**
+ * pdht_async_event - handles a completion event from the async event queue
+ *   called by the progress thread serving the table's async queue
+ * @param dht - hash table data structure
+ * @param ev - ACK (put) or REPLY (get) event
+ */
+void pdht_async_event(pdht_t *dht, ptl_event_t *ev) {
+  _pdht_async_t *req = ev->user_ptr;
+
+  switch (ev->type) {
+    case PTL_EVENT_ACK:
+      if (ev->ni_fail_type == PTL_NI_PT_DISABLED) {
+        // flow control, give the target time to refill its pending queue before trying again
+        pdht_async_backoff(req);
+      } else {
+        pdht_async_complete(req, (ev->ni_fail_type == PTL_NI_OK) ? PdhtStatusOK : PdhtStatusError);
+      }
+      break;
+
+    case PTL_EVENT_REPLY:
+      if (req->stage == PdhtAsyncNbhd)
+        __atomic_sub_fetch(&dht->asyncwait, 1, __ATOMIC_RELAXED);
+
+      if (ev->ni_fail_type == PTL_NI_OK) {
+        pdht_async_reply(req);
+      } else if (req->stage == PdhtAsyncNbhd) {
+        // the direct LE covers every slot, any failure is a real error
+        pdht_dprintf("pdht_async_event: neighborhood read from rank %d failed\n", req->rank.rank);
+        pdht_async_complete(req, PdhtStatusError);
+      } else {
+        // nothing matched our bits
+        dht->stats.notfound++;
+        pdht_async_complete(req, PdhtStatusNotFound);
+      }
+      break;
+
+    default:
+      pdht_dprintf("pdht_async_event: unexpected event: %s\n", pdht_event_to_string(ev->type));
+      pdht_dump_event(ev);
+      break;
+  }
+}
+
+
+
+/**
+ * pdht_async_deliver - async work that doesn't show up in the poll set
+ *   handles direct neighborhood replies, re-issues puts whose flow control
+ *   backoff is over and calls back operations the caller already completed.
+ *   called by the progress thread serving the table's async queue
+ * @param dht - hash table data structure
+ * @returns number of events, retries and callbacks handled
+ */
+int pdht_async_deliver(pdht_t *dht) {
+  _pdht_async_t *req, *next;
+  int n = 0;
+
+  if (dht->layout == PdhtLayoutDirect)
+    n += pdht_async_drain(dht);
+  n += pdht_async_retry(dht);
+
+  if (!__atomic_load_n(&dht->asyncdone, __ATOMIC_RELAXED))
+    return n;
+
+  for (req = __atomic_exchange_n(&dht->asyncdone, NULL, __ATOMIC_ACQUIRE); req; req = next) {
+    next = req->next;
+    pdht_async_complete(req, req->status);
+    n++;
+  }
+  return n;
+}
+
+
+
+/**
+ * pdht_async_alloc - allocates a request and accounts for it as in flight
+ *   callers wait (driving progress) while PDHT_MAX_ASYNC ops are in flight,
+ *   callbacks don't, since they run on the engine that completes them.
+ */
+static _pdht_async_t *pdht_async_alloc(pdht_t *dht, void *key, pdht_async_cb cb, void *arg) {
+  _pdht_async_t *req;
+  size_t len;
+
+  while ((__atomic_load_n(&dht->asyncpending, __ATOMIC_RELAXED) >= PDHT_MAX_ASYNC) && (!_pdht_in_progress))
+    pdht_progress_yield();
+
+  // put wire data or a get reply, bucket and direct gets may read a whole bucket or neighborhood
+  len = sizeof(ptl_me_t) + PDHT_MAXKEYSIZE + dht->elemsize;
+  if ((dht->layout == PdhtLayoutBucket) && (dht->bucketsize > len))
+    len = dht->bucketsize;
+  else if ((dht->layout == PdhtLayoutDirect) && (PDHT_DIRECT_HOPS * dht->directslotsize > len))
+    len = PDHT_DIRECT_HOPS * dht->directslotsize;
+
+  req = malloc(sizeof(_pdht_async_t) + len);
+  if (!req) {
+    pdht_dprintf("pdht_async_alloc: malloc error: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  req->dht   = dht;
+  req->cb    = cb;
+  req->arg   = arg;
+  req->stage = PdhtAsyncEntry;
+  req->probe = 0;
+  req->tries = 0;
+  memset(req->key, 0, PDHT_MAXKEYSIZE);
+  memcpy(req->key, key, dht->keysize);
+
+  __atomic_add_fetch(&dht->asyncpending, 1, __ATOMIC_RELAXED);
+  return req;
+}
+
+
+
+/**
+ * pdht_async_issue - puts a request on the wire (again, for retries and probes)
+ * @returns Portals status
+ */
+static int pdht_async_issue(_pdht_async_t *req) {
+  pdht_t *dht = req->dht;
+  ptl_match_bits_t bits;
+  ptl_size_t len;
+  int ret;
+
+  if (req->op == PdhtAsyncPut)
+    return PtlPut(dht->ptl.asyncmd, req->loffset, req->len, PTL_ACK_REQ, req->rank,
+                  dht->ptl.putindex[req->ptindex], req->mbits, 0, req, 0);
+
+  if (req->stage == PdhtAsyncBucket)
+    return PtlGet(dht->ptl.asyncmd, (ptl_size_t)req->data, dht->bucketsize, req->rank,
+                  dht->ptl.getindex[req->ptindex], pdht_bucket_bits(dht, req->mbits), 0, req);
+
+  if (req->stage == PdhtAsyncNbhd) {
+    // counted before it goes out, the reply may be handled before PtlGet() returns
+    __atomic_add_fetch(&dht->asyncwait, 1, __ATOMIC_RELAXED);
+    len = PDHT_DIRECT_HOPS * dht->directslotsize;
+    ret = PtlGet(dht->ptl.dasyncmd, (ptl_size_t)req->data, len, req->rank, dht->ptl.dindex, 0,
+                 pdht_direct_home(dht, req->mbits) * dht->directslotsize, req);
+    if (ret != PTL_OK)
+      __atomic_sub_fetch(&dht->asyncwait, 1, __ATOMIC_RELAXED);
+    return ret;
+  }
+
+  // chain markers are zero length, make sure a marker reply never looks like our key
+  req->data[0] = ~req->key[0];
+  bits = req->probe ? pdht_probe_bits(req->mbits, req->probe) : req->mbits;
+  return PtlGet(dht->ptl.asyncmd, (ptl_size_t)req->data, PDHT_MAXKEYSIZE + dht->elemsize, req->rank,
+                dht->ptl.getindex[req->ptindex], bits, 0, req);
+}
+
+
+
+/**
+ * pdht_async_reply - takes the next step of a get once its read has landed
+ *   a bucket or neighborhood miss falls through to the key's own ME only
+ *   when the owner says some keys overflowed it, as in pdht_locate()
+ */
+static void pdht_async_reply(_pdht_async_t *req) {
+  pdht_t *dht = req->dht;
+  char buf[PDHT_MAXKEYSIZE + dht->elemsize];
+  pdht_status_t rval;
+  int overflow;
+
+  switch (req->stage) {
+    case PdhtAsyncBucket:
+      rval = pdht_bucket_scan(dht, req->key, (_pdht_bucket_t *)req->data, NULL, buf, &overflow);
+      break;
+
+    case PdhtAsyncNbhd:
+      rval = pdht_direct_scan(dht, req->key, pdht_direct_home(dht, req->mbits), req->data, NULL, buf, &overflow);
+      if (rval == PdhtStatusError) {
+        // owner was moving a slot, read the neighborhood again
+        if ((++req->tries < PDHT_DIRECT_RETRIES) && (pdht_async_issue(req) == PTL_OK))
+          return;
+        pdht_dprintf("pdht_async_reply: neighborhood on rank %d still changing after %d reads\n", req->rank.rank, req->tries);
+        pdht_async_complete(req, PdhtStatusError);
+        return;
+      }
+      break;
+
+    case PdhtAsyncEntry:
+    default:
+      if (memcmp(req->data, req->key, dht->keysize) == 0) {
+        memcpy(req->value, req->data + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
+        pdht_async_complete(req, PdhtStatusOK);
+
+      } else if (req->probe < PDHT_MAX_PROBES) {
+        // chain marker or another key under the same bits, try the next probe slot
+        req->probe++;
+        if (pdht_async_issue(req) != PTL_OK)
+          pdht_async_complete(req, PdhtStatusError);
+
+      } else {
+        dht->stats.notfound++;
+        pdht_async_complete(req, PdhtStatusNotFound);
+      }
+      return;
+  }
+
+  if (rval == PdhtStatusOK) {
+    memcpy(req->value, buf + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
+    pdht_async_complete(req, PdhtStatusOK);
+
+  } else if (!overflow) {
+    dht->stats.notfound++;
+    pdht_async_complete(req, PdhtStatusNotFound);
+
+  } else {
+    // key may have kept its own ME, fetch it like an entry layout get
+    req->stage = PdhtAsyncEntry;
+    req->probe = 0;
+    if (pdht_async_issue(req) != PTL_OK)
+      pdht_async_complete(req, PdhtStatusError);
+  }
+}
+
+
+
+/**
+ * pdht_async_local - looks up a get on our own rank in the owner index
+ *   uses the completion mutex only, so it is safe from a callback
+ * @returns OK or NotFound, value is filled in on OK
+ */
+static pdht_status_t pdht_async_local(_pdht_async_t *req) {
+  pdht_t *dht = req->dht;
+  char *pt;
+
+  pthread_mutex_lock(&dht->completion_mutex);
+  pt = pdht_layout_find(dht, req->key, req->mbits, req->ptindex);
+  if (!pt) {
+    pt = pdht_index_find(dht, req->key, req->mbits);
+    if (pt)
+      pt = pdht_entry_key(dht, pt); // index hands back the entry
+  }
+  if (pt)
+    memcpy(req->value, pt + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
+  pthread_mutex_unlock(&dht->completion_mutex);
+
+  if (!pt) {
+    dht->stats.notfound++;
+    return PdhtStatusNotFound;
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_async_backoff - parks a put refused by flow control until its backoff is over
+ *   called from pdht_async_event(), pdht_async_retry() puts it back on the wire
+ */
+static void pdht_async_backoff(_pdht_async_t *req) {
+  pdht_t *dht = req->dht;
+  u_int64_t delay = PDHT_ASYNC_RETRY_NS;
+
+  for (int i=0; (i < req->tries) && (delay < PDHT_ASYNC_RETRY_MAX_NS); i++)
+    delay <<= 1;
+  if (delay > PDHT_ASYNC_RETRY_MAX_NS)
+    delay = PDHT_ASYNC_RETRY_MAX_NS;
+
+  req->tries++;
+  req->retry_t = pdht_async_now() + delay;
+  __atomic_add_fetch(&dht->asyncwait, 1, __ATOMIC_RELAXED);
+  pdht_async_push(&dht->asyncretry, req);
+}
+
+
+
+/**
+ * pdht_async_retry - re-issues parked puts whose backoff is over
+ * @returns number of puts re-issued
+ */
+static int pdht_async_retry(pdht_t *dht) {
+  _pdht_async_t *req, *next;
+  u_int64_t now;
+  int n = 0;
+
+  if (!__atomic_load_n(&dht->asyncretry, __ATOMIC_RELAXED))
+    return 0;
+
+  now = pdht_async_now();
+  for (req = __atomic_exchange_n(&dht->asyncretry, NULL, __ATOMIC_ACQUIRE); req; req = next) {
+    next = req->next;
+    if (req->retry_t > now) {
+      pdht_async_push(&dht->asyncretry, req); // not yet
+      continue;
+    }
+    __atomic_sub_fetch(&dht->asyncwait, 1, __ATOMIC_RELAXED);
+    if (pdht_async_issue(req) != PTL_OK)
+      pdht_async_complete(req, PdhtStatusError);
+    n++;
+  }
+  return n;
+}
+
+
+
+/**
+ * pdht_async_drain - handles a batch of direct neighborhood replies
+ * @returns number of events handled
+ */
+static int pdht_async_drain(pdht_t *dht) {
+  ptl_event_t ev;
+  int n, ret;
+
+  for (n=0; n < PDHT_PROGRESS_BATCH; n++) {
+    ret = PtlEQGet(dht->ptl.dasynceq, &ev);
+    if (ret == PTL_EQ_EMPTY)
+      break;
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_async_drain: PtlEQGet error: %s\n", pdht_ptl_error(ret));
+      break;
+    }
+    pdht_async_event(dht, &ev);
+  }
+  return n;
+}
+
+
+
+/**
+ * pdht_async_push - pushes a request onto a deferred completion or retry stack
+ */
+static void pdht_async_push(_pdht_async_t **list, _pdht_async_t *req) {
+  req->next = __atomic_load_n(list, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(list, &req->next, req, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ; // req->next was reloaded, try again
+}
+
+
+
+/**
+ * pdht_async_defer - hands a request the caller completed to the progress engine for its callback
+ */
+static void pdht_async_defer(_pdht_async_t *req, pdht_status_t status) {
+  req->status = status;
+  pdht_async_push(&req->dht->asyncdone, req);
+}
+
+
+
+/**
+ * pdht_async_complete - runs the callback and retires a request
+ */
+static void pdht_async_complete(_pdht_async_t *req, pdht_status_t status) {
+  pdht_t *dht = req->dht;
+
+  if (req->cb)
+    req->cb(dht, req->key, req->value, status, req->arg);
+  free(req);
+
+  // after the callback, so ops it issued keep pdht_async_wait() waiting
+  __atomic_sub_fetch(&dht->asyncpending, 1, __ATOMIC_RELEASE);
+}
+
+
+
+/**
+ * pdht_async_now - monotonic clock in nanoseconds, for flow control backoff
+ */
+static u_int64_t pdht_async_now(void) {
+  struct timespec ts = pdht_get_wtime();
+  return (1000000000ULL * ts.tv_sec) + ts.tv_nsec;
+}
@@ -17,16 +17,17 @@ struct _pdht_atomic_data_s {
 typedef struct _pdht_atomic_data_s _pdht_atomic_data_t;
 
 /*
- * pdht_atomic_init - initialize data structures for atomic operations
+ * pdht_atomic_init - initialize a thread context's data structures for atomic operations
  * @param ht - a PDHT hash table
+ * @param tc - communication context being created
  */
-int pdht_atomic_init(pdht_t *ht) {
+int pdht_atomic_init(pdht_t *ht, pdht_tctx_t *tc) {
   ptl_md_t md;
   int ret;
   _pdht_atomic_data_t *atomicptr = NULL;
 
   // get CT ready for local counter MD events
-  ret = PtlCTAlloc(ht->ptl.lni, &ht->ptl.atomic_ct);
+  ret = PtlCTAlloc(ht->ptl.lni, &tc->atomic_ct);
   if (ret != PTL_OK) {
     pdht_dprintf("pdht_atomic_init: unable to create CT for atomics. -- %s\n", pdht_ptl_error(ret));
     return -1;
@@ -37,48 +38,106 @@ int pdht_atomic_init(pdht_t *ht) {
     pdht_dprintf("unable to get aligned memory block for atomic ops - %s\n", strerror(errno));
     return -1;
   }
-  ht->ptl.atomic_scratch = atomicptr; // save this to use for the actual atomic op later
+  tc->atomic_scratch = atomicptr; // save this to use for the actual atomic op later
   memset(atomicptr, 0, sizeof(_pdht_atomic_data_t));
 
-  md.start     = ht->ptl.atomic_scratch;
+  md.start     = tc->atomic_scratch;
   md.length    = sizeof(_pdht_atomic_data_t);
   md.options   = PTL_MD_EVENT_CT_REPLY;
   md.eq_handle = PTL_EQ_NONE;
-  md.ct_handle = ht->ptl.atomic_ct;
+  md.ct_handle = tc->atomic_ct;
 
-  ret = PtlMDBind(ht->ptl.lni, &md, &ht->ptl.atomic_md);
+  ret = PtlMDBind(ht->ptl.lni, &md, &tc->atomic_md);
   if (ret != PTL_OK) {
     pdht_dprintf("pdht_atomic_init: unable to create MD for atomics");
     return -1;
   }
+
+  // batched cswaps get a ring of scratch blocks, completions are counted and
+  // only failures (keys living under collision chain bits) show up as events
+  ret = posix_memalign(&tc->cswap_ring, sizeof(int64_t), PDHT_CSWAP_RING * sizeof(_pdht_atomic_data_t));
+  if (ret != 0) {
+    pdht_dprintf("unable to get aligned memory block for batched atomic ops - %s\n", strerror(errno));
+    return -1;
+  }
+  memset(tc->cswap_ring, 0, PDHT_CSWAP_RING * sizeof(_pdht_atomic_data_t));
+
+  ret = PtlCTAlloc(ht->ptl.lni, &tc->cswap_ct);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_atomic_init: unable to create CT for batched atomics. -- %s\n", pdht_ptl_error(ret));
+    return -1;
+  }
+  ret = PtlEQAlloc(ht->ptl.lni, PDHT_CSWAP_RING, &tc->cswap_eq);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_atomic_init: unable to create EQ for batched atomics. -- %s\n", pdht_ptl_error(ret));
+    return -1;
+  }
+
+  md.start     = tc->cswap_ring;
+  md.length    = PDHT_CSWAP_RING * sizeof(_pdht_atomic_data_t);
+  md.options   = PTL_MD_EVENT_CT_REPLY | PTL_MD_EVENT_SUCCESS_DISABLE | PTL_MD_EVENT_SEND_DISABLE;
+  md.eq_handle = tc->cswap_eq;
+  md.ct_handle = tc->cswap_ct;
+
+  ret = PtlMDBind(ht->ptl.lni, &md, &tc->cswap_md);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_atomic_init: unable to create MD for batched atomics");
+    return -1;
+  }
+
+  // direct table slots are only reachable through the non-matching NI
+  if (ht->layout == PdhtLayoutDirect) {
+    ret = PtlCTAlloc(c->ptl.nni, &tc->datomic_ct);
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_atomic_init: unable to create direct CT for atomics. -- %s\n", pdht_ptl_error(ret));
+      return -1;
+    }
+    md.ct_handle = tc->datomic_ct;
+    ret = PtlMDBind(c->ptl.nni, &md, &tc->datomic_md);
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_atomic_init: unable to create direct MD for atomics");
+      return -1;
+    }
+  }
   return 0;
 }
 
 
 
 /*
- * pdht_atomic_free - cleanup after atomics 
+ * pdht_atomic_free - cleanup after a thread context's atomics 
  * @param ht - a PDHT hash table
+ * @param tc - communication context being released
  */
-void pdht_atomic_free(pdht_t *ht) {
-  PtlCTFree(ht->ptl.atomic_ct);    // free counter
-  PtlMDRelease(ht->ptl.atomic_md); // free memory descriptor
-  free(ht->ptl.atomic_scratch);    // free scratch space
+void pdht_atomic_free(pdht_t *ht, pdht_tctx_t *tc) {
+  PtlCTFree(tc->atomic_ct);    // free counter
+  PtlMDRelease(tc->atomic_md); // free memory descriptor
+  if (ht->layout == PdhtLayoutDirect) {
+    PtlCTFree(tc->datomic_ct);
+    PtlMDRelease(tc->datomic_md);
+  }
+  free(tc->atomic_scratch);    // free scratch space
+  PtlMDRelease(tc->cswap_md);
+  PtlEQFree(tc->cswap_eq);
+  PtlCTFree(tc->cswap_ct);
+  free(tc->cswap_ring);
 }
 
 
 
-/* 
- * pdht_atomic_cswap - atomically compare and swap an int64 inside a HT entry
- * @note this is hard-coded to int64_t, but could take a type parameter and 
- *        support all portals atomic types (and cswap variants)
+/*
+ * pdht_atomic_fetch - fetching atomic on part of a HT entry, through the calling thread's scratch space
+ *   the caller fills in as->new (and as->compare for compare-and-swap), the
+ *   value prior to the operation comes back in as->old
  * @param ht - a PDHT hash table
  * @param key - the key of the value to atomically update
  * @param offset - offset inside the hash table entry to modify
- * @param old - copyout of the remote value _prior_ to the swap
- * @param new - new value to swap into HT entry
+ * @param len - operand size
+ * @param op - Portals atomic operation
+ * @param type - Portals atomic datatype
+ * @returns status of operation
  */
-pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new) {
+static pdht_status_t pdht_atomic_fetch(pdht_t *ht, void *key, size_t offset, ptl_size_t len, ptl_op_t op, ptl_datatype_t type) {
   ptl_match_bits_t mbits;
   uint32_t ptindex;
   ptl_pt_index_t ptl_ptindex;
@@ -86,51 +145,72 @@ pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *o
   ptl_process_t rank;
   _pdht_atomic_data_t *as;
   ptl_size_t oldoff, newoff;
+  ptl_size_t eoffset = 0;
+  pdht_tctx_t *tc = pdht_tctx(ht);
+  ptl_handle_md_t amd = tc->atomic_md;
+  ptl_handle_ct_t act = tc->atomic_ct;
+  int direct = 0;
   int retries = 5;
   int ret;
 
   // find out where we need to perform operation
-  ht->hashfn(ht, key, &mbits, &ptindex, &rank);
+  pdht_hashkey(ht, key, &mbits, &ptindex, &rank);
   ptl_ptindex = ht->ptl.getindex[ptindex];
 
-  // setup scratch space and get current counter value
-  as = (_pdht_atomic_data_t *)ht->ptl.atomic_scratch; 
-  as->old = 0;
-  as->new = new;
-  as->compare = *old;
+  // bucketed and direct entries live at some slot offset inside a shared ME/LE
+  if (ht->layout != PdhtLayoutEntry) {
+    char buf[PDHT_MAXKEYSIZE + ht->elemsize];
+    ret = pdht_locate(ht, key, mbits, ptindex, rank, &mbits, &eoffset, buf);
+    if (ret != PdhtStatusOK)
+      return ret;
+    if (mbits == __PDHT_DIRECT_BITS) {
+      amd = tc->datomic_md;
+      act = tc->datomic_ct;
+      ptl_ptindex = ht->ptl.dindex;
+      mbits = 0; // ignored on the non-matching portal
+      direct = 1;
+    }
+  }
+
+  as = (_pdht_atomic_data_t *)tc->atomic_scratch; 
   oldoff = offsetof(_pdht_atomic_data_t, old);
   newoff = offsetof(_pdht_atomic_data_t, new);
 
   do {
-    PtlCTGet(ht->ptl.atomic_ct, &ctevent);
-    //eprintf("pdht_atomic_cswap: pre: success: %lu fail: %lu rank: %lu\n", ctevent.success, ctevent.failure, rank.rank);
-
-    // perform atomic cswap
-    ret = PtlSwap(ht->ptl.atomic_md, oldoff, ht->ptl.atomic_md, newoff,
-        sizeof(int64_t), rank, ptl_ptindex, mbits, offset + PDHT_MAXKEYSIZE,
-        NULL, 0, &as->compare, PTL_CSWAP, PTL_INT64_T);
+    PtlCTGet(act, &ctevent);
+    //eprintf("pdht_atomic_fetch: pre: success: %lu fail: %lu rank: %lu\n", ctevent.success, ctevent.failure, rank.rank);
+
+    // swaps carry their compare value, everything else is a plain fetching atomic
+    if ((op == PTL_SWAP) || (op == PTL_CSWAP))
+      ret = PtlSwap(amd, oldoff, amd, newoff,
+          len, rank, ptl_ptindex, mbits, eoffset + offset + PDHT_MAXKEYSIZE,
+          NULL, 0, &as->compare, op, type);
+    else
+      ret = PtlFetchAtomic(amd, oldoff, amd, newoff,
+          len, rank, ptl_ptindex, mbits, eoffset + offset + PDHT_MAXKEYSIZE,
+          NULL, 0, op, type);
     if (ret != PTL_OK) {
-      pdht_dprintf("pdht_atomic_cswap: PtlSwap failed\n");
+      pdht_dprintf("pdht_atomic_fetch: fetching atomic failed: %s\n", pdht_ptl_error(ret));
       return PdhtStatusError;
     }
 
 #define RELIABLE_TARGETS
 #ifdef RELIABLE_TARGETS
     // wait for completion
-    ret = PtlCTWait(ht->ptl.atomic_ct, ctevent.success+1, &ct2);
+    ret = pdht_progress_ct_wait(act, ctevent.success+1, &ct2);
     if (ret != PTL_OK) {
-      pdht_dprintf("pdht_atomic_cswap: PtlCTWait failed\n");
+      pdht_dprintf("pdht_atomic_fetch: PtlCTWait failed\n");
       return PdhtStatusError;
     }
 #else
     ptl_size_t splusone = ctevent.success+1;
     int which;
-    ret = PtlCTPoll(&ht->ptl.atomic_ct, &splusone, 1, 4, &ct2, &which);
+    ret = PtlCTPoll(&act, &splusone, 1, 4, &ct2, &which);
     if (ret == PTL_CT_NONE_REACHED) {
-      pdht_dprintf("pdht_atomic_cswap: timed out waiting for reply\n");
+      pdht_dprintf("pdht_atomic_fetch: timed out waiting for reply\n");
       return PdhtStatusError;
     } else if (ret != PTL_OK) {
-      pdht_dprintf("pdht_atomic_cswap: PtlCTPoll failed\n");
+      pdht_dprintf("pdht_atomic_fetch: PtlCTPoll failed\n");
       return PdhtStatusError;
     }
 #endif
@@ -138,21 +218,214 @@ pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *o
     if (ct2.failure > ctevent.failure) {
       ct2.success = 0;
       ct2.failure = -1;
-      PtlCTInc(ht->ptl.atomic_ct, ct2);
+      PtlCTInc(act, ct2);
       retries--;
+
+      // entry may live under a collision chain probe slot, not the primary bits
+      if (!direct && !(mbits & (__PDHT_PROBE_BIT | __PDHT_BUCKET_BIT))) {
+        char buf[PDHT_MAXKEYSIZE + ht->elemsize];
+        if (pdht_probe(ht, key, mbits, ptindex, rank, &mbits, buf) == PdhtStatusNotFound)
+          return PdhtStatusNotFound;
+      }
     } else {
-      *old = as->old;
       retries = -1;
       return PdhtStatusOK;
     }
   } while (retries > 0);
 
   //printf("oldoff: %d newoff: %d offset: %d %12"PRIx64" %d, %d %ld\n", oldoff, newoff, offset, mbits, ptl_ptindex, rank, as->old);
-  //pdht_dprintf("pdht_atomic_cswap: failure : %d : %d\n", c->rank, rank.rank);
+  //pdht_dprintf("pdht_atomic_fetch: failure : %d : %d\n", c->rank, rank.rank);
 
   return PdhtStatusError;
 }
 
+
+
+/* 
+ * pdht_atomic_cswap - atomically compare and swap an int64 inside a HT entry
+ * @param ht - a PDHT hash table
+ * @param key - the key of the value to atomically update
+ * @param offset - offset inside the hash table entry to modify
+ * @param old - copyout of the remote value _prior_ to the swap
+ * @param new - new value to swap into HT entry
+ */
+pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new) {
+  _pdht_atomic_data_t *as = (_pdht_atomic_data_t *)pdht_tctx(ht)->atomic_scratch;
+  pdht_status_t ret;
+
+  // setup scratch space
+  as->old = 0;
+  as->new = new;
+  as->compare = *old;
+
+  ret = pdht_atomic_fetch(ht, key, offset, sizeof(int64_t), PTL_CSWAP, PTL_INT64_T);
+  if (ret == PdhtStatusOK)
+    *old = as->old;
+  return ret;
+}
+
+
+
+/*
+ * pdht_atomic_cswap_many - compare and swap an int64 inside many HT entries at once
+ *   every swap is issued before waiting once for all of their replies. keys
+ *   found under collision chain bits, and every key of the bucket and direct
+ *   layouts (which need a lookup first anyway), fall back to pdht_atomic_cswap().
+ * @param ht - a PDHT hash table
+ * @param n - number of keys
+ * @param keys - keys of the values to atomically update
+ * @param offset - offset inside each hash table entry to modify
+ * @param old - compare values in, copyout of the remote values _prior_ to the swaps
+ * @param new - new values to swap into the HT entries
+ * @param status - per-key status of the swaps (may be NULL)
+ * @returns OK if every swap succeeded, otherwise the status of a failed one
+ */
+pdht_status_t pdht_atomic_cswap_many(pdht_t *ht, int n, void **keys, size_t offset, int64_t *old, int64_t *new, pdht_status_t *status) {
+  _pdht_atomic_data_t *ring, *as;
+  ptl_match_bits_t mbits;
+  uint32_t ptindex;
+  ptl_process_t rank;
+  ptl_ct_event_t base, ctevent;
+  ptl_event_t ev;
+  pdht_status_t rval = PdhtStatusOK, ret;
+  pdht_tctx_t *tc = pdht_tctx(ht);
+  int failed[PDHT_CSWAP_RING];
+  int k, err;
+
+  ring = (_pdht_atomic_data_t *)tc->cswap_ring;
+
+  for (int i=0; i < n; i += PDHT_CSWAP_RING) {
+    k = (n - i) < PDHT_CSWAP_RING ? (n - i) : PDHT_CSWAP_RING;
+    memset(failed, 0, k * sizeof(int));
+
+    if (ht->layout != PdhtLayoutEntry) {
+      for (int j=0; j < k; j++)
+        failed[j] = 1;
+      goto retry;
+    }
+
+    PtlCTGet(tc->cswap_ct, &base);
+
+    // issue this chunk's swaps without waiting on any of them
+    for (int j=0; j < k; j++) {
+      as = &ring[j];
+      as->old     = 0;
+      as->new     = new[i+j];
+      as->compare = old[i+j];
+
+      pdht_hashkey(ht, keys[i+j], &mbits, &ptindex, &rank);
+      err = PtlSwap(tc->cswap_md, (char *)&as->old - (char *)ring, tc->cswap_md, (char *)&as->new - (char *)ring,
+          sizeof(int64_t), rank, ht->ptl.getindex[ptindex], mbits, offset + PDHT_MAXKEYSIZE,
+          (void *)(intptr_t)j, 0, &as->compare, PTL_CSWAP, PTL_INT64_T);
+      if (err != PTL_OK) {
+        pdht_dprintf("pdht_atomic_cswap_many: PtlSwap failed: %s\n", pdht_ptl_error(err));
+        // nothing after this one was issued
+        for (int m=j; m < k; m++)
+          failed[m] = 1;
+        k = j;
+        break;
+      }
+    }
+
+    // one wait for the whole chunk
+    err = pdht_progress_ct_wait(tc->cswap_ct, base.success + base.failure + k, &ctevent);
+    if (err != PTL_OK) {
+      pdht_dprintf("pdht_atomic_cswap_many: PtlCTWait failed\n");
+      return PdhtStatusError;
+    }
+
+    // replies that didn't match are the only events on the queue
+    for (ptl_size_t f = base.failure; f < ctevent.failure; ) {
+      if (PtlEQWait(tc->cswap_eq, &ev) != PTL_OK)
+        break;
+      if ((ev.type == PTL_EVENT_REPLY) && (ev.ni_fail_type != PTL_NI_OK)) {
+        failed[(intptr_t)ev.user_ptr] = 1;
+        f++;
+      }
+    }
+
+    for (int j=0; j < k; j++) {
+      if (failed[j])
+        continue;
+      old[i+j] = ring[j].old;
+      if (status)
+        status[i+j] = PdhtStatusOK;
+    }
+
+retry:
+    k = (n - i) < PDHT_CSWAP_RING ? (n - i) : PDHT_CSWAP_RING;
+    for (int j=0; j < k; j++) {
+      if (!failed[j])
+        continue;
+      ret = pdht_atomic_cswap(ht, keys[i+j], offset, &old[i+j], new[i+j]);
+      if (status)
+        status[i+j] = ret;
+      if (ret != PdhtStatusOK)
+        rval = ret;
+    }
+  }
+  return rval;
+}
+
+
+
+/*
+ * pdht_fetch_op - atomically applies an operator to one element of a HT entry
+ *   and returns the element's prior value, in one round trip
+ * @param ht - a PDHT hash table
+ * @param key - the key of the value to atomically update
+ * @param offset - offset of the element inside the hash table entry
+ * @param type - element type
+ * @param op - operator (AssocOpSwap stores the operand)
+ * @param operand - right hand side of the operator
+ * @param old - copyout of the remote value _prior_ to the operation
+ * @returns status of operation
+ */
+pdht_status_t pdht_fetch_op(pdht_t *ht, void *key, size_t offset, pdht_datatype_t type, pdht_oper_t op, void *operand, void *old) {
+  _pdht_atomic_data_t *as = (_pdht_atomic_data_t *)pdht_tctx(ht)->atomic_scratch;
+  int tsize = pdht_acc_typesize(type);
+  pdht_status_t ret;
+
+  if ((offset + tsize > ht->elemsize) || !pdht_acc_check(type, op)) {
+    pdht_dprintf("pdht_fetch_op: operator %d on type %d at offset %lu is invalid\n", op, type, offset);
+    return PdhtStatusError;
+  }
+
+  as->old = 0;
+  as->new = 0;
+  memcpy(&as->new, operand, tsize);
+
+  ret = pdht_atomic_fetch(ht, key, offset, tsize, pdht_acc_ptlop(op), pdht_acc_ptltype(type));
+  if (ret == PdhtStatusOK)
+    memcpy(old, &as->old, tsize);
+  return ret;
+}
+
+
+
+/*
+ * counters are spread over the ranks rather than all living on rank 0, so
+ * that tables with many counters don't pile every fetch-add onto one NIC.
+ * a chunked counter goes further: each thread claims a run of values with a
+ * single fetch-add and hands them out locally until the run is used up.
+ * values from a chunked counter are unique but not ordered across threads,
+ * and whatever is left of a run when a larger increment needs a new one is
+ * skipped.
+ */
+
+
+
+/**
+ * pdht_counter_home - rank holding the target side of a counter
+ * @param cindex - counter index
+ * @returns owner rank
+ */
+static inline int pdht_counter_home(int cindex) {
+  return cindex % c->size;
+}
+
+
+
 /*
  * pdht_counter_init - initializes a new atomic counter for a hash table
  * @param ht - a PDHT hash table
@@ -160,15 +433,34 @@ pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *o
  * @returns index of the new counter
  */
 int pdht_counter_init(pdht_t *ht, int initval) {
+  return pdht_counter_init_chunked(ht, initval, 1);
+}
+
+
+
+/*
+ * pdht_counter_init_chunked - initializes a new atomic counter with per-thread caching
+ * @param ht - a PDHT hash table
+ * @param initval - initial counter value
+ * @param chunk - number of values claimed from the counter's home at a time (1 disables caching)
+ * @returns index of the new counter
+ */
+int pdht_counter_init_chunked(pdht_t *ht, int initval, unsigned chunk) {
   int cindex, ret;
   ptl_me_t me;
   ptl_md_t md;
 
   // XXX these structures are leaked and not cleaned up on hash table removal
 
+  if (ht->countercount >= PDHT_MAX_COUNTERS) {
+    pdht_dprintf("pdht_counter_init: too many counters (max %d)\n", PDHT_MAX_COUNTERS);
+    return -1;
+  }
+
   cindex = ht->countercount++;
+  ht->counterchunk[cindex] = chunk ? chunk : 1;
 
-  if (c->rank == 0) {
+  if (c->rank == pdht_counter_home(cindex)) {
     // create new counter md in array of counter objects in pdht_t
 
     // create MD for the target side counter array
@@ -217,81 +509,101 @@ int pdht_counter_init(pdht_t *ht, int initval) {
 
 /**
  * pdht_counter_reset - collectively reset an HT atomic counter
+ *   also drops every thread's cached chunk of the counter
  * @param ht - a hash table
  * @param counter - which counter to reset
  */
 void pdht_counter_reset(pdht_t *ht, int counter) {
-  ptl_process_t r0 = { .rank = 0 };
-  ptl_ct_event_t ctevent;
-  int ret;
-
-  PtlCTGet(ht->ptl.countcts[counter], &ctevent);
+  pdht_tctx_t *tc;
 
   ht->lcounts[counter] = 0; // set our value to zero
 
-  // swap with rank 0's value.
-  if (c->rank == 0) {
-
-  // use PtlSwap if we want one-sided reset/set (add parameter to initialize value)
-#if 0
-  if (c->rank == 1)
-    ret = PtlSwap(ht->ptl.countmds[counter], 0, 
-                  ht->ptl.countmds[counter], 0, 
-                  sizeof(uint64_t), r0, __PDHT_COUNTER_INDEX,
-                  counter, 0, NULL, 0, PTL_SWAP, PTL_UINT64_T);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_counter_reset: swap error\n");
-      return;
-    }
+  for (int i=0; i < PDHT_MAX_THREADS; i++) {
+    tc = ht->ptl.tctx[i];
+    if (tc)
+      tc->ccnext[counter] = tc->ccend[counter] = 0;
+  }
 
-    printf("rank 0 waiting\n");
-    ret = PtlCTWait(ht->ptl.countcts[counter], ctevent.success+1, &ctevent);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_counter_reset: PtlCTWait failed\n");
-      return;
-    }
-#endif
+  if (c->rank == pdht_counter_home(counter))
     ht->counters[counter] = 0;
-  } 
   pdht_barrier();
-  // not handling atomic failure (ctevent.failure)
 }
 
 
 
 /**
- * pdht_counter_inc - increments a counter by a given value
+ * pdht_counter_fetch_add - fetch-add on a counter's home rank
  * @param ht a hash table
  * @param counter index of the counter to modify
  * @param val amount to increment counter by
  * @returns existing counter value
  */
-uint64_t pdht_counter_inc(pdht_t *ht, int counter, uint64_t val) {
-  ptl_process_t r0 = { .rank = 0 };
+static uint64_t pdht_counter_fetch_add(pdht_t *ht, int counter, uint64_t val) {
+  ptl_process_t home = { .rank = pdht_counter_home(counter) };
   ptl_ct_event_t ctevent;
+  pdht_tctx_t *tc;
+  _pdht_atomic_data_t *as;
   int ret;
 
 
+  // the per-counter MDs are shared, fetch into this thread's atomic scratch instead
+  tc = pdht_tctx(ht);
+  as = (_pdht_atomic_data_t *)tc->atomic_scratch;
+
   // get the current counter values
-  PtlCTGet(ht->ptl.countcts[counter], &ctevent);
+  PtlCTGet(tc->atomic_ct, &ctevent);
 
   // set target value to the parameter
-  ht->lcounts[counter] = val;
+  as->new = val;
 
-  // fetch and add to counter on rank zero
-  ret = PtlFetchAtomic(ht->ptl.countmds[counter], 0, ht->ptl.countmds[counter], 0,
-      sizeof(ht->lcounts[counter]), r0, __PDHT_COUNTER_INDEX,
+  // fetch and add to counter on its home rank
+  ret = PtlFetchAtomic(tc->atomic_md, offsetof(_pdht_atomic_data_t, old), tc->atomic_md, offsetof(_pdht_atomic_data_t, new),
+      sizeof(uint64_t), home, __PDHT_COUNTER_INDEX,
       counter, 0, NULL, 0, PTL_SUM, PTL_UINT64_T);
   if (ret != PTL_OK) {
     pdht_dprintf("pdht_counter_inc: fetch add error\n");
     return -1;
   }
 
-  ret = PtlCTWait(ht->ptl.countcts[counter], ctevent.success+1, &ctevent);
+  ret = pdht_progress_ct_wait(tc->atomic_ct, ctevent.success+1, &ctevent);
   if (ret != PTL_OK) {
     pdht_dprintf("pdht_counter_inc: PtlCTWait failed\n");
     return -1;
   }
   // not handling atomic failure (ctevent.failure)
-  return ht->lcounts[counter];
+  return (uint64_t)as->old;
+}
+
+
+
+/**
+ * pdht_counter_inc - increments a counter by a given value
+ *   chunked counters are served from this thread's cached run when it
+ *   has room, an increment of 0 always reads the counter's home
+ * @param ht a hash table
+ * @param counter index of the counter to modify
+ * @param val amount to increment counter by
+ * @returns existing counter value
+ */
+uint64_t pdht_counter_inc(pdht_t *ht, int counter, uint64_t val) {
+  pdht_tctx_t *tc;
+  uint64_t chunk, ret;
+
+  chunk = ht->counterchunk[counter];
+  if ((chunk <= 1) || (val == 0))
+    return pdht_counter_fetch_add(ht, counter, val);
+
+  tc = pdht_tctx(ht);
+  if (tc->ccend[counter] - tc->ccnext[counter] < val) {
+    chunk = val > chunk ? val : chunk;
+    ret = pdht_counter_fetch_add(ht, counter, chunk);
+    if (ret == (uint64_t)-1)
+      return ret;
+    tc->ccnext[counter] = ret;
+    tc->ccend[counter]  = ret + chunk;
+  }
+
+  ret = tc->ccnext[counter];
+  tc->ccnext[counter] += val;
+  return ret;
 }
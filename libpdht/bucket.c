@@ -0,0 +1,272 @@
+/********************************************************/
+/*                                                      */
+/*  bucket.c - PDHT bucketed active match list layout   */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table bucket layout
+ *
+ * with PdhtLayoutBucket each active PTE carries a fixed set of persistent
+ * bucket MEs instead of one ME per entry. a bucket ME matches
+ * pdht_bucket_bits() and ignores the low match bits, so every key hashing
+ * to the bucket lands on the same ME. once a put has been linked, the owner
+ * copies it into a free slot of its bucket and drops the per-entry ME.
+ * initiators fetch the whole bucket and resolve the key themselves, updates
+ * put straight into the slot by offset. entries that find their bucket full
+ * keep their own ME (and collision handling) and are found on the normal path.
+ */
+
+static _pdht_bucket_t *pdht_bucket_iter_bucket(pdht_t *dht, char *pos, unsigned *slot);
+
+
+
+/**
+ * pdht_bucket_init - allocates bucket storage and links the bucket MEs
+ * @param dht - hash table data structure
+ */
+void pdht_bucket_init(pdht_t *dht) {
+  ptl_me_t me;
+  unsigned nbuckets = 1, perpte;
+  int ret;
+
+  // keep buckets about half full on average
+  perpte = (2 * dht->maxentries) / (dht->ptl.nptes * dht->bucketslots);
+  while (nbuckets < perpte)
+    nbuckets <<= 1;
+  assert(nbuckets <= (1U << 30)); // bucket index has to fit under the bucket bit
+
+  dht->bucketmask = nbuckets - 1;
+  dht->bucketsize = sizeof(_pdht_bucket_t) + (dht->bucketslots * (PDHT_MAXKEYSIZE + dht->elemsize));
+  dht->bucketsize = (dht->bucketsize + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1); // keep used counts aligned
+
+  nbuckets *= dht->ptl.nptes;
+  dht->buckets   = calloc(nbuckets, dht->bucketsize);
+  dht->bucketmes = malloc(nbuckets * sizeof(ptl_handle_me_t));
+  if ((!dht->buckets) || (!dht->bucketmes)) {
+    pdht_dprintf("pdht_bucket_init: calloc error: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  me.length        = dht->bucketsize;
+  me.ct_handle     = PTL_CT_NONE;
+  me.uid           = PTL_UID_ANY;
+  me.options       = PTL_ME_OP_GET
+                   | PTL_ME_OP_PUT
+                   | PTL_ME_IS_ACCESSIBLE
+                   | PTL_ME_EVENT_COMM_DISABLE
+                   | PTL_ME_EVENT_LINK_DISABLE
+                   | PTL_ME_EVENT_UNLINK_DISABLE;
+  me.match_id.rank = PTL_RANK_ANY;
+  me.ignore_bits   = __PDHT_BUCKET_IGNORE;
+
+  for (unsigned ptindex=0; ptindex < dht->ptl.nptes; ptindex++) {
+    for (unsigned b=0; b <= dht->bucketmask; b++) {
+      me.start      = pdht_bucket_ptr(dht, ptindex, b);
+      me.match_bits = __PDHT_BUCKET_BIT | ((ptl_match_bits_t)b << __PDHT_BUCKET_SHIFT);
+
+      ret = PtlMEAppend(dht->ptl.lni, dht->ptl.getindex[ptindex], &me, PTL_PRIORITY_LIST, NULL,
+                        &dht->bucketmes[(ptindex * (dht->bucketmask+1)) + b]);
+      if (ret != PTL_OK) {
+        pdht_dprintf("pdht_bucket_init: PtlMEAppend error [%d/%d]: %s\n", ptindex, b, pdht_ptl_error(ret));
+        exit(1);
+      }
+    }
+  }
+
+  pdht_eprintf(PDHT_DEBUG_WARN, "\tbucket layout: %d buckets/PTE, %d entries/bucket (%d bytes)\n",
+               dht->bucketmask+1, dht->bucketslots, dht->bucketsize);
+}
+
+
+
+/**
+ * pdht_bucket_fini - unlinks bucket MEs and releases bucket storage
+ * @param dht - hash table data structure
+ */
+void pdht_bucket_fini(pdht_t *dht) {
+  if (!dht->buckets)
+    return;
+
+  for (unsigned i=0; i < (dht->ptl.nptes * (dht->bucketmask+1)); i++)
+    PtlMEUnlink(dht->bucketmes[i]);
+
+  free(dht->bucketmes);
+  free(dht->buckets);
+  dht->bucketmes = NULL;
+  dht->buckets   = NULL;
+}
+
+
+
+/**
+ * pdht_bucket_place - copies a newly linked entry into its bucket
+ *   must be called with the completion mutex held
+ * @param dht - hash table data structure
+ * @param entry - local hash table entry (key + value filled in)
+ * @param bits - primary match bits of the entry
+ * @param ptindex - PTE the entry belongs to
+ * @returns 1 if the entry now lives in the bucket, 0 if the bucket is full
+ */
+int pdht_bucket_place(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex) {
+  _pdht_bucket_t *b = pdht_bucket_ptr(dht, ptindex, pdht_bucket_index(dht, bits));
+  unsigned slotsize = PDHT_MAXKEYSIZE + dht->elemsize;
+  char *key = pdht_entry_key(dht, entry); // value follows the key in both entry types
+  char *slot;
+
+  for (unsigned i=0; i < b->used; i++) {
+    slot = b->slots + (i * slotsize); // pointer math
+    if (memcmp(slot, key, dht->keysize) == 0) {
+      // re-put of a bucketed key just overwrites the value
+      memcpy(slot + PDHT_MAXKEYSIZE, key + PDHT_MAXKEYSIZE, dht->elemsize);
+      return 1;
+    }
+  }
+
+  if (b->used == dht->bucketslots)
+    return 0;
+
+  // fill the slot before publishing it to initiators reading the bucket
+  slot = b->slots + (b->used * slotsize); // pointer math
+  memcpy(slot, key, slotsize);
+  __sync_synchronize();
+  b->used++;
+  return 1;
+}
+
+
+
+/**
+ * pdht_bucket_scan - looks for a key in a bucket fetched from its owner
+ * @param dht - hash table data structure
+ * @param key - key to find
+ * @param b - fetched bucket
+ * @param offset - optional copy-out of the offset of key + value inside the bucket
+ * @param buf - reply buffer (key + value)
+ * @param overflow - set if key may instead be linked under its own ME
+ * @returns OK if key was found, NotFound otherwise
+ */
+pdht_status_t pdht_bucket_scan(pdht_t *dht, void *key, _pdht_bucket_t *b, ptl_size_t *offset, char *buf, int *overflow) {
+  unsigned slotsize = PDHT_MAXKEYSIZE + dht->elemsize;
+  char *slot;
+
+  for (unsigned i=0; (i < b->used) && (i < dht->bucketslots); i++) {
+    slot = b->slots + (i * slotsize); // pointer math
+    if (memcmp(slot, key, dht->keysize) == 0) {
+      memcpy(buf, slot, slotsize);
+      if (offset)
+        *offset = slot - (char *)b;
+      return PdhtStatusOK;
+    }
+  }
+
+  // only entries that found their bucket full have an ME of their own
+  *overflow = (b->used >= dht->bucketslots);
+  return PdhtStatusNotFound;
+}
+
+
+
+/**
+ * pdht_bucket_find - finds a local bucketed entry
+ *   must be called with the completion mutex held
+ * @param dht - hash table data structure
+ * @param key - key to find
+ * @param bits - primary match bits of key
+ * @param ptindex - PTE of key
+ * @returns pointer to the slot (key + value), or NULL if not in the bucket
+ */
+void *pdht_bucket_find(pdht_t *dht, void *key, ptl_match_bits_t bits, uint32_t ptindex) {
+  _pdht_bucket_t *b = pdht_bucket_ptr(dht, ptindex, pdht_bucket_index(dht, bits));
+  unsigned slotsize = PDHT_MAXKEYSIZE + dht->elemsize;
+  char *slot;
+
+  for (unsigned i=0; i < b->used; i++) {
+    slot = b->slots + (i * slotsize); // pointer math
+    if (memcmp(slot, key, dht->keysize) == 0)
+      return slot;
+  }
+  return NULL;
+}
+
+
+
+/**
+ * pdht_bucket_hasnext - bucket layout iteration, skips empty slots and unused entries
+ *   iteration covers bucket slots first, then entries that overflowed their bucket
+ * @param it a PDHT iterator structure
+ * @returns 1 if next entry is valid, 0 otherwise
+ */
+int pdht_bucket_hasnext(pdht_iter_t *it) {
+  pdht_t *dht = it->dht;
+  char *bend = (char *)dht->buckets + (dht->ptl.nptes * (dht->bucketmask+1) * dht->bucketsize);
+  _pdht_bucket_t *b;
+  unsigned slot;
+
+  if ((it->iterator >= (char *)dht->buckets) && (it->iterator < bend)) {
+    while (it->iterator < bend) {
+      b = pdht_bucket_iter_bucket(dht, it->iterator, &slot);
+      if (slot < b->used) {
+        it->iterator = b->slots + (slot * (PDHT_MAXKEYSIZE + dht->elemsize)); // pointer math
+        return 1;
+      }
+      // rest of this bucket is empty, skip to the next one
+      it->iterator = (char *)b + dht->bucketsize;
+    }
+    it->iterator = (char *)dht->ht;
+  }
+  return pdht_entry_hasnext(it);
+}
+
+
+
+/**
+ * pdht_bucket_getnext - bucket layout iteration
+ * @param it a PDHT iterator structure
+ * @param key optional copy-out of matching key for entry
+ * @returns pointer to HT entry value
+ */
+void *pdht_bucket_getnext(pdht_iter_t *it, void **key) {
+  pdht_t *dht = it->dht;
+  char *ret;
+
+  if (!pdht_bucket_hasnext(it))
+    return NULL;
+
+  if ((it->iterator >= (char *)dht->ht) && (it->iterator < (char *)dht->ht + (dht->maxentries * dht->entrysize))) {
+    ret = pdht_entry_key(dht, it->iterator);
+    it->iterator += dht->entrysize;
+  } else {
+    ret = it->iterator;
+    it->iterator += PDHT_MAXKEYSIZE + dht->elemsize;
+  }
+
+  if (key)
+    *key = ret;
+  return ret + PDHT_MAXKEYSIZE; // pointer math
+}
+
+
+
+/**
+ * pdht_bucket_iter_bucket - maps an iterator position in bucket storage to its bucket and slot
+ */
+static _pdht_bucket_t *pdht_bucket_iter_bucket(pdht_t *dht, char *pos, unsigned *slot) {
+  size_t off = pos - (char *)dht->buckets;
+  _pdht_bucket_t *b = (_pdht_bucket_t *)((char *)dht->buckets + ((off / dht->bucketsize) * dht->bucketsize));
+
+  // positions inside the header belong to slot 0
+  if (pos < b->slots) {
+    *slot = 0;
+  } else {
+    *slot = (pos - b->slots) / (PDHT_MAXKEYSIZE + dht->elemsize);
+  }
+  return b;
+}
@@ -0,0 +1,402 @@
+/********************************************************/
+/*                                                      */
+/*  collision.c - PDHT match bit collision resolution   */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table collision resolution
+ *
+ * two keys that hash to the same 64-bit match bits would otherwise be linked
+ * on the same active PTE under identical match bits. the owner keeps an index
+ * of linked match bits and, on the first collision, turns the slot into a chain:
+ *   - a zero-length, get-only marker ME is linked at the primary match bits
+ *   - every colliding entry is relinked under pdht_probe_bits(bits, i)
+ * a get that lands on the marker (or on a different key) just walks the probes
+ * until it finds its key or misses, so the common case stays a single round trip.
+ */
+
+static inline _pdht_index_slot_t *pdht_index_lookup(pdht_t *dht, ptl_match_bits_t bits);
+static inline _pdht_index_slot_t *pdht_index_lookup_in(_pdht_index_slot_t *slots, unsigned mask, ptl_match_bits_t bits);
+static int pdht_index_do_claim(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex, ptl_match_bits_t *lbits);
+static void pdht_index_link_marker(pdht_t *dht, _pdht_index_slot_t *slot);
+static int pdht_index_next_probe(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex, uint32_t entry, ptl_match_bits_t *pbits);
+
+
+
+/**
+ * pdht_index_init - allocates the owner-side match bits index
+ * @param dht - hash table data structure
+ */
+void pdht_index_init(pdht_t *dht) {
+  _pdht_index_slot_t *slots;
+  unsigned nslots = pdht_index_size(dht);
+
+  // same-node ranks read the index out of our shared segment (shm.c)
+  slots = dht->shm ? pdht_shm_index(dht) : malloc(nslots * sizeof(_pdht_index_slot_t));
+  if (!slots) {
+    pdht_dprintf("pdht_index_init: malloc error: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  for (unsigned i=0; i < nslots; i++) {
+    slots[i].entry = __PDHT_INDEX_EMPTY;
+    slots[i].mark  = PTL_INVALID_HANDLE;
+  }
+
+  dht->index     = slots;
+  dht->indexmask = nslots - 1;
+}
+
+
+
+/**
+ * pdht_index_size - number of owner index slots for a table
+ * @param dht - hash table data structure
+ */
+unsigned pdht_index_size(pdht_t *dht) {
+  unsigned nslots = 1;
+
+  // keep the index at most half full
+  while (nslots < 2*dht->maxentries)
+    nslots <<= 1;
+  return nslots;
+}
+
+
+
+/**
+ * pdht_index_fini - releases chain markers and the owner-side index
+ * @param dht - hash table data structure
+ */
+void pdht_index_fini(pdht_t *dht) {
+  _pdht_index_slot_t *slots = dht->index;
+
+  if (!slots)
+    return;
+
+  for (unsigned i=0; i <= dht->indexmask; i++) {
+    if (!PtlHandleIsEqual(slots[i].mark, PTL_INVALID_HANDLE))
+      PtlMEUnlink(slots[i].mark);
+  }
+  if (!dht->shm)
+    free(slots);
+  dht->index = NULL;
+}
+
+
+
+/**
+ * pdht_index_claim - records a new local entry and picks the match bits it is linked under
+ *   a key that is already linked (directly or in a chain) keeps its entry,
+ *   the new value is copied over the old one
+ * @param dht - hash table data structure
+ * @param entry - new local hash table entry (key + value filled in)
+ * @param bits - primary match bits computed by the initiator
+ * @param ptindex - PTE the entry belongs to
+ * @param lbits - match bits the entry should be linked with (bits, or a probe slot on collision)
+ * @returns 1 if the entry needs an ME under lbits, 0 if the key was already
+ *          present and updated in place, -1 if the collision chain is full
+ */
+int pdht_index_claim(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex, ptl_match_bits_t *lbits) {
+  int ret;
+
+  // same-node readers retry if they overlap the index update
+  pdht_shm_write_begin(dht);
+  ret = pdht_index_do_claim(dht, entry, bits, ptindex, lbits);
+  pdht_shm_write_end(dht);
+  return ret;
+}
+
+
+
+/**
+ * pdht_index_do_claim - updates the index for a new entry, see pdht_index_claim()
+ */
+static int pdht_index_do_claim(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex, ptl_match_bits_t *lbits) {
+  _pdht_index_slot_t *slot, *pslot;
+  uint32_t eindex = pdht_find_bucket(dht, entry);
+  char *key = pdht_entry_key(dht, entry); // value follows the key in both entry types
+  ptl_match_bits_t pbits;
+  char *prev;
+
+  *lbits = bits;
+  slot = pdht_index_lookup(dht, bits);
+
+  if (slot->entry == __PDHT_INDEX_EMPTY) {
+    // common case, first entry under these match bits
+    slot->bits    = bits;
+    slot->entry   = eindex;
+    slot->ptindex = ptindex;
+    dht->stats.ptentries[ptindex]++;
+    return 1;
+  }
+
+  if (slot->entry != __PDHT_INDEX_CHAIN) {
+    if (slot->entry == eindex)
+      return 1;
+
+    // re-putting an existing key is not a collision
+    prev = pdht_entry_key(dht, (char *)dht->ht + (slot->entry * dht->entrysize)); // pointer math
+    if (memcmp(prev, key, dht->keysize) == 0) {
+      memcpy(prev + PDHT_MAXKEYSIZE, key + PDHT_MAXKEYSIZE, dht->elemsize);
+      return 0;
+    }
+
+    // first collision on these bits, marker goes up before the old entry moves
+    pdht_index_link_marker(dht, slot);
+    pdht_index_next_probe(dht, bits, ptindex, slot->entry, &pbits); // every probe of a new chain is free
+    pdht_index_relink(dht, (char *)dht->ht + (slot->entry * dht->entrysize), pbits, ptindex); // pointer math
+    slot->entry = __PDHT_INDEX_CHAIN;
+    dht->stats.ptentries[ptindex]++;
+
+  } else {
+    // same for a key that already sits in the chain
+    for (int i=1; i <= PDHT_MAX_PROBES; i++) {
+      pslot = pdht_index_lookup(dht, pdht_probe_bits(bits, i));
+      if (pslot->entry == __PDHT_INDEX_EMPTY)
+        break;
+      if (pslot->entry == eindex) {
+        *lbits = pslot->bits;
+        return 1;
+      }
+      prev = pdht_entry_key(dht, (char *)dht->ht + (pslot->entry * dht->entrysize)); // pointer math
+      if (memcmp(prev, key, dht->keysize) == 0) {
+        memcpy(prev + PDHT_MAXKEYSIZE, key + PDHT_MAXKEYSIZE, dht->elemsize);
+        return 0;
+      }
+    }
+  }
+
+  if (!pdht_index_next_probe(dht, bits, ptindex, eindex, lbits)) {
+    pdht_dprintf("pdht_index_claim: more than %d keys collide on match bits %"PRIx64"\n", PDHT_MAX_PROBES, bits);
+    return -1;
+  }
+  dht->stats.collisions++;
+  dht->stats.ptentries[ptindex]++;
+  return 1;
+}
+
+
+
+/**
+ * pdht_index_relink - moves an active entry to a new set of match bits
+ * @param dht - hash table data structure
+ * @param entry - local hash table entry
+ * @param bits - new match bits
+ * @param ptindex - PTE the entry belongs to
+ */
+void pdht_index_relink(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex) {
+  _pdht_ht_entry_t *hte = (_pdht_ht_entry_t *)entry; // pme/ame overlay both entry types
+  ptl_handle_me_t old = hte->ame;
+  ptl_me_t me;
+  int ret;
+
+  me.start         = pdht_entry_key(dht, entry);
+  me.length        = PDHT_MAXKEYSIZE + dht->elemsize;
+  me.ct_handle     = PTL_CT_NONE;
+  me.uid           = PTL_UID_ANY;
+  me.options       = PTL_ME_OP_GET
+                   | PTL_ME_OP_PUT
+                   | PTL_ME_IS_ACCESSIBLE
+                   | PTL_ME_EVENT_COMM_DISABLE
+                   | PTL_ME_EVENT_LINK_DISABLE
+                   | PTL_ME_EVENT_UNLINK_DISABLE;
+  me.match_id.rank = PTL_RANK_ANY;
+  me.match_bits    = bits;
+  me.ignore_bits   = 0;
+
+  // link under the new bits before dropping the old ME, so the entry never disappears
+  ret = PtlMEAppend(dht->ptl.lni, dht->ptl.getindex[ptindex], &me, PTL_PRIORITY_LIST, entry, &hte->ame);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_index_relink: PtlMEAppend error: %s\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+
+  if (!PtlHandleIsEqual(old, PTL_INVALID_HANDLE))
+    PtlMEUnlink(old);
+}
+
+
+
+/**
+ * pdht_index_find - finds a local entry by key, following collision chains
+ * @param dht - hash table data structure
+ * @param key - key to find
+ * @param bits - primary match bits of key
+ * @returns pointer to the local entry, or NULL if not present
+ */
+void *pdht_index_find(pdht_t *dht, void *key, ptl_match_bits_t bits) {
+  return pdht_index_find_in(dht, dht->index, dht->ht, key, bits);
+}
+
+
+
+/**
+ * pdht_index_find_in - finds an entry by key in any rank's index and entries
+ *   also used on a same-node rank's shared segment, which may change under
+ *   us (see pdht_shm_get()), so entry numbers are checked before use
+ * @param dht - hash table data structure
+ * @param slots - index to search
+ * @param entries - entry array the index refers to
+ * @param key - key to find
+ * @param bits - primary match bits of key
+ * @returns pointer to the entry, or NULL if not present
+ */
+void *pdht_index_find_in(pdht_t *dht, _pdht_index_slot_t *slots, char *entries, void *key, ptl_match_bits_t bits) {
+  _pdht_index_slot_t *slot;
+  void *entry;
+
+  slot = pdht_index_lookup_in(slots, dht->indexmask, bits);
+  if (slot->entry == __PDHT_INDEX_EMPTY)
+    return NULL;
+
+  if (slot->entry != __PDHT_INDEX_CHAIN) {
+    if (slot->entry >= dht->maxentries)
+      return NULL;
+    entry = entries + (slot->entry * dht->entrysize); // pointer math
+    return (memcmp(pdht_entry_key(dht, entry), key, dht->keysize) == 0) ? entry : NULL;
+  }
+
+  for (int i=1; i <= PDHT_MAX_PROBES; i++) {
+    slot = pdht_index_lookup_in(slots, dht->indexmask, pdht_probe_bits(bits, i));
+    if ((slot->entry == __PDHT_INDEX_EMPTY) || (slot->entry >= dht->maxentries))
+      return NULL;
+    entry = entries + (slot->entry * dht->entrysize); // pointer math
+    if (memcmp(pdht_entry_key(dht, entry), key, dht->keysize) == 0)
+      return entry;
+  }
+  return NULL;
+}
+
+
+
+/**
+ * pdht_index_rehash - moves linked entries onto the PTE picked by the hash function
+ *   called after the PTE set has been scaled, match bits are unchanged
+ * @param dht - hash table data structure
+ */
+void pdht_index_rehash(pdht_t *dht) {
+  _pdht_index_slot_t *slots = dht->index;
+  _pdht_index_slot_t *first;
+  ptl_handle_me_t old;
+  ptl_match_bits_t bits;
+  ptl_process_t rank;
+  uint32_t ptindex;
+  void *entry;
+
+  for (unsigned i=0; i <= dht->indexmask; i++) {
+    if (slots[i].entry == __PDHT_INDEX_EMPTY)
+      continue;
+
+    if (slots[i].entry == __PDHT_INDEX_CHAIN) {
+      // markers have no key, the first probe always holds one of the chain's keys
+      first = pdht_index_lookup(dht, pdht_probe_bits(slots[i].bits, 1));
+      entry = (char *)dht->ht + (first->entry * dht->entrysize); // pointer math
+    } else {
+      entry = (char *)dht->ht + (slots[i].entry * dht->entrysize); // pointer math
+    }
+
+    // probe slots have their own bits, but always follow the PTE of their key
+    pdht_hashkey(dht, pdht_entry_key(dht, entry), &bits, &ptindex, &rank);
+    if (ptindex == slots[i].ptindex)
+      continue;
+
+    dht->stats.ptentries[slots[i].ptindex]--;
+    dht->stats.ptentries[ptindex]++;
+
+    if (slots[i].entry == __PDHT_INDEX_CHAIN) {
+      old = slots[i].mark;
+      slots[i].ptindex = ptindex;
+      pdht_index_link_marker(dht, &slots[i]);
+      PtlMEUnlink(old);
+    } else {
+      pdht_index_relink(dht, entry, slots[i].bits, ptindex);
+      slots[i].ptindex = ptindex;
+    }
+  }
+}
+
+
+
+/**
+ * pdht_index_lookup - open addressed search for the slot holding (or able to hold) bits
+ */
+static inline _pdht_index_slot_t *pdht_index_lookup(pdht_t *dht, ptl_match_bits_t bits) {
+  return pdht_index_lookup_in(dht->index, dht->indexmask, bits);
+}
+
+
+
+/**
+ * pdht_index_lookup_in - pdht_index_lookup() on an arbitrary index
+ */
+static inline _pdht_index_slot_t *pdht_index_lookup_in(_pdht_index_slot_t *slots, unsigned mask, ptl_match_bits_t bits) {
+  unsigned i;
+
+  i = (unsigned)((bits ^ (bits >> 31)) * __PDHT_PROBE_STRIDE >> 32) & mask;
+  while ((slots[i].entry != __PDHT_INDEX_EMPTY) && (slots[i].bits != bits))
+    i = (i + 1) & mask;
+  return &slots[i];
+}
+
+
+
+/**
+ * pdht_index_next_probe - claims the first unused probe slot of a chain
+ * @param pbits - probe match bits for entry
+ * @returns 1 on success, 0 if every probe slot is taken
+ */
+static int pdht_index_next_probe(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex, uint32_t entry, ptl_match_bits_t *pbits) {
+  _pdht_index_slot_t *slot;
+
+  // probes are filled in order, so a get can stop at the first empty one
+  for (int i=1; i <= PDHT_MAX_PROBES; i++) {
+    *pbits = pdht_probe_bits(bits, i);
+    slot = pdht_index_lookup(dht, *pbits);
+    if (slot->entry == __PDHT_INDEX_EMPTY) {
+      slot->bits    = *pbits;
+      slot->entry   = entry;
+      slot->ptindex = ptindex;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+
+/**
+ * pdht_index_link_marker - links the chain head marker ME under the primary bits
+ */
+static void pdht_index_link_marker(pdht_t *dht, _pdht_index_slot_t *slot) {
+  ptl_me_t me;
+  int ret;
+
+  // zero-length and get-only: gets see no key, updates fail with an op violation
+  me.start         = NULL;
+  me.length        = 0;
+  me.ct_handle     = PTL_CT_NONE;
+  me.uid           = PTL_UID_ANY;
+  me.options       = PTL_ME_OP_GET
+                   | PTL_ME_IS_ACCESSIBLE
+                   | PTL_ME_EVENT_COMM_DISABLE
+                   | PTL_ME_EVENT_LINK_DISABLE
+                   | PTL_ME_EVENT_UNLINK_DISABLE;
+  me.match_id.rank = PTL_RANK_ANY;
+  me.match_bits    = slot->bits;
+  me.ignore_bits   = 0;
+
+  ret = PtlMEAppend(dht->ptl.lni, dht->ptl.getindex[slot->ptindex], &me, PTL_PRIORITY_LIST, NULL, &slot->mark);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_index_link_marker: PtlMEAppend error: %s\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+}
@@ -28,10 +28,8 @@ static int pdht_collective_size(pdht_datatype_t type);
  */
 void pdht_collective_init(pdht_context_t *c) {
   ptl_md_t md;
-  ptl_handle_md_t md_handle;
   ptl_pt_index_t index;
   ptl_me_t me;
-  ptl_handle_me_t me_handle;
   int ret;
 
   // initialize our collective count to one (for ourself)
@@ -191,7 +189,7 @@ void pdht_barrier(void) {
   // if we have children, wait for them to send us a barrier entry message
   if (nchildren > 0) {
     //pdht_dprintf("waiting for %d messages from l: %lu r: %lu \n", nchildren, l.rank, r.rank);
-    ret = PtlCTWait(c->ptl.barrier_ct, count_base + nchildren, &cval);
+    ret = pdht_progress_ct_wait(c->ptl.barrier_ct, count_base + nchildren, &cval);
     if (ret != PTL_OK) {
       pdht_dprintf("pdht_barrier: CTWait failed (children)\n");
       exit(1);
@@ -216,7 +214,7 @@ void pdht_barrier(void) {
     }
 
     // wait for downward broadcast from parent
-    ret = PtlCTWait(c->ptl.barrier_ct, count_base + (nchildren + nparent), &cval);
+    ret = pdht_progress_ct_wait(c->ptl.barrier_ct, count_base + (nchildren + nparent), &cval);
     if (ret != PTL_OK) {
       pdht_dprintf("barrier: CTWait failed (parent)\n");
       exit(1);
@@ -304,7 +302,7 @@ pdht_status_t pdht_reduce(void *in, void *out, pdht_reduceop_t op, pdht_datatype
   // if we have children, wait for them to send us reduce message
   if (nchildren > 0) {
     //pdht_dprintf("pdht_reduce: waiting for %d messages from l: %lu r: %lu \n", nchildren, l.rank, r.rank);
-    ret = PtlCTWait(c->ptl.reduce_ct, count_base + nchildren, &cval);
+    ret = pdht_progress_ct_wait(c->ptl.reduce_ct, count_base + nchildren, &cval);
     if (ret != PTL_OK) {
       pdht_dprintf("pdht_reduce: CTWait failed (children)\n");
       exit(1);
@@ -332,7 +330,7 @@ pdht_status_t pdht_reduce(void *in, void *out, pdht_reduceop_t op, pdht_datatype
     }
 
     // wait for downward broadcast from parent
-    ret = PtlCTWait(c->ptl.reduce_ct, count_base + (nchildren + nparent), &cval);
+    ret = pdht_progress_ct_wait(c->ptl.reduce_ct, count_base + (nchildren + nparent), &cval);
     if (ret != PTL_OK) {
       pdht_dprintf("barrier: CTWait failed (parent)\n");
       exit(1);
@@ -407,7 +405,7 @@ pdht_status_t pdht_broadcast(void *buf, pdht_datatype_t type, int elems) {
 
   // wait for parent to send message
   if (c->rank > 0) {
-    ret = PtlCTWait(c->ptl.bcast_ct, bcast_base + nparent, &cval);
+    ret = pdht_progress_ct_wait(c->ptl.bcast_ct, bcast_base + nparent, &cval);
     if (ret != PTL_OK) {
       pdht_dprintf("pdht_broadcast: CTWait failed (parent)\n");
       exit(1);
@@ -437,7 +435,7 @@ pdht_status_t pdht_broadcast(void *buf, pdht_datatype_t type, int elems) {
 
   // now we need to wait for confirmation from our children
   if (nchildren != 0)  {
-    ret = PtlCTWait(c->ptl.bcast_ct, bcast_base + (nparent + nchildren), &cval);
+    ret = pdht_progress_ct_wait(c->ptl.bcast_ct, bcast_base + (nparent + nchildren), &cval);
     if (ret != PTL_OK) {
       pdht_dprintf("pdht_broadcast: CTWait failed (parent)\n");
       exit(1);
@@ -493,70 +491,114 @@ pdht_status_t pdht_allreduce(void *in, void *out, pdht_reduceop_t op, pdht_datat
  * @param dht hash table
  */
 void pdht_fence(pdht_t *dht) {
-  int ret;
   int sbuf[2], rbuf[2];
 
+  // accumulates are ACKed once applied, so ours are done before anyone leaves the allreduce
+  pdht_acc_flush(dht);
 
   do {
-    // count up link events from appending things to the active queue
-    pthread_mutex_lock(&dht->completion_mutex);
+    // give the progress engine a chance to link what is still pending
     pdht_finalize_puts(dht);
-    pthread_mutex_unlock(&dht->completion_mutex);
 
-    sbuf[0] = dht->stats.pendputs;
-    sbuf[1] = dht->stats.appends;
+    sbuf[0] = __atomic_load_n(&dht->stats.pendputs, __ATOMIC_RELAXED);
+    sbuf[1] = __atomic_load_n(&dht->stats.appends, __ATOMIC_ACQUIRE);
     pdht_allreduce(sbuf, rbuf, PdhtReduceOpSum, IntType, 2);
     
     //pdht_eprintf(PDHT_DEBUG_NONE, "expected: %d actual: %d\n", rbuf[0], rbuf[1]);
   } while (rbuf[0] > rbuf[1]);
 
   // reset all the pending counters
-  dht->stats.pendputs = 0;
-  dht->stats.appends = 0;
+  __atomic_store_n(&dht->stats.pendputs, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&dht->stats.appends, 0, __ATOMIC_RELAXED);
+
+  // everything is linked, spread long match lists over more PTEs if needed
+  // (only tables tuned with PDHT_TUNE_SCALE have maxptes > nptes and reduce again)
+  if (dht->ptl.nptes < dht->ptl.maxptes)
+    pdht_pte_scale(dht);
 }
 
 
 
 /**
- * pdht_finalize_puts - tally completion of put operations for fence
+ * pdht_finalize_puts - waits for the progress engine to link more pending puts
+ *   the progress threads are the only consumers of the active event queues, so
+ *   this never polls them itself (with PdhtProgressManual it drives progress
+ *   on the table instead). returns once the append count moves or after
+ *   10 ms, whichever comes first.
  * @param dht a hash table
  * @returns status of operation
  */
 pdht_status_t pdht_finalize_puts(pdht_t *dht) {
-  int ret = PTL_OK;
-  ptl_event_t ev;
-  unsigned int ptindex;
-  ptl_time_t timeout;
-
-  // NOTE: this function may be called by the polling/trigger progress threads 
-  // _or_ during the fence operation _or_ in get when something  is local. 
-  // it should be protected by a mutex in the caller
-
-  timeout = 10; // only block the polling progress thread or fence operation for up to 10 ms
-     
-  while ((ret = PtlEQPoll(dht->ptl.aeq,dht->ptl.nptes, timeout, &ev, &ptindex)) == PTL_OK) {
-    //pdht_dump_event(&ev);
-    if (ev.type == PTL_EVENT_LINK) {
-      dht->stats.appends++;
-      dht->stats.tappends[ptindex]++;
-    }
-    else if (ev.type == PTL_EVENT_SEARCH){
-      pthread_mutex_lock(&dht->local_gets_flag_mutex);
-      dht->local_get_flag = 1;
-      if(ev.ni_fail_type == PTL_NI_NO_MATCH){
-        dht->local_get_flag = -1;
-      }
-      else{
-        *(ptl_event_t **)ev.user_ptr = ev.start;
-      }
-      pthread_mutex_unlock(&dht->local_gets_flag_mutex);
-      return ret;
+  struct timespec ts = { 0, 100000 }; // 100us
+  u_int64_t appends = __atomic_load_n(&dht->stats.appends, __ATOMIC_ACQUIRE);
+
+  // only block the fence operation for up to 10 ms
+  for (int i=0; i < 100; i++) {
+    if (__atomic_load_n(&dht->stats.appends, __ATOMIC_ACQUIRE) != appends)
+      break;
+    if (pdht_progress(dht) == 0) // no-op unless the app drives progress
+      nanosleep(&ts, NULL);
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_active_event - handles an event from an active (get) PTE event queue
+ *   called by the progress thread that owns ptindex, only placing a triggered
+ *   append takes the completion mutex
+ * @param dht a hash table
+ * @param ev event from the active EQ of ptindex
+ * @param ptindex PTE pair the event arrived on
+ * @returns 1 if the event completed a local get search, 0 otherwise
+ */
+int pdht_active_event(pdht_t *dht, ptl_event_t *ev, unsigned ptindex) {
+  if (ev->type == PTL_EVENT_LINK) {
+    // triggered appends land under the initiator's bits, move them if they collide
+    if (dht->pmode == PdhtPendingTrig) {
+      _pdht_ht_trigentry_t *hte = (_pdht_ht_trigentry_t *)ev->user_ptr;
+      ptl_match_bits_t bits;
+      int dropped;
+
+      pthread_mutex_lock(&dht->completion_mutex);
+      // copied into bucket/direct storage, or a re-put that went into the existing
+      // entry (or the chain is full): this entry doesn't need its own ME anymore
+      dropped = pdht_layout_place(dht, hte, hte->me.match_bits, ptindex)
+             || (pdht_index_claim(dht, hte, hte->me.match_bits, ptindex, &bits) <= 0);
+      if (dropped) {
+        PtlMEUnlink(hte->ame);
+        hte->ame = PTL_INVALID_HANDLE;
+      } else if (bits != hte->me.match_bits)
+        pdht_index_relink(dht, hte, bits, ptindex);
+      pthread_mutex_unlock(&dht->completion_mutex);
+
+      // published after the entry is in place, fence reads it without a lock
+      __atomic_add_fetch(&dht->stats.appends, 1, __ATOMIC_RELEASE);
+
+      // a dropped entry goes straight back on the pending queue instead of being refilled
+      if (dropped)
+        pdht_trig_repost(dht, ptindex, hte);
+      else
+        __atomic_add_fetch(&dht->stats.tappends[ptindex], 1, __ATOMIC_RELAXED); // refill reads this unlocked
+    } else {
+      __atomic_add_fetch(&dht->stats.appends, 1, __ATOMIC_RELEASE);
+      __atomic_add_fetch(&dht->stats.tappends[ptindex], 1, __ATOMIC_RELAXED);
     }
   }
-  if ((ret != PTL_EQ_EMPTY) && (ret != PTL_INTERRUPTED)) {
-    printf("pdht_finalize_puts: PtlEQPoll error %s\n", pdht_ptl_error(ret));
+  else if (ev->type == PTL_EVENT_SEARCH){
+    // searches carry the searching thread's context, whoever drains the event
+    pdht_tctx_t *tc = (pdht_tctx_t *)ev->user_ptr;
+    if(ev->ni_fail_type == PTL_NI_NO_MATCH){
+      __atomic_store_n(&tc->search_flag, -1, __ATOMIC_RELEASE);
+    }
+    else{
+      tc->search = ev->start;
+      __atomic_store_n(&tc->search_flag, 1, __ATOMIC_RELEASE);
+    }
+    return 1;
   }
-  return ret;
+  return 0;
 }
 
 
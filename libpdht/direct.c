@@ -0,0 +1,477 @@
+/********************************************************/
+/*                                                      */
+/*  direct.c - PDHT direct-addressed table layout       */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#include <alloca.h>
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table direct layout
+ *
+ * with PdhtLayoutDirect every table exposes an array of fixed-size slots
+ * through a single LE on a non-matching portal. a key's home slot comes
+ * straight from its match bits, and the key always lives within
+ * PDHT_DIRECT_HOPS slots of home, so a get is one PtlGet of the whole
+ * neighborhood at a computed offset with no match list search at all.
+ *
+ * puts still go through the pending queue and the owner's progress path,
+ * which places linked entries by linear probing with a bounded window:
+ * the first free slot among the PDHT_DIRECT_HOPS starting at home. there
+ * is no cuckoo or hopscotch displacement, a placed key never moves again,
+ * so accumulates and fetching atomics can go straight to the slot an
+ * initiator located.
+ * only the owner ever writes key and value, with the completion mutex
+ * held: pdht_update() of a key in another rank's slots fails rather than
+ * being deferred, callers re-put it and see it after the fence.
+ * each slot is bracketed by head/tail versions: the owner bumps the tail,
+ * writes, then copies the tail into the head, so a reader that sees
+ * head != tail just reads the neighborhood again. keys that find their
+ * neighborhood full keep their own ME on the matching NI, and the home
+ * slot counts them so readers know when a miss needs the normal path.
+ */
+
+static void pdht_direct_ni_init(void);
+static pdht_status_t pdht_direct_xfer(pdht_t *dht, int isget, ptl_process_t rank, ptl_size_t roffset, void *buf, ptl_size_t len);
+static void pdht_direct_write(pdht_t *dht, _pdht_direct_slot_t *s, char *kv);
+
+
+
+/**
+ * pdht_direct_init - allocates the slot array and exposes it on a non-matching PTE
+ * @param dht - hash table data structure
+ */
+void pdht_direct_init(pdht_t *dht) {
+  ptl_le_t le;
+  unsigned nslots = 1;
+  int ret;
+
+  if (PtlHandleIsEqual(c->ptl.nni, PTL_INVALID_HANDLE))
+    pdht_direct_ni_init();
+
+  // keep the array at most half full, neighborhoods of the last homes run off the end
+  while (nslots < 2*dht->maxentries)
+    nslots <<= 1;
+  assert(nslots <= (1U << 31));
+
+  dht->directmask     = nslots - 1;
+  dht->directslotsize = sizeof(_pdht_direct_slot_t) + dht->elemsize;
+  dht->directslotsize = (dht->directslotsize + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1); // aligned tail
+  dht->directslotsize += sizeof(uint64_t);
+  nslots += PDHT_DIRECT_HOPS - 1;
+
+  dht->direct = calloc(nslots, dht->directslotsize);
+  if (!dht->direct) {
+    pdht_dprintf("pdht_direct_init: calloc error: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  // every process creates tables in the same order, so indices agree
+  ret = PtlPTAlloc(c->ptl.nni, 0, PTL_EQ_NONE, c->ptl.dpt_nextfree, &dht->ptl.dindex);
+  if ((ret != PTL_OK) || (dht->ptl.dindex != c->ptl.dpt_nextfree)) {
+    pdht_dprintf("pdht_direct_init: PtlPTAlloc failure (%s)\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+  c->ptl.dpt_nextfree++;
+
+  le.start     = dht->direct;
+  le.length    = nslots * dht->directslotsize;
+  le.ct_handle = PTL_CT_NONE;
+  le.uid       = PTL_UID_ANY;
+  le.options   = PTL_LE_OP_GET
+               | PTL_LE_OP_PUT
+               | PTL_LE_IS_ACCESSIBLE
+               | PTL_LE_EVENT_COMM_DISABLE
+               | PTL_LE_EVENT_LINK_DISABLE
+               | PTL_LE_EVENT_UNLINK_DISABLE;
+
+  ret = PtlLEAppend(c->ptl.nni, dht->ptl.dindex, &le, PTL_PRIORITY_LIST, NULL, &dht->ptl.dle);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_direct_init: PtlLEAppend error: %s\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+
+  // initiator side MDs are per thread, see pdht_direct_tctx_init()
+
+  pdht_eprintf(PDHT_DEBUG_WARN, "\tdirect layout: %d slots, %d slot neighborhoods (%d bytes/slot)\n",
+               dht->directmask+1, PDHT_DIRECT_HOPS, dht->directslotsize);
+}
+
+
+
+/**
+ * pdht_direct_tctx_init - sets up a thread context for gets and updates on the non-matching NI
+ * @param tc - communication context being created
+ */
+void pdht_direct_tctx_init(pdht_tctx_t *tc) {
+  ptl_md_t md;
+  int ret;
+
+  ret = PtlCTAlloc(c->ptl.nni, &tc->dmdct);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_direct_tctx_init: PtlCTAlloc failure\n");
+    exit(1);
+  }
+
+  md.start     = NULL;
+  md.length    = PTL_SIZE_MAX;
+  md.options   = PTL_MD_EVENT_SUCCESS_DISABLE | PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY | PTL_MD_EVENT_SEND_DISABLE;
+  md.eq_handle = PTL_EQ_NONE;
+  md.ct_handle = tc->dmdct;
+
+  ret = PtlMDBind(c->ptl.nni, &md, &tc->dmd);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_direct_tctx_init: PtlMDBind failure\n");
+    exit(1);
+  }
+}
+
+
+
+/**
+ * pdht_direct_tctx_fini - releases a thread context's non-matching NI handles
+ * @param tc - communication context being released
+ */
+void pdht_direct_tctx_fini(pdht_tctx_t *tc) {
+  PtlMDRelease(tc->dmd);
+  PtlCTFree(tc->dmdct);
+}
+
+
+
+/**
+ * pdht_direct_fini - unlinks the direct table and releases its storage
+ * @param dht - hash table data structure
+ */
+void pdht_direct_fini(pdht_t *dht) {
+  if (!dht->direct)
+    return;
+
+  PtlLEUnlink(dht->ptl.dle);
+  PtlPTFree(c->ptl.nni, dht->ptl.dindex);
+
+  free(dht->direct);
+  dht->direct = NULL;
+}
+
+
+
+/**
+ * pdht_direct_place - moves a newly linked entry into the slot array
+ *   must be called with the completion mutex held
+ * @param dht - hash table data structure
+ * @param entry - local hash table entry (key + value filled in)
+ * @param bits - primary match bits of the entry
+ * @returns 1 if the entry now lives in the slot array, 0 if it has to keep its ME
+ */
+int pdht_direct_place(pdht_t *dht, void *entry, ptl_match_bits_t bits) {
+  unsigned home = pdht_direct_home(dht, bits);
+  _pdht_direct_slot_t *h = pdht_direct_slot(dht, home);
+  _pdht_direct_slot_t *s;
+  char *kv = pdht_entry_key(dht, entry); // value follows the key in both entry types
+  unsigned freeslot;
+
+  // re-put of a key already in the neighborhood overwrites it in place
+  for (unsigned i=0; i < PDHT_DIRECT_HOPS; i++) {
+    s = pdht_direct_slot(dht, home + i);
+    if ((h->hops & (1U << i)) && (memcmp(s->key, kv, dht->keysize) == 0)) {
+      pdht_direct_write(dht, s, kv);
+      return 1;
+    }
+  }
+
+  // first free slot of the neighborhood, keys are never displaced (see above)
+  for (freeslot = home; freeslot - home < PDHT_DIRECT_HOPS; freeslot++) {
+    if (!pdht_direct_slot(dht, freeslot)->used)
+      break;
+  }
+  if (freeslot - home >= PDHT_DIRECT_HOPS)
+    goto overflow;
+
+  pdht_direct_write(dht, pdht_direct_slot(dht, freeslot), kv);
+  h->hops |= 1U << (freeslot - home);
+  return 1;
+
+overflow:
+  if (h->overflow < UINT16_MAX)
+    h->overflow++; // saturates, readers just fall back to the entry path
+  return 0;
+}
+
+
+
+/**
+ * pdht_direct_find - finds a local key in the slot array
+ *   must be called with the completion mutex held
+ * @param dht - hash table data structure
+ * @param key - key to find
+ * @param bits - primary match bits of key
+ * @returns pointer to the slot key (value follows), or NULL if not in the array
+ */
+void *pdht_direct_find(pdht_t *dht, void *key, ptl_match_bits_t bits) {
+  unsigned home = pdht_direct_home(dht, bits);
+  _pdht_direct_slot_t *h = pdht_direct_slot(dht, home);
+  _pdht_direct_slot_t *s;
+
+  for (unsigned i=0; i < PDHT_DIRECT_HOPS; i++) {
+    s = pdht_direct_slot(dht, home + i);
+    if ((h->hops & (1U << i)) && (memcmp(s->key, key, dht->keysize) == 0))
+      return s->key;
+  }
+  return NULL;
+}
+
+
+
+/**
+ * pdht_direct_fetch - reads the neighborhood of a key from its owner
+ * @param dht - hash table data structure
+ * @param key - hash table key
+ * @param mbits - primary match bits of key
+ * @param rank - owner of key
+ * @param offset - optional copy-out of the offset of key + value inside the direct LE
+ * @param buf - reply buffer (key + value)
+ * @param overflow - set if key may instead be linked under its own ME
+ * @returns OK if key was found, NotFound, or Error
+ */
+pdht_status_t pdht_direct_fetch(pdht_t *dht, void *key, ptl_match_bits_t mbits, ptl_process_t rank,
+                                ptl_size_t *offset, char *buf, int *overflow) {
+  unsigned home = pdht_direct_home(dht, mbits);
+  ptl_size_t len = PDHT_DIRECT_HOPS * dht->directslotsize;
+  char *nbhd = alloca(len);
+  pdht_status_t rval;
+
+  for (int tries=0; tries < PDHT_DIRECT_RETRIES; tries++) {
+    rval = pdht_direct_xfer(dht, 1, rank, home * dht->directslotsize, nbhd, len);
+    if (rval != PdhtStatusOK)
+      return rval;
+
+    rval = pdht_direct_scan(dht, key, home, nbhd, offset, buf, overflow);
+    if (rval != PdhtStatusError)
+      return rval;
+  }
+
+  pdht_dprintf("pdht_direct_fetch: neighborhood on rank %d still changing after %d reads\n", rank.rank, PDHT_DIRECT_RETRIES);
+  return PdhtStatusError;
+}
+
+
+
+/**
+ * pdht_direct_scan - looks for a key in a neighborhood fetched from its owner
+ * @param dht - hash table data structure
+ * @param key - hash table key
+ * @param home - home slot of key
+ * @param nbhd - PDHT_DIRECT_HOPS slots read starting at home
+ * @param offset - optional copy-out of the offset of key + value inside the direct LE
+ * @param buf - reply buffer (key + value)
+ * @param overflow - set if key may instead be linked under its own ME
+ * @returns OK if key was found, NotFound, or Error if a slot was being written (read again)
+ */
+pdht_status_t pdht_direct_scan(pdht_t *dht, void *key, unsigned home, char *nbhd,
+                               ptl_size_t *offset, char *buf, int *overflow) {
+  _pdht_direct_slot_t *s;
+  int torn = 0;
+
+  *overflow = 0;
+
+  for (unsigned i=0; i < PDHT_DIRECT_HOPS; i++) {
+    s = (_pdht_direct_slot_t *)(nbhd + (i * dht->directslotsize)); // pointer math
+    if (s->head != *pdht_direct_tail(dht, s)) {
+      torn = 1; // owner was writing this slot, it may have been ours
+      continue;
+    }
+    if (s->used && (memcmp(s->key, key, dht->keysize) == 0)) {
+      memcpy(buf, s->key, PDHT_MAXKEYSIZE + dht->elemsize);
+      if (offset)
+        *offset = ((home + i) * dht->directslotsize) + offsetof(_pdht_direct_slot_t, key);
+      return PdhtStatusOK;
+    }
+  }
+
+  if (torn)
+    return PdhtStatusError;
+  *overflow = ((_pdht_direct_slot_t *)nbhd)->overflow != 0;
+  return PdhtStatusNotFound;
+}
+
+
+
+/**
+ * pdht_direct_store - versioned overwrite of the value in a local slot
+ *   must be called with the completion mutex held
+ * @param dht - hash table data structure
+ * @param slotkey - slot key from pdht_direct_find()
+ * @param value - new value
+ */
+void pdht_direct_store(pdht_t *dht, void *slotkey, void *value) {
+  _pdht_direct_slot_t *s = (_pdht_direct_slot_t *)((char *)slotkey - offsetof(_pdht_direct_slot_t, key)); // pointer math
+  uint64_t *tail = pdht_direct_tail(dht, s);
+
+  (*tail)++;
+  __sync_synchronize();
+  memcpy(s->data, value, dht->elemsize);
+  __sync_synchronize();
+  s->head = *tail;
+}
+
+
+
+/**
+ * pdht_direct_hasnext - direct layout iteration, skips empty slots and unused entries
+ *   iteration covers the slot array first, then entries that kept their own ME
+ * @param it a PDHT iterator structure
+ * @returns 1 if next entry is valid, 0 otherwise
+ */
+int pdht_direct_hasnext(pdht_iter_t *it) {
+  pdht_t *dht = it->dht;
+  char *dend = (char *)dht->direct + ((dht->directmask + PDHT_DIRECT_HOPS) * dht->directslotsize);
+
+  if ((it->iterator >= (char *)dht->direct) && (it->iterator < dend)) {
+    for ( ; it->iterator < dend; it->iterator += dht->directslotsize) {
+      if (((_pdht_direct_slot_t *)it->iterator)->used)
+        return 1;
+    }
+    it->iterator = (char *)dht->ht;
+  }
+  return pdht_entry_hasnext(it);
+}
+
+
+
+/**
+ * pdht_direct_getnext - direct layout iteration
+ * @param it a PDHT iterator structure
+ * @param key optional copy-out of matching key for entry
+ * @returns pointer to HT entry value
+ */
+void *pdht_direct_getnext(pdht_iter_t *it, void **key) {
+  pdht_t *dht = it->dht;
+  char *ret;
+
+  if (!pdht_direct_hasnext(it))
+    return NULL;
+
+  if ((it->iterator >= (char *)dht->ht) && (it->iterator < (char *)dht->ht + (dht->maxentries * dht->entrysize))) {
+    ret = pdht_entry_key(dht, it->iterator);
+    it->iterator += dht->entrysize;
+  } else {
+    ret = ((_pdht_direct_slot_t *)it->iterator)->key;
+    it->iterator += dht->directslotsize;
+  }
+
+  if (key)
+    *key = ret;
+  return ret + PDHT_MAXKEYSIZE; // pointer math
+}
+
+
+
+/**
+ * pdht_direct_ni_init - brings up the non-matching logical NI on first use
+ */
+static void pdht_direct_ni_init(void) {
+  ptl_ni_limits_t ni_req_limits;
+  int ret;
+
+  // one PTE, LE, MDs, a couple of CTs and the async EQ per table
+  memset(&ni_req_limits, 0, sizeof(ni_req_limits));
+  ni_req_limits.max_entries = PDHT_MAX_TABLES;
+  ni_req_limits.max_unexpected_headers = 1024;
+  ni_req_limits.max_mds = 3*PDHT_MAX_TABLES;
+  ni_req_limits.max_eqs = PDHT_MAX_TABLES;
+  ni_req_limits.max_cts = 2*PDHT_MAX_TABLES;
+  ni_req_limits.max_pt_index = PDHT_MAX_TABLES;
+  ni_req_limits.max_iovecs = 1024;
+  ni_req_limits.max_list_size = PDHT_MAX_TABLES;
+  ni_req_limits.max_triggered_ops = 0;
+  ni_req_limits.max_msg_size = LONG_MAX;
+  ni_req_limits.max_atomic_size = 512;
+  ni_req_limits.max_fetch_atomic_size = 512;
+  ni_req_limits.max_waw_ordered_size = 512;
+  ni_req_limits.max_war_ordered_size = 512;
+  ni_req_limits.max_volatile_size = 512;
+  ni_req_limits.features = 0;
+
+  ret = PtlNIInit(PTL_IFACE_DEFAULT,
+      PTL_NI_NO_MATCHING | PTL_NI_LOGICAL,
+      PTL_PID_ANY,
+      &ni_req_limits,
+      &(c->ptl.nni_limits),
+      &(c->ptl.nni));
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_direct_ni_init: non-matching logical NI initialization error: (%s)\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+
+  ret = PtlSetMap(c->ptl.nni, c->size, c->ptl.mapping);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_direct_ni_init: physical/logical mapping failed : %s.\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+  c->ptl.dpt_nextfree = 0;
+}
+
+
+
+/**
+ * pdht_direct_xfer - blocking get or put against the direct LE of a process
+ */
+static pdht_status_t pdht_direct_xfer(pdht_t *dht, int isget, ptl_process_t rank, ptl_size_t roffset, void *buf, ptl_size_t len) {
+  pdht_tctx_t *tc = pdht_tctx(dht);
+  ptl_ct_event_t current, ctevent;
+  int ret;
+
+  PtlCTGet(tc->dmdct, &current);
+  if (current.failure > 0) {
+    ctevent.success = 0;
+    ctevent.failure = -current.failure;
+    PtlCTInc(tc->dmdct, ctevent);
+    current.failure = 0;
+  }
+
+  if (isget)
+    ret = PtlGet(tc->dmd, (ptl_size_t)buf, len, rank, dht->ptl.dindex, 0, roffset, NULL);
+  else
+    ret = PtlPut(tc->dmd, (ptl_size_t)buf, len, PTL_ACK_REQ, rank, dht->ptl.dindex, 0, roffset, NULL, 0);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_direct_xfer: %s failed: %s\n", isget ? "PtlGet" : "PtlPut", pdht_ptl_error(ret));
+    return PdhtStatusError;
+  }
+
+  ret = pdht_progress_ct_wait(tc->dmdct, current.success+1, &ctevent);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_direct_xfer: PtlCTWait() failed\n");
+    return PdhtStatusError;
+  }
+
+  // the LE covers every slot, any failure is a real error
+  if (ctevent.failure > current.failure) {
+    pdht_dprintf("pdht_direct_xfer: %s to rank %d failed\n", isget ? "get" : "put", rank.rank);
+    return PdhtStatusError;
+  }
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_direct_write - versioned write of key + value into a slot
+ */
+static void pdht_direct_write(pdht_t *dht, _pdht_direct_slot_t *s, char *kv) {
+  uint64_t *tail = pdht_direct_tail(dht, s);
+
+  // tail moves first: a reader that saw the old head sees the new tail
+  (*tail)++;
+  __sync_synchronize();
+  memmove(s->key, kv, PDHT_MAXKEYSIZE + dht->elemsize);
+  s->used = 1;
+  __sync_synchronize();
+  s->head = *tail;
+}
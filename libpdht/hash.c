@@ -23,7 +23,7 @@
  *  @returns match bits for portals request
  */
 void pdht_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank) {
-   *mbits = CityHash64((char *)key, dht->keysize);
+   *mbits = CityHash64((char *)key, dht->keysize) & __PDHT_HASH_MASK;
    *ptindex = *mbits % dht->ptl.nptes;
    //(*rank).rank  = 0; // for testing only
    (*rank).rank  = *mbits % c->size; 
@@ -34,11 +34,9 @@ void pdht_bthandler(int sig);
  */
 pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
   pdht_t *dht;
-  ptl_md_t md;
   _pdht_ht_entry_t *hte;
   pdht_config_t cfg;
   char *iter; // used for pointer math
-  int ret;
 
   struct stat fileStat;
   if (stat("/dev/ummunotify",&fileStat) != 0){
@@ -61,6 +59,15 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
      cfg.quiet        = PDHT_DEFAULT_QUIET;
      cfg.local_gets   = PDHT_DEFAULT_LOCAL_GETS;
      cfg.rank         = PDHT_DEFAULT_RANK_HINT;
+     cfg.maxptes      = 0; // no scaling unless PDHT_TUNE_SCALE asks for it
+     cfg.ptlistmax    = PDHT_DEFAULT_PTE_LIST_MAX;
+     cfg.layout       = PDHT_DEFAULT_LAYOUT;
+     cfg.bucketslots  = PDHT_DEFAULT_BUCKET_SLOTS;
+     cfg.progress_spin = PDHT_DEFAULT_PROGRESS_SPIN;
+     cfg.progress_cpu  = PDHT_DEFAULT_PROGRESS_CPU;
+     cfg.progress_threads = PDHT_DEFAULT_PROGRESS_THREADS;
+     cfg.progmode     = PDHT_DEFAULT_PROGMODE;
+     cfg.shmmode      = PDHT_DEFAULT_SHMMODE;
   } else {
     memcpy(&cfg, __pdht_config, sizeof(pdht_config_t));
   }
@@ -88,16 +95,25 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
   dht->gameover = 0;
   dht->local_get = cfg.local_gets;
   dht->hashfn = pdht_hash;
+  dht->layout = cfg.layout;
+  dht->bucketslots = cfg.bucketslots;
 
   // portals info
   dht->ptl.nptes         = cfg.nptes;
+  dht->ptl.maxptes       = cfg.maxptes > cfg.nptes ? cfg.maxptes : cfg.nptes;
+  dht->ptl.ptlistmax     = cfg.ptlistmax;
   dht->ptl.ptalloc_opts  = cfg.ptalloc_opts;
-  assert(dht->ptl.nptes < PDHT_MAX_PTES);
+  assert(dht->ptl.maxptes <= PDHT_MAX_PTES);
+
+  // buckets are laid out per PTE and already bound the match list length,
+  // direct tables only link entries that overflowed their neighborhood
+  if (dht->layout != PdhtLayoutEntry)
+    dht->ptl.maxptes     = dht->ptl.nptes;
 
-  // setup PTE allocation ranges
+  // setup PTE allocation ranges, reserve enough for the table to scale up to maxptes
   dht->ptl.getindex_base = c->ptl.pt_nextfree; 
-  dht->ptl.putindex_base = dht->ptl.getindex_base + dht->ptl.nptes;
-  c->ptl.pt_nextfree    += 2*dht->ptl.nptes; // update global PTE index tracker
+  dht->ptl.putindex_base = dht->ptl.getindex_base + dht->ptl.maxptes;
+  c->ptl.pt_nextfree    += 2*dht->ptl.maxptes; // update global PTE index tracker
   dht->ptl.lni           = c->ptl.lni;
 
 
@@ -122,7 +138,11 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
     pdht_eprintf(PDHT_DEBUG_WARN, "\tpending PTE mode: triggered\n");
   }
 
-  dht->ht = calloc(dht->maxentries, dht->entrysize);
+  // same-node ranks map our entries directly, fall back to private memory if we can't share
+  if (cfg.shmmode == PdhtShmNode)
+    pdht_shm_init(dht);
+  if (!dht->ht)
+    dht->ht = calloc(dht->maxentries, dht->entrysize);
   if (!dht->ht) {
     pdht_dprintf("pdht_create: calloc error: %s\n", strerror(errno));
     exit(1);
@@ -141,39 +161,16 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
     iter += dht->entrysize; // pointer math, danger.
   }
 
+  // owner-side index used to resolve match bit collisions
+  pdht_index_init(dht);
 
-  c->hts[c->dhtcount] = dht;
-
-  // allocate event counter for puts/gets
-  ret = PtlCTAlloc(dht->ptl.lni, &dht->ptl.lmdct);
-  if (ret != PTL_OK) {
-    pdht_dprintf("pdht_create: PtlCTAlloc failure (put/get)\n");
-    exit(1);
-  }
-
-  // allocate event queue
-  ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &dht->ptl.lmdeq);
-  if (ret != PTL_OK) {
-    pdht_dprintf("pdht_create: PtlEQAlloc failure\n");
-    exit(1);
-  }
-
+  // find and map the segments of ranks on our node
+  if (cfg.shmmode == PdhtShmNode)
+    pdht_shm_attach(dht);
 
-  // create memory descriptor (MD) to allow for remote access of our memory
-  md.start  = NULL;
-  md.length = PTL_SIZE_MAX; 
-  md.options = PTL_MD_EVENT_SUCCESS_DISABLE | PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY | PTL_MD_EVENT_SEND_DISABLE;
-  md.eq_handle = dht->ptl.lmdeq;
-  md.ct_handle = dht->ptl.lmdct;
+  // initiator side MD, CT and EQ are per thread, see pdht_tctx()
 
-  // bind MD to our matching interface
-  ret = PtlMDBind(c->ptl.lni, &md, &dht->ptl.lmd);
-  if (ret != PTL_OK) {
-    pdht_dprintf("pdht_create: PtlMDBind failure\n");
-    exit(1);
-  }
-
-  // initialize mutex for synch between progress thread and fence calls
+  // initialize mutex guarding owner-side index and layout placement
   pthread_mutex_init(&dht->completion_mutex, NULL);
 
   // initialize Portals bookkeeping for atomic counters
@@ -185,22 +182,15 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
     dht->ptl.countcts[i] = PTL_INVALID_HANDLE;
   }
 
-  for (unsigned int ptindex=0; ptindex < dht->ptl.nptes; ptindex++) {
-    // create PTE for matching gets, will be populated by pending put poller
-
-    // need to create an event queue for PTL_EVENT_LINK events for triggered appends and fence op
-    ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &dht->ptl.aeq[ptindex]);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_create: PtlEQAlloc failure [%d] (%s)\n", ptindex, pdht_ptl_error(ret));
-      exit(1);
-    }
-    ret = PtlPTAlloc(dht->ptl.lni, dht->ptl.ptalloc_opts, dht->ptl.aeq[ptindex],
-        dht->ptl.getindex_base+ptindex, &dht->ptl.getindex[ptindex]);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_create: PtlPTAlloc failure [%d] (%s)\n", ptindex, pdht_ptl_error(ret));
-      exit(1);
-    }
-  }
+  // create PTEs for matching gets, will be populated by pending put poller
+  for (unsigned int ptindex=0; ptindex < dht->ptl.nptes; ptindex++)
+    pdht_pte_init(dht, ptindex);
+
+  // persistent bucket MEs go on the active PTEs ahead of any entry
+  if (dht->layout == PdhtLayoutBucket)
+    pdht_bucket_init(dht);
+  else if (dht->layout == PdhtLayoutDirect)
+    pdht_direct_init(dht);
 
   // setup data structures for pending puts
   if (dht->pmode == PdhtPendingPoll) {
@@ -209,41 +199,63 @@ pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
     pdht_trig_init(dht);
   }
 
-  // initialize atomic operations MD, CT, and scratch space
-  pdht_atomic_init(dht);
+  // completion queue for callback-based async ops, served by the progress engine
+  pdht_async_init(dht);
 
-  c->dhtcount++; // register ourselves globally on this process
+  pdht_progress_register(dht); // register ourselves globally on this process
   return dht;
 }
 
 
 
+/**
+ * pdht_pte_init -- allocates an active (get) PTE and its event queue
+ * @param dht - hash table data structure
+ * @param ptindex - PTE pair to setup
+ */
+void pdht_pte_init(pdht_t *dht, unsigned ptindex) {
+  int ret;
+
+  // need to create an event queue for PTL_EVENT_LINK events for triggered appends and fence op
+  ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &dht->ptl.aeq[ptindex]);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_pte_init: PtlEQAlloc failure [%d] (%s)\n", ptindex, pdht_ptl_error(ret));
+    exit(1);
+  }
+  ret = PtlPTAlloc(dht->ptl.lni, dht->ptl.ptalloc_opts, dht->ptl.aeq[ptindex],
+      dht->ptl.getindex_base+ptindex, &dht->ptl.getindex[ptindex]);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_pte_init: PtlPTAlloc failure [%d] (%s)\n", ptindex, pdht_ptl_error(ret));
+    exit(1);
+  }
+  dht->stats.ptentries[ptindex] = 0;
+}
+
+
+
 /**
  * pdht_free -- frees a new dht
  * @param dht - the dht to free
  */
 void pdht_free(pdht_t *dht) {
   assert(dht);
-  struct timespec ts;
-  int ret;
-  int i = 0;
-
-  // remove hash table from progress thread's list of tables to look after
-  for (i=0; (i < c->dhtcount) && (c->hts[i] != dht); i++) 
-    ; // find this ht
-  while (i < c->dhtcount) {
-    c->hts[i] = c->hts[i+1]; // shuffle everybody down
-    i++;
-  }
 
-  c->dhtcount--;
+  // outstanding async ops need the progress engine to call back
+  pdht_async_wait(dht);
 
-  dht->gameover = 1; // signal progress thread that we're outta here
+  // remove hash table from the progress engine's list of tables to look after
+  pdht_progress_unregister(dht);
+  pdht_async_fini(dht);
   
   // disable incoming gets
   for (int ptindex=0; ptindex < dht->ptl.nptes; ptindex++) 
     PtlPTDisable(dht->ptl.lni, dht->ptl.getindex[ptindex]);
   
+  // drop collision chain markers, bucket MEs and the direct table
+  pdht_index_fini(dht);
+  pdht_bucket_fini(dht);
+  pdht_direct_fini(dht);
+
   // cleans up from pending put MEs 
   // -- also removes all MEs from both put/get PTEs
   switch(dht->pmode){
@@ -263,12 +275,8 @@ void pdht_free(pdht_t *dht) {
     PtlEQFree(dht->ptl.aeq[ptindex]); // yes, after PTFree
   }
 
-  // free our memory descriptor
-  PtlMDRelease(dht->ptl.lmd);
-
-  // release event queue and counter
-  PtlCTFree(dht->ptl.lmdct);
-  PtlEQFree(dht->ptl.lmdeq);
+  // free every thread's MD, CT, EQ and atomic scratch space
+  pdht_tctx_free(dht);
 
   // free Portals bookkeeping for atomic counters
   for (int i=0; i<PDHT_MAX_COUNTERS; i++) {
@@ -283,8 +291,8 @@ void pdht_free(pdht_t *dht) {
       PtlMDRelease(dht->ptl.countmds[i]);
   }
 
-  // cleanup MD, CT, and scratch space for atomic operations
-  pdht_atomic_free(dht);
+  // unmap our entries and any same-node segments
+  pdht_shm_fini(dht);
 
   // clean up everything if we're last out the door
   if (c->dhtcount <= 0) {
@@ -298,6 +306,9 @@ void pdht_free(pdht_t *dht) {
 
 /**
  ** pdht_tune - sets tunable parameters for PDHT
+ *   only fields named in opts are read from config, PDHT_TUNE_ALL covers the
+ *   original set and leaves the scale/layout/progress/shm fields at their
+ *   defaults. pdht_tune(0, &cfg) fills cfg in with the current settings.
  * @param opts - bit flags marking modified parameters
  * @param config - config tunable structure
  */
@@ -314,6 +325,15 @@ void pdht_tune(unsigned opts, pdht_config_t *config) {
      __pdht_config->ptalloc_opts = PDHT_PTALLOC_OPTIONS;
      __pdht_config->quiet        = PDHT_DEFAULT_QUIET;
      __pdht_config->rank         = PDHT_DEFAULT_RANK_HINT;
+     __pdht_config->maxptes      = 0; // no scaling unless PDHT_TUNE_SCALE asks for it
+     __pdht_config->ptlistmax    = PDHT_DEFAULT_PTE_LIST_MAX;
+     __pdht_config->layout       = PDHT_DEFAULT_LAYOUT;
+     __pdht_config->bucketslots  = PDHT_DEFAULT_BUCKET_SLOTS;
+     __pdht_config->progress_spin = PDHT_DEFAULT_PROGRESS_SPIN;
+     __pdht_config->progress_cpu  = PDHT_DEFAULT_PROGRESS_CPU;
+     __pdht_config->progress_threads = PDHT_DEFAULT_PROGRESS_THREADS;
+     __pdht_config->progmode     = PDHT_DEFAULT_PROGMODE;
+     __pdht_config->shmmode      = PDHT_DEFAULT_SHMMODE;
   }
   if (opts & PDHT_TUNE_NPTES) 
     __pdht_config->nptes        = config->nptes;
@@ -331,6 +351,42 @@ void pdht_tune(unsigned opts, pdht_config_t *config) {
     __pdht_config->local_gets   = config->local_gets;
   if (opts & PDHT_TUNE_RANK)
     __pdht_config->rank         = config->rank;
+  if (opts & PDHT_TUNE_SCALE) {
+    __pdht_config->maxptes      = config->maxptes;
+    __pdht_config->ptlistmax    = config->ptlistmax;
+    // out of range values fall back to the defaults
+    if ((config->maxptes < 1) || (config->maxptes > PDHT_MAX_PTES))
+      __pdht_config->maxptes    = PDHT_DEFAULT_MAX_PTES;
+    if (config->ptlistmax == 0)
+      __pdht_config->ptlistmax  = PDHT_DEFAULT_PTE_LIST_MAX;
+  }
+  if (opts & PDHT_TUNE_LAYOUT) {
+    __pdht_config->layout       = config->layout;
+    __pdht_config->bucketslots  = config->bucketslots;
+    if ((config->layout < PdhtLayoutEntry) || (config->layout > PdhtLayoutDirect))
+      __pdht_config->layout     = PDHT_DEFAULT_LAYOUT;
+    if ((config->bucketslots < 1) || (config->bucketslots > PDHT_MAX_BUCKET_SLOTS))
+      __pdht_config->bucketslots = PDHT_DEFAULT_BUCKET_SLOTS;
+  }
+  if (opts & PDHT_TUNE_PROGRESS) {
+    __pdht_config->progress_spin = config->progress_spin;
+    __pdht_config->progress_cpu  = config->progress_cpu;
+    __pdht_config->progress_threads = config->progress_threads;
+    __pdht_config->progmode     = config->progmode;
+    if (config->progress_spin > PDHT_MAX_PROGRESS_SPIN)
+      __pdht_config->progress_spin = PDHT_DEFAULT_PROGRESS_SPIN;
+    if (config->progress_cpu < -1)
+      __pdht_config->progress_cpu  = PDHT_DEFAULT_PROGRESS_CPU;
+    if ((config->progress_threads < 1) || (config->progress_threads > PDHT_MAX_PROGRESS_THREADS))
+      __pdht_config->progress_threads = PDHT_DEFAULT_PROGRESS_THREADS;
+    if ((config->progmode < PdhtProgressThreads) || (config->progmode > PdhtProgressManual))
+      __pdht_config->progmode   = PDHT_DEFAULT_PROGMODE;
+  }
+  if (opts & PDHT_TUNE_SHM) {
+    __pdht_config->shmmode      = config->shmmode;
+    if ((config->shmmode < PdhtShmOff) || (config->shmmode > PdhtShmNode))
+      __pdht_config->shmmode    = PDHT_DEFAULT_SHMMODE;
+  }
   // copy back tunables, so app can see
   memcpy(config,__pdht_config, sizeof(pdht_config_t));
 }
@@ -352,8 +408,9 @@ void pdht_clear(pdht_t *dht) {
  */
 void pdht_init(pdht_config_t *cfg) {
   ptl_ni_limits_t ni_req_limits;
-  ptl_process_t me;
-  int stderrfd = dup2(STDERR_FILENO,stderrfd);
+  unsigned maxptes = cfg->maxptes > cfg->nptes ? cfg->maxptes : cfg->nptes;
+  unsigned nbuckets = 0;
+  int stderrfd = dup(STDERR_FILENO);
   int ret;
 
   // turn off output buffering for everyone's sanity
@@ -361,6 +418,7 @@ void pdht_init(pdht_config_t *cfg) {
 
   c = (pdht_context_t *)malloc(sizeof(pdht_context_t));
   memset(c,0,sizeof(pdht_context_t));
+  c->ptl.nni = PTL_INVALID_HANDLE; // only brought up by direct layout tables
 
   //c->verbosity = 1; // for debugging Portals
 
@@ -387,17 +445,21 @@ void pdht_init(pdht_config_t *cfg) {
     exit(-1);
   }
 
+  // bucket MEs are linked on top of per-entry MEs (at most 4x maxentries/bucketslots, after rounding)
+  if (cfg->layout == PdhtLayoutBucket)
+    nbuckets = PDHT_MAX_TABLES * ((4 * cfg->maxentries) / cfg->bucketslots + cfg->nptes);
+
   // request portals NI limits
-  ni_req_limits.max_entries = (cfg->maxentries) + PDHT_MAX_COUNTERS + PDHT_COLLECTIVE_CTS + PDHT_COMPLETION_CTS + PDHT_ATOMIC_CTS + 1;
+  ni_req_limits.max_entries = (cfg->maxentries) + nbuckets + PDHT_MAX_COUNTERS + PDHT_COLLECTIVE_CTS + PDHT_COMPLETION_CTS + PDHT_ATOMIC_CTS + 1;
   ni_req_limits.max_unexpected_headers = 1024;
   ni_req_limits.max_mds = 1024;
-  ni_req_limits.max_eqs = PDHT_MAX_TABLES * ((2*cfg->nptes)+2);
+  ni_req_limits.max_eqs = PDHT_MAX_TABLES * ((2*maxptes)+2);
   //ni_req_limits.max_cts = (cfg->nptes*cfg->pendq_size)+PDHT_MAX_COUNTERS
   ni_req_limits.max_cts = (cfg->maxentries)+PDHT_MAX_COUNTERS + PDHT_COLLECTIVE_CTS + PDHT_COMPLETION_CTS + PDHT_ATOMIC_CTS + 1;
-  ni_req_limits.max_pt_index = 2*cfg->nptes + PDHT_COUNT_PTES + PDHT_COLLECTIVE_PTES + 1;
+  ni_req_limits.max_pt_index = PDHT_MAX_TABLES*2*maxptes + PDHT_COUNT_PTES + PDHT_COLLECTIVE_PTES + 1;
   ni_req_limits.max_iovecs = 1024;
-  ni_req_limits.max_list_size = cfg->maxentries;
-  ni_req_limits.max_triggered_ops = (cfg->nptes*cfg->pendq_size)+100;
+  ni_req_limits.max_list_size = cfg->maxentries + nbuckets;
+  ni_req_limits.max_triggered_ops = (maxptes*cfg->pendq_size)+100;
   ni_req_limits.max_msg_size = LONG_MAX;
   ni_req_limits.max_atomic_size = 512;
   ni_req_limits.max_fetch_atomic_size = 512;
@@ -459,6 +521,9 @@ void pdht_init(pdht_config_t *cfg) {
    */
   pdht_collective_init(c);
   init_only_barrier(); // safe to use pdht_barrier() after this
+
+  // one progress engine serves every table created from here on
+  pdht_progress_init(cfg);
   
   // allocate global counter PTE (shared PTE amongst all HTs)
   ptl_pt_index_t index;
@@ -499,6 +564,10 @@ void pdht_fini(void) {
   // free up collective initialization stuff (PT Entry, MD)
   pdht_collective_fini();
 
+  pdht_progress_fini();
+
+  if (!PtlHandleIsEqual(c->ptl.nni, PTL_INVALID_HANDLE))
+    PtlNIFini(c->ptl.nni);
   PtlNIFini(c->ptl.lni);
   if (c->ptl.mapping)
     free(c->ptl.mapping);
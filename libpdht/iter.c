@@ -24,6 +24,10 @@
 pdht_status_t pdht_iterate(pdht_t *dht, pdht_iter_t *it) {
   it->dht = dht;
   it->iterator = (char *)dht->ht;
+  if (dht->layout == PdhtLayoutBucket)
+    it->iterator = (char *)dht->buckets; // bucket slots, then overflow entries
+  else if (dht->layout == PdhtLayoutDirect)
+    it->iterator = (char *)dht->direct;  // direct slots, then overflow entries
   return PdhtStatusOK;
 }
 
@@ -40,6 +44,11 @@ int pdht_hasnext(pdht_iter_t *it) {
   _pdht_ht_trigentry_t *thte;
   char *peek = it->iterator;
 
+  if (it->dht->layout == PdhtLayoutBucket)
+    return pdht_bucket_hasnext(it);
+  else if (it->dht->layout == PdhtLayoutDirect)
+    return pdht_direct_hasnext(it);
+
   switch (it->dht->pmode) {
     case PdhtPendingPoll:
       phte = (_pdht_ht_entry_t *)peek;
@@ -69,6 +78,11 @@ void *pdht_getnext(pdht_iter_t *it, void **key)  {
   _pdht_ht_entry_t     *phte;
   _pdht_ht_trigentry_t *thte;
 
+  if (it->dht->layout == PdhtLayoutBucket)
+    return pdht_bucket_getnext(it, key);
+  else if (it->dht->layout == PdhtLayoutDirect)
+    return pdht_direct_getnext(it, key);
+
   switch (it->dht->pmode) {
     case PdhtPendingPoll:
       phte = (_pdht_ht_entry_t *)it->iterator;
@@ -80,12 +94,40 @@ void *pdht_getnext(pdht_iter_t *it, void **key)  {
       break;
     case PdhtPendingTrig:
       thte = (_pdht_ht_trigentry_t *)it->iterator;
-      if (thte->ame != PTL_INVALID_HANDLE)
+      if (thte->ame != PTL_INVALID_HANDLE) {
         ret =  &thte->data;
         if (key)
           *key = &thte->key;
+      }
       break;
   }
   it->iterator += it->dht->entrysize;
   return ret;
 }
+
+
+
+/**
+ * pdht_entry_hasnext - advances to the next table entry with an ME of its own
+ *   used by layouts that keep most entries elsewhere and only link overflow
+ * @param it a PDHT iterator structure (positioned inside the entry array)
+ * @returns 1 if next entry is valid, 0 otherwise
+ */
+int pdht_entry_hasnext(pdht_iter_t *it) {
+  pdht_t *dht = it->dht;
+  char *hend = (char *)dht->ht + (dht->maxentries * dht->entrysize);
+  ptl_ct_event_t ct;
+
+  for ( ; it->iterator < hend; it->iterator += dht->entrysize) {
+    if (PtlHandleIsEqual(((_pdht_ht_entry_t *)it->iterator)->ame, PTL_INVALID_HANDLE))
+      continue;
+    // pending entries hold a not-yet-triggered append, only count ones a put has landed in
+    if (dht->pmode == PdhtPendingTrig) {
+      PtlCTGet(((_pdht_ht_trigentry_t *)it->iterator)->tct, &ct);
+      if (ct.success == 0)
+        continue;
+    }
+    return 1;
+  }
+  return 0;
+}
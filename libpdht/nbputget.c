@@ -38,10 +38,10 @@ pdht_handle_t pdht_nbput(pdht_t *dht, void *key, void *value) {
 /**
  * pdht_nbget - asynchronously gets an entry from the global hash table
  *   @param key - hash table key
- *   @param value - value of the global entry
+ *   @param value - buffer for the value, must stay valid until the get completes
  *   @returns handle for completion operations
  */
-pdht_handle_t pdht_nbget(pdht_t *dht, void *key, void **value) {
+pdht_handle_t pdht_nbget(pdht_t *dht, void *key, void *value) {
   // worry about spending too much time finding a free NB handle here
 
   // hash key to get dest rank + match bits
@@ -40,6 +40,7 @@
 #define PDHT_MAX_COUNTERS      20
 #define PDHT_MAX_REDUCE_ELEMS 128
 #define PDHT_MAX_RANKS       1024
+#define PDHT_MAX_THREADS       64 // application threads using PDHT at once
 
 /**********************************************/
 /* statistics/performance data                */
@@ -67,6 +68,9 @@ struct pdht_stats_s {
   u_int64_t    collisions;
   u_int64_t    notfound;
   u_int64_t    ptcounts[PDHT_MAX_PTES];
+  u_int64_t    ptentries[PDHT_MAX_PTES];     // active MEs linked on each get PTE
+  u_int64_t    ptgrowths;     // number of times the PTE set was scaled up
+  u_int64_t    shmops;        // gets/updates served from a same-node rank's shared memory
   pdht_timer_t ptimer; // put timer
   pdht_timer_t gtimer; // get timer
   pdht_timer_t t1; // utility timer 1
@@ -131,6 +135,9 @@ struct pdht_portals_s {
   void            *collective_rscratch; //!< scratch space for collective ops
   void            *collective_scratch;  //!< scratch space for collective ops
   u_int32_t        pt_nextfree;         //!< next available PTE index
+  ptl_handle_ni_t  nni;                 //!< non-matching logical NI (direct layout)
+  ptl_ni_limits_t  nni_limits;          //!< non-matching logical NI limits
+  u_int32_t        dpt_nextfree;        //!< next available non-matching PTE index
 };
 typedef struct pdht_portals_s pdht_portals_t;
 
@@ -144,7 +151,12 @@ struct pdht_context_s {
   int              size;         //!< process count
   int              dbglvl;       //!< debug level for error printing
   pdht_portals_t   ptl;          //!< Portals 4 ADTs
-  pthread_t        progress_tid; //!< progress thread id
+  unsigned         progress_gen; //!< bumped whenever the set of EQs to poll changes
+  unsigned         progress_threads; //!< progress threads, each owns a shard of the PTEs
+  int              progress_run; //!< progress engine is running
+  int              progress_manual; //!< no progress threads, see PdhtProgressManual
+  int              progress_cpu; //!< first CPU to pin progress threads to (-1: don't)
+  unsigned         progress_spin; //!< empty polls to spin through before blocking
   int              verbosity;    //!< verbosity level for portals logs
 };
 typedef struct pdht_context_s pdht_context_t;
@@ -174,12 +186,37 @@ typedef enum pdht_pmode_e pdht_pmode_t;
 #define PDHT_DEFAULT_PMODE PdhtPendingTrig
 //#define PDHT_DEFAULT_PMODE PdhtPendingPoll
 
+/* active match list layout */
+enum pdht_layout_e {
+  PdhtLayoutEntry,    // one active ME per entry
+  PdhtLayoutBucket,   // one active ME per fixed-size bucket of entries, resolved by the initiator
+  PdhtLayoutDirect    // slot array on a non-matching portal, gets read a neighborhood by offset
+};
+typedef enum pdht_layout_e pdht_layout_t;
+#define PDHT_DEFAULT_LAYOUT PdhtLayoutEntry
+
+/* who drives target-side progress */
+enum pdht_progmode_e {
+  PdhtProgressThreads, // progress threads poll the event queues
+  PdhtProgressManual   // no threads, app calls pdht_progress(), blocking ops drive progress themselves
+};
+typedef enum pdht_progmode_e pdht_progmode_t;
+#define PDHT_DEFAULT_PROGMODE PdhtProgressThreads
+
+/* access to the partitions of ranks on the same node */
+enum pdht_shmmode_e {
+  PdhtShmOff,   // every remote operation goes through Portals
+  PdhtShmNode   // entries live in shared memory, same-node gets/updates are loads and stores
+};
+typedef enum pdht_shmmode_e pdht_shmmode_t;
+#define PDHT_DEFAULT_SHMMODE PdhtShmOff  // opt-in, see PDHT_TUNE_SHM
+
 /* DHT operatation status */
 enum pdht_status_e {
   PdhtStatusOK,
   PdhtStatusError,
   PdhtStatusNotFound,
-  PdhtStatusCollision
+  PdhtStatusCollision  // match bit collisions are resolved by the owner, not returned by put/get
 };
 typedef enum pdht_status_e pdht_status_t;
 
@@ -195,30 +232,69 @@ typedef int pdht_handle_t;
 
 typedef void (*pdht_hashfunc)(struct pdht_s *dht, void *key, ptl_match_bits_t *bits, uint32_t *ptindex, ptl_process_t *rank);
 
+// completion callback for pdht_get_async() / pdht_put_async(), runs on the progress engine
+typedef void (*pdht_async_cb)(struct pdht_s *dht, void *key, void *value, pdht_status_t status, void *arg);
+struct _pdht_async_s; // async request, see async.c
+
+
+/* per-thread communication context, one per application thread and table (see pdht_tctx()) */
+struct pdht_tctx_s {
+  ptl_handle_md_t lmd;                          //!< memory descriptor for this thread's put/gets
+  ptl_handle_eq_t lmdeq;                        //!< event queue for local MD
+  ptl_handle_ct_t lmdct;                        //!< counter for local MD
+  ptl_ct_event_t  curcounts;                    //!< current fail/success counts for local MD state (tracks progress)
+  ptl_handle_md_t atomic_md;                    //!< atomic MD handle
+  ptl_handle_ct_t atomic_ct;                    //!< atomic CT handle
+  void           *atomic_scratch;               //!< atomic scratch space
+  ptl_handle_md_t cswap_md;                     //!< MD over the batched cswap scratch ring
+  ptl_handle_ct_t cswap_ct;                     //!< replies for cswap_md
+  ptl_handle_eq_t cswap_eq;                     //!< failed replies for cswap_md
+  void           *cswap_ring;                   //!< batched cswap scratch ring
+  ptl_handle_md_t dmd;                          //!< MD for gets/puts on the non-matching NI
+  ptl_handle_ct_t dmdct;                        //!< counter for dmd
+  ptl_handle_md_t datomic_md;                   //!< atomic MD on the non-matching NI
+  ptl_handle_ct_t datomic_ct;                   //!< atomic CT on the non-matching NI
+  void           *search;                       //!< entry found by this thread's local ME search
+  int             search_flag;                  //!< 0: search pending, 1: found, -1: not found
+  ptl_handle_md_t accmd;                        //!< MD over the accumulate operand ring
+  ptl_handle_eq_t acceq;                        //!< ACKs for accumulates in flight
+  void           *accring;                      //!< accumulate operand ring (assoc.c)
+  unsigned        accnext;                      //!< next ring slot to try
+  unsigned        accbusy;                      //!< accumulates waiting for their ACK
+  uint64_t        ccnext[PDHT_MAX_COUNTERS];    //!< next value of this thread's chunk of each counter
+  uint64_t        ccend[PDHT_MAX_COUNTERS];     //!< end of this thread's chunk of each counter
+};
+typedef struct pdht_tctx_s pdht_tctx_t;
 
 /* portals-specific data structures */
 struct pdht_htportals_s {
   ptl_handle_ni_t lni;                          //!< portals logical NI
   unsigned        ptalloc_opts;                 //!< options to PtlPTAlloc (for unordered matching)
   unsigned        nptes;                        //!< number of pending / active PTE pairs
+  unsigned        maxptes;                      //!< upper bound on nptes when scaling
+  unsigned        ptlistmax;                    //!< active match list length that triggers scaling
   ptl_pt_index_t  getindex_base;                //!< active_base 
-  ptl_pt_index_t  putindex_base;                //!< active_base + dht->nptes
+  ptl_pt_index_t  putindex_base;                //!< active_base + dht->maxptes
   ptl_pt_index_t  getindex[PDHT_MAX_PTES];      //!< portal table entry index
   ptl_pt_index_t  putindex[PDHT_MAX_PTES];      //!< portal table entry index
   ptl_handle_eq_t eq[PDHT_MAX_PTES];            //!< event queue for put PT entry
   ptl_handle_eq_t aeq[PDHT_MAX_PTES];           //!< event queue for get PT entry (fence/triggered)
   ptl_me_t        me;                           //!< default match entry for ht
-  ptl_handle_md_t lmd;                          //!< memory descriptor for any outgoing put/gets
-  ptl_handle_eq_t lmdeq;                        //!< event queue for local MD
-  ptl_handle_ct_t lmdct;                        //!< counter for local MD
-  ptl_handle_me_t centries[PDHT_MAX_COUNTERS];  //!< ME entries for atomic counters (target, rank 0 only)
+  ptl_handle_me_t centries[PDHT_MAX_COUNTERS];  //!< ME entries for atomic counters (target, counter's home rank only)
   ptl_handle_md_t countmds[PDHT_MAX_COUNTERS];  //!< MDs for initiator counter ops (initiator, all ranks)
   ptl_handle_ct_t countcts[PDHT_MAX_COUNTERS];  //!< CTs for initiator counter ops (initiator, all ranks)
-  ptl_ct_event_t  curcounts;                    //!< current fail/success counts for local MD state (tracks progress)
-  ptl_handle_md_t atomic_md;                   //!< atomic MD handle
-  ptl_handle_ct_t atomic_ct;                   //!< atomic CT handle
-  void           *atomic_scratch;              //!< atomic scratch space
   ptl_size_t      lfail;                        //!< number of strict messages received
+  ptl_pt_index_t  dindex;                       //!< non-matching PTE (direct layout)
+  ptl_handle_le_t dle;                          //!< LE exposing the direct table
+  int             disabled[PDHT_MAX_PTES];      //!< pending PTEs turned off by flow control
+  u_int64_t       refill_t[PDHT_MAX_PTES];      //!< time (ns) of the last arrival rate sample
+  u_int64_t       refill_n[PDHT_MAX_PTES];      //!< consumed pending entries at the last sample
+  double          refill_rate[PDHT_MAX_PTES];   //!< EWMA of pending entries consumed per ms
+  pdht_tctx_t    *tctx[PDHT_MAX_THREADS];       //!< initiator contexts, indexed by thread slot
+  ptl_handle_md_t asyncmd;                      //!< MD for callback-based async ops
+  ptl_handle_eq_t asynceq;                      //!< completion events for asyncmd, served by the progress engine
+  ptl_handle_md_t dasyncmd;                     //!< MD for async neighborhood reads on the non-matching NI (direct layout)
+  ptl_handle_eq_t dasynceq;                     //!< completion events for dasyncmd, drained by pdht_async_deliver()
 };
 typedef struct pdht_htportals_s pdht_htportals_t;
 
@@ -228,6 +304,17 @@ typedef struct pdht_htportals_s pdht_htportals_t;
 /**********************************************/
 struct pdht_s {
   void             *ht;  
+  void             *index;       // owner-side match bits index (collision resolution)
+  unsigned          indexmask;   // index slot count - 1
+  pdht_layout_t     layout;      // per-entry or bucketed active MEs
+  void             *buckets;     // bucket storage, nptes * (bucketmask+1) buckets (bucket layout)
+  ptl_handle_me_t  *bucketmes;   // one active ME per bucket (bucket layout)
+  unsigned          bucketmask;  // buckets per PTE - 1
+  unsigned          bucketslots; // entries per bucket
+  unsigned          bucketsize;  // bytes per bucket (header + slots)
+  void             *direct;      // slot array (direct layout)
+  unsigned          directmask;  // home slots - 1
+  unsigned          directslotsize; // bytes per direct slot (versions + key + value)
   unsigned          keysize;
   unsigned          elemsize;
   unsigned          entrysize;
@@ -235,18 +322,23 @@ struct pdht_s {
   unsigned          usedentries; // number of pending + active entries
   unsigned          pendq_size;
   pdht_hashfunc     hashfn;
-  unsigned          nextfree;
+  unsigned          nextfree;    // first unclaimed ht entry, see pdht_entry_claim()
   pdht_mode_t       mode;
   pdht_pmode_t      pmode;
   pdht_stats_t      stats;
   pdht_local_gets_t local_get;
-  uint64_t          counters[PDHT_MAX_COUNTERS]; // rank 0 target (master) counters
+  uint64_t          counters[PDHT_MAX_COUNTERS]; // target (master) counters, counter i lives on rank i % size
   uint64_t          lcounts[PDHT_MAX_COUNTERS];  // initiator side buffers
-  int               local_get_flag;
+  unsigned          counterchunk[PDHT_MAX_COUNTERS]; // values claimed from the home rank per increment
   int               countercount; // :)
   int               gameover; // signal for progress thread to die
-  pthread_mutex_t   completion_mutex;    //!< thread mutex to synch between progress thread and fence
-  pthread_mutex_t   local_gets_flag_mutex;
+  pthread_mutex_t   completion_mutex;    //!< guards the owner-side index and layout placement
+  void             *shm;         // our shared entry + index segment, NULL if not shared (shm.c)
+  void            **shmpeers;    // segments of same-node ranks (including us), NULL if not shared
+  unsigned          asyncpending; // async ops issued and not yet called back
+  struct _pdht_async_s *asyncdone; // async ops completed by the caller, called back from the progress engine
+  struct _pdht_async_s *asyncretry; // flow controlled async puts waiting out their backoff
+  unsigned          asyncwait;   // async ops whose completion the poll set can't see (direct reads, backoffs)
   pdht_htportals_t  ptl;
   pdht_status_t   (*put)(struct pdht_s *dht, void *k, void *v);
   pdht_status_t   (*get)(struct pdht_s *dht, void *k, void **v);
@@ -264,7 +356,11 @@ typedef struct pdht_s pdht_t;
 #define PDHT_TUNE_QUIET      0x20
 #define PDHT_TUNE_GETS       0x40
 #define PDHT_TUNE_RANK       0x80
-#define PDHT_TUNE_ALL        0xffffffff
+#define PDHT_TUNE_SCALE      0x100
+#define PDHT_TUNE_LAYOUT     0x200
+#define PDHT_TUNE_PROGRESS   0x400
+#define PDHT_TUNE_SHM        0x800
+#define PDHT_TUNE_ALL        0xff   // NPTES..RANK only, SCALE and later must be asked for by name
 struct pdht_config_s {
   unsigned      nptes;
   pdht_pmode_t  pendmode;
@@ -275,12 +371,28 @@ struct pdht_config_s {
  #define PDHT_DEFAULT_RANK_HINT -1 // use PMI-defined rank
   int           rank;
   pdht_local_gets_t local_gets;
+  unsigned      maxptes;      // PTE count may grow up to this at fence time
+  unsigned      ptlistmax;    // grow once a match list is longer than this
+  pdht_layout_t layout;       // active ME per entry or per bucket
+  unsigned      bucketslots;  // entries per bucket (bucket layout)
+  unsigned      progress_spin; // empty polls the progress engine spins through before blocking
+  int           progress_cpu;  // CPU to pin the first progress thread to, -1 to leave them unpinned
+  unsigned      progress_threads; // progress threads, PTE i is served by thread i % progress_threads
+  pdht_progmode_t progmode;     // progress threads or app-driven progress
+  pdht_shmmode_t shmmode;       // map same-node ranks' entries for direct gets/updates
 };
 typedef struct pdht_config_s pdht_config_t;
 
 /* atomic associative operators */
 enum pdht_oper_e {
-  AssocOpAdd
+  AssocOpAdd,
+  AssocOpMin,
+  AssocOpMax,
+  AssocOpProd,
+  AssocOpBand,  // integer types only
+  AssocOpBor,   // integer types only
+  AssocOpBxor,  // integer types only
+  AssocOpSwap   // pdht_fetch_op() only
 };
 typedef enum pdht_oper_e pdht_oper_t;
 
@@ -333,6 +445,9 @@ pdht_status_t        pdht_wait(pdht_handle_t h);
 pdht_status_t        pdht_waitrank(int rank);
 pdht_status_t        pdht_waitall(void);
 
+// Explicit progress (PdhtProgressManual) -- progress.c
+int                  pdht_progress(pdht_t *dht);
+
 // Put / Get Operations -- putget.c
 pdht_status_t        pdht_put(pdht_t *dht, void *key, void *value);
 pdht_status_t        pdht_add(pdht_t *dht, void *key, void *value);
@@ -343,11 +458,17 @@ pdht_status_t        pdht_persistent_get(pdht_t *dht, void *key, void *value);
 
 // Asynchronous Put / Get Operations -- nbputget.c
 pdht_handle_t        pdht_nbput(pdht_t *dht, void *key, void *value);
-pdht_handle_t        pdht_nbget(pdht_t *dht, void *key, void **value);
+pdht_handle_t        pdht_nbget(pdht_t *dht, void *key, void *value);
+
+// Callback-based Asynchronous Operations -- async.c
+pdht_status_t        pdht_get_async(pdht_t *dht, void *key, void *value, pdht_async_cb cb, void *arg);
+pdht_status_t        pdht_put_async(pdht_t *dht, void *key, void *value, pdht_async_cb cb, void *arg);
+void                 pdht_async_wait(pdht_t *dht);
 
 // Associative Update Operations -- assoc.c
-pdht_status_t        pdht_acc(pdht_t *dht, void *key, pdht_datatype_t type, pdht_oper_t op, void *value);
-pdht_handle_t        pdht_nbacc(pdht_t *dht, void *key, pdht_datatype_t type, pdht_oper_t op, void *value);
+#define PDHT_ACC_ALL ((size_t)-1) // offset that applies an accumulate to the whole element
+pdht_status_t        pdht_acc(pdht_t *dht, void *key, size_t offset, pdht_datatype_t type, pdht_oper_t op, void *value);
+pdht_handle_t        pdht_nbacc(pdht_t *dht, void *key, size_t offset, pdht_datatype_t type, pdht_oper_t op, void *value);
 
 // Hash Function Operations -- hash.c
 void                 pdht_sethash(pdht_t *dht, pdht_hashfunc hfun);
@@ -362,11 +483,12 @@ void                *pdht_getnext(pdht_iter_t *it, void **key);
 
 // atomics / counter support atomics.c
 int                  pdht_counter_init(pdht_t *ht, int initval);
+int                  pdht_counter_init_chunked(pdht_t *ht, int initval, unsigned chunk);
 uint64_t             pdht_counter_inc(pdht_t *ht, int counter, uint64_t val);
 void                 pdht_counter_reset(pdht_t *ht, int counter);
-int                  pdht_atomic_init(pdht_t *ht);
-void                 pdht_atomic_free(pdht_t *ht);
 pdht_status_t        pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new);
+pdht_status_t        pdht_fetch_op(pdht_t *ht, void *key, size_t offset, pdht_datatype_t type, pdht_oper_t op, void *operand, void *old);
+pdht_status_t        pdht_atomic_cswap_many(pdht_t *ht, int n, void **keys, size_t offset, int64_t *old, int64_t *new, pdht_status_t *status);
 
 //trig.c - temp
 void print_count(pdht_t *dht, char *msg);
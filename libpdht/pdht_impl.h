@@ -39,6 +39,8 @@
 #define PDHT_PENDINGQ_SIZE      20000
 
 #define PDHT_DEFAULT_NUM_PTES  1
+#define PDHT_DEFAULT_MAX_PTES  8     // scaling limit if PDHT_TUNE_SCALE gives an out of range maxptes
+#define PDHT_DEFAULT_PTE_LIST_MAX 8192 // longest active match list tolerated before scaling
 #define PDHT_COUNT_PTES 1
 #define PDHT_COMPLETION_CTS 1
 #define PDHT_COLLECTIVE_PTES 3 // barrier, mutex, termination
@@ -47,6 +49,32 @@
 
 #define PDHT_MAXKEYSIZE 32 // size in bytes (32 for MADNESS)
 
+#define PDHT_DEFAULT_BUCKET_SLOTS 8  // entries per bucket ME (bucket layout)
+#define PDHT_MAX_BUCKET_SLOTS  1024
+
+#define PDHT_DEFAULT_PROGRESS_SPIN 1024   // empty polls before the progress engine blocks
+#define PDHT_MAX_PROGRESS_SPIN     (1 << 20)
+#define PDHT_DEFAULT_PROGRESS_CPU  -1     // progress engine is not pinned
+#define PDHT_DEFAULT_PROGRESS_THREADS 1
+#define PDHT_MAX_PROGRESS_THREADS  PDHT_MAX_PTES // more threads than PTEs would sit idle
+#define PDHT_PROGRESS_BLOCK_MS     10     // longest the progress engine blocks in PtlEQPoll
+#define PDHT_PROGRESS_BATCH        64     // events handled per queue by one pdht_progress() call
+#define PDHT_MAX_ASYNC             1024   // async ops in flight per table before callers wait
+#define PDHT_ASYNC_EQ_SIZE         (2*PDHT_MAX_ASYNC) // callbacks may issue past PDHT_MAX_ASYNC
+#define PDHT_ASYNC_RETRY_NS        1000000   // first flow control backoff of an async put, doubles per retry
+#define PDHT_ASYNC_RETRY_MAX_NS    10000000  // longest flow control backoff (same as pdht_put())
+
+#define PDHT_REFILL_CHUNK          8      // pending entries replaced per pass once headroom is met
+#define PDHT_REFILL_HORIZON_MS     2      // headroom covers this much arrival at the recent rate
+#define PDHT_REFILL_SAMPLE_NS      1000000 // arrival rate sample period (1ms)
+#define PDHT_REFILL_ALPHA          0.25   // weight of the newest arrival rate sample
+
+#define PDHT_DIRECT_HOPS      16   // neighborhood a key is placed in, slots read by a direct get
+#define PDHT_DIRECT_RETRIES   64   // neighborhood re-reads before giving up on a torn slot
+
+#define PDHT_ACC_RING         256  // accumulates in flight per thread and table
+#define PDHT_CSWAP_RING       256  // batched cswaps in flight per thread and table
+
 //#define PDHT_PTALLOC_OPTIONS 0
 #define PDHT_PTALLOC_OPTIONS PTL_PT_MATCH_UNORDERED
 
@@ -65,6 +93,26 @@
 #define __PDHT_COUNTER_INDEX 1
 #define __PDHT_COUNTER_MATCH 0xdeadbeef
 
+// match bit collision resolution: colliding keys are relinked on the owner
+// under secondary (probe) match bits, primary bits never have the probe bit set
+#define PDHT_MAX_PROBES       8
+#define __PDHT_PROBE_BIT      0x8000000000000000ULL
+#define __PDHT_PROBE_STRIDE   0x9e3779b97f4a7c15ULL
+#define __PDHT_INDEX_EMPTY    0xffffffff  // owner index slot unused
+#define __PDHT_INDEX_CHAIN    0xfffffffe  // owner index slot is a collision chain head
+
+// bucket layout: bucket MEs match on BUCKET_BIT | index << 32 and ignore the low 32 bits
+#define __PDHT_BUCKET_BIT     0x4000000000000000ULL
+#define __PDHT_BUCKET_SHIFT   32
+#define __PDHT_BUCKET_IGNORE  0x00000000ffffffffULL
+#define __PDHT_HASH_MASK      (~(__PDHT_PROBE_BIT | __PDHT_BUCKET_BIT))
+
+// intra-node shared memory segments (shm.c)
+#define PDHT_SHM_MAGIC        0x7064687473686d31ULL // "pdhtshm1"
+
+// direct layout: pdht_locate() reports keys found in the slot array with these bits
+#define __PDHT_DIRECT_BITS    0xffffffffffffffffULL
+
 #define offsetof(type, member)  __builtin_offsetof (type, member)
 
 extern pdht_config_t   *__pdht_config; 
@@ -95,6 +143,76 @@ struct _pdht_ht_trigentry_s {
 };
 typedef struct _pdht_ht_trigentry_s _pdht_ht_trigentry_t;
 
+// owner-side index of linked match bits -> local entry (collision.c)
+struct _pdht_index_slot_s {
+   ptl_match_bits_t  bits;    // match bits of linked ME
+   uint32_t          entry;   // ht[] entry index, or __PDHT_INDEX_EMPTY/CHAIN
+   uint32_t          ptindex; // PTE the ME is linked on
+   ptl_handle_me_t   mark;    // chain head marker ME (chain slots only)
+};
+typedef struct _pdht_index_slot_s _pdht_index_slot_t;
+
+// bucket layout storage, slots hold key + value just like an entry ME (bucket.c)
+struct _pdht_bucket_s {
+   uint64_t          used;     // slots filled, slots are never reused
+   char              slots[0]; // bucketslots * (PDHT_MAXKEYSIZE + elemsize)
+};
+typedef struct _pdht_bucket_s _pdht_bucket_t;
+
+// callback-based async operation in flight (async.c)
+enum _pdht_async_op_e { PdhtAsyncGet, PdhtAsyncPut };
+enum _pdht_async_stage_e { PdhtAsyncEntry, PdhtAsyncBucket, PdhtAsyncNbhd };
+struct _pdht_async_s {
+   pdht_t               *dht;
+   enum _pdht_async_op_e op;
+   pdht_async_cb         cb;
+   void                 *arg;
+   void                 *value;   // get: caller's buffer, put: our copy of the value
+   ptl_match_bits_t      mbits;
+   uint32_t              ptindex;
+   ptl_process_t         rank;
+   enum _pdht_async_stage_e stage; // get: what is being fetched (entry ME, bucket, direct neighborhood)
+   int                   probe;   // get: collision chain slot being fetched, 0 for the primary bits
+   int                   tries;   // get: torn neighborhood reads, put: flow control retries
+   u_int64_t             retry_t; // put: time (ns) a flow controlled request goes back on the wire
+   pdht_status_t         status;  // deferred completions only
+   ptl_size_t            loffset; // put: start of the wire data
+   ptl_size_t            len;     // put: bytes on the wire
+   struct _pdht_async_s *next;    // deferred completion or retry stack
+   char                  key[PDHT_MAXKEYSIZE];
+   char                  data[0]; // get: reply (key + value, bucket or neighborhood), put: ME header + key + value
+};
+typedef struct _pdht_async_s _pdht_async_t;
+
+// direct layout slot, head and (trailing) tail versions bracket the slot contents (direct.c)
+struct _pdht_direct_slot_s {
+   uint64_t          head;     // equal to the tail unless the owner is writing the slot
+   uint32_t          hops;     // home slots: neighborhood slots holding keys homed here
+   uint16_t          used;     // slot holds a key
+   uint16_t          overflow; // home slots: keys homed here that kept their own ME
+   char              key[PDHT_MAXKEYSIZE];
+   char              data[0];  // elemsize, followed by the uint64_t tail version
+};
+typedef struct _pdht_direct_slot_s _pdht_direct_slot_t;
+
+// head of a rank's shared segment, entries and the owner index follow (shm.c)
+struct _pdht_shm_hdr_s {
+   uint64_t          magic;
+   uint32_t          maxentries;
+   uint32_t          entrysize;
+   uint32_t          indexmask;
+   uint32_t          keysize;
+   uint32_t          elemsize;
+   uint32_t          pmode;
+   uint64_t          entoff;   // offset of the entry array
+   uint64_t          idxoff;   // offset of the owner index
+   uint64_t          len;      // total segment length
+   uint32_t          lock;     // writer lock, owner and same-node updaters
+   uint32_t          pad;
+   uint64_t          seq;      // odd while the index or a value is being written
+};
+typedef struct _pdht_shm_hdr_s _pdht_shm_hdr_t;
+
 
 /********************************************************/
 /* portals distributed hash table prototypes            */
@@ -104,11 +222,18 @@ typedef struct _pdht_ht_trigentry_s _pdht_ht_trigentry_t;
 void                 pdht_init(pdht_config_t *cfg);
 void                 pdht_fini(void);
 void                 pdht_clearall(void);
+void                 pdht_pte_init(pdht_t *dht, unsigned ptindex);
 
 // commsynch.c
 void                 pdht_collective_init(pdht_context_t *c);
 void                 pdht_collective_fini();
 pdht_status_t        pdht_finalize_puts(pdht_t *dht);
+int                  pdht_active_event(pdht_t *dht, ptl_event_t *ev, unsigned ptindex);
+
+// putget.c
+pdht_status_t        pdht_probe(pdht_t *dht, void *key, ptl_match_bits_t mbits, uint32_t ptindex, ptl_process_t rank, ptl_match_bits_t *found, char *buf);
+pdht_status_t        pdht_locate(pdht_t *dht, void *key, ptl_match_bits_t mbits, uint32_t ptindex, ptl_process_t rank,
+                                 ptl_match_bits_t *bits, ptl_size_t *offset, char *buf);
 
 // pmi.c
 void init_pmi(pdht_config_t *cfg);
@@ -127,11 +252,260 @@ void pdht_dump_event(ptl_event_t *ev);
 // hash.c - PDHT hash function operations
 void pdht_hash(pdht_t *dht, void *key, ptl_match_bits_t *bits, uint32_t *ptindex, ptl_process_t *rank);
 
+// collision.c - PDHT match bit collision resolution
+void              pdht_index_init(pdht_t *dht);
+void              pdht_index_fini(pdht_t *dht);
+int               pdht_index_claim(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex, ptl_match_bits_t *lbits);
+void              pdht_index_relink(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex);
+void             *pdht_index_find(pdht_t *dht, void *key, ptl_match_bits_t bits);
+void             *pdht_index_find_in(pdht_t *dht, _pdht_index_slot_t *slots, char *entries, void *key, ptl_match_bits_t bits);
+unsigned          pdht_index_size(pdht_t *dht);
+void              pdht_index_rehash(pdht_t *dht);
+
+// bucket.c - PDHT bucketed active match list layout
+void   pdht_bucket_init(pdht_t *dht);
+void   pdht_bucket_fini(pdht_t *dht);
+int    pdht_bucket_place(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex);
+void  *pdht_bucket_find(pdht_t *dht, void *key, ptl_match_bits_t bits, uint32_t ptindex);
+pdht_status_t pdht_bucket_scan(pdht_t *dht, void *key, _pdht_bucket_t *b, ptl_size_t *offset, char *buf, int *overflow);
+int    pdht_bucket_hasnext(pdht_iter_t *it);
+void  *pdht_bucket_getnext(pdht_iter_t *it, void **key);
+
+// direct.c - PDHT direct-addressed table layout
+void           pdht_direct_init(pdht_t *dht);
+void           pdht_direct_fini(pdht_t *dht);
+int            pdht_direct_place(pdht_t *dht, void *entry, ptl_match_bits_t bits);
+void          *pdht_direct_find(pdht_t *dht, void *key, ptl_match_bits_t bits);
+pdht_status_t  pdht_direct_fetch(pdht_t *dht, void *key, ptl_match_bits_t mbits, ptl_process_t rank,
+                                 ptl_size_t *offset, char *buf, int *overflow);
+pdht_status_t  pdht_direct_scan(pdht_t *dht, void *key, unsigned home, char *nbhd,
+                                ptl_size_t *offset, char *buf, int *overflow);
+void           pdht_direct_store(pdht_t *dht, void *slotkey, void *value);
+int            pdht_direct_hasnext(pdht_iter_t *it);
+void          *pdht_direct_getnext(pdht_iter_t *it, void **key);
+void           pdht_direct_tctx_init(pdht_tctx_t *tc);
+void           pdht_direct_tctx_fini(pdht_tctx_t *tc);
+
+// shm.c - PDHT intra-node shared memory
+void           pdht_shm_init(pdht_t *dht);
+void           pdht_shm_attach(pdht_t *dht);
+void           pdht_shm_fini(pdht_t *dht);
+void          *pdht_shm_index(pdht_t *dht);
+pdht_status_t  pdht_shm_get(pdht_t *dht, void *key, ptl_match_bits_t bits, ptl_process_t rank, void *value);
+pdht_status_t  pdht_shm_update(pdht_t *dht, void *key, ptl_match_bits_t bits, ptl_process_t rank, void *value);
+void           pdht_shm_write_begin(pdht_t *dht);
+void           pdht_shm_write_end(pdht_t *dht);
+
+// atomics.c - PDHT atomic and counter operations
+int  pdht_atomic_init(pdht_t *ht, pdht_tctx_t *tc);
+void pdht_atomic_free(pdht_t *ht, pdht_tctx_t *tc);
+
+// assoc.c - PDHT associative operations
+void           pdht_acc_init(pdht_t *dht, pdht_tctx_t *tc);
+void           pdht_acc_free(pdht_t *dht, pdht_tctx_t *tc);
+void           pdht_acc_flush(pdht_t *dht);
+int            pdht_acc_typesize(pdht_datatype_t type);
+ptl_datatype_t pdht_acc_ptltype(pdht_datatype_t type);
+ptl_op_t       pdht_acc_ptlop(pdht_oper_t op);
+int            pdht_acc_check(pdht_datatype_t type, pdht_oper_t op);
+
+// async.c - PDHT callback-based asynchronous operations
+void pdht_async_init(pdht_t *dht);
+void pdht_async_fini(pdht_t *dht);
+void pdht_async_event(pdht_t *dht, ptl_event_t *ev);
+int  pdht_async_deliver(pdht_t *dht);
+
+// tctx.c - PDHT per-thread communication contexts
+extern __thread int _pdht_thread_id;
+int          pdht_thread_register(void);
+pdht_tctx_t *pdht_tctx_create(pdht_t *dht, int id);
+void         pdht_tctx_free(pdht_t *dht);
+
+// iter.c
+int pdht_entry_hasnext(pdht_iter_t *it);
+
+// scale.c - PDHT dynamic PTE scaling
+void pdht_pte_scale(pdht_t *dht);
+
 // poll.c - PDHT polling tasks
 void pdht_polling_init(pdht_t *dht);
 void pdht_polling_fini(pdht_t *dht);
-void *pdht_poll(void *arg);
+void pdht_polling_pte_init(pdht_t *dht, unsigned ptindex);
+void pdht_poll_event(pdht_t *dht, ptl_event_t *ev, unsigned ptindex);
 
 // trig.c - PDHT triggered tasks
 void pdht_trig_init(pdht_t *dht);
 void pdht_trig_fini(pdht_t *dht);
+void pdht_trig_pte_init(pdht_t *dht, unsigned ptindex);
+void pdht_trig_event(pdht_t *dht, ptl_event_t *ev, unsigned ptindex);
+void pdht_trig_refill(pdht_t *dht, unsigned ptindex);
+void pdht_trig_repost(pdht_t *dht, unsigned ptindex, void *entry);
+
+// progress.c - PDHT progress engine
+void pdht_progress_init(pdht_config_t *cfg);
+void pdht_progress_fini(void);
+void pdht_progress_register(pdht_t *dht);
+void pdht_progress_unregister(pdht_t *dht);
+void pdht_progress_changed(void);
+int  pdht_progress_ct_wait(ptl_handle_ct_t ct, ptl_size_t test, ptl_ct_event_t *event);
+void pdht_progress_yield(void);
+extern __thread int _pdht_in_progress;
+
+
+
+/**
+ * pdht_tctx - returns the calling thread's communication context for a table
+ *   contexts are created the first time a thread uses a table
+ */
+static inline pdht_tctx_t *pdht_tctx(pdht_t *dht) {
+  int id = (_pdht_thread_id >= 0) ? _pdht_thread_id : pdht_thread_register();
+  pdht_tctx_t *tc = dht->ptl.tctx[id];
+
+  return tc ? tc : pdht_tctx_create(dht, id);
+}
+
+
+
+/**
+ * pdht_hashkey - hashes a key with the table hash function
+ *   primary match bits are kept clear of the probe and bucket bits
+ */
+static inline void pdht_hashkey(pdht_t *dht, void *key, ptl_match_bits_t *bits, uint32_t *ptindex, ptl_process_t *rank) {
+  dht->hashfn(dht, key, bits, ptindex, rank);
+  *bits &= __PDHT_HASH_MASK;
+}
+
+
+
+/**
+ * pdht_probe_bits - secondary match bits for the i-th entry of a collision chain
+ */
+static inline ptl_match_bits_t pdht_probe_bits(ptl_match_bits_t bits, int probe) {
+  return (bits + (probe * __PDHT_PROBE_STRIDE)) | __PDHT_PROBE_BIT;
+}
+
+
+
+/**
+ * pdht_entry_key - returns the key stored in a local hash table entry
+ */
+static inline char *pdht_entry_key(pdht_t *dht, void *entry) {
+  if (dht->pmode == PdhtPendingTrig)
+    return ((_pdht_ht_trigentry_t *)entry)->key;
+  else
+    return ((_pdht_ht_entry_t *)entry)->key;
+}
+
+
+
+
+/**
+ * pdht_entry_claim - reserves up to want unused table entries (e.g. for a pending queue)
+ *   progress threads claim concurrently, no completion mutex needed
+ * @param first - index of the first reserved entry
+ * @returns number of entries reserved, 0 if the table is full
+ */
+static inline unsigned pdht_entry_claim(pdht_t *dht, unsigned want, unsigned *first) {
+  unsigned next = __atomic_load_n(&dht->nextfree, __ATOMIC_RELAXED), n;
+
+  do {
+    if (next >= dht->maxentries)
+      return 0;
+    n = (dht->maxentries - next) < want ? (dht->maxentries - next) : want;
+  } while (!__atomic_compare_exchange_n(&dht->nextfree, &next, next + n, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+  __atomic_add_fetch(&dht->usedentries, n, __ATOMIC_RELAXED);
+  *first = next;
+  return n;
+}
+
+
+
+/**
+ * pdht_bucket_index - bucket (within a PTE) that holds the entry with primary bits
+ */
+static inline unsigned pdht_bucket_index(pdht_t *dht, ptl_match_bits_t bits) {
+  // rank and ptindex come from the low bits, mix before picking a bucket
+  return (unsigned)((bits * __PDHT_PROBE_STRIDE) >> 32) & dht->bucketmask;
+}
+
+
+
+/**
+ * pdht_bucket_bits - match bits an initiator uses to reach the bucket holding bits
+ */
+static inline ptl_match_bits_t pdht_bucket_bits(pdht_t *dht, ptl_match_bits_t bits) {
+  return __PDHT_BUCKET_BIT | ((ptl_match_bits_t)pdht_bucket_index(dht, bits) << __PDHT_BUCKET_SHIFT) | (bits & __PDHT_BUCKET_IGNORE);
+}
+
+
+
+/**
+ * pdht_bucket_ptr - local storage for a bucket
+ */
+static inline _pdht_bucket_t *pdht_bucket_ptr(pdht_t *dht, uint32_t ptindex, unsigned bindex) {
+  return (_pdht_bucket_t *)((char *)dht->buckets + ((((ptindex * (dht->bucketmask+1)) + bindex)) * dht->bucketsize)); // pointer math
+}
+
+
+
+/**
+ * pdht_direct_home - home slot of the entry with primary bits
+ */
+static inline unsigned pdht_direct_home(pdht_t *dht, ptl_match_bits_t bits) {
+  return (unsigned)((bits * __PDHT_PROBE_STRIDE) >> 32) & dht->directmask;
+}
+
+
+
+/**
+ * pdht_direct_slot - local storage for a direct slot
+ */
+static inline _pdht_direct_slot_t *pdht_direct_slot(pdht_t *dht, unsigned slot) {
+  return (_pdht_direct_slot_t *)((char *)dht->direct + (slot * dht->directslotsize)); // pointer math
+}
+
+
+
+/**
+ * pdht_direct_tail - trailing version of a direct slot
+ */
+static inline uint64_t *pdht_direct_tail(pdht_t *dht, _pdht_direct_slot_t *s) {
+  return (uint64_t *)((char *)s + dht->directslotsize - sizeof(uint64_t)); // pointer math
+}
+
+
+
+/**
+ * pdht_layout_place - moves a newly linked entry into storage owned by the table layout
+ *   must be called with the completion mutex held
+ * @returns 1 if the entry no longer needs an ME of its own
+ */
+static inline int pdht_layout_place(pdht_t *dht, void *entry, ptl_match_bits_t bits, uint32_t ptindex) {
+  switch (dht->layout) {
+    case PdhtLayoutBucket:
+      return pdht_bucket_place(dht, entry, bits, ptindex);
+    case PdhtLayoutDirect:
+      return pdht_direct_place(dht, entry, bits);
+    default:
+      return 0;
+  }
+}
+
+
+
+/**
+ * pdht_layout_find - finds a local key in storage owned by the table layout
+ *   must be called with the completion mutex held
+ * @returns pointer to the key (value follows), or NULL
+ */
+static inline void *pdht_layout_find(pdht_t *dht, void *key, ptl_match_bits_t bits, uint32_t ptindex) {
+  switch (dht->layout) {
+    case PdhtLayoutBucket:
+      return pdht_bucket_find(dht, key, bits, ptindex);
+    case PdhtLayoutDirect:
+      return pdht_direct_find(dht, key, bits);
+    default:
+      return NULL;
+  }
+}
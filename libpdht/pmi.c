@@ -15,7 +15,6 @@ void init_pmi(pdht_config_t *cfg) {
     ptl_process_t me;
     int name_max, key_max, val_max;
     char *name, *key, *val;
-    int ret;
 
     PMI_Init(&initialized);
 
@@ -17,18 +17,35 @@
  * portals distributed hash table polling task code
  */
 
-static pthread_t _pdht_poll_tid;
-
 /**
- * pdht_polling_init -- initializes polling thread
+ * pdht_polling_init -- initializes pending put queues for polling mode
  * @param dht - hash table data structure
  */
 void pdht_polling_init(pdht_t *dht) {
+
+  // deal with multiple PTEs per hash table to handle match list length
+  // each PTE takes the next PENDINGQ_SIZE entries of the table for its pending queue
+  dht->nextfree = 0;
+  for (int ptindex = 0; ptindex < dht->ptl.nptes; ptindex++)
+    pdht_polling_pte_init(dht, ptindex);
+
+  // nextfree is now nptes * PENDINGQ_SIZE (free = DEFAULT_TABLE_SIZE - nptes * PENDINGQ_SIZE)
+  // the progress engine picks up our event queues once the table is registered
+}
+
+
+
+/**
+ * pdht_polling_pte_init -- sets up the pending put PTE and its pending queue for one PTE pair
+ * @param dht - hash table data structure
+ * @param ptindex - PTE pair to setup
+ */
+void pdht_polling_pte_init(pdht_t *dht, unsigned ptindex) {
   int ret;
   _pdht_ht_entry_t *hte;
   char *iter; // used for pointer math
+  unsigned first, n;
   ptl_me_t me;
-  int pentries = 0;
 
   // default match-list entry values
   me.length      = PDHT_MAXKEYSIZE + dht->elemsize; // storing key _and_ value for each entry
@@ -44,56 +61,47 @@ void pdht_polling_init(pdht_t *dht) {
   me.match_bits  = __PDHT_PENDING_MATCH; // this is ignored, each one of these is a wildcard
   me.ignore_bits = 0xffffffffffffffff; // ignore it all
 
-  // deal with multiple PTEs per hash table to handle match list length
-  for (int ptindex = 0; ptindex < dht->ptl.nptes; ptindex++) {
-
-    // allocate event queue for pending puts
-    ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &dht->ptl.eq[ptindex]);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_polling_init: PtlEQAlloc failure\n");
-      exit(1);
-    }
+  // allocate event queue for pending puts
+  ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &dht->ptl.eq[ptindex]);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_polling_pte_init: PtlEQAlloc failure\n");
+    exit(1);
+  }
 
-    // allocate PTE for pending put
-    ret = PtlPTAlloc(dht->ptl.lni, PTL_PT_ONLY_USE_ONCE | PTL_PT_FLOWCTRL,
-        dht->ptl.eq[ptindex], dht->ptl.putindex_base+ptindex, &dht->ptl.putindex[ptindex]);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_polling_init: PtlPTAlloc failure [%d] : %s\n", ptindex, pdht_ptl_error(ret));
-      exit(1);
-    }
-    //pdht_dprintf("%d: %d %d\n", ptindex, dht->ptl.putindex_base+ptindex, dht->ptl.putindex[ptindex]);
+  // allocate PTE for pending put
+  ret = PtlPTAlloc(dht->ptl.lni, PTL_PT_ONLY_USE_ONCE | PTL_PT_FLOWCTRL,
+      dht->ptl.eq[ptindex], dht->ptl.putindex_base+ptindex, &dht->ptl.putindex[ptindex]);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_polling_pte_init: PtlPTAlloc failure [%d] : %s\n", ptindex, pdht_ptl_error(ret));
+    exit(1);
+  }
+  //pdht_dprintf("%d: %d %d\n", ptindex, dht->ptl.putindex_base+ptindex, dht->ptl.putindex[ptindex]);
 
-    // iterator = ht[PTE * QSIZE] (i.e. PENDINGQ_SIZE per PTE)
-    iter = (char *)dht->ht + ((dht->pendq_size * ptindex) * dht->entrysize);  // pointer math
-    //pdht_dprintf("init append: ptindex: %d %d ht[%d] userp: %p\n", ptindex, dht->ptl.putindex[ptindex], pdht_find_bucket(dht, iter), iter);
+  // iterator = ht[first] (i.e. PENDINGQ_SIZE per PTE)
+  n = pdht_entry_claim(dht, dht->pendq_size, &first);
+  iter = (char *)dht->ht + (first * dht->entrysize);  // pointer math
+  //pdht_dprintf("init append: ptindex: %d %d ht[%d] userp: %p\n", ptindex, dht->ptl.putindex[ptindex], pdht_find_bucket(dht, iter), iter);
 
-    // append one-time match entres to the put PTE to catch incoming puts
-    for (int i=0; i < dht->pendq_size; i++) {
-      hte = (_pdht_ht_entry_t *)iter;
-      assert(hte->pme == PTL_INVALID_HANDLE);
-      assert(hte->ame == PTL_INVALID_HANDLE);
-      me.start  = &hte->key; // each entry has a unique memory buffer (starts with key)
+  // append one-time match entres to the put PTE to catch incoming puts
+  for (int i=0; i < n; i++) {
+    hte = (_pdht_ht_entry_t *)iter;
+    assert(hte->pme == PTL_INVALID_HANDLE);
+    assert(hte->ame == PTL_INVALID_HANDLE);
+    me.start  = &hte->key; // each entry has a unique memory buffer (starts with key)
 
-      //pdht_dprintf("init append: %d %d userp: %p\n", i, pdht_find_bucket(dht, hte), hte);
-      ret = PtlMEAppend(dht->ptl.lni, dht->ptl.putindex[ptindex], &me, PTL_PRIORITY_LIST, hte, &hte->pme);
-      if (ret != PTL_OK) {
-        pdht_dprintf("pdht_polling_init: [%d/%d]:ht[%d] PTE: %d PtlMEAppend error: %s\n", ptindex, i, pdht_find_bucket(dht,iter),dht->ptl.putindex[ptindex], pdht_ptl_error(ret));
-        pdht_dprintf("start %p len: %lu %d %d %8x %8x %8x\n", me.start, me.length, (me.ct_handle==PTL_CT_NONE), 
-            (me.uid==PTL_UID_ANY), me.options, me.match_bits, me.ignore_bits);
-        exit(1);
-      } 
-      pentries++;
-      // clean out the LINK events from the event queue
-      // PtlEQWait(dht->ptl.eq, &ev);
+    //pdht_dprintf("init append: %d %d userp: %p\n", i, pdht_find_bucket(dht, hte), hte);
+    ret = PtlMEAppend(dht->ptl.lni, dht->ptl.putindex[ptindex], &me, PTL_PRIORITY_LIST, hte, &hte->pme);
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_polling_pte_init: [%d/%d]:ht[%d] PTE: %d PtlMEAppend error: %s\n", ptindex, i, pdht_find_bucket(dht,iter),dht->ptl.putindex[ptindex], pdht_ptl_error(ret));
+      pdht_dprintf("start %p len: %lu %d %d %8x %8x %8x\n", me.start, me.length, (me.ct_handle==PTL_CT_NONE), 
+          (me.uid==PTL_UID_ANY), me.options, me.match_bits, me.ignore_bits);
+      exit(1);
+    } 
+    // clean out the LINK events from the event queue
+    // PtlEQWait(dht->ptl.eq, &ev);
 
-      iter += dht->entrysize; // pointer math, danger.
-    }
+    iter += dht->entrysize; // pointer math, danger.
   }
-
-  dht->nextfree = dht->ptl.nptes * dht->pendq_size; // free = DEFAULT_TABLE_SIZE - PENDINGQ_SIZE
-
-  pthread_create(&_pdht_poll_tid, NULL, pdht_poll, dht);
-  eprintf("XXX progress threads need fixed in polling model -- won't work with multiple dhts\n");  // admit defeat
 }
 
 
@@ -112,8 +120,7 @@ void pdht_polling_fini(pdht_t *dht) {
   for (int ptindex=0; ptindex < dht->ptl.nptes; ptindex++)
     PtlPTDisable(dht->ptl.lni, dht->ptl.putindex[ptindex]);
 
-  // wait for polling progress thread to exit
-  pthread_join(_pdht_poll_tid, NULL);
+  // progress engine has already dropped our event queues (pdht_progress_unregister)
 
   // kill off event queues
   for (int ptindex=0; ptindex < dht->ptl.nptes; ptindex++) {
@@ -156,126 +163,106 @@ void pdht_polling_fini(pdht_t *dht) {
   for (int ptindex=0; ptindex < dht->ptl.nptes; ptindex++)
     PtlPTFree(dht->ptl.lni, dht->ptl.putindex[ptindex]);
 
-  // release all storage for ht objects
-  free(dht->ht);
+  // release all storage for ht objects, shared entries are unmapped by pdht_shm_fini()
+  if (!dht->shm)
+    free(dht->ht);
 }
 
 
 
 /**
- * pdht_poll - runs periodic polling events
- * @param dht distributed hash table data structure
+ * pdht_poll_event - handles an event from a pending put queue (polling mode)
+ *   called by the progress thread that owns ptindex. only linking the put into
+ *   the active list takes the completion mutex, the replacement pending entry
+ *   is claimed and appended by the shard alone.
+ * @param dht - hash table data structure
+ * @param ev - event from the pending EQ of ptindex
+ * @param ptindex - PTE pair the event arrived on
  */
-void *pdht_poll(void *arg) {
-  pdht_t *dht = (pdht_t *)arg;
+void pdht_poll_event(pdht_t *dht, ptl_event_t *ev, unsigned ptindex) {
   _pdht_ht_entry_t *hte;
-  ptl_event_t ev;
   ptl_me_t me;
   char *index;
-  int ret;
-  unsigned int ptindex;
-  int pollcount = 0;
+  unsigned next;
+  int ret, placed;
 
-
-  // NOTE: we have one thread per DHT, we could re-write to handle _all_ 
-  //   polling activity in one thread, need to keep a list of "active" hts
-  //   and switch over to PtlEQPoll()
-  // XXX - this will cause pain in the future. TODO
+  PDHT_START_TIMER(dht,t5);
 
   // default match-list entry values
   me.length        = PDHT_MAXKEYSIZE + dht->elemsize; // storing HT key _and_ HT entry in each elem.
   me.ct_handle     = PTL_CT_NONE;
   me.uid           = PTL_UID_ANY;
-  // disable auto-unlink events, we just check for PUT completion
-  me.options       = PTL_ME_OP_GET 
-                   | PTL_ME_OP_PUT
-                   | PTL_ME_IS_ACCESSIBLE 
-                   | PTL_ME_EVENT_UNLINK_DISABLE;
   me.match_id.rank = PTL_RANK_ANY;
 
-  pdht_eprintf(PDHT_DEBUG_WARN, "Polling thread is active\n");
-
-
-  // need to run through the event queue for the putindex
-  while (!dht->gameover) {
- 
-    if ((ret = PtlEQPoll(dht->ptl.eq,dht->ptl.nptes, PTL_TIME_FOREVER, &ev, &ptindex)) == PTL_OK)  {
-      PDHT_START_TIMER(dht,t5);
-      // found something to do, is it something we care about?
-      if (ev.type == PTL_EVENT_PUT) {
-        pollcount++;
-        hte = (_pdht_ht_entry_t *)ev.user_ptr;
-        //eprintf("+");
+  // found something to do, is it something we care about?
+  if (ev->type == PTL_EVENT_PUT) {
+    hte = (_pdht_ht_entry_t *)ev->user_ptr;
 #ifdef PDHT_DEBUG_TRACE
-        pdht_dprintf("poll: key: %lu is pending queue bound for %d, new pending is: %d\n", *(unsigned long *)hte->key, pdht_find_bucket(dht, hte), dht->nextfree);
+    pdht_dprintf("poll: key: %lu is pending queue bound for %d, new pending is: %d\n", *(unsigned long *)hte->key, pdht_find_bucket(dht, hte), dht->nextfree);
 #endif  
 
-        // if get ME is inactive, then this is a new put()
-        if (PtlHandleIsEqual(hte->ame, PTL_INVALID_HANDLE)) {
-
-          //eprintf("processing key: %lu\n", (u_int64_t)be64toh(hte->key));
-          me.start         = &hte->key; // hte points to entire entry, start at key+val
-          me.options       = PTL_ME_OP_GET 
-                           | PTL_ME_IS_ACCESSIBLE 
-                           | PTL_ME_EVENT_UNLINK_DISABLE;
-          me.match_bits = ev.match_bits; // copy over match_bits from put
-          me.ignore_bits   = 0;
-
-          PDHT_START_TIMER(dht,t6);
-          // append this pending put to the active PTE match list
-          ret = PtlMEAppend(dht->ptl.lni, dht->ptl.getindex[ptindex], &me, PTL_PRIORITY_LIST, hte, &hte->ame);
-          if (ret != PTL_OK) {
-            pdht_dprintf("pdht_poll: ME append failed (active) [%d]: %s\n", pollcount, pdht_ptl_error(ret));
-            exit(1);
-          }
-          PDHT_STOP_TIMER(dht,t6);
-        } 
-
-        // setup ME entry to replace the one that was just consumed
-        index =  (char *)dht->ht;
-        index += (dht->nextfree * dht->entrysize); // pointer math, caution
-
-        hte = (_pdht_ht_entry_t *)index; // index into HT entry table
-        me.start       = &hte->key; // put stores key+val into ht
-        me.options     = PTL_ME_OP_PUT 
-                       | PTL_ME_USE_ONCE 
-                       | PTL_ME_IS_ACCESSIBLE 
-                       | PTL_ME_EVENT_UNLINK_DISABLE 
-                       | PTL_ME_EVENT_LINK_DISABLE;
-        me.match_bits  = __PDHT_PENDING_MATCH; // this is ignored, each one of these is a wildcard
-        me.ignore_bits = 0xffffffffffffffff; // ignore it all
-
+    pthread_mutex_lock(&dht->completion_mutex);
 
-        assert(dht->nextfree <= dht->maxentries);
+    // if get ME is inactive, then this is a new put()
+    placed = pdht_layout_place(dht, hte, ev->match_bits, ptindex);
+    if ((!placed) && (PtlHandleIsEqual(hte->ame, PTL_INVALID_HANDLE)))
+      placed = pdht_index_claim(dht, hte, ev->match_bits, ptindex, &me.match_bits) <= 0; // put's bits, unless they collide
 
-        //pdht_dprintf("append: %d %d userp: %p\n", dht->nextfree, pdht_find_bucket(dht, hte), hte);
+    if (placed) {
+      // bucketed and direct entries (and re-puts of linked keys) never get an ME of their own,
+      // count the append for fence
+      __atomic_add_fetch(&dht->stats.appends, 1, __ATOMIC_RELEASE);
+      __atomic_add_fetch(&dht->stats.tappends[ptindex], 1, __ATOMIC_RELAXED);
 
-        PDHT_START_TIMER(dht,t6);
-        // add replacement entry to put/pending ME
-        ret = PtlMEAppend(dht->ptl.lni, dht->ptl.putindex[ptindex], &me, PTL_PRIORITY_LIST, hte, &hte->pme);
-        if (ret != PTL_OK) {
-          pdht_dprintf("append: ptindex: %d pollcount: %d %d %d userp: %p\n", ptindex, pollcount, dht->nextfree, pdht_find_bucket(dht, hte), hte);
-          pdht_dprintf("pdht_poll: PtlMEAppend error (pending): %s\n", pdht_ptl_error(ret));
-        }
+    } else if (PtlHandleIsEqual(hte->ame, PTL_INVALID_HANDLE)) {
 
-        PDHT_STOP_TIMER(dht,t6);
+      me.start         = &hte->key; // hte points to entire entry, start at key+val
+      me.options       = PTL_ME_OP_GET 
+                       | PTL_ME_IS_ACCESSIBLE 
+                       | PTL_ME_EVENT_UNLINK_DISABLE;
+      me.ignore_bits   = 0;
 
-        dht->nextfree++; // update next free space in local HT table
-      } else {
-        pdht_dprintf("pdht_poll: got event for %s\n", pdht_event_to_string(ev.type));
-        pdht_dprintf("pdht_poll: pollcount: %d\n", pollcount);
-        pdht_dump_event(&ev);
+      PDHT_START_TIMER(dht,t6);
+      // append this pending put to the active PTE match list
+      ret = PtlMEAppend(dht->ptl.lni, dht->ptl.getindex[ptindex], &me, PTL_PRIORITY_LIST, hte, &hte->ame);
+      if (ret != PTL_OK) {
+        pdht_dprintf("pdht_poll_event: ME append failed (active): %s\n", pdht_ptl_error(ret));
+        exit(1);
       }
-    } else {
-      // check for other problems
-      pdht_dprintf("pdht_poll: event queue issue: %s\n", pdht_ptl_error(ret));
-    }
-    PDHT_STOP_TIMER(dht,t5);
+      PDHT_STOP_TIMER(dht,t6);
+    } 
 
-    // count up link events from appending things to the active queue
-    pthread_mutex_lock(&dht->completion_mutex);
-    pdht_finalize_puts(dht);
     pthread_mutex_unlock(&dht->completion_mutex);
+
+    // setup ME entry to replace the one that was just consumed
+    if (pdht_entry_claim(dht, 1, &next) == 0) {
+      PDHT_STOP_TIMER(dht,t5);
+      return; // table is full, pending queue shrinks
+    }
+    index =  (char *)dht->ht;
+    index += (next * dht->entrysize); // pointer math, caution
+
+    hte = (_pdht_ht_entry_t *)index; // index into HT entry table
+    me.start       = &hte->key; // put stores key+val into ht
+    me.options     = PTL_ME_OP_PUT 
+                   | PTL_ME_USE_ONCE 
+                   | PTL_ME_IS_ACCESSIBLE 
+                   | PTL_ME_EVENT_UNLINK_DISABLE 
+                   | PTL_ME_EVENT_LINK_DISABLE;
+    me.match_bits  = __PDHT_PENDING_MATCH; // this is ignored, each one of these is a wildcard
+    me.ignore_bits = 0xffffffffffffffff; // ignore it all
+
+    PDHT_START_TIMER(dht,t6);
+    // add replacement entry to put/pending ME
+    ret = PtlMEAppend(dht->ptl.lni, dht->ptl.putindex[ptindex], &me, PTL_PRIORITY_LIST, hte, &hte->pme);
+    if (ret != PTL_OK) {
+      pdht_dprintf("append: ptindex: %d %d %d userp: %p\n", ptindex, next, pdht_find_bucket(dht, hte), hte);
+      pdht_dprintf("pdht_poll_event: PtlMEAppend error (pending): %s\n", pdht_ptl_error(ret));
+    }
+    PDHT_STOP_TIMER(dht,t6);
+  } else {
+    pdht_dprintf("pdht_poll_event: got event for %s\n", pdht_event_to_string(ev->type));
+    pdht_dump_event(ev);
   }
-  return NULL;
+  PDHT_STOP_TIMER(dht,t5);
 }
@@ -0,0 +1,558 @@
+/********************************************************/
+/*                                                      */
+/*  progress.c - PDHT progress engine                   */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <time.h>
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table progress engine
+ *
+ * a small pool of threads serves every table. the PTEs are sharded across
+ * the pool (PTE i of every table belongs to thread i % progress_threads),
+ * and each thread waits on the pending (put) and active (get) event queues
+ * of its shard with one PtlEQPoll(), so adding tables adds queues to the
+ * poll sets rather than threads or polling passes. the completion queue of
+ * a table's callback-based async ops (async.c) is served the same way, by
+ * thread (table index % progress_threads).
+ *
+ * a shard refills its own pending queues, a chunk per event and on quiet
+ * polls, toward a headroom that follows the recent arrival rate (see
+ * pdht_trig_refill()). replacement entries are claimed from the table with
+ * pdht_entry_claim(), so only work on shared table state
+ * (linking a put, collision index, bucket/direct placement) goes through the
+ * table's completion mutex and target-side inserts scale with the pool.
+ *
+ * when events stop arriving a thread spins through a budget of empty
+ * polls before blocking. the budget grows when events show up right after
+ * the thread blocked (bursty traffic) and shrinks when blocking times out,
+ * so an idle process gives its cores back to the application.
+ *
+ * with PdhtProgressManual no threads are started at all. the application
+ * calls pdht_progress() from its own loop, and blocking operations drive
+ * progress while they wait (pdht_progress_ct_wait()), so a fully subscribed
+ * node keeps every core and avoids the scheduling jitter of a polling thread.
+ */
+
+// where an event queue in the poll set came from
+enum _pdht_progress_kind_e {
+  PdhtSrcPending, // pending (PUT) queue of a PTE
+  PdhtSrcActive,  // active (LINK/SEARCH) queue of a PTE
+  PdhtSrcAsync    // completions of the table's callback-based async ops
+};
+struct _pdht_progress_src_s {
+  pdht_t   *dht;
+  unsigned  ptindex;
+  enum _pdht_progress_kind_e kind;
+};
+typedef struct _pdht_progress_src_s _pdht_progress_src_t;
+
+// one progress thread and the shard of event queues it polls
+struct _pdht_progress_thread_s {
+  pthread_t             tid;
+  unsigned              id;
+  unsigned              seen; // last generation this thread rebuilt its EQ set for
+  unsigned              neqs;
+  ptl_handle_eq_t       eqs[PDHT_MAX_TABLES * ((2 * PDHT_MAX_PTES) + 1)];
+  _pdht_progress_src_t  srcs[PDHT_MAX_TABLES * ((2 * PDHT_MAX_PTES) + 1)];
+};
+typedef struct _pdht_progress_thread_s _pdht_progress_thread_t;
+
+static _pdht_progress_thread_t *_pdht_progress_threads = NULL;
+static pthread_rwlock_t         _pdht_progress_lock; // guards c->hts[] against the progress threads
+static pthread_mutex_t          _pdht_progress_manual = PTHREAD_MUTEX_INITIALIZER; // one app thread drives progress at a time
+
+__thread int _pdht_in_progress = 0; // calling thread is driving the progress engine (async callbacks)
+
+static void *pdht_progress_thread(void *arg);
+static void pdht_progress_event(pdht_t *dht, ptl_event_t *ev, _pdht_progress_src_t *src);
+static int pdht_progress_drain(pdht_t *dht, ptl_handle_eq_t eq, _pdht_progress_src_t *src);
+static int pdht_progress_table(pdht_t *dht);
+static void pdht_progress_build(_pdht_progress_thread_t *self);
+static int  pdht_progress_idle(_pdht_progress_thread_t *self);
+static int pdht_progress_registered(pdht_t *dht);
+static void pdht_progress_pin(_pdht_progress_thread_t *self);
+
+
+
+/**
+ * pdht_progress_init - sets up progress engine state, called once from pdht_init()
+ * @param cfg - PDHT configuration
+ */
+void pdht_progress_init(pdht_config_t *cfg) {
+  pthread_rwlockattr_t attr;
+
+  // table create/free must not starve behind a busy pool of readers
+  pthread_rwlockattr_init(&attr);
+  pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+  pthread_rwlock_init(&_pdht_progress_lock, &attr);
+  pthread_rwlockattr_destroy(&attr);
+
+  c->progress_gen     = 0;
+  c->progress_run     = 0;
+  c->progress_spin    = cfg->progress_spin;
+  c->progress_cpu     = cfg->progress_cpu;
+  c->progress_threads = cfg->progress_threads;
+  c->progress_manual  = (cfg->progmode == PdhtProgressManual);
+
+  // the application drives progress itself, no threads to set up
+  if (c->progress_manual) {
+    c->progress_threads = 0;
+    return;
+  }
+
+  _pdht_progress_threads = calloc(c->progress_threads, sizeof(_pdht_progress_thread_t));
+  if (!_pdht_progress_threads) {
+    pdht_dprintf("pdht_progress_init: calloc error: %s\n", strerror(errno));
+    exit(1);
+  }
+  for (unsigned t=0; t < c->progress_threads; t++)
+    _pdht_progress_threads[t].id = t;
+}
+
+
+
+/**
+ * pdht_progress_fini - releases progress engine state, called once from pdht_fini()
+ *   all tables (and with them the progress threads) are gone by now
+ */
+void pdht_progress_fini(void) {
+  free(_pdht_progress_threads);
+  _pdht_progress_threads = NULL;
+  pthread_rwlock_destroy(&_pdht_progress_lock);
+}
+
+
+
+/**
+ * pdht_progress_register - hands a fully initialized table to the progress engine
+ *   starts the progress threads with the first table
+ * @param dht - hash table data structure
+ */
+void pdht_progress_register(pdht_t *dht) {
+  int ret;
+
+  pthread_rwlock_wrlock(&_pdht_progress_lock);
+  c->hts[c->dhtcount++] = dht;
+  pdht_progress_changed();
+
+  if ((!c->progress_run) && (!c->progress_manual)) {
+    c->progress_run = 1;
+    for (unsigned t=0; t < c->progress_threads; t++) {
+      _pdht_progress_threads[t].seen = c->progress_gen - 1; // force the first build
+      ret = pthread_create(&_pdht_progress_threads[t].tid, NULL, pdht_progress_thread, &_pdht_progress_threads[t]);
+      if (ret != 0) {
+        pdht_dprintf("pdht_progress_register: cannot spawn progress thread %u: %s\n", t, strerror(ret));
+        exit(1);
+      }
+    }
+  }
+  pthread_rwlock_unlock(&_pdht_progress_lock);
+}
+
+
+
+/**
+ * pdht_progress_unregister - removes a table from the progress engine
+ *   stops the progress threads with the last table. once this returns, no
+ *   progress thread will touch dht again.
+ * @param dht - hash table data structure
+ */
+void pdht_progress_unregister(pdht_t *dht) {
+  struct timespec ts = { 0, 100000 }; // 100us
+  unsigned gen;
+  int i, last;
+
+  pthread_rwlock_wrlock(&_pdht_progress_lock);
+  for (i=0; (i < c->dhtcount) && (c->hts[i] != dht); i++)
+    ; // find this ht
+  for ( ; i < c->dhtcount - 1; i++)
+    c->hts[i] = c->hts[i+1]; // shuffle everybody down
+  c->dhtcount--;
+  dht->gameover = 1;
+  pdht_progress_changed();
+  gen = c->progress_gen;
+
+  last = (c->dhtcount == 0) && c->progress_run;
+  if (last)
+    c->progress_run = 0; // threads exit on their next pass
+  pthread_rwlock_unlock(&_pdht_progress_lock);
+
+  if (last) {
+    for (unsigned t=0; t < c->progress_threads; t++)
+      pthread_join(_pdht_progress_threads[t].tid, NULL);
+    return;
+  }
+
+  // our queues are about to be freed, wait until no thread polls them anymore
+  // (with manual progress the write lock already kept pdht_progress() out)
+  for (unsigned t=0; t < c->progress_threads; t++) {
+    while ((int)(__atomic_load_n(&_pdht_progress_threads[t].seen, __ATOMIC_ACQUIRE) - gen) < 0)
+      nanosleep(&ts, NULL);
+  }
+}
+
+
+
+/**
+ * pdht_progress_changed - tells the progress threads to rebuild their event queue sets
+ *   safe to call with a table's completion mutex held (e.g. PTE scaling)
+ */
+void pdht_progress_changed(void) {
+  __sync_fetch_and_add(&c->progress_gen, 1);
+}
+
+
+
+/**
+ * pdht_progress - drives progress on a table from the application (PdhtProgressManual)
+ *   services whatever is waiting on the table's event queues and tops up its
+ *   pending queues, then returns without blocking. safe to call from several
+ *   threads, only one of them does the work at a time. a no-op when progress
+ *   threads are running.
+ * @param dht - hash table data structure, NULL for every table
+ * @returns number of events handled
+ */
+int pdht_progress(pdht_t *dht) {
+  pdht_t *t;
+  int n = 0;
+
+  if (!c->progress_manual)
+    return 0;
+
+  // somebody else is already driving progress (or we are, further up the stack)
+  if (pthread_mutex_trylock(&_pdht_progress_manual) != 0)
+    return 0;
+
+  pthread_rwlock_rdlock(&_pdht_progress_lock);
+  _pdht_in_progress = 1;
+  for (int i=0; i < c->dhtcount; i++) {
+    t = c->hts[i];
+    if ((!dht) || (t == dht))
+      n += pdht_progress_table(t);
+  }
+  _pdht_in_progress = 0;
+  pthread_rwlock_unlock(&_pdht_progress_lock);
+
+  pthread_mutex_unlock(&_pdht_progress_manual);
+  return n;
+}
+
+
+
+/**
+ * pdht_progress_ct_wait - PtlCTWait() for blocking operations
+ *   with PdhtProgressManual nobody else serves our event queues, so poll the
+ *   counter and drive progress on every table while waiting.
+ * @param ct - counter to wait on
+ * @param test - wait until success + failure reaches this
+ * @param event - counter value on return
+ * @returns Portals status
+ */
+int pdht_progress_ct_wait(ptl_handle_ct_t ct, ptl_size_t test, ptl_ct_event_t *event) {
+  int ret;
+
+  if (!c->progress_manual)
+    return PtlCTWait(ct, test, event);
+
+  while (1) {
+    ret = PtlCTGet(ct, event);
+    if ((ret != PTL_OK) || ((event->success + event->failure) >= test))
+      return ret;
+    if (pdht_progress(NULL) == 0)
+      sched_yield();
+  }
+}
+
+
+
+/**
+ * pdht_progress_yield - one pass of a spin-wait on something the progress engine delivers
+ */
+void pdht_progress_yield(void) {
+  if (pdht_progress(NULL) == 0)
+    sched_yield();
+}
+
+
+
+/**
+ * pdht_progress_thread - progress thread, serves one shard of the PTEs
+ * @param arg - this thread's _pdht_progress_thread_t
+ */
+static void *pdht_progress_thread(void *arg) {
+  _pdht_progress_thread_t *self = arg;
+  struct timespec ts = { 0, PDHT_PROGRESS_BLOCK_MS * 1000000 };
+  _pdht_progress_src_t *src;
+  ptl_event_t ev;
+  unsigned gen, which;
+  unsigned spinmax = c->progress_spin, spins = 0;
+  ptl_time_t timeout;
+  int ret, blocked;
+
+  pdht_progress_pin(self);
+  pdht_eprintf(PDHT_DEBUG_WARN, "Progress thread %u is active\n", self->id);
+  _pdht_in_progress = 1;
+
+  gen = self->seen;
+
+  while (1) {
+    if (gen != c->progress_gen) {
+      pthread_rwlock_rdlock(&_pdht_progress_lock);
+      if (!c->progress_run) {
+        pthread_rwlock_unlock(&_pdht_progress_lock);
+        break;
+      }
+      gen = c->progress_gen;
+      pdht_progress_build(self);
+      __atomic_store_n(&self->seen, gen, __ATOMIC_RELEASE);
+      pthread_rwlock_unlock(&_pdht_progress_lock);
+    }
+
+    // more threads than PTEs, nothing to serve until the PTE set grows
+    if (self->neqs == 0) {
+      nanosleep(&ts, NULL);
+      continue;
+    }
+
+    // spin with zero timeouts while there is budget left, then block
+    blocked = (spins == 0);
+    timeout = blocked ? PDHT_PROGRESS_BLOCK_MS : 0;
+
+    ret = PtlEQPoll(self->eqs, self->neqs, timeout, &ev, &which);
+
+    if (ret == PTL_OK) {
+      // woken up right after blocking, traffic is bursty enough to spin longer
+      if (blocked)
+        spinmax = (2*spinmax + 1) < c->progress_spin ? (2*spinmax + 1) : c->progress_spin;
+      spins = spinmax;
+
+      pthread_rwlock_rdlock(&_pdht_progress_lock);
+      src = &self->srcs[which];
+
+      // the table may have gone away between the poll and here
+      if (pdht_progress_registered(src->dht))
+        pdht_progress_event(src->dht, &ev, src);
+      pthread_rwlock_unlock(&_pdht_progress_lock);
+
+    } else if ((ret == PTL_EQ_EMPTY) || (ret == PTL_INTERRUPTED)) {
+      if (blocked)
+        spinmax /= 2; // nothing arrived in a whole block period, spin less
+      else
+        spins--;
+
+      // quiet pass, catch up on pending queue refills and deferred callbacks
+      if (pdht_progress_idle(self) && (spins == 0))
+        spins = 1; // async work only shows up on quiet passes, don't block on it
+
+    } else {
+      pdht_dprintf("pdht_progress_thread: PtlEQPoll error: %s\n", pdht_ptl_error(ret));
+      gen = c->progress_gen - 1; // queues may have been freed, rebuild
+    }
+  }
+  return NULL;
+}
+
+
+
+/**
+ * pdht_progress_event - hands an event to its layer
+ *   must be called by the owner of the queue with the progress lock held
+ * @param dht - hash table data structure
+ * @param ev - event from one of the table's queues
+ * @param src - queue the event came from
+ */
+static void pdht_progress_event(pdht_t *dht, ptl_event_t *ev, _pdht_progress_src_t *src) {
+  switch (src->kind) {
+    case PdhtSrcActive:
+      pdht_active_event(dht, ev, src->ptindex); // locks what it shares
+      break;
+    case PdhtSrcAsync:
+      pdht_async_event(dht, ev);
+      pdht_async_deliver(dht);
+      return;
+    case PdhtSrcPending:
+    default:
+      if (dht->pmode == PdhtPendingPoll)
+        pdht_poll_event(dht, ev, src->ptindex); // locks what it shares
+      else
+        pdht_trig_event(dht, ev, src->ptindex);
+      break;
+  }
+
+  // consumed pending entries are replaced a chunk at a time by the owning shard
+  if (dht->pmode == PdhtPendingTrig)
+    pdht_trig_refill(dht, src->ptindex);
+}
+
+
+
+/**
+ * pdht_progress_table - drives all of a table's queues from the application (PdhtProgressManual)
+ *   must be called with the progress lock and the manual progress mutex held
+ * @param dht - hash table data structure
+ * @returns number of events and callbacks handled
+ */
+static int pdht_progress_table(pdht_t *dht) {
+  _pdht_progress_src_t src = { dht, 0, PdhtSrcPending };
+  int n = 0, quiet;
+
+  for (src.ptindex=0; src.ptindex < dht->ptl.nptes; src.ptindex++) {
+    src.kind = PdhtSrcPending;
+    quiet  = (pdht_progress_drain(dht, dht->ptl.eq[src.ptindex], &src) == 0);
+    src.kind = PdhtSrcActive;
+    quiet &= (pdht_progress_drain(dht, dht->ptl.aeq[src.ptindex], &src) == 0);
+    n += !quiet;
+
+    // same as a quiet pass of a progress thread
+    if (quiet && (dht->pmode == PdhtPendingTrig))
+      pdht_trig_refill(dht, src.ptindex);
+  }
+
+  src.ptindex = 0;
+  src.kind = PdhtSrcAsync;
+  n += pdht_progress_drain(dht, dht->ptl.asynceq, &src);
+  n += pdht_async_deliver(dht);
+  return n;
+}
+
+
+
+/**
+ * pdht_progress_drain - handles a bounded batch of waiting events from one queue
+ * @param dht - hash table data structure
+ * @param eq - event queue to drain
+ * @param src - what the queue belongs to
+ * @returns number of events handled
+ */
+static int pdht_progress_drain(pdht_t *dht, ptl_handle_eq_t eq, _pdht_progress_src_t *src) {
+  ptl_event_t ev;
+  int n, ret;
+
+  for (n=0; n < PDHT_PROGRESS_BATCH; n++) {
+    ret = PtlEQGet(eq, &ev);
+    if (ret == PTL_EQ_EMPTY)
+      break;
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_progress: PtlEQGet error: %s\n", pdht_ptl_error(ret));
+      break;
+    }
+    pdht_progress_event(dht, &ev, src);
+  }
+  return n;
+}
+
+
+
+/**
+ * pdht_progress_build - collects the event queues of this thread's shard of all registered tables
+ *   must be called with the progress lock held
+ * @param self - progress thread
+ */
+static void pdht_progress_build(_pdht_progress_thread_t *self) {
+  unsigned n = 0;
+  pdht_t *dht;
+
+  for (int i=0; i < c->dhtcount; i++) {
+    dht = c->hts[i];
+    for (unsigned ptindex=self->id; ptindex < dht->ptl.nptes; ptindex += c->progress_threads) {
+      self->eqs[n]          = dht->ptl.eq[ptindex];
+      self->srcs[n].dht     = dht;
+      self->srcs[n].ptindex = ptindex;
+      self->srcs[n].kind    = PdhtSrcPending;
+      n++;
+
+      self->eqs[n]          = dht->ptl.aeq[ptindex];
+      self->srcs[n].dht     = dht;
+      self->srcs[n].ptindex = ptindex;
+      self->srcs[n].kind    = PdhtSrcActive;
+      n++;
+    }
+
+    // async completions of table i go to thread i % progress_threads
+    if ((i % c->progress_threads) == self->id) {
+      self->eqs[n]          = dht->ptl.asynceq;
+      self->srcs[n].dht     = dht;
+      self->srcs[n].ptindex = 0;
+      self->srcs[n].kind    = PdhtSrcAsync;
+      n++;
+    }
+  }
+  self->neqs = n;
+}
+
+
+
+/**
+ * pdht_progress_idle - quiet pass work: tops up triggered pending queues and runs deferred callbacks
+ * @param self - progress thread
+ * @returns 1 if a table still has async ops outside the poll set (direct reads, backoffs)
+ */
+static int pdht_progress_idle(_pdht_progress_thread_t *self) {
+  _pdht_progress_src_t *src;
+  int waiting = 0;
+
+  pthread_rwlock_rdlock(&_pdht_progress_lock);
+  for (unsigned i=0; i < self->neqs; i++) {
+    src = &self->srcs[i];
+    if ((src->kind == PdhtSrcActive) || (!pdht_progress_registered(src->dht)))
+      continue;
+    if (src->kind == PdhtSrcAsync) {
+      pdht_async_deliver(src->dht);
+      waiting |= (__atomic_load_n(&src->dht->asyncwait, __ATOMIC_RELAXED) != 0);
+    } else if (src->dht->pmode == PdhtPendingTrig)
+      pdht_trig_refill(src->dht, src->ptindex);
+  }
+  pthread_rwlock_unlock(&_pdht_progress_lock);
+  return waiting;
+}
+
+
+
+/**
+ * pdht_progress_registered - checks that a table is still served by the engine
+ *   must be called with the progress lock held
+ */
+static int pdht_progress_registered(pdht_t *dht) {
+  for (int i=0; i < c->dhtcount; i++) {
+    if (c->hts[i] == dht)
+      return 1;
+  }
+  return 0;
+}
+
+
+
+/**
+ * pdht_progress_pin - binds a progress thread to its CPU (progress_cpu + thread id)
+ * @param self - progress thread
+ */
+static void pdht_progress_pin(_pdht_progress_thread_t *self) {
+  cpu_set_t cpus;
+  int cpu = c->progress_cpu + self->id;
+  int ret;
+
+  if (c->progress_cpu < 0)
+    return;
+
+  if (cpu >= CPU_SETSIZE) {
+    pdht_eprintf(PDHT_DEBUG_WARN, "pdht_progress: CPU %d out of range, progress thread %u not pinned\n", cpu, self->id);
+    return;
+  }
+
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (ret != 0)
+    pdht_eprintf(PDHT_DEBUG_WARN, "pdht_progress: unable to pin progress thread %u to CPU %d: %s\n",
+                 self->id, cpu, strerror(ret));
+}
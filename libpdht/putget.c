@@ -22,8 +22,7 @@ extern int gstateflag;
 // local-only discriminator for add/update/put operations
 typedef enum { PdhtPTQPending, PdhtPTQActive } pdht_ptq_t;
 static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdht_ptq_t which);
-static void pdht_keystr(void *key, char* str);
-static void pdht_dump_entry(pdht_t *dht, void *exp, void *act);
+static pdht_status_t pdht_get_bits(pdht_t *dht, void *key, ptl_match_bits_t mbits, uint32_t ptindex, ptl_process_t rank, char *buf, ptl_size_t len);
 
 /**
  * pdht_put - puts or overwrites an entry in the global hash table
@@ -33,11 +32,12 @@ static void pdht_dump_entry(pdht_t *dht, void *exp, void *act);
  *   @returns status of operation
  */
 static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdht_ptq_t which) {
-  ptl_match_bits_t mbits; 
+  ptl_match_bits_t mbits, lbits; 
   ptl_process_t rank;
   uint32_t ptindex;
   ptl_size_t loffset;
   ptl_size_t lsize;
+  ptl_size_t roffset = 0;
   ptl_ct_event_t ctevent, current, reset;
   ptl_event_t fault;
   ptl_pt_index_t ptl_pt_index;
@@ -45,15 +45,31 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
   ptl_me_t *mep;
   char *valp, *kval;
   pdht_status_t rval = PdhtStatusOK;
+  pdht_tctx_t *tc = pdht_tctx(dht);
   struct timespec ts;
 
   PDHT_START_TIMER(dht, ptimer);
 
   // 1. hash key -> rank + match bits + element
-  dht->hashfn(dht, key, &mbits, &ptindex, &rank);
+  pdht_hashkey(dht, key, &mbits, &ptindex, &rank);
 
   dht->stats.rankputs[rank.rank]++;
 
+  // remote updates find the ME (or slot) holding the key first: a put under the
+  // primary bits alone would overwrite whatever other key is linked there
+  if ((which == PdhtPTQActive) && (rank.rank != (ptl_rank_t)c->rank)) {
+    rval = pdht_locate(dht, key, mbits, ptindex, rank, &lbits, &roffset, alloca(PDHT_MAXKEYSIZE + dht->elemsize));
+    if (rval != PdhtStatusOK)
+      goto done;
+    if (lbits == __PDHT_DIRECT_BITS) {
+      // only the owner writes direct slots (versioned, so readers never see a torn value),
+      // a re-put would only land at the next fence, so say so rather than claim it is done
+      rval = PdhtStatusError;
+      goto done;
+    }
+    mbits = lbits;
+  }
+
   // 1.5 figure out what we need to send to far end
   //   - send just HT element usually, need to also send
   //     match bits for triggered-only updates
@@ -107,16 +123,29 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
   // find out which ME queue we're off too...
   if (which == PdhtPTQPending) {
     ptl_pt_index = dht->ptl.putindex[ptindex];  // put/add to pending
-    dht->stats.pendputs++;
+    __atomic_add_fetch(&dht->stats.pendputs, 1, __ATOMIC_RELAXED); // any thread may put
   } else {
     ptl_pt_index = dht->ptl.getindex[ptindex];  // update to active
   }
 
   // handle local updates
-  if ((rank.rank == c->rank) && (which == PdhtPTQActive)) {
+  if ((rank.rank == (ptl_rank_t)c->rank) && (which == PdhtPTQActive)) {
     ptl_me_t me;
     void *pt;
 
+    // bucketed and direct entries have no ME of their own to search for
+    if (dht->layout != PdhtLayoutEntry) {
+      pthread_mutex_lock(&dht->completion_mutex);
+      pt = pdht_layout_find(dht, key, mbits, ptindex);
+      if (pt && (dht->layout == PdhtLayoutDirect))
+        pdht_direct_store(dht, pt, value); // versioned, initiators may be reading the slot
+      else if (pt)
+        memcpy(pt + PDHT_MAXKEYSIZE, value, dht->elemsize); // pointer math
+      pthread_mutex_unlock(&dht->completion_mutex);
+      if (pt)
+        goto done;
+    }
+
     me.start         = NULL;
     me.length        = PDHT_MAXKEYSIZE + dht->elemsize; // storing HT key & entry in each elem.
     me.ct_handle     = PTL_CT_NONE;
@@ -126,40 +155,45 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
     me.match_bits    = mbits;
     me.ignore_bits   = 0;
 
-    pthread_mutex_lock(&dht->local_gets_flag_mutex);
-    dht->local_get_flag = 0;
-    pthread_mutex_unlock(&dht->local_gets_flag_mutex);
+    tc->search_flag = 0;
 
-    PtlMESearch(dht->ptl.lni, dht->ptl.getindex[ptindex],&me,PTL_ACTIVE_SEARCH_ONLY,&pt);
+    PtlMESearch(dht->ptl.lni, dht->ptl.getindex[ptindex],&me,PTL_ACTIVE_SEARCH_ONLY,tc);
 
-    pthread_mutex_lock(&dht->completion_mutex);
-    if (dht->local_get_flag == 0){
-      pdht_finalize_puts(dht);
-    }
-    pthread_mutex_unlock(&dht->completion_mutex);
+    // the progress engine serving this PTE drops the result into our context
+    while (__atomic_load_n(&tc->search_flag, __ATOMIC_ACQUIRE) == 0)
+      pdht_progress_yield();
+    pt = tc->search;
 
-    if (dht->local_get_flag == -1){
+    if (tc->search_flag == -1){
       dht->stats.notfound++;
       rval = PdhtStatusNotFound;
       goto done;
     }
 
-    if (memcmp(pt, key, dht->keysize) != 0) {
-      // keys don't match, this must be a collision
-      dht->stats.collisions++;
-      pdht_dprintf("pdht_put: found local collision. %d\n");
-      //pdht_dump_entry(dht, key, buf);
-      rval = PdhtStatusCollision;
-      goto done;
+    if ((!pt) || (memcmp(pt, key, dht->keysize) != 0)) {
+      // chain marker or another key under the same bits, walk the collision chain
+      pthread_mutex_lock(&dht->completion_mutex);
+      pt = pdht_index_find(dht, key, mbits);
+      pthread_mutex_unlock(&dht->completion_mutex);
+      if (pt)
+        pt = pdht_entry_key(dht, pt); // index hands back the entry, the search hands back its key
+      if (!pt) {
+        dht->stats.notfound++;
+        rval = PdhtStatusNotFound;
+        goto done;
+      }
     }
+    // same-node ranks may be reading the entry out of our segment
+    pdht_shm_write_begin(dht);
     memcpy(pt + PDHT_MAXKEYSIZE, value, dht->elemsize); // pointer math
+    pdht_shm_write_end(dht);
 
     goto done;
   }
 
-  PtlCTGet(dht->ptl.lmdct, &dht->ptl.curcounts);
-  current = dht->ptl.curcounts;
-  //pdht_dprintf("pdht_put: pre: success: %lu fail: %lu\n", dht->ptl.curcounts.success, dht->ptl.curcounts.failure);
+  PtlCTGet(tc->lmdct, &tc->curcounts);
+  current = tc->curcounts;
+  //pdht_dprintf("pdht_put: pre: success: %lu fail: %lu\n", tc->curcounts.success, tc->curcounts.failure);
 
   // may have to re-attempt put if we run into flow control, repeat until successful
   do { 
@@ -167,8 +201,8 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
     toobusy = 0; // default is to only repeat once
 
     // put hash entry on target
-    ret = PtlPut(dht->ptl.lmd, loffset, lsize, PTL_ACK_REQ, rank, ptl_pt_index,
-        mbits, 0, value, 0);
+    ret = PtlPut(tc->lmd, loffset, lsize, PTL_ACK_REQ, rank, ptl_pt_index,
+        mbits, roffset, value, 0);
     if (ret != PTL_OK) {
       pdht_dprintf("pdht_put: PtlPut(key: %lu, rank: %d, ptindex: %d) failed: %s\n",
           *(long *)key, rank.rank, dht->ptl.putindex[ptindex], pdht_ptl_error(ret));
@@ -177,7 +211,7 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
 
 
     // wait for local completion
-    ret = PtlCTWait(dht->ptl.lmdct, current.success+1, &ctevent);
+    ret = pdht_progress_ct_wait(tc->lmdct, current.success+1, &ctevent);
     if (ret != PTL_OK) {
       pdht_dprintf("pdht_put: PtlCTWait() failed\n");
       goto error;
@@ -189,17 +223,29 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
 
     // check for errors
     if (ctevent.failure > current.failure) {
-      ret = PtlEQWait(dht->ptl.lmdeq, &fault);
+      ret = PtlEQWait(tc->lmdeq, &fault);
 
       if (ret == PTL_OK) {
 
-        if (fault.ni_fail_type == PTL_NI_PT_DISABLED) {
+        if ((fault.ni_fail_type == PTL_NI_OP_VIOLATION) && (which == PdhtPTQActive)) {
+          // update hit a collision chain marker, find the probe slot holding our key
+          reset.success = 0;
+          reset.failure = -1;
+          PtlCTInc(tc->lmdct, reset); // reset failure count
+          rval = pdht_probe(dht, key, mbits, ptindex, rank, &mbits, alloca(PDHT_MAXKEYSIZE + dht->elemsize));
+          if (rval != PdhtStatusOK)
+            goto done;
+          PtlCTGet(tc->lmdct, &current);
+          tc->curcounts = current;
+          toobusy = 1; // retry put against the probe slot
+        } else if (fault.ni_fail_type == PTL_NI_PT_DISABLED) {
           // flow control event generated only on initial drop
           if (!_pdht_flow_control_warning) {
             pdht_dprintf("pdht_put: flow control on remote rank: %d : %d\n", rank, dht->stats.puts);
             _pdht_flow_control_warning = 1;
           }
-          PtlCTGet(dht->ptl.lmdct, &current);
+          PtlCTGet(tc->lmdct, &current);
+          pdht_progress(NULL); // with manual progress, keep serving our own queues while we back off
           ts.tv_sec = 0;
           ts.tv_nsec = 10000000; // 10ms
           nanosleep(&ts, NULL);
@@ -207,7 +253,7 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
           toobusy = 1; // reset loop sentinel
           reset.success = 0;
           reset.failure = -1;
-          PtlCTInc(dht->ptl.lmdct, reset); // reset failure count
+          PtlCTInc(tc->lmdct, reset); // reset failure count
         } else { // if (fault.ni_fail_type != PTL_NI_OK) {
           pdht_dprintf("pdht_put: found fail event: %s\n", pdht_event_to_string(fault.type));
           pdht_dump_event(&fault);
@@ -219,10 +265,11 @@ static inline pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value, pdh
         }
       }
 
-    if (again && (ctevent.success == dht->ptl.curcounts.success)) {
+    if (again && (ctevent.success == tc->curcounts.success)) {
         //pdht_dprintf("pdht_put: (again) flow control on remote rank: %d : %d\n", rank, dht->stats.puts);
-        PtlCTGet(dht->ptl.lmdct, &current);
+        PtlCTGet(tc->lmdct, &current);
         //pdht_dprintf("pdht_put: post (again): success: %lu fail: %lu\n", current.success, current.failure);
+        pdht_progress(NULL);
         nanosleep(&ts, NULL);
         toobusy = 1; // reset loop sentinel
       }
@@ -270,13 +317,28 @@ error:
 
   /**
    * pdht_update - overwrites an entry in the global hash table
+   *   with the direct layout, keys held in another rank's slots can't be updated
+   *   in place (PdhtStatusError), pdht_put() them instead, visible after pdht_fence()
    *   @param key - hash table key
    *   @param ksize - size of key
    *   @param value - value for table entry
-   *   @returns status of operation
+   *   @returns status of operation, PdhtStatusNotFound if the key isn't in the table
    */
   pdht_status_t pdht_update(pdht_t *dht, void *key, void *value) {
+    ptl_match_bits_t mbits;
+    uint32_t ptindex;
+    ptl_process_t rank;
+
     dht->stats.updates++;
+
+    // same-node owner, store straight into its entry if it has one
+    if (dht->shmpeers) {
+      pdht_hashkey(dht, key, &mbits, &ptindex, &rank);
+      if (dht->shmpeers[rank.rank] && (pdht_shm_update(dht, key, mbits, rank, value) == PdhtStatusOK)) {
+        dht->stats.shmops++;
+        return PdhtStatusOK;
+      }
+    }
     return pdht_do_put(dht,key,value,PdhtPTQActive);
   }
 
@@ -291,41 +353,51 @@ error:
 pdht_status_t pdht_get(pdht_t *dht, void *key, void *value) {
 
   ptl_match_bits_t mbits; 
-  unsigned long roffset = 0;
   uint32_t ptindex;
-  ptl_ct_event_t ctevent;
   ptl_process_t rank;
   char buf[PDHT_MAXKEYSIZE + dht->elemsize];
-  ptl_event_t ev;
-  int ret;
   pdht_status_t rval = PdhtStatusOK;
-
-  int check, c2 = -1;
-  char *ptr;
+  pdht_tctx_t *tc = pdht_tctx(dht);
 
   PDHT_START_TIMER(dht, gtimer);
 
   dht->stats.gets++;
 
-  dht->hashfn(dht, key, &mbits, &ptindex, &rank);
+  pdht_hashkey(dht, key, &mbits, &ptindex, &rank);
 
   dht->stats.ptcounts[ptindex]++;
 
+  // same-node owner, read its segment directly (misses still ask the owner)
+  if (dht->shmpeers && dht->shmpeers[rank.rank] &&
+      (pdht_shm_get(dht, key, mbits, rank, value) == PdhtStatusOK)) {
+    dht->stats.shmops++;
+    goto done;
+  }
+
 #ifdef PDHT_DEBUG_TRACE
   pdht_dprintf("pdht_get: key: %lu from active queue of %d with match: %lu\n", *(unsigned long *)key, rank, mbits);
 #endif
 
-  if ((rank.rank == c->rank) && (dht->local_get == PdhtSearchLocal) && 
+  if ((rank.rank == (ptl_rank_t)c->rank) && (dht->local_get == PdhtSearchLocal) && 
       (dht->ptl.ptalloc_opts == PTL_PT_MATCH_UNORDERED)) {
     ptl_me_t me;
     char *index;
-    ptl_event_t ev;
-    int which;
-    int ret; 
     //char pt[PDHT_MAXKEYSIZE + dht->elemsize];
     void *pt;
 
     _pdht_ht_entry_t *hte;
+
+    // bucketed and direct entries have no ME of their own to search for
+    if (dht->layout != PdhtLayoutEntry) {
+      pthread_mutex_lock(&dht->completion_mutex);
+      pt = pdht_layout_find(dht, key, mbits, ptindex);
+      if (pt)
+        memcpy(value, pt + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
+      pthread_mutex_unlock(&dht->completion_mutex);
+      if (pt)
+        goto done;
+    }
+
     index = (char *)dht->ht;
 
     me.match_bits = mbits;
@@ -344,32 +416,32 @@ pdht_status_t pdht_get(pdht_t *dht, void *key, void *value) {
     me.match_bits    = mbits;
     me.ignore_bits   = 0;
 
-    pthread_mutex_lock(&dht->local_gets_flag_mutex);
-    dht->local_get_flag = 0;
-    pthread_mutex_unlock(&dht->local_gets_flag_mutex);
+    tc->search_flag = 0;
     
-    PtlMESearch(dht->ptl.lni, dht->ptl.getindex[ptindex],&me,PTL_ACTIVE_SEARCH_ONLY,&pt);
+    PtlMESearch(dht->ptl.lni, dht->ptl.getindex[ptindex],&me,PTL_ACTIVE_SEARCH_ONLY,tc);
     
-    pthread_mutex_lock(&dht->completion_mutex);
+    // the progress engine serving this PTE drops the result into our context
+    while (__atomic_load_n(&tc->search_flag, __ATOMIC_ACQUIRE) == 0)
+      pdht_progress_yield();
+    pt = tc->search;
 
-    if (dht->local_get_flag == 0){
-      pdht_finalize_puts(dht);
-    }
-    pthread_mutex_unlock(&dht->completion_mutex);
-
-    if (dht->local_get_flag == -1){
+    if (tc->search_flag == -1){
       dht->stats.notfound++;
       rval = PdhtStatusNotFound;
       goto done;
     }
-    if (memcmp(pt, key, dht->keysize) != 0) {
-      // keys don't match, this must be a collision
-      dht->stats.collisions++;
-      pdht_dprintf("pdht_get: found local collision. %d\n");
-      pdht_dump_entry(dht, key, buf);
-      rval = PdhtStatusCollision;
-      PDHT_STOP_TIMER(dht,t4);
-      goto done;
+    if ((!pt) || (memcmp(pt, key, dht->keysize) != 0)) {
+      // chain marker or another key under the same bits, walk the collision chain
+      pthread_mutex_lock(&dht->completion_mutex);
+      pt = pdht_index_find(dht, key, mbits);
+      pthread_mutex_unlock(&dht->completion_mutex);
+      if (pt)
+        pt = pdht_entry_key(dht, pt); // index hands back the entry, the search hands back its key
+      if (!pt) {
+        dht->stats.notfound++;
+        rval = PdhtStatusNotFound;
+        goto done;
+      }
     }
     memcpy(value, pt + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
 
@@ -377,101 +449,211 @@ pdht_status_t pdht_get(pdht_t *dht, void *key, void *value) {
 
   } else {
 
-    PtlCTGet(dht->ptl.lmdct, &dht->ptl.curcounts);
-    if (dht->ptl.curcounts.failure > 0) {
-      ctevent.success = 0;
-      ctevent.failure = -dht->ptl.curcounts.failure;
-      PtlCTInc(dht->ptl.lmdct, ctevent);
-    }
-    PtlCTGet(dht->ptl.lmdct, &dht->ptl.curcounts);
-    //pdht_dprintf("pdht_get: pre: success: %lu fail: %lu\n", dht->ptl.curcounts.success, dht->ptl.curcounts.failure);
+    // fetched entry has key + value concatenated
+    rval = pdht_locate(dht, key, mbits, ptindex, rank, NULL, NULL, buf);
+    if (rval != PdhtStatusOK)
+      goto done;
+  }
 
-    ret = PtlGet(dht->ptl.lmd, (ptl_size_t)buf, PDHT_MAXKEYSIZE + dht->elemsize, rank, dht->ptl.getindex[ptindex], mbits, roffset, NULL);
+  // looks good, copy value to application buffer
+  // skipping over the embedded key data (for collision detection)
+  memcpy(value, buf + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
 
+done:
+  // get of non-existent entry should hit fail counter + PTL_EVENT_REPLY event
+  // in PTL_EVENT_REPLY event, we should get ni_fail_type
+  // ni_fail_type should be: PTL_NI_DROPPED
+  PDHT_STOP_TIMER(dht, gtimer);
+  return rval;
+}
 
-    if (ret != PTL_OK) {
-      //pdht_dprintf("pdht_get: PtlGet(key: %lu, rank: %d, ptindex: %d/%d) failed: (%s) : %d\n", *(long *)key, rank.rank, ptindex, dht->ptl.putindex[ptindex], pdht_ptl_error(ret), dht->stats.gets);
-      goto error;
-    }
+
+/**
+ * pdht_get_bits - fetches the entry (or bucket) linked under a set of match bits
+ *   @param key - hash table key (only used to poison the reply buffer)
+ *   @param mbits - match bits to fetch
+ *   @param buf - reply buffer (key + value)
+ *   @param len - bytes to fetch
+ *   @returns OK if something matched, NotFound if no ME matched, Error otherwise
+ */
+static pdht_status_t pdht_get_bits(pdht_t *dht, void *key, ptl_match_bits_t mbits, uint32_t ptindex, ptl_process_t rank, char *buf, ptl_size_t len) {
+  pdht_tctx_t *tc = pdht_tctx(dht);
+  ptl_ct_event_t ctevent;
+  ptl_event_t ev;
+  int ret;
+
+  // chain markers are zero length, make sure a marker reply never looks like our key
+  buf[0] = ~((char *)key)[0];
+
+  PtlCTGet(tc->lmdct, &tc->curcounts);
+  if (tc->curcounts.failure > 0) {
+    ctevent.success = 0;
+    ctevent.failure = -tc->curcounts.failure;
+    PtlCTInc(tc->lmdct, ctevent);
+  }
+  PtlCTGet(tc->lmdct, &tc->curcounts);
+  //pdht_dprintf("pdht_get: pre: success: %lu fail: %lu\n", tc->curcounts.success, tc->curcounts.failure);
+
+  ret = PtlGet(tc->lmd, (ptl_size_t)buf, len, rank, dht->ptl.getindex[ptindex], mbits, 0, NULL);
+  if (ret != PTL_OK) {
+    //pdht_dprintf("pdht_get: PtlGet(key: %lu, rank: %d, ptindex: %d/%d) failed: (%s) : %d\n", *(long *)key, rank.rank, ptindex, dht->ptl.putindex[ptindex], pdht_ptl_error(ret), dht->stats.gets);
+    return PdhtStatusError;
+  }
 
 #define RELIABLE_TARGETS
 #ifdef RELIABLE_TARGETS
-    // check for completion or failure
-    ret = PtlCTWait(dht->ptl.lmdct, dht->ptl.curcounts.success+1, &ctevent);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_get: PtlCTWait() failed\n");
-      goto error;
-    }
+  // check for completion or failure
+  ret = pdht_progress_ct_wait(tc->lmdct, tc->curcounts.success+1, &ctevent);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_get: PtlCTWait() failed\n");
+    return PdhtStatusError;
+  }
 #else
-    ptl_size_t splusone = dht->ptl.curcounts.success+1;
-    int which;
-    ret = PtlCTPoll(&dht->ptl.lmdct, &splusone, 1, 3, &ctevent, &which);
-    if (ret == PTL_CT_NONE_REACHED) {
-      pdht_dprintf("pdht_get: timed out waiting for reply\n");
-      dht->stats.notfound++;
-      rval = PdhtStatusNotFound;
-      goto done;
-    } else if (ret != PTL_OK) {
-      pdht_dprintf("pdht_get: PtlCTPoll() failed\n");
-      goto error;
-    }
+  ptl_size_t splusone = tc->curcounts.success+1;
+  int which;
+  ret = PtlCTPoll(&tc->lmdct, &splusone, 1, 3, &ctevent, &which);
+  if (ret == PTL_CT_NONE_REACHED) {
+    pdht_dprintf("pdht_get: timed out waiting for reply\n");
+    dht->stats.notfound++;
+    return PdhtStatusNotFound;
+  } else if (ret != PTL_OK) {
+    pdht_dprintf("pdht_get: PtlCTPoll() failed\n");
+    return PdhtStatusError;
+  }
 #endif
 
-    //pdht_dprintf("pdht_get: event counter: success: %lu failure: %lu\n", ctevent.success, ctevent.failure);
-    if (ctevent.failure > dht->ptl.curcounts.failure) {
-      ret = PtlEQWait(dht->ptl.lmdeq, &ev);
-      if (ret == PTL_OK) {
-        if (ev.type == PTL_EVENT_REPLY) {
+  //pdht_dprintf("pdht_get: event counter: success: %lu failure: %lu\n", ctevent.success, ctevent.failure);
+  if (ctevent.failure > tc->curcounts.failure) {
+    ret = PtlEQWait(tc->lmdeq, &ev);
+    if (ret == PTL_OK) {
+      if (ev.type == PTL_EVENT_REPLY) {
 #ifdef PDHT_DEBUG_TRACE
-          pdht_dprintf("pdht_get: key: %lu not found\n", *(unsigned long *)key);
+        pdht_dprintf("pdht_get: key: %lu not found\n", *(unsigned long *)key);
 #endif  
-          //pdht_dprintf("pdht_get: key: %lu not found\n", *(unsigned long *)key);
-
-          ctevent.success = 0;
-          ctevent.failure = -1;
-          PtlCTInc(dht->ptl.lmdct, ctevent);
-          dht->stats.notfound++;
-          rval = PdhtStatusNotFound;
-          goto done;
-        } else if (ev.ni_fail_type != PTL_NI_OK) {
-          pdht_dprintf("pdht_get: found fail event: %s\n", pdht_event_to_string(ev.type));   
-          pdht_dump_event(&ev);
-        } 
-      } else {
-        pdht_dprintf("pdht_get: PtlEQWait() failed\n");
-        goto error;
-      }
+        ctevent.success = 0;
+        ctevent.failure = -1;
+        PtlCTInc(tc->lmdct, ctevent);
+        dht->stats.notfound++;
+        return PdhtStatusNotFound;
+      } else if (ev.ni_fail_type != PTL_NI_OK) {
+        pdht_dprintf("pdht_get: found fail event: %s\n", pdht_event_to_string(ev.type));   
+        pdht_dump_event(&ev);
+      } 
+    } else {
+      pdht_dprintf("pdht_get: PtlEQWait() failed\n");
+      return PdhtStatusError;
     }
   }
-  // fetched entry has key + value concatenated, validate key
+  return PdhtStatusOK;
+}
 
-  if (memcmp(buf, key, dht->keysize) != 0) {
-    // keys don't match, this must be a collision
-    dht->stats.collisions++;
-    pdht_dprintf("pdht_get: found collision.\n");
-    pdht_dump_entry(dht, key, buf);
-    rval = PdhtStatusCollision;
-    PDHT_STOP_TIMER(dht,t4);
-    goto done;
+
+
+/**
+ * pdht_probe - walks a collision chain looking for a key
+ *   @param key - hash table key
+ *   @param mbits - primary match bits of key
+ *   @param found - optional copy-out of the probe match bits holding key
+ *   @param buf - reply buffer (key + value)
+ *   @returns OK if key was found, NotFound, or Error
+ */
+pdht_status_t pdht_probe(pdht_t *dht, void *key, ptl_match_bits_t mbits, uint32_t ptindex, ptl_process_t rank, ptl_match_bits_t *found, char *buf) {
+  ptl_match_bits_t pbits;
+  pdht_status_t rval;
+
+  // owner fills probe slots in order, first miss ends the chain
+  for (int i=1; i <= PDHT_MAX_PROBES; i++) {
+    pbits = pdht_probe_bits(mbits, i);
+    rval = pdht_get_bits(dht, key, pbits, ptindex, rank, buf, PDHT_MAXKEYSIZE + dht->elemsize);
+    if (rval != PdhtStatusOK)
+      return rval;
+
+    if (memcmp(buf, key, dht->keysize) == 0) {
+      if (found)
+        *found = pbits;
+      return PdhtStatusOK;
+    }
   }
+  dht->stats.notfound++;
+  return PdhtStatusNotFound;
+}
 
-  // looks good, copy value to application buffer
-  // skipping over the embedded key data (for collision detection)
-  memcpy(value, buf + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
 
-done:
-  // get of non-existent entry should hit fail counter + PTL_EVENT_REPLY event
-  // in PTL_EVENT_REPLY event, we should get ni_fail_type
-  // ni_fail_type should be: PTL_NI_DROPPED
-  PDHT_STOP_TIMER(dht, gtimer);
-  return rval;
+/**
+ * pdht_locate - fetches the remote entry for a key and reports where it lives
+ *   @param key - hash table key
+ *   @param mbits - primary match bits of key
+ *   @param bits - optional copy-out of the match bits of the ME holding key
+ *                 (__PDHT_DIRECT_BITS if it is in a direct layout slot)
+ *   @param offset - optional copy-out of the offset of key + value inside that ME
+ *   @param buf - reply buffer (key + value)
+ *   @returns OK if key was found, NotFound, or Error
+ */
+pdht_status_t pdht_locate(pdht_t *dht, void *key, ptl_match_bits_t mbits, uint32_t ptindex, ptl_process_t rank,
+                          ptl_match_bits_t *bits, ptl_size_t *offset, char *buf) {
+  unsigned slotsize = PDHT_MAXKEYSIZE + dht->elemsize;
+  ptl_match_bits_t bbits;
+  _pdht_bucket_t *b;
+  pdht_status_t rval;
+  int overflow;
+
+  if (bits)
+    *bits = mbits;
+  if (offset)
+    *offset = 0;
+
+  if (dht->layout == PdhtLayoutBucket) {
+    // pull the whole bucket over and resolve the key here
+    b = alloca(dht->bucketsize);
+    bbits = pdht_bucket_bits(dht, mbits);
+    rval = pdht_get_bits(dht, key, bbits, ptindex, rank, (char *)b, dht->bucketsize);
+    if (rval != PdhtStatusOK)
+      return rval;
+
+    if (pdht_bucket_scan(dht, key, b, offset, buf, &overflow) == PdhtStatusOK) {
+      if (bits)
+        *bits = bbits;
+      return PdhtStatusOK;
+    }
 
-error:
-  PDHT_STOP_TIMER(dht, gtimer);
-  return PdhtStatusError;
+    // only entries that found their bucket full have an ME of their own
+    if (!overflow) {
+      dht->stats.notfound++;
+      return PdhtStatusNotFound;
+    }
+
+  } else if (dht->layout == PdhtLayoutDirect) {
+    // one read of the key's neighborhood, no match list involved
+    rval = pdht_direct_fetch(dht, key, mbits, rank, offset, buf, &overflow);
+    if (rval == PdhtStatusOK) {
+      if (bits)
+        *bits = __PDHT_DIRECT_BITS;
+      return rval;
+    }
+    if (rval != PdhtStatusNotFound)
+      return rval;
+
+    // only entries that found their neighborhood full have an ME of their own
+    if (!overflow) {
+      dht->stats.notfound++;
+      return PdhtStatusNotFound;
+    }
+  }
+
+  rval = pdht_get_bits(dht, key, mbits, ptindex, rank, buf, slotsize);
+  if (rval != PdhtStatusOK)
+    return rval;
+
+  // validate key
+  if (memcmp(buf, key, dht->keysize) != 0) {
+    // chain marker or another key under the same bits, walk the collision chain
+    rval = pdht_probe(dht, key, mbits, ptindex, rank, bits, buf);
+  }
+  return rval;
 }
 
 
+
 pdht_status_t pdht_persistent_get(pdht_t *dht, void *key, void *value){
     pdht_status_t ret;
     while(1){
@@ -493,22 +675,25 @@ pdht_status_t pdht_insert(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex,
   _pdht_ht_entry_t *phte;
   _pdht_ht_trigentry_t *thte;
   ptl_me_t me;
+  unsigned next;
   int ret;
-  static int foo = 1;
 
   dht->stats.inserts++;
+  bits &= __PDHT_HASH_MASK;
 
   // find our next spot 
 
   // iterator = ht[PTE * QSIZE] (i.e. PENDINGQ_SIZE per PTE)
   //index = (char *)dht->ht + ((dht->pendq_size * ptindex) * dht->entrysize);
+  if (pdht_entry_claim(dht, 1, &next) == 0)
+    goto error; // table is full
   index = (char *)dht->ht;
-  index += (dht->nextfree * dht->entrysize); // pointer math
+  index += (next * dht->entrysize); // pointer math
 
   switch (dht->pmode) {
   case PdhtPendingPoll:
     phte = (_pdht_ht_entry_t *)index;
-    assert(dht->nextfree == pdht_find_bucket(dht, phte));
+    assert(next == pdht_find_bucket(dht, phte));
     memcpy(&phte->key, key, PDHT_MAXKEYSIZE); 
     memcpy(&phte->data, value, dht->elemsize);
     me.start         = &phte->key;
@@ -516,7 +701,7 @@ pdht_status_t pdht_insert(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex,
 
   case PdhtPendingTrig:
     thte = (_pdht_ht_trigentry_t *)index;
-    assert(dht->nextfree == pdht_find_bucket(dht, thte));
+    assert(next == pdht_find_bucket(dht, thte));
     memcpy(&thte->key, key, PDHT_MAXKEYSIZE); 
     memcpy(&thte->data, value, dht->elemsize);
     me.start         = &thte->key;
@@ -535,7 +720,15 @@ pdht_status_t pdht_insert(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex,
                    | PTL_ME_EVENT_LINK_DISABLE
                    | PTL_ME_EVENT_UNLINK_DISABLE;
   me.match_id.rank = PTL_RANK_ANY;
-  me.match_bits    = bits;
+  // bucketed and direct entries don't need an ME of their own
+  if (pdht_layout_place(dht, index, bits, ptindex))
+    return PdhtStatusOK;
+
+  ret = pdht_index_claim(dht, index, bits, ptindex, &me.match_bits);
+  if (ret == 0)
+    return PdhtStatusOK; // key was already here, its value has been updated
+  if (ret < 0)
+    goto error;
   me.ignore_bits   = 0;
 
 
@@ -552,35 +745,9 @@ pdht_status_t pdht_insert(pdht_t *dht, ptl_match_bits_t bits, uint32_t ptindex,
     pdht_dprintf("pdht_insert: ME append failed (active) : %s\n", pdht_ptl_error(ret));
     exit(1);
   }
-  dht->nextfree++;
 
   return PdhtStatusOK;
 
 error:
   return PdhtStatusError;
 }
-
-
-static void pdht_dump_entry(pdht_t *dht, void *exp, void *act) {
-  char *cp;
-  int ptindex;
-  ptl_process_t rank;
-  uint64_t ehash, ahash;
-
-  printf("expected: ");
-  cp = exp;
-  for (int i=0; i<dht->keysize; i++)  printf("%2hhx ", cp[i]);
-  printf("\nactual:   ");
-  cp = act;
-  for (int i=0; i<dht->keysize; i++)  printf("%2hhx ", cp[i]);
-  printf("\n");
-  dht->hashfn(dht, exp, &ehash, &ptindex, &rank);
-  dht->hashfn(dht, act, &ahash, &ptindex, &rank);
-  //printf("    hashes: exp: %llx act: %llx\n", ehash, ahash);
-}
-
-  static void pdht_keystr(void *key, char* str) {
-    long *k = (long *)key;
-    // sprintf(str, "<%ld,%ld,%ld> @ %ld", k[0], k[1], k[2], k[3]); // MADNESS
-    sprintf(str, "%ld", k[0]); // tests
-  }
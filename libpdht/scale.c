@@ -0,0 +1,89 @@
+/********************************************************/
+/*                                                      */
+/*  scale.c - PDHT dynamic PTE scaling                  */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table PTE scaling
+ *
+ * matching in software Portals walks the active match list linearly, so get
+ * latency grows with the number of entries linked on a PTE. every rank tracks
+ * the MEs linked on each of its get PTEs, and at fence time the table agrees
+ * to double the number of PTE pairs (up to maxptes) once any list grows past
+ * ptlistmax. the hash function spreads keys over the larger PTE set and each
+ * owner rehashes its existing entries onto their new PTEs.
+ */
+
+
+
+/**
+ * pdht_pte_scale - grows the PTE set of a table if any match list is too long
+ *   collective, called by every process from pdht_fence()
+ * @param dht - hash table data structure
+ */
+void pdht_pte_scale(pdht_t *dht) {
+  long sbuf[2], rbuf[2];
+  unsigned oldptes, newptes;
+  u_int64_t longest = 0;
+
+  // maxptes is the same everywhere, so everyone bails out together
+  if (dht->ptl.nptes >= dht->ptl.maxptes)
+    return;
+
+  oldptes = dht->ptl.nptes;
+  newptes = 2*oldptes < dht->ptl.maxptes ? 2*oldptes : dht->ptl.maxptes;
+
+  pthread_mutex_lock(&dht->completion_mutex);
+  for (unsigned ptindex=0; ptindex < oldptes; ptindex++) {
+    if (dht->stats.ptentries[ptindex] > longest)
+      longest = dht->stats.ptentries[ptindex];
+  }
+  // each new PTE carves its pending queue out of the unused table entries
+  sbuf[1] = (dht->maxentries - __atomic_load_n(&dht->nextfree, __ATOMIC_RELAXED)) < ((newptes - oldptes) * dht->pendq_size);
+  pthread_mutex_unlock(&dht->completion_mutex);
+
+  sbuf[0] = longest;
+  pdht_allreduce(sbuf, rbuf, PdhtReduceOpMax, LongType, 2);
+
+  if (rbuf[0] <= dht->ptl.ptlistmax)
+    return;
+
+  if (rbuf[1]) {
+    pdht_eprintf(PDHT_DEBUG_WARN, "pdht_pte_scale: match lists at %ld entries, no room for %u more pending queues\n",
+                 rbuf[0], newptes - oldptes);
+    dht->ptl.maxptes = oldptes; // don't try again
+    return;
+  }
+
+  pthread_mutex_lock(&dht->completion_mutex);
+
+  for (unsigned ptindex=oldptes; ptindex < newptes; ptindex++) {
+    pdht_pte_init(dht, ptindex);
+    if (dht->pmode == PdhtPendingPoll)
+      pdht_polling_pte_init(dht, ptindex);
+    else
+      pdht_trig_pte_init(dht, ptindex);
+  }
+
+  // hash function sees the new PTE count from here on
+  dht->ptl.nptes = newptes;
+  pdht_progress_changed(); // engine has new event queues to poll
+  pdht_index_rehash(dht);
+  dht->stats.ptgrowths++;
+
+  pthread_mutex_unlock(&dht->completion_mutex);
+
+  pdht_eprintf(PDHT_DEBUG_WARN, "pdht_pte_scale: longest match list: %ld, scaling PTEs %u -> %u\n",
+               rbuf[0], oldptes, newptes);
+
+  // no one can target the new PTEs until everyone has them
+  pdht_barrier();
+}
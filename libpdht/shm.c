@@ -0,0 +1,347 @@
+/********************************************************/
+/*                                                      */
+/*  shm.c - PDHT intra-node shared memory               */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#include <pdht_impl.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table intra-node fast path
+ *
+ * with the per-entry layout, every rank keeps its entry array and owner index
+ * in a POSIX shared memory segment instead of private memory. at create time
+ * each rank tries to open every other rank's segment by name; names are only
+ * visible on the same host, so whatever opens is on our node. gets and updates
+ * for keys owned by a mapped rank are served with loads and stores instead of
+ * a Portals round trip.
+ *
+ * the owner publishes entries into its index under a seqlock: the sequence in
+ * the segment header is odd while the index (or a value, for same-node updates)
+ * is being written. readers search the index and copy the value, then retry if
+ * the sequence moved. keys that are not indexed yet (still in flight on the
+ * pending PTE) miss and fall back to the network, which sees the same state a
+ * remote rank would.
+ */
+
+static uint64_t _pdht_shm_job = 0; // per-job token keeping segment names unique
+
+static void              pdht_shm_name(pdht_t *dht, int rank, char *name, size_t len);
+static inline _pdht_shm_hdr_t *pdht_shm_hdr(pdht_t *dht, int rank);
+static inline void       pdht_shm_lock(_pdht_shm_hdr_t *hdr);
+static inline void       pdht_shm_unlock(_pdht_shm_hdr_t *hdr);
+
+#define PDHT_SHM_NAMELEN 64
+
+
+
+/**
+ * pdht_shm_name - segment name for a table on a given rank
+ * @param dht - hash table data structure
+ * @param rank - owner of the segment
+ * @param name - buffer for name
+ * @param len - size of name buffer
+ */
+static void pdht_shm_name(pdht_t *dht, int rank, char *name, size_t len) {
+  snprintf(name, len, "/pdht.%lx.%d.%d", (unsigned long)_pdht_shm_job, dht->ptl.getindex_base, rank);
+}
+
+
+
+/**
+ * pdht_shm_hdr - header of a mapped segment
+ */
+static inline _pdht_shm_hdr_t *pdht_shm_hdr(pdht_t *dht, int rank) {
+  return (_pdht_shm_hdr_t *)dht->shmpeers[rank];
+}
+
+
+
+/**
+ * pdht_shm_init - allocates the entry array and index in a shared segment
+ *   collective, every process calls this from pdht_create()
+ *   on failure dht->shm stays NULL and the caller allocates private memory
+ * @param dht - hash table data structure
+ */
+void pdht_shm_init(pdht_t *dht) {
+  _pdht_shm_hdr_t *hdr;
+  char name[PDHT_SHM_NAMELEN];
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t entlen, idxlen;
+  uint64_t entoff, idxoff, len;
+  long job;
+  void *seg;
+  int fd;
+
+  // bucketed and direct tables keep their entries elsewhere
+  if (dht->layout != PdhtLayoutEntry)
+    return;
+
+  // everyone agrees on rank 0's token once
+  if (!_pdht_shm_job) {
+    job = (c->rank == 0) ? (long)(((uint64_t)getpid() << 24) ^ (uint64_t)time(NULL)) : 0;
+    pdht_broadcast(&job, LongType, 1);
+    _pdht_shm_job = job ? job : 1;
+  }
+
+  entlen = (size_t)dht->maxentries * dht->entrysize;
+  idxlen = (size_t)pdht_index_size(dht) * sizeof(_pdht_index_slot_t);
+  entoff = page;
+  idxoff = entoff + ((entlen + page - 1) & ~(page - 1));
+  len    = idxoff + ((idxlen + page - 1) & ~(page - 1));
+
+  pdht_shm_name(dht, c->rank, name, sizeof(name));
+  fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    pdht_eprintf(PDHT_DEBUG_WARN, "pdht_shm_init: shm_open(%s) error: %s\n", name, strerror(errno));
+    return;
+  }
+
+  if ((posix_fallocate(fd, 0, len) != 0) ||
+      ((seg = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)) {
+    pdht_eprintf(PDHT_DEBUG_WARN, "pdht_shm_init: unable to map %lu bytes, using private memory\n", len);
+    close(fd);
+    shm_unlink(name);
+    return;
+  }
+  close(fd);
+
+  // fresh pages are zeroed, the entries need nothing else from calloc()
+  hdr = (_pdht_shm_hdr_t *)seg;
+  hdr->maxentries = dht->maxentries;
+  hdr->entrysize  = dht->entrysize;
+  hdr->indexmask  = pdht_index_size(dht) - 1;
+  hdr->keysize    = dht->keysize;
+  hdr->elemsize   = dht->elemsize;
+  hdr->pmode      = dht->pmode;
+  hdr->entoff     = entoff;
+  hdr->idxoff     = idxoff;
+  hdr->len        = len;
+  __atomic_store_n(&hdr->magic, PDHT_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  dht->shm = seg;
+  dht->ht  = (char *)seg + entoff; // pointer math
+}
+
+
+
+/**
+ * pdht_shm_index - owner index storage inside our segment
+ * @param dht - hash table data structure
+ */
+void *pdht_shm_index(pdht_t *dht) {
+  return (char *)dht->shm + ((_pdht_shm_hdr_t *)dht->shm)->idxoff; // pointer math
+}
+
+
+
+/**
+ * pdht_shm_attach - maps the segments of every same-node rank
+ *   collective, every process calls this from pdht_create()
+ * @param dht - hash table data structure
+ */
+void pdht_shm_attach(pdht_t *dht) {
+  _pdht_shm_hdr_t *hdr;
+  struct stat st;
+  char name[PDHT_SHM_NAMELEN];
+  void *seg;
+  int fd, peers = 0;
+
+  if (dht->layout != PdhtLayoutEntry)
+    return;
+
+  // all segments exist (or never will) once everyone is here
+  pdht_barrier();
+
+  dht->shmpeers = calloc(c->size, sizeof(void *));
+  dht->shmpeers[c->rank] = dht->shm;
+
+  for (int r=0; r < c->size; r++) {
+    if ((r == c->rank) || !dht->shm)
+      continue;
+
+    pdht_shm_name(dht, r, name, sizeof(name));
+    if ((fd = shm_open(name, O_RDWR, 0)) < 0)
+      continue; // other node, or that rank fell back to private memory
+
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(_pdht_shm_hdr_t))) {
+      close(fd);
+      continue;
+    }
+    seg = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED)
+      continue;
+
+    // everyone created the table with the same geometry, but check before trusting it
+    hdr = (_pdht_shm_hdr_t *)seg;
+    if ((__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != PDHT_SHM_MAGIC) ||
+        (hdr->maxentries != dht->maxentries) || (hdr->entrysize != dht->entrysize) ||
+        (hdr->indexmask != dht->indexmask) || (hdr->keysize != dht->keysize) ||
+        (hdr->elemsize != dht->elemsize) || (hdr->pmode != dht->pmode) || (hdr->len != (uint64_t)st.st_size)) {
+      pdht_dprintf("pdht_shm_attach: segment %s does not match this table, ignoring\n", name);
+      munmap(seg, st.st_size);
+      continue;
+    }
+
+    dht->shmpeers[r] = seg;
+    peers++;
+  }
+
+  // names can go once everyone has mapped, the mappings outlive them
+  pdht_barrier();
+  if (dht->shm) {
+    pdht_shm_name(dht, c->rank, name, sizeof(name));
+    shm_unlink(name);
+  }
+
+  pdht_eprintf(PDHT_DEBUG_WARN, "\tshared memory: %s, %d same-node peers\n", dht->shm ? "on" : "off", peers);
+}
+
+
+
+/**
+ * pdht_shm_fini - unmaps our segment and those of same-node peers
+ * @param dht - hash table data structure
+ */
+void pdht_shm_fini(pdht_t *dht) {
+  if (dht->shmpeers) {
+    for (int r=0; r < c->size; r++) {
+      if ((r != c->rank) && dht->shmpeers[r])
+        munmap(dht->shmpeers[r], pdht_shm_hdr(dht, r)->len);
+    }
+    free(dht->shmpeers);
+    dht->shmpeers = NULL;
+  }
+
+  if (dht->shm) {
+    munmap(dht->shm, ((_pdht_shm_hdr_t *)dht->shm)->len);
+    dht->shm = NULL;
+    dht->ht  = NULL;
+  }
+}
+
+
+
+/**
+ * pdht_shm_lock - spins for the segment's writer lock
+ */
+static inline void pdht_shm_lock(_pdht_shm_hdr_t *hdr) {
+  while (__atomic_exchange_n(&hdr->lock, 1, __ATOMIC_ACQUIRE))
+    sched_yield();
+}
+
+
+
+/**
+ * pdht_shm_unlock - releases the segment's writer lock
+ */
+static inline void pdht_shm_unlock(_pdht_shm_hdr_t *hdr) {
+  __atomic_store_n(&hdr->lock, 0, __ATOMIC_RELEASE);
+}
+
+
+
+/**
+ * pdht_shm_write_begin - opens a write to our index or entries
+ *   no-op unless the table lives in shared memory
+ * @param dht - hash table data structure
+ */
+void pdht_shm_write_begin(pdht_t *dht) {
+  _pdht_shm_hdr_t *hdr = dht->shm;
+
+  if (!hdr)
+    return;
+
+  pdht_shm_lock(hdr);
+  __atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+
+/**
+ * pdht_shm_write_end - closes a write opened with pdht_shm_write_begin()
+ * @param dht - hash table data structure
+ */
+void pdht_shm_write_end(pdht_t *dht) {
+  _pdht_shm_hdr_t *hdr = dht->shm;
+
+  if (!hdr)
+    return;
+
+  __atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE);
+  pdht_shm_unlock(hdr);
+}
+
+
+
+/**
+ * pdht_shm_get - reads an entry out of a same-node rank's segment
+ * @param dht - hash table data structure
+ * @param key - key to find
+ * @param bits - primary match bits of key
+ * @param rank - owner of key, must be mapped
+ * @param value - buffer for the value
+ * @returns OK if found, NotFound if the caller should ask over the network
+ */
+pdht_status_t pdht_shm_get(pdht_t *dht, void *key, ptl_match_bits_t bits, ptl_process_t rank, void *value) {
+  _pdht_shm_hdr_t *hdr = pdht_shm_hdr(dht, rank.rank);
+  char *entries = (char *)hdr + hdr->entoff;  // pointer math
+  _pdht_index_slot_t *slots = (_pdht_index_slot_t *)((char *)hdr + hdr->idxoff);
+  uint64_t seq;
+  void *entry;
+
+  do {
+    while ((seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE)) & 1)
+      sched_yield();
+
+    entry = pdht_index_find_in(dht, slots, entries, key, bits);
+    if (entry)
+      memcpy(value, pdht_entry_key(dht, entry) + PDHT_MAXKEYSIZE, dht->elemsize); // pointer math
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) != seq);
+
+  return entry ? PdhtStatusOK : PdhtStatusNotFound;
+}
+
+
+
+/**
+ * pdht_shm_update - overwrites an entry in a same-node rank's segment
+ * @param dht - hash table data structure
+ * @param key - key to update
+ * @param bits - primary match bits of key
+ * @param rank - owner of key, must be mapped
+ * @param value - new value
+ * @returns OK if updated, NotFound if the caller should update over the network
+ */
+pdht_status_t pdht_shm_update(pdht_t *dht, void *key, ptl_match_bits_t bits, ptl_process_t rank, void *value) {
+  _pdht_shm_hdr_t *hdr = pdht_shm_hdr(dht, rank.rank);
+  char *entries = (char *)hdr + hdr->entoff;  // pointer math
+  _pdht_index_slot_t *slots = (_pdht_index_slot_t *)((char *)hdr + hdr->idxoff);
+  void *entry;
+
+  pdht_shm_lock(hdr);
+  entry = pdht_index_find_in(dht, slots, entries, key, bits);
+  if (entry) {
+    __atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(pdht_entry_key(dht, entry) + PDHT_MAXKEYSIZE, value, dht->elemsize); // pointer math
+    __atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE);
+  }
+  pdht_shm_unlock(hdr);
+
+  return entry ? PdhtStatusOK : PdhtStatusNotFound;
+}
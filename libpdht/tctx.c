@@ -0,0 +1,180 @@
+/********************************************************/
+/*                                                      */
+/*  tctx.c - PDHT per-thread communication contexts     */
+/*                                                      */
+/*  author: d. brian larkins                            */
+/*  created: 10/19/26                                   */
+/*                                                      */
+/********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * portals distributed hash table per-thread communication contexts
+ *
+ * blocking operations issue a call and wait for success+1 on a counter.
+ * two application threads sharing one MD/CT/EQ would consume each other's
+ * completions, so every thread gets its own context (MD, CT, EQ, atomic
+ * scratch) for each table it touches, created on first use.
+ *
+ * threads are handed a slot number the first time they call into PDHT and
+ * give it back when they exit. contexts belong to the slot, not the thread,
+ * so a thread pool that is torn down and rebuilt reuses them.
+ */
+
+__thread int _pdht_thread_id = -1; // slot of the calling thread, -1 until registered
+
+static pthread_once_t  _pdht_thread_once  = PTHREAD_ONCE_INIT;
+static pthread_key_t   _pdht_thread_key;
+static pthread_mutex_t _pdht_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int             _pdht_thread_free[PDHT_MAX_THREADS]; // slots released by exited threads
+static int             _pdht_thread_nfree = 0;
+static int             _pdht_thread_next  = 0;
+
+static void pdht_thread_key_init(void);
+static void pdht_thread_release(void *arg);
+
+
+
+/**
+ * pdht_thread_register - assigns a thread slot to the calling thread
+ * @returns slot of the calling thread
+ */
+int pdht_thread_register(void) {
+  int id = -1;
+
+  pthread_once(&_pdht_thread_once, pdht_thread_key_init);
+
+  pthread_mutex_lock(&_pdht_thread_mutex);
+  if (_pdht_thread_nfree > 0)
+    id = _pdht_thread_free[--_pdht_thread_nfree];
+  else if (_pdht_thread_next < PDHT_MAX_THREADS)
+    id = _pdht_thread_next++;
+  pthread_mutex_unlock(&_pdht_thread_mutex);
+
+  if (id < 0) {
+    pdht_dprintf("pdht_thread_register: more than %d threads are using PDHT\n", PDHT_MAX_THREADS);
+    exit(1);
+  }
+
+  // key value is slot+1, the destructor only runs for non-NULL values
+  pthread_setspecific(_pdht_thread_key, (void *)(intptr_t)(id + 1));
+  _pdht_thread_id = id;
+  return id;
+}
+
+
+
+/**
+ * pdht_tctx_create - creates the calling thread's context for a table
+ * @param dht - hash table data structure
+ * @param id - thread slot of the caller
+ * @returns new communication context
+ */
+pdht_tctx_t *pdht_tctx_create(pdht_t *dht, int id) {
+  pdht_tctx_t *tc;
+  ptl_md_t md;
+  int ret;
+
+  tc = calloc(1, sizeof(pdht_tctx_t));
+  if (!tc) {
+    pdht_dprintf("pdht_tctx_create: calloc error: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  // allocate event counter for puts/gets
+  ret = PtlCTAlloc(dht->ptl.lni, &tc->lmdct);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_tctx_create: PtlCTAlloc failure (put/get)\n");
+    exit(1);
+  }
+
+  // allocate event queue
+  ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &tc->lmdeq);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_tctx_create: PtlEQAlloc failure\n");
+    exit(1);
+  }
+
+  // create memory descriptor (MD) covering all of our memory for outgoing ops
+  md.start     = NULL;
+  md.length    = PTL_SIZE_MAX;
+  md.options   = PTL_MD_EVENT_SUCCESS_DISABLE | PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY | PTL_MD_EVENT_SEND_DISABLE;
+  md.eq_handle = tc->lmdeq;
+  md.ct_handle = tc->lmdct;
+
+  ret = PtlMDBind(c->ptl.lni, &md, &tc->lmd);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_tctx_create: PtlMDBind failure\n");
+    exit(1);
+  }
+
+  if (pdht_atomic_init(dht, tc) != 0)
+    exit(1);
+  pdht_acc_init(dht, tc);
+
+  if (dht->layout == PdhtLayoutDirect)
+    pdht_direct_tctx_init(tc);
+
+  dht->ptl.tctx[id] = tc;
+  return tc;
+}
+
+
+
+/**
+ * pdht_tctx_free - releases every thread's context for a table
+ * @param dht - hash table data structure
+ */
+void pdht_tctx_free(pdht_t *dht) {
+  pdht_tctx_t *tc;
+
+  for (int i=0; i < PDHT_MAX_THREADS; i++) {
+    tc = dht->ptl.tctx[i];
+    if (!tc)
+      continue;
+
+    if (dht->layout == PdhtLayoutDirect)
+      pdht_direct_tctx_fini(tc);
+    pdht_acc_free(dht, tc);
+    pdht_atomic_free(dht, tc);
+
+    PtlMDRelease(tc->lmd);
+    PtlCTFree(tc->lmdct);
+    PtlEQFree(tc->lmdeq);
+
+    free(tc);
+    dht->ptl.tctx[i] = NULL;
+  }
+}
+
+
+
+/**
+ * pdht_thread_key_init - creates the key whose destructor gives slots back
+ */
+static void pdht_thread_key_init(void) {
+  int ret;
+
+  ret = pthread_key_create(&_pdht_thread_key, pdht_thread_release);
+  if (ret != 0) {
+    pdht_dprintf("pdht_thread_key_init: pthread_key_create error: %s\n", strerror(ret));
+    exit(1);
+  }
+}
+
+
+
+/**
+ * pdht_thread_release - returns an exiting thread's slot (and its contexts) to the pool
+ * @param arg - slot+1 of the exiting thread
+ */
+static void pdht_thread_release(void *arg) {
+  int id = (int)(intptr_t)arg - 1;
+
+  pthread_mutex_lock(&_pdht_thread_mutex);
+  _pdht_thread_free[_pdht_thread_nfree++] = id;
+  pthread_mutex_unlock(&_pdht_thread_mutex);
+}
@@ -15,113 +15,59 @@
  * portals distributed hash table triggered ops code
  */
 
+static unsigned  pdht_trig_post(pdht_t *dht, unsigned ptindex, unsigned want);
+static u_int64_t pdht_trig_now(void);
 
-void *pdht_trig_progress(void *arg);
 
 /**
  * pdht_trig_init -- initializes triggered operations for pending puts
  * @param dht - hash table data structure
  */
 void pdht_trig_init(pdht_t *dht) {
-  int ret;
-  _pdht_ht_trigentry_t *hte;
-  char *iter; // used for pointer math
-  ptl_event_t ev;
-  ptl_ct_event_t inc;
-  unsigned hdrsize;
-
-  // only xfer latter half of ME entry in put to pending ME
-  hdrsize = sizeof(ptl_me_t) - offsetof(ptl_me_t, match_bits); 
+  // each PTE takes the next PENDINGQ_SIZE entries of the table for its pending queue
+  dht->nextfree = 0;
 
-  // setup triggered CT ops to increment success field by one
-  inc.success = 1;
-  inc.failure = 0;
+  for (int ptindex = 0; ptindex < dht->ptl.nptes; ptindex++)
+    pdht_trig_pte_init(dht, ptindex);
 
-  for (int ptindex = 0; ptindex < dht->ptl.nptes; ptindex++) {
-
-    // allocate event queue for pending puts
-    ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &dht->ptl.eq[ptindex]);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_trig_init: PtlEQAlloc failure\n");
-      exit(1);
-    }
-    // allocate PTE for pending put
-    ret = PtlPTAlloc(dht->ptl.lni, PTL_PT_ONLY_USE_ONCE | PTL_PT_FLOWCTRL,
-        dht->ptl.eq[ptindex], dht->ptl.putindex_base+ptindex, &dht->ptl.putindex[ptindex]);
-    if (ret != PTL_OK) {
-      pdht_dprintf("pdht_trig_init: PtlPTAlloc failure\n");
-      exit(1);
-    }
-
-    // iterator = ht[PTE * QSIZE] (i.e. PENDINGQ_SIZE per PTE)
-    iter = (char *)dht->ht + ((dht->pendq_size * ptindex) * dht->entrysize);
-    //pdht_dprintf("trig init append: ptindex: %d %d ht[%d] userp: %p\n", ptindex, dht->ptl.putindex[ptindex], pdht_find_bucket(dht, iter), iter);
+  // nextfree points to the first empty hash entry that doesn't have a pending trigger setup
+  // (free = DEFAULT_TABLE_SIZE - nptes * PENDINGQ_SIZE)
+  // the progress engine picks up our event queues once the table is registered
+}
 
-    // append one-time match entres to the put PTE to catch incoming puts
-    for (int i=0; i < dht->pendq_size; i++) {
-      hte = (_pdht_ht_trigentry_t *)iter;
 
-      // allocate per-pending elem trigger event counter
-      ret = PtlCTAlloc(dht->ptl.lni, &hte->tct);
-      if (ret != PTL_OK) {
-        pdht_dprintf("pdht_trig_init: PtlCTAlloc failure: %s (%d)\n", pdht_ptl_error(ret), i);
-        exit(1);
-      }
 
-      // set pending ME params / options
-      hte->me.start         = &hte->me.match_bits; // each entry has a unique memory buffer
-      hte->me.length        = hdrsize + PDHT_MAXKEYSIZE + dht->elemsize;
-      hte->me.uid           = PTL_UID_ANY;
-      hte->me.options       = PTL_ME_OP_PUT 
-                            | PTL_ME_USE_ONCE 
-                            | PTL_ME_EVENT_CT_COMM 
-                            | PTL_ME_IS_ACCESSIBLE | PTL_ME_EVENT_UNLINK_DISABLE 
-                            | PTL_ME_EVENT_LINK_DISABLE;
-      hte->me.match_id.rank = PTL_RANK_ANY;
-      hte->me.match_bits    = __PDHT_PENDING_MATCH;
-      hte->me.ignore_bits   = 0xffffffffffffffff; // ignore it all
-      hte->me.ct_handle     = hte->tct;
-
-      // append ME to the pending ME list
-      ret = PtlMEAppend(dht->ptl.lni, dht->ptl.putindex[ptindex], &hte->me, PTL_PRIORITY_LIST, hte, &hte->pme);
-      if (ret != PTL_OK) {
-        pdht_dprintf("pdht_trig_init: PtlMEAppend error (%d:%d) -- %s\n", i,hte->me.length, pdht_ptl_error(ret));
-        exit(1);
-      }
-
-      // fix up ME entry data for future triggered append
-      hte->me.start         = &hte->key;
-      hte->me.length        = PDHT_MAXKEYSIZE + dht->elemsize;
-      hte->me.options       = PTL_ME_OP_GET 
-                            | PTL_ME_OP_PUT
-                            | PTL_ME_IS_ACCESSIBLE 
-                            | PTL_ME_EVENT_COMM_DISABLE
-                            | PTL_ME_EVENT_UNLINK_DISABLE;
-      hte->me.ignore_bits   = 0;
-
-      // once match bits have been copied, append to active match list
-      //printf("%d: trigger set i: %d ptr: %p\n", c->rank, i, hte->me.start);
-      ret = PtlTriggeredMEAppend(dht->ptl.lni, dht->ptl.getindex[ptindex], &hte->me, PTL_PRIORITY_LIST,
-          hte, &hte->ame, hte->tct, 1);
-      if (ret != PTL_OK) {
-        pdht_dprintf("pdht_trig_init: PtlTriggeredMEAppend error (iteration %d)\n",i );
-        exit(1);
-      }
+/**
+ * pdht_trig_pte_init -- sets up the pending put PTE and triggered appends for one PTE pair
+ * @param dht - hash table data structure
+ * @param ptindex - PTE pair to setup (active PTE must already exist)
+ */
+void pdht_trig_pte_init(pdht_t *dht, unsigned ptindex) {
+  int ret;
 
-      iter += dht->entrysize; // pointer math, danger.
-      dht->usedentries++;
-    }
+  // allocate event queue for pending puts
+  ret = PtlEQAlloc(dht->ptl.lni, dht->pendq_size, &dht->ptl.eq[ptindex]);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_trig_pte_init: PtlEQAlloc failure\n");
+    exit(1);
+  }
+  // allocate PTE for pending put
+  ret = PtlPTAlloc(dht->ptl.lni, PTL_PT_ONLY_USE_ONCE | PTL_PT_FLOWCTRL,
+      dht->ptl.eq[ptindex], dht->ptl.putindex_base+ptindex, &dht->ptl.putindex[ptindex]);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_trig_pte_init: PtlPTAlloc failure\n");
+    exit(1);
   }
 
-  // nextfree points to the first empty hash entry that doesn't have a pending trigger setup
-  dht->nextfree = dht->ptl.nptes * dht->pendq_size; // free = DEFAULT_TABLE_SIZE - PENDINGQ_SIZE
+  // each PTE takes the next PENDINGQ_SIZE free entries of the table for its pending queue
+  pdht_trig_post(dht, ptindex, dht->pendq_size);
 
-  if (c->dhtcount == 0) {
-    ret = pthread_create(&c->progress_tid, NULL, pdht_trig_progress, NULL);
-    if (ret < 0) {
-      pdht_dprintf("pdht_trig_init: cannot spawn progress thread: %s\n", strerror(ret));
-    } 
-  }
+  dht->stats.tappends[ptindex] = 0;
+
+  // no arrivals seen yet, refill starts out at the minimum headroom
+  dht->ptl.refill_t[ptindex]    = pdht_trig_now();
+  dht->ptl.refill_n[ptindex]    = 0;
+  dht->ptl.refill_rate[ptindex] = 0.0;
 }
 
 
@@ -140,9 +86,7 @@ void pdht_trig_fini(pdht_t *dht) {
   for (int ptindex=0; ptindex < dht->ptl.nptes; ptindex++) 
     PtlPTDisable(dht->ptl.lni, dht->ptl.putindex[ptindex]);
 
-  if (c->dhtcount == 0)  {
-    pthread_join(c->progress_tid, NULL);
-  }
+  // progress engine has already dropped our event queues (pdht_progress_unregister)
 
   // remove all match entries from the table
   iter = (char *)dht->ht;
@@ -185,148 +129,227 @@ void pdht_trig_fini(pdht_t *dht) {
     }
   }
 
-  // release all storage for ht objects
-  free(dht->ht);
+  // release all storage for ht objects, shared entries are unmapped by pdht_shm_fini()
+  if (!dht->shm)
+    free(dht->ht);
+}
+
+
+
+/**
+ * pdht_trig_event - handles an event from a pending put queue (triggered mode)
+ *   triggered appends do the real work, only flow control needs attention.
+ *   called by the progress thread that owns ptindex
+ * @param dht - hash table data structure
+ * @param ev - event from the pending EQ of ptindex
+ * @param ptindex - PTE pair the event arrived on
+ */
+void pdht_trig_event(pdht_t *dht, ptl_event_t *ev, unsigned ptindex) {
+  switch (ev->type) {
+  case PTL_EVENT_PUT:
+    break;
+  case PTL_EVENT_SEARCH:
+    break;
+  case PTL_EVENT_PT_DISABLED:
+    assert(ptindex < dht->ptl.nptes);
+    dht->ptl.disabled[ptindex] = 1; // re-enabled once the queue is refilled
+    break;
+  default:
+    pdht_dprintf("pdht_trig_event: found event on queue from PTE %d\n", ptindex);
+    pdht_dump_event(ev);
+    break;
+  }
+}
+
+
+
+/**
+ * pdht_trig_refill - replaces consumed pending entries and re-enables a flow controlled PTE
+ *   called by the progress thread that owns ptindex, without the completion mutex.
+ *
+ *   the pending queue is topped up a little on every pass instead of in one
+ *   pendq_size/2 burst. the arrival rate of the PTE is tracked as an EWMA and
+ *   sets the headroom (posted entries) we want to keep. while the queue is
+ *   below that target the whole gap is refilled at once, otherwise at most
+ *   PDHT_REFILL_CHUNK entries per pass.
+ * @param dht - hash table data structure
+ * @param ptindex - PTE pair to refill
+ */
+void pdht_trig_refill(pdht_t *dht, unsigned ptindex) {
+  u_int64_t consumed, now, elapsed;
+  double rate;
+  unsigned posted, target, want;
+
+  consumed = __atomic_load_n(&dht->stats.tappends[ptindex], __ATOMIC_RELAXED);
+  now      = pdht_trig_now();
+
+  // sample the arrival rate (entries/ms) at most once per sample period
+  elapsed = now - dht->ptl.refill_t[ptindex];
+  if (elapsed >= PDHT_REFILL_SAMPLE_NS) {
+    rate = (double)(consumed - dht->ptl.refill_n[ptindex]) * 1e6 / elapsed;
+    dht->ptl.refill_rate[ptindex] += PDHT_REFILL_ALPHA * (rate - dht->ptl.refill_rate[ptindex]);
+    dht->ptl.refill_t[ptindex] = now;
+    dht->ptl.refill_n[ptindex] = consumed;
+  }
+
+  posted = (consumed < dht->pendq_size) ? dht->pendq_size - consumed : 0;
+
+  // keep enough posted to cover the expected arrivals, but never more than a full queue
+  target = (unsigned)(dht->ptl.refill_rate[ptindex] * PDHT_REFILL_HORIZON_MS);
+  if (target < dht->pendq_size / 4)
+    target = dht->pendq_size / 4;
+  if (target > dht->pendq_size)
+    target = dht->pendq_size;
+
+  if (posted < target)
+    want = target - posted;                    // below headroom, close the whole gap now
+  else if (consumed >= PDHT_REFILL_CHUNK)
+    want = PDHT_REFILL_CHUNK;                  // trickle in the rest of the deficit
+  else
+    want = 0;
+
+  if (want > 0) {
+    if (want > consumed)
+      want = consumed;
+
+    // entries we can't get (table full) are written off all the same
+    pdht_trig_post(dht, ptindex, want);
+    __atomic_sub_fetch(&dht->stats.tappends[ptindex], want, __ATOMIC_RELAXED); // LINK events may bump it concurrently
+    dht->ptl.refill_n[ptindex] -= want;
+  }
+
+  // turn on pending queue if it was disabled from flow control
+  if (dht->ptl.disabled[ptindex]) {
+    pdht_dprintf("pdht_trig_refill: re-enabling PTE: %d\n", ptindex);
+    PtlPTEnable(dht->ptl.lni, dht->ptl.putindex[ptindex]);
+    dht->ptl.disabled[ptindex] = 0;
+  }
 }
 
 
 
 /**
- * pdht_trig_progress - progress thread for triggered mode
- */ 
-void *pdht_trig_progress(void *arg) {
-  pdht_t *dht;
+ * pdht_trig_post_entry - posts one table entry to a pending queue
+ *   a one-time pending ME plus a triggered append to the active PTE, the
+ *   entry's trigger counter must already be allocated and zero
+ * @param dht - hash table data structure
+ * @param ptindex - PTE pair to post to
+ * @param hte - table entry
+ */
+static void pdht_trig_post_entry(pdht_t *dht, unsigned ptindex, _pdht_ht_trigentry_t *hte) {
+  unsigned hdrsize;
+  int ret;
+
+  // only xfer latter half of ME entry in put to pending ME
+  hdrsize = sizeof(ptl_me_t) - offsetof(ptl_me_t, match_bits); 
+
+  // set pending ME params / options
+  hte->me.start         = &hte->me.match_bits; // each entry has a unique memory buffer
+  hte->me.length        = hdrsize + PDHT_MAXKEYSIZE + dht->elemsize;
+  hte->me.uid           = PTL_UID_ANY;
+  hte->me.options       = PTL_ME_OP_PUT 
+                        | PTL_ME_USE_ONCE 
+                        | PTL_ME_EVENT_CT_COMM 
+                        | PTL_ME_IS_ACCESSIBLE | PTL_ME_EVENT_UNLINK_DISABLE 
+                        | PTL_ME_EVENT_LINK_DISABLE;
+  hte->me.match_id.rank = PTL_RANK_ANY;
+  hte->me.match_bits    = __PDHT_PENDING_MATCH;
+  hte->me.ignore_bits   = 0xffffffffffffffff; // ignore it all
+  hte->me.ct_handle     = hte->tct;
+
+  // append ME to the pending ME list
+  ret = PtlMEAppend(dht->ptl.lni, dht->ptl.putindex[ptindex], &hte->me, PTL_PRIORITY_LIST, hte, &hte->pme);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_trig_post: PtlMEAppend error (%d) used: %u: %s\n", 
+                hte->me.length, dht->usedentries,pdht_ptl_error(ret));
+    exit(1);
+  }
+
+  // fix up ME entry data for future triggered append
+  hte->me.start         = &hte->key;
+  hte->me.length        = PDHT_MAXKEYSIZE + dht->elemsize;
+  hte->me.options       = PTL_ME_OP_GET 
+                        | PTL_ME_OP_PUT
+                        | PTL_ME_IS_ACCESSIBLE 
+                        | PTL_ME_EVENT_COMM_DISABLE
+                        | PTL_ME_EVENT_UNLINK_DISABLE;
+  hte->me.ignore_bits   = 0;
+
+  // once match bits have been copied, append to active match list
+  ret = PtlTriggeredMEAppend(dht->ptl.lni, dht->ptl.getindex[ptindex], 
+                             &hte->me, PTL_PRIORITY_LIST,
+                             hte, &hte->ame, hte->tct, 1);
+  if (ret != PTL_OK) {
+    pdht_dprintf("pdht_trig_post: PtlTriggeredMEAppend error: %s\n", pdht_ptl_error(ret));
+    exit(1);
+  }
+}
+
+
+
+/**
+ * pdht_trig_post - claims free table entries and posts them to a pending queue
+ *   each entry gets a one-time pending ME and a triggered append to the active PTE
+ * @param dht - hash table data structure
+ * @param ptindex - PTE pair to post to
+ * @param want - number of entries to post
+ * @returns number of entries posted (fewer than want if the table is full)
+ */
+static unsigned pdht_trig_post(pdht_t *dht, unsigned ptindex, unsigned want) {
   _pdht_ht_trigentry_t *hte;
   char *index; // used for pointer math
-  ptl_me_t me;
-  ptl_event_t ev;
-  unsigned hdrsize;
-  int disabled_pts[PDHT_MAX_PTES];
-  int ret, which, lothresh;
-
-  while (c->dhtcount > 0) {
-
-    /* iterate over all active tables */
-    for (int cur=0; cur < c->dhtcount; cur++) {
-      dht = c->hts[cur]; 
-
-      // count up link events from appending things to the active queue
-      pthread_mutex_lock(&dht->completion_mutex);
-      pdht_finalize_puts(dht);
-      pthread_mutex_unlock(&dht->completion_mutex);
-
-      index = (char *)dht->ht;
-      index += (dht->nextfree * dht->entrysize);
-
-      // only xfer latter half of ME entry in put to pending ME
-      hdrsize = sizeof(ptl_me_t) - offsetof(ptl_me_t, match_bits); 
- 
-      // reset our flow control tracking array
-      memset(disabled_pts,0,sizeof(disabled_pts));
-
-      // clean out any events on the pending event queue
-      while (PtlEQPoll(dht->ptl.eq, dht->ptl.nptes, 10, &ev, &which) == PTL_OK) {
-         switch (ev.type) {
-         case PTL_EVENT_PUT:
-           break;
-         case PTL_EVENT_SEARCH:
-           break;
-         case PTL_EVENT_PT_DISABLED:
-           assert(which < dht->ptl.nptes);
-           disabled_pts[which] = 1; // remember disabled PTs for later
-           break;
-         default:
-           pdht_dprintf("pdht_trig_progress: found event on queue from PTE %d\n", which);
-           pdht_dump_event(&ev);
-           break;
-         }
-      }
+  unsigned first, n;
+  int ret;
+
+  // don't create pending queue entries beyond maxentries count 
+  n = pdht_entry_claim(dht, want, &first);
+  index = (char *)dht->ht + (first * dht->entrysize);
+
+  for (int i=0; i < n; i++) {
+    hte = (_pdht_ht_trigentry_t *)index;
+
+    // allocate per-pending elem trigger event counter
+    ret = PtlCTAlloc(dht->ptl.lni, &hte->tct);
+    if (ret != PTL_OK) {
+      pdht_dprintf("pdht_trig_post: PtlCTAlloc failure: %s (%d used: %u max: %u)\n", 
+      pdht_ptl_error(ret), i, dht->usedentries, dht->maxentries);
+      exit(1);
+    }
+
+    pdht_trig_post_entry(dht, ptindex, hte);
+    index += dht->entrysize; // pointer math, danger.
+  }
+  return n;
+}
+
 
-      // for each active PTE in this table,
-      for (int ptindex=0; ptindex < dht->ptl.nptes; ptindex++) {
-        lothresh = dht->pendq_size / 2;
-        
-        // check to see if we've exhausted pending ME entries
-        if (dht->stats.tappends[ptindex] >= lothresh) {
-          pdht_lprintf(PDHT_DEBUG_VERBOSE, "refilling pending queue\n", c->rank);
-
-          // if so, refill the pending queue
-          for (int i=0; i < lothresh; i++) {
-            hte = (_pdht_ht_trigentry_t *)index;
-
-            // don't create pending queue entries beyond maxentries count 
-            if (dht->usedentries >= dht->maxentries)
-              break;
-
-            // allocate per-pending elem trigger event counter
-            ret = PtlCTAlloc(dht->ptl.lni, &hte->tct);
-            if (ret != PTL_OK) {
-              pdht_dprintf("pdht_trig_progress: PtlCTAlloc failure: %s (%d used: %ld max: %ld)\n", 
-              pdht_ptl_error(ret), i, dht->usedentries, dht->maxentries);
-              exit(1);
-            }
-
-            // set pending ME params / options
-            hte->me.start         = &hte->me.match_bits; // each entry has a unique memory buffer
-            hte->me.length        = hdrsize + PDHT_MAXKEYSIZE + dht->elemsize;
-            hte->me.uid           = PTL_UID_ANY;
-            hte->me.options       = PTL_ME_OP_PUT 
-                                  | PTL_ME_USE_ONCE 
-                                  | PTL_ME_EVENT_CT_COMM 
-                                  | PTL_ME_IS_ACCESSIBLE | PTL_ME_EVENT_UNLINK_DISABLE 
-                                  | PTL_ME_EVENT_LINK_DISABLE;
-            hte->me.match_id.rank = PTL_RANK_ANY;
-            hte->me.match_bits    = __PDHT_PENDING_MATCH;
-            hte->me.ignore_bits   = 0xffffffffffffffff; // ignore it all
-            hte->me.ct_handle     = hte->tct;
-
-            // append ME to the pending ME list
-            ret = PtlMEAppend(dht->ptl.lni, dht->ptl.putindex[ptindex], &hte->me, PTL_PRIORITY_LIST, hte, &hte->pme);
-            
-            if (ret != PTL_OK) {
-              pdht_dprintf("pdht_trig_progress: PtlMEAppend error (%d:%d) used: %ld: %s\n", 
-                          i, hte->me.length, dht->usedentries,pdht_ptl_error(ret));
-              exit(1);
-            }
-
-            // fix up ME entry data for future triggered append
-            hte->me.start         = &hte->key;
-            hte->me.length        = PDHT_MAXKEYSIZE + dht->elemsize;
-            hte->me.options       = PTL_ME_OP_GET 
-                                  | PTL_ME_OP_PUT
-                                  | PTL_ME_IS_ACCESSIBLE 
-                                  | PTL_ME_EVENT_COMM_DISABLE
-                                  | PTL_ME_EVENT_UNLINK_DISABLE;
-            hte->me.ignore_bits   = 0;
-
-            // once match bits have been copied, append to active match list
-            ret = PtlTriggeredMEAppend(dht->ptl.lni, dht->ptl.getindex[ptindex], 
-                                       &hte->me, PTL_PRIORITY_LIST,
-                                       hte, &hte->ame, hte->tct, 1);
-            if (ret != PTL_OK) {
-              pdht_dprintf("pdht_trig_progress: PtlTriggeredMEAppend error (iteration %d)\n",i );
-              exit(1);
-            }
-
-            index += dht->entrysize; // pointer math, danger.
-            dht->nextfree++;
-            dht->usedentries++;
-          } // refill
-
-          dht->stats.tappends[ptindex] -= lothresh; // reset the number of consumed pending entries
-
-        } // if exhausted
-
-        // turn on pending queue if it was disabled from flow control
-        if (disabled_pts[ptindex]) {
-          pdht_dprintf("pdht_trig_progress: re-enabling PTE: %d\n", ptindex);
-          PtlPTEnable(dht->ptl.lni, dht->ptl.putindex[ptindex]);
-        }
-
-      } // PTE loop
-    } // HT loop
-  } // forever loop
-  return NULL;
+
+/**
+ * pdht_trig_repost - puts an entry whose put was merged elsewhere back on its pending queue
+ *   the put went into an existing entry or bucket/direct storage, so the
+ *   triggered append only linked a copy nobody uses. reusing the entry keeps
+ *   it from being written off. called by the progress thread that owns
+ *   ptindex, after the copy's ME is unlinked. the refill doesn't count it.
+ * @param dht - hash table data structure
+ * @param ptindex - PTE pair the entry came from
+ * @param entry - table entry
+ */
+void pdht_trig_repost(pdht_t *dht, unsigned ptindex, void *entry) {
+  _pdht_ht_trigentry_t *hte = (_pdht_ht_trigentry_t *)entry;
+  ptl_ct_event_t zero = { 0, 0 };
+
+  PtlCTSet(hte->tct, zero);
+  pdht_trig_post_entry(dht, ptindex, hte);
+}
+
+
+
+/**
+ * pdht_trig_now - monotonic clock in nanoseconds, for arrival rate tracking
+ */
+static u_int64_t pdht_trig_now(void) {
+  struct timespec ts = pdht_get_wtime();
+  return (1000000000ULL * ts.tv_sec) + ts.tv_nsec;
 }
 
 
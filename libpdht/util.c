@@ -277,13 +277,11 @@ void pdht_print_active(pdht_t *dht, void kprinter(void *key), void vprinter(void
   char *iter;
   int pending = 0;
   _pdht_ht_trigentry_t *hte;
-  long *key;
 
   iter = (char *)dht->ht;
 
   for (int i=0; i < dht->maxentries; i++) {
     hte = (_pdht_ht_trigentry_t *)iter;
-    key = (long *)hte->key;
     if (hte->ame != PTL_INVALID_HANDLE) {
       pdht_dprintf("elem %d: mbits: %12"PRIx64" ptr: %p ", i, hte->me.match_bits, &hte->key);
       //pdht_dprintf(" pkey: %ld ", key[0]);
@@ -305,11 +303,11 @@ void pdht_print_active(pdht_t *dht, void kprinter(void *key), void vprinter(void
  * pdht_print_stats - prints out runtime statistics
  */
 void pdht_print_stats(pdht_t *dht) {
-  u_int64_t ilocal[6];
-  u_int64_t tilocal[6];
-  u_int64_t isum[6];
-  u_int64_t imin[6];
-  u_int64_t imax[6];
+  u_int64_t ilocal[7];
+  u_int64_t tilocal[7];
+  u_int64_t isum[7];
+  u_int64_t imin[7];
+  u_int64_t imax[7];
   double    dlocal[8];
   double    dsum[8];
   double    dmin[8];
@@ -323,6 +321,7 @@ void pdht_print_stats(pdht_t *dht) {
   ilocal[3] = dht->stats.notfound;
   ilocal[4] = dht->stats.updates;
   ilocal[5] = dht->stats.inserts;
+  ilocal[6] = dht->stats.shmops;
  
   memcpy(tilocal,ilocal,sizeof(ilocal));
 
@@ -337,11 +336,11 @@ void pdht_print_stats(pdht_t *dht) {
   
   memcpy(tdlocal,dlocal,sizeof(dlocal)); //have to set temp locals because they are manipulated for pdht_allreduce
   
-  pdht_allreduce(tilocal, isum, PdhtReduceOpSum, LongType, 6);
+  pdht_allreduce(tilocal, isum, PdhtReduceOpSum, LongType, 7);
   memcpy(tilocal,ilocal,sizeof(ilocal));
-  pdht_allreduce(tilocal, imin, PdhtReduceOpMin, LongType, 6);
+  pdht_allreduce(tilocal, imin, PdhtReduceOpMin, LongType, 7);
   memcpy(tilocal,ilocal,sizeof(ilocal));
-  pdht_allreduce(tilocal, imax, PdhtReduceOpMax, LongType, 6);
+  pdht_allreduce(tilocal, imax, PdhtReduceOpMax, LongType, 7);
 
   pdht_allreduce(tdlocal, dsum, PdhtReduceOpSum, DoubleType, 8);
   memcpy(tdlocal,dlocal,sizeof(dlocal));
@@ -358,6 +357,8 @@ void pdht_print_stats(pdht_t *dht) {
     printf("\tgets:       min: %12"PRIu64"\tmax: %12"PRIu64"\t total: %12"PRIu64"\n", imin[1], imax[1], isum[1]);
     printf("\tcollisions: min: %12"PRIu64"\tmax: %12"PRIu64"\t total: %12"PRIu64"\n", imin[2], imax[2], isum[2]);
     printf("\tnotfound:   min: %12"PRIu64"\tmax: %12"PRIu64"\t total: %12"PRIu64"\n", imin[3], imax[3], isum[3]);
+    printf("\tshm ops:    min: %12"PRIu64"\tmax: %12"PRIu64"\t total: %12"PRIu64"\n", imin[6], imax[6], isum[6]);
+    printf("\tPTEs:       %12u\t(scaled %"PRIu64" times, max %u)\n", dht->ptl.nptes, dht->stats.ptgrowths, dht->ptl.maxptes);
     printf("\tputtime:    min: %10.4f sec\t max:%10.4f sec avg: %10.4f\n", 
                   dmin[0]/(double)1e9, dmax[0]/(double)1e9, dsum[0]/(double)(c->size * 1e9));
     printf("\tgettime:    min: %10.4f sec\t max:%10.4f sec avg: %10.4f\n", 
@@ -0,0 +1,278 @@
+/***********************************************************/
+/*                                                         */
+/*  comm.c - PDHT TCP backend client side connections      */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * each rank keeps at most one blocking socket to every other rank (and one
+ * to itself), opened the first time it is needed. requests that don't need
+ * an answer (puts) are queued in a per-connection buffer and written in
+ * batches of PDHT_TCP_BATCH bytes. a call flushes whatever is queued along
+ * with its own request and waits for the reply; the server handles a
+ * connection in order, so the reply to a call is always the next one read.
+ */
+
+static void pdht_comm_connect(int rank);
+static void pdht_comm_queue(pdht_conn_t *cn, pdht_msgtype_t type, int ht, uint64_t arg, const void *data, size_t len);
+static void pdht_comm_flush(pdht_conn_t *cn);
+
+
+
+/**
+ * pdht_comm_init - sets up (unconnected) connection state for every rank
+ */
+void pdht_comm_init(void) {
+  c->conns = calloc(c->size, sizeof(pdht_conn_t));
+  for (int i=0; i < c->size; i++) {
+    c->conns[i].fd = -1;
+    pthread_mutex_init(&c->conns[i].lock, NULL);
+  }
+}
+
+
+
+/**
+ * pdht_comm_fini - flushes and closes all open connections
+ */
+void pdht_comm_fini(void) {
+  for (int i=0; i < c->size; i++) {
+    if (c->conns[i].fd >= 0) {
+      pdht_comm_flush(&c->conns[i]);
+      close(c->conns[i].fd);
+    }
+    free(c->conns[i].obuf);
+    pthread_mutex_destroy(&c->conns[i].lock);
+  }
+  free(c->conns);
+  c->conns = NULL;
+}
+
+
+
+/**
+ * pdht_comm_connect - opens the connection to a rank, waiting for it to come up
+ * @param rank target rank
+ */
+static void pdht_comm_connect(int rank) {
+  struct addrinfo hints, *res;
+  char port[16];
+  double deadline = pdht_wtime() + PDHT_TCP_CONNECT_SECS;
+  struct timespec ts = { 0, 10000000 };
+  int fd, ret, one = 1;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(port, sizeof(port), "%d", c->port + rank);
+
+  ret = getaddrinfo(c->hosts[rank % c->nhosts], port, &hints, &res);
+  if (ret != 0) {
+    pdht_dprintf("pdht_comm_connect: unable to resolve %s: %s\n", c->hosts[rank % c->nhosts], gai_strerror(ret));
+    exit(1);
+  }
+
+  // peers start at different times, keep trying until they are listening
+  for (;;) {
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+      pdht_dprintf("pdht_comm_connect: socket: %s\n", strerror(errno));
+      exit(1);
+    }
+    if (connect(fd, res->ai_addr, res->ai_addrlen) == 0)
+      break;
+    close(fd);
+    if (pdht_wtime() > deadline) {
+      pdht_dprintf("pdht_comm_connect: unable to reach rank %d at %s:%s: %s\n",
+          rank, c->hosts[rank % c->nhosts], port, strerror(errno));
+      exit(1);
+    }
+    nanosleep(&ts, NULL);
+  }
+  freeaddrinfo(res);
+
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  c->conns[rank].fd = fd;
+}
+
+
+
+/**
+ * pdht_comm_queue - appends a request to a connection's output buffer
+ * @param cn connection (locked)
+ * @param type request type
+ * @param ht table index
+ * @param arg request specific argument
+ * @param data request payload
+ * @param len payload length
+ */
+static void pdht_comm_queue(pdht_conn_t *cn, pdht_msgtype_t type, int ht, uint64_t arg, const void *data, size_t len) {
+  pdht_msg_t *msg;
+  size_t need = cn->olen + PDHT_MSG_SIZE(len);
+
+  if (need > cn->ocap) {
+    cn->ocap = cn->ocap ? cn->ocap : 2*PDHT_TCP_BATCH;
+    while (cn->ocap < need)
+      cn->ocap *= 2;
+    cn->obuf = realloc(cn->obuf, cn->ocap);
+  }
+
+  msg = (pdht_msg_t *)(cn->obuf + cn->olen);
+  msg->len  = len;
+  msg->type = type;
+  msg->ht   = ht;
+  msg->arg  = arg;
+  if (len)
+    memcpy(msg->data, data, len);
+  cn->olen = need;
+}
+
+
+
+/**
+ * pdht_comm_flush - writes out all queued requests
+ * @param cn connection (locked)
+ */
+static void pdht_comm_flush(pdht_conn_t *cn) {
+  if (cn->olen == 0)
+    return;
+  if (pdht_comm_writeall(cn->fd, cn->obuf, cn->olen) != 0) {
+    pdht_dprintf("pdht_comm_flush: write failed: %s\n", strerror(errno));
+    exit(1);
+  }
+  cn->olen = 0;
+}
+
+
+
+/**
+ * pdht_comm_send - queues a request that has no reply
+ * @param rank target rank
+ * @param type request type
+ * @param ht table index
+ * @param arg request specific argument
+ * @param data request payload
+ * @param len payload length
+ */
+void pdht_comm_send(int rank, pdht_msgtype_t type, int ht, uint64_t arg, const void *data, size_t len) {
+  pdht_conn_t *cn = &c->conns[rank];
+
+  pthread_mutex_lock(&cn->lock);
+  if (cn->fd < 0)
+    pdht_comm_connect(rank);
+  pdht_comm_queue(cn, type, ht, arg, data, len);
+  cn->dirty = 1;
+  if (cn->olen >= PDHT_TCP_BATCH)
+    pdht_comm_flush(cn);
+  pthread_mutex_unlock(&cn->lock);
+}
+
+
+
+/**
+ * pdht_comm_call - sends a request along with anything queued, waits for the reply
+ * @param rank target rank
+ * @param type request type
+ * @param ht table index
+ * @param arg request specific argument
+ * @param data request payload
+ * @param len payload length
+ * @param reply buffer for the reply payload
+ * @param rlen size of reply buffer, any extra reply payload is dropped
+ * @returns status carried in the reply
+ */
+pdht_status_t pdht_comm_call(int rank, pdht_msgtype_t type, int ht, uint64_t arg, const void *data, size_t len,
+                             void *reply, size_t rlen) {
+  pdht_conn_t *cn = &c->conns[rank];
+  pdht_msg_t hdr;
+  size_t plen, n;
+  char scratch[256];
+
+  pthread_mutex_lock(&cn->lock);
+  if (cn->fd < 0)
+    pdht_comm_connect(rank);
+  pdht_comm_queue(cn, type, ht, arg, data, len);
+  pdht_comm_flush(cn);
+
+  if (pdht_comm_readall(cn->fd, (char *)&hdr, sizeof(hdr)) != 0) {
+    pdht_dprintf("pdht_comm_call: lost connection to rank %d\n", rank);
+    exit(1);
+  }
+
+  plen = PDHT_MSG_SIZE(hdr.len) - sizeof(hdr);
+  n = hdr.len < rlen ? hdr.len : rlen;
+  if ((n > 0) && (pdht_comm_readall(cn->fd, reply, n) != 0)) {
+    pdht_dprintf("pdht_comm_call: lost connection to rank %d\n", rank);
+    exit(1);
+  }
+  // skip padding and anything that didn't fit
+  for (plen -= n; plen > 0; plen -= n) {
+    n = plen < sizeof(scratch) ? plen : sizeof(scratch);
+    if (pdht_comm_readall(cn->fd, scratch, n) != 0) {
+      pdht_dprintf("pdht_comm_call: lost connection to rank %d\n", rank);
+      exit(1);
+    }
+  }
+  pthread_mutex_unlock(&cn->lock);
+
+  return hdr.type;
+}
+
+
+
+/**
+ * pdht_comm_writeall - writes a whole buffer to a blocking socket
+ * @param fd socket
+ * @param buf data
+ * @param len length of data
+ * @returns 0 on success, -1 on error
+ */
+int pdht_comm_writeall(int fd, const char *buf, size_t len) {
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+
+
+/**
+ * pdht_comm_readall - reads exactly len bytes from a blocking socket
+ * @param fd socket
+ * @param buf destination
+ * @param len number of bytes
+ * @returns 0 on success, -1 on error or EOF
+ */
+int pdht_comm_readall(int fd, char *buf, size_t len) {
+  ssize_t n;
+
+  while (len > 0) {
+    n = read(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (n == 0)
+      return -1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
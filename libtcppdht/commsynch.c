@@ -0,0 +1,111 @@
+/***********************************************************/
+/*                                                         */
+/*  commsynch.c - PDHT TCP backend synchronization         */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+#define PDHT_COUNTER_HOLDER 0
+#define PDHT_REDUCE_ROOT    0
+
+
+
+/**
+ * pdht_barrier - blocks until every rank has arrived
+ */
+void pdht_barrier(void) {
+  int in = 0, out;
+  pdht_allreduce(&in, &out, PdhtReduceOpSum, IntType, 1);
+}
+
+
+
+/**
+ * pdht_fence - waits until all puts from all ranks have been applied
+ * @param dht hash table (all tables are fenced)
+ */
+void pdht_fence(pdht_t *dht) {
+  // a fence reply means everything queued before it on that connection is done
+  for (int i=0; i < c->size; i++) {
+    if (c->conns[i].dirty) {
+      c->conns[i].dirty = 0;
+      pdht_comm_call(i, pdhtFence, dht->index, 0, NULL, 0, NULL, 0);
+    }
+  }
+  pdht_barrier();
+}
+
+
+
+/**
+ * pdht_allreduce - reduces values from all ranks and returns the result to all
+ * @param in local contribution
+ * @param out reduced result
+ * @param op reduction operator
+ * @param type element type
+ * @param elems number of elements
+ * @returns status of operation
+ */
+pdht_status_t pdht_allreduce(void *in, void *out, pdht_reduceop_t op, pdht_datatype_t type, int elems) {
+  size_t len = (size_t)pdht_typesize(type) * elems;
+
+  return pdht_comm_call(PDHT_REDUCE_ROOT, pdhtReduce, 0, PDHT_REDUCE_ARG(op, type, elems), in, len, out, len);
+}
+
+
+
+/*
+ * pdht_counter_init - initializes a new atomic counter for a hash table
+ * @param ht - a PDHT hash table
+ * @param initval - initial counter value
+ * @returns index of the new counter
+ */
+int pdht_counter_init(pdht_t *ht, int initval) {
+  int cindex;
+
+  if (ht->counter_count >= PDHT_MAX_COUNTERS) {
+    pdht_dprintf("pdht_counter_init: out of counters (max: %d)\n", PDHT_MAX_COUNTERS);
+    return -1;
+  }
+  cindex = ht->counter_count++;
+
+  // the holder's server thread is the only other user of the counter
+  if (c->rank == PDHT_COUNTER_HOLDER)
+    __atomic_store_n(&ht->counters[cindex], (uint64_t)initval, __ATOMIC_SEQ_CST);
+
+  return cindex;
+}
+
+
+
+/**
+ * pdht_counter_reset - collectively reset an HT atomic counter
+ * @param ht - a hash table
+ * @param counter - which counter to reset
+ */
+void pdht_counter_reset(pdht_t *ht, int counter) {
+  if (c->rank == PDHT_COUNTER_HOLDER)
+    __atomic_store_n(&ht->counters[counter], 0, __ATOMIC_SEQ_CST);
+  pdht_barrier();
+}
+
+
+
+/**
+ * pdht_counter_inc - increments a counter by a given value
+ * @param ht a hash table
+ * @param counter index of the counter to modify
+ * @param val amount to increment counter by
+ * @returns existing counter value
+ */
+uint64_t pdht_counter_inc(pdht_t *ht, int counter, uint64_t val) {
+  uint32_t cindex = counter;
+  uint64_t old = 0;
+
+  pdht_comm_call(PDHT_COUNTER_HOLDER, pdhtCounterInc, ht->index, val, &cindex, sizeof(cindex), &old, sizeof(old));
+  return old;
+}
@@ -0,0 +1,18 @@
+/***********************************************************/
+/*                                                         */
+/*  evembed.c - bundled libev, built into libtcppdht       */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+// no configure step, pick the Linux backends by hand (see libev's EMBEDDING docs)
+#define EV_STANDALONE   1
+#define EV_USE_EPOLL    1
+#define EV_USE_POLL     1
+#define EV_USE_SELECT   1
+#define EV_USE_EVENTFD  1
+#define EV_USE_MONOTONIC 1
+
+#include "ev.c"
@@ -0,0 +1,36 @@
+/***********************************************************/
+/*                                                         */
+/*  hash.c - PDHT TCP backend key placement                */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+#include <city.h>
+
+/**
+ * pdht_hash - default hash function, same placement as the MPI backend
+ * @param dht hash table
+ * @param key the key
+ * @param mbits 64-bit hash of the key
+ * @param ptindex always zero
+ * @param rank owner of the key
+ */
+void pdht_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank) {
+  *mbits = CityHash64((char *)key, dht->keysize);
+  *ptindex = 0;
+  (*rank).rank = *mbits % c->size;
+}
+
+
+
+/**
+ * pdht_sethash - replaces the hash function for a table
+ * @param dht hash table
+ * @param hfun new hash function
+ */
+void pdht_sethash(pdht_t *dht, pdht_hashfunc hfun) {
+  dht->hashfn = hfun;
+}
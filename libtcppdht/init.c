@@ -0,0 +1,156 @@
+/***********************************************************/
+/*                                                         */
+/*  init.c - PDHT TCP backend initialization/teardown      */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * there is no launcher dependency, a rank learns its place from the
+ * environment. the first of PDHT_RANK, PMI_RANK, OMPI_COMM_WORLD_RANK and
+ * SLURM_PROCID that is set gives the rank (sizes likewise). PDHT_HOSTS is a
+ * comma separated list of hosts, rank r runs on entry r % nhosts (default:
+ * everyone on 127.0.0.1). rank r listens on PDHT_PORT + r (default 7400).
+ */
+
+static void pdht_init(void);
+static int  pdht_envint(const char **names, int dflt);
+
+// global pdht context
+pdht_context_t *c = NULL;
+
+static const char *pdht_rank_vars[] = { "PDHT_RANK", "PMI_RANK", "OMPI_COMM_WORLD_RANK", "SLURM_PROCID", NULL };
+static const char *pdht_size_vars[] = { "PDHT_SIZE", "PMI_SIZE", "OMPI_COMM_WORLD_SIZE", "SLURM_NTASKS", NULL };
+static const char *pdht_port_vars[] = { "PDHT_PORT", NULL };
+
+
+
+/**
+ * pdht_envint - first integer environment variable that is set
+ * @param names NULL-terminated list of variable names
+ * @param dflt value if none are set
+ */
+static int pdht_envint(const char **names, int dflt) {
+  char *v;
+
+  for (int i=0; names[i]; i++) {
+    if ((v = getenv(names[i])) != NULL)
+      return atoi(v);
+  }
+  return dflt;
+}
+
+
+
+/**
+ * pdht_init - initializes PDHT system
+ */
+static void pdht_init(void) {
+  char *hosts, *h, *save;
+
+  c = (pdht_context_t *)calloc(1, sizeof(pdht_context_t));
+  c->rank = pdht_envint(pdht_rank_vars, 0);
+  c->size = pdht_envint(pdht_size_vars, 1);
+  c->port = pdht_envint(pdht_port_vars, PDHT_TCP_DEFAULT_PORT);
+
+  if ((c->size < 1) || (c->rank < 0) || (c->rank >= c->size)) {
+    fprintf(stderr, "pdht_init: bad rank/size from environment: %d/%d\n", c->rank, c->size);
+    exit(1);
+  }
+
+  hosts = strdup(getenv("PDHT_HOSTS") ? getenv("PDHT_HOSTS") : PDHT_TCP_DEFAULT_HOST);
+  c->hosts = calloc(strlen(hosts) / 2 + 2, sizeof(char *));
+  for (h = strtok_r(hosts, ",", &save); h; h = strtok_r(NULL, ",", &save))
+    c->hosts[c->nhosts++] = strdup(h);
+  if (c->nhosts == 0)
+    c->hosts[c->nhosts++] = strdup(PDHT_TCP_DEFAULT_HOST);
+  free(hosts);
+
+  // a peer exiting early shouldn't kill us on write
+  signal(SIGPIPE, SIG_IGN);
+
+  pdht_comm_init();
+  pdht_server_start();
+}
+
+
+
+/**
+ * pdht_tune - tuning parameters do not apply to the TCP backend
+ * @param opts - options mask
+ * @param config - configuration
+ */
+void pdht_tune(unsigned opts, pdht_config_t *config) {
+  return;
+}
+
+
+
+/**
+ * pdht_create -- collectively allocates a new dht
+ * @returns the newly minted dht
+ */
+pdht_t *pdht_create(int keysize, int elemsize, pdht_mode_t mode) {
+  pdht_t *dht;
+
+  if (!c)
+    pdht_init();
+
+  if ((keysize > PDHT_MAXKEYSIZE) || (c->dhtcount >= PDHT_MAX_TABLES)) {
+    pdht_dprintf("pdht_create: keysize (%d) or table count (%d) too large\n", keysize, c->dhtcount);
+    return NULL;
+  }
+
+  dht = (pdht_t *)calloc(1, sizeof(pdht_t));
+  dht->keysize   = keysize;
+  dht->elemsize  = elemsize;
+  dht->hashfn    = pdht_hash;
+  dht->ptl.nptes = 1;
+  dht->index     = c->dhtcount;
+  pdht_table_init(dht);
+
+  __atomic_store_n(&c->hts[dht->index], dht, __ATOMIC_SEQ_CST);
+  c->dhtcount++;
+
+  // nobody sends to the new table until everyone has it
+  pdht_barrier();
+
+  return dht;
+}
+
+
+
+/**
+ * pdht_free -- collectively frees a dht
+ * @param dht - dht to free
+ */
+void pdht_free(pdht_t *dht) {
+  int last = (dht->index == c->dhtcount - 1);
+
+  pdht_fence(dht);
+
+  __atomic_store_n(&c->hts[dht->index], NULL, __ATOMIC_SEQ_CST);
+  if (last) {
+    while ((c->dhtcount > 0) && (c->hts[c->dhtcount - 1] == NULL))
+      c->dhtcount--;
+  }
+  pdht_table_fini(dht);
+  free(dht);
+
+  if (c->dhtcount == 0) {
+    pdht_barrier();      // everyone is done talking to us
+    pdht_server_stop();
+    pdht_comm_fini();
+    for (int i=0; i < c->nhosts; i++)
+      free(c->hosts[i]);
+    free(c->hosts);
+    free(c);
+    c = NULL;
+  }
+}
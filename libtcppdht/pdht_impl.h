@@ -0,0 +1,109 @@
+/***********************************************************/
+/*                                                         */
+/*  pdht_impl.h - PDHT TCP backend private protos/ADTs     */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#pragma once
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <pdht.h>
+#include <ev.h>
+
+#define PDHT_TCP_DEFAULT_PORT   7400
+#define PDHT_TCP_DEFAULT_HOST   "127.0.0.1"
+#define PDHT_TCP_BATCH          65536  // queued request bytes per connection before a flush
+#define PDHT_TCP_CONNECT_SECS   30     // keep retrying a peer that isn't listening yet
+#define PDHT_TCP_MIN_SLOTS      1024   // initial open addressing table size
+
+#define pdht_dprintf(...) pdht_dbg_printf(__VA_ARGS__)
+
+// request types, the reply type field carries a pdht_status_t instead
+enum pdht_msgtype_e {
+  pdhtGet,
+  pdhtPut,
+  pdhtCswap,
+  pdhtFence,
+  pdhtCounterInc,
+  pdhtReduce
+};
+typedef enum pdht_msgtype_e pdht_msgtype_t;
+
+// every request and reply on the wire starts with this header
+struct pdht_msg_s {
+  uint32_t len;   // payload bytes following the header
+  uint16_t type;  // request: pdht_msgtype_t, reply: pdht_status_t
+  uint16_t ht;    // table index (c->hts[])
+  uint64_t arg;   // request specific: counter increment, cswap offset, reduce op/type/count
+  char     data[0];
+};
+typedef struct pdht_msg_s pdht_msg_t;
+
+// messages are padded on the wire so that the next header stays aligned
+#define PDHT_MSG_SIZE(len) (sizeof(pdht_msg_t) + (((len) + 7) & ~(size_t)7))
+
+// packs reduce operator, datatype and element count into pdht_msg_t.arg
+#define PDHT_REDUCE_ARG(op, type, n) ((((uint64_t)(n)) << 16) | (((uint64_t)(op)) << 8) | (uint64_t)(type))
+#define PDHT_REDUCE_OP(arg)          ((pdht_reduceop_t)(((arg) >> 8) & 0xff))
+#define PDHT_REDUCE_TYPE(arg)        ((pdht_datatype_t)((arg) & 0xff))
+#define PDHT_REDUCE_COUNT(arg)       ((int)((arg) >> 16))
+
+// client side connection to one rank
+struct pdht_conn_s {
+  int              fd;     // -1 until first use
+  pthread_mutex_t  lock;   // one outstanding call per connection
+  char            *obuf;   // requests queued but not yet written (batched puts)
+  size_t           olen;
+  size_t           ocap;
+  int              dirty;  // puts sent since the last fence
+};
+typedef struct pdht_conn_s pdht_conn_t;
+
+// comm.c - client side connections
+void          pdht_comm_init(void);
+void          pdht_comm_fini(void);
+void          pdht_comm_send(int rank, pdht_msgtype_t type, int ht, uint64_t arg, const void *data, size_t len);
+pdht_status_t pdht_comm_call(int rank, pdht_msgtype_t type, int ht, uint64_t arg, const void *data, size_t len,
+                             void *reply, size_t rlen);
+int           pdht_comm_writeall(int fd, const char *buf, size_t len);
+int           pdht_comm_readall(int fd, char *buf, size_t len);
+
+// server.c - target side event loop
+void pdht_server_start(void);
+void pdht_server_stop(void);
+
+// table.c - open addressing table for the local part of a PDHT
+void  pdht_table_init(pdht_t *dht);
+void  pdht_table_fini(pdht_t *dht);
+char *pdht_table_find(pdht_t *dht, ptl_match_bits_t mbits, void *key);
+char *pdht_table_insert(pdht_t *dht, ptl_match_bits_t mbits, void *key);
+
+// util.c
+int   pdht_dbg_printf(const char *format, ...);
+int   pdht_typesize(pdht_datatype_t type);
+void  pdht_reduce_op(void *acc, void *in, pdht_reduceop_t op, pdht_datatype_t type, int elems);
+
+
+
+/**
+ * pdht_tcp_rank - owner of a key
+ */
+static inline int pdht_tcp_rank(pdht_t *dht, void *key, ptl_match_bits_t *mbits) {
+  ptl_process_t rank;
+  uint32_t ptindex;
+
+  dht->hashfn(dht, key, mbits, &ptindex, &rank);
+  return rank.rank;
+}
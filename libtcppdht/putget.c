@@ -0,0 +1,148 @@
+/***********************************************************/
+/*                                                         */
+/*  putget.c - PDHT TCP backend put/get operations         */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+static pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value);
+
+
+
+/**
+ * pdht_do_put - queues an insert/overwrite for the key's owner
+ *   puts are batched per destination, they are applied before any later
+ *   request to the same rank and are visible everywhere after pdht_fence()
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+static pdht_status_t pdht_do_put(pdht_t *dht, void *key, void *value) {
+  ptl_match_bits_t mbits;
+  char buf[sizeof(mbits) + dht->keysize + dht->elemsize];
+  int rank;
+
+  rank = pdht_tcp_rank(dht, key, &mbits);
+
+  // mbits | key | value
+  memcpy(buf, &mbits, sizeof(mbits));
+  memcpy(buf + sizeof(mbits), key, dht->keysize);
+  memcpy(buf + sizeof(mbits) + dht->keysize, value, dht->elemsize);
+
+  pdht_comm_send(rank, pdhtPut, dht->index, 0, buf, sizeof(buf));
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_put - adds an entry to the global hash table
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_put(pdht_t *dht, void *key, void *value) {
+  dht->puts++;
+  return pdht_do_put(dht, key, value);
+}
+
+
+
+/**
+ * pdht_add - adds an entry in the global hash table
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_add(pdht_t *dht, void *key, void *value) {
+  dht->puts++;
+  return pdht_do_put(dht, key, value);
+}
+
+
+
+/**
+ * pdht_update - overwrites an entry in the global hash table
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_update(pdht_t *dht, void *key, void *value) {
+  dht->puts++;
+  return pdht_do_put(dht, key, value);
+}
+
+
+
+/**
+ * pdht_get - gets an entry from the global hash table
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_get(pdht_t *dht, void *key, void *value) {
+  ptl_match_bits_t mbits;
+  char buf[sizeof(mbits) + dht->keysize];
+  pdht_status_t ret;
+  int rank;
+
+  dht->gets++;
+  rank = pdht_tcp_rank(dht, key, &mbits);
+
+  // mbits | key
+  memcpy(buf, &mbits, sizeof(mbits));
+  memcpy(buf + sizeof(mbits), key, dht->keysize);
+
+  ret = pdht_comm_call(rank, pdhtGet, dht->index, 0, buf, sizeof(buf), value, dht->elemsize);
+  if (ret == PdhtStatusNotFound)
+    dht->notfound++;
+  return ret;
+}
+
+
+
+/**
+ * pdht_persistent_get - gets an entry, waiting for it to be added if needed
+ *   @param key - hash table key
+ *   @param value - value for table entry
+ *   @returns status of operation
+ */
+pdht_status_t pdht_persistent_get(pdht_t *dht, void *key, void *value) {
+  struct timespec ts = { 0, 100000 };
+  pdht_status_t ret;
+
+  while ((ret = pdht_get(dht, key, value)) == PdhtStatusNotFound)
+    nanosleep(&ts, NULL);
+  return ret;
+}
+
+
+
+/**
+ * pdht_atomic_cswap - atomic compare/swap on a 64-bit word inside an entry
+ * @param ht - a PDHT hash table
+ * @param key - the key of the value to atomically update
+ * @param offset - offset inside the hash table entry to modify
+ * @param old - compare value in, copyout of the remote value _prior_ to the swap
+ * @param new - new value to swap into HT entry
+ */
+pdht_status_t pdht_atomic_cswap(pdht_t *ht, void *key, size_t offset, int64_t *old, int64_t new) {
+  ptl_match_bits_t mbits;
+  char buf[sizeof(mbits) + ht->keysize + 2*sizeof(int64_t)];
+  char *p = buf;
+  int rank;
+
+  rank = pdht_tcp_rank(ht, key, &mbits);
+
+  // mbits | key | compare | new
+  memcpy(p, &mbits, sizeof(mbits));   p += sizeof(mbits);
+  memcpy(p, key, ht->keysize);        p += ht->keysize;
+  memcpy(p, old, sizeof(int64_t));    p += sizeof(int64_t);
+  memcpy(p, &new, sizeof(int64_t));
+
+  return pdht_comm_call(rank, pdhtCswap, ht->index, offset, buf, sizeof(buf), old, sizeof(int64_t));
+}
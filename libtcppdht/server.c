@@ -0,0 +1,448 @@
+/***********************************************************/
+/*                                                         */
+/*  server.c - PDHT TCP backend target side event loop     */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * every rank runs one libev loop on a server thread. the loop accepts a
+ * connection from each peer that talks to us, reads whatever has arrived,
+ * runs each complete request against our part of the table and appends the
+ * reply (if any) to the connection's output buffer. replies for a whole batch
+ * of requests go out with a single write, and only fall back to a write
+ * watcher when the socket is full.
+ *
+ * the server thread is the only one that touches the open addressing tables,
+ * so requests need no locking. rank 0 also collects allreduce/barrier
+ * contributions and answers everyone once the last one arrives.
+ */
+
+#define PDHT_SERVER_READ 65536
+
+// one accepted connection
+struct pdht_sconn_s {
+  int                  fd;
+  ev_io                rw;
+  ev_io                ww;
+  char                *ibuf;
+  size_t               ilen, icap;
+  char                *obuf;
+  size_t               olen, ocap, ooff;
+  struct pdht_sconn_s *next;
+};
+typedef struct pdht_sconn_s pdht_sconn_t;
+
+struct pdht_server_s {
+  struct ev_loop  *loop;
+  pthread_t        thread;
+  int              lfd;
+  ev_io            aw;
+  ev_async         stopw;
+  pdht_sconn_t    *conns;
+  // allreduce state, rank 0 only
+  pdht_sconn_t   **rwaiters;
+  int              rarrived;
+  char            *racc;
+  size_t           rlen;
+};
+typedef struct pdht_server_s pdht_server_t;
+
+static void *pdht_server_thread(void *arg);
+static void  pdht_server_accept(struct ev_loop *loop, ev_io *w, int revents);
+static void  pdht_server_read(struct ev_loop *loop, ev_io *w, int revents);
+static void  pdht_server_write(struct ev_loop *loop, ev_io *w, int revents);
+static void  pdht_server_halt(struct ev_loop *loop, ev_async *w, int revents);
+static void  pdht_server_close(pdht_sconn_t *sc);
+static void  pdht_server_handle(pdht_sconn_t *sc, pdht_msg_t *msg);
+static void  pdht_server_reply(pdht_sconn_t *sc, pdht_status_t status, int ht, const void *data, size_t len);
+static int   pdht_server_flush(pdht_sconn_t *sc);
+
+
+
+/**
+ * pdht_server_start - listens on our port and starts the event loop thread
+ */
+void pdht_server_start(void) {
+  pdht_server_t *s;
+  struct sockaddr_in addr;
+  int one = 1;
+
+  s = calloc(1, sizeof(pdht_server_t));
+  s->lfd = socket(AF_INET, SOCK_STREAM, 0);
+  if (s->lfd < 0) {
+    pdht_dprintf("pdht_server_start: socket: %s\n", strerror(errno));
+    exit(1);
+  }
+  setsockopt(s->lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(c->port + c->rank);
+
+  // listen before the thread starts, early connects from peers wait in the backlog
+  if ((bind(s->lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (listen(s->lfd, SOMAXCONN) < 0)) {
+    pdht_dprintf("pdht_server_start: unable to listen on port %d: %s\n", c->port + c->rank, strerror(errno));
+    exit(1);
+  }
+  fcntl(s->lfd, F_SETFL, fcntl(s->lfd, F_GETFL) | O_NONBLOCK);
+
+  s->loop = ev_loop_new(EVFLAG_AUTO);
+  if (!s->loop) {
+    pdht_dprintf("pdht_server_start: unable to create event loop\n");
+    exit(1);
+  }
+  ev_io_init(&s->aw, pdht_server_accept, s->lfd, EV_READ);
+  ev_io_start(s->loop, &s->aw);
+  ev_async_init(&s->stopw, pdht_server_halt);
+  ev_async_start(s->loop, &s->stopw);
+  ev_set_userdata(s->loop, s);
+
+  if (c->rank == 0)
+    s->rwaiters = calloc(c->size, sizeof(pdht_sconn_t *));
+
+  c->server = s;
+
+  if (pthread_create(&s->thread, NULL, pdht_server_thread, s) != 0) {
+    pdht_dprintf("pdht_server_start: unable to start server thread\n");
+    exit(1);
+  }
+}
+
+
+
+/**
+ * pdht_server_stop - stops the event loop, pushes out any remaining replies
+ */
+void pdht_server_stop(void) {
+  pdht_server_t *s = c->server;
+  pdht_sconn_t *sc, *next;
+
+  ev_async_send(s->loop, &s->stopw);
+  pthread_join(s->thread, NULL);
+
+  // loop is gone, finish any replies the peers are still waiting on
+  for (sc = s->conns; sc; sc = next) {
+    next = sc->next;
+    if (sc->olen > sc->ooff) {
+      fcntl(sc->fd, F_SETFL, fcntl(sc->fd, F_GETFL) & ~O_NONBLOCK);
+      pdht_comm_writeall(sc->fd, sc->obuf + sc->ooff, sc->olen - sc->ooff);
+    }
+    close(sc->fd);
+    free(sc->ibuf);
+    free(sc->obuf);
+    free(sc);
+  }
+
+  close(s->lfd);
+  ev_loop_destroy(s->loop);
+  free(s->rwaiters);
+  free(s->racc);
+  free(s);
+  c->server = NULL;
+}
+
+
+
+/**
+ * pdht_server_thread - runs the event loop until pdht_server_stop()
+ * @param arg server state
+ */
+static void *pdht_server_thread(void *arg) {
+  pdht_server_t *s = arg;
+
+  ev_run(s->loop, 0);
+  return NULL;
+}
+
+
+
+/**
+ * pdht_server_halt - async watcher callback, breaks out of the event loop
+ */
+static void pdht_server_halt(struct ev_loop *loop, ev_async *w, int revents) {
+  ev_break(loop, EVBREAK_ALL);
+}
+
+
+
+/**
+ * pdht_server_accept - accepts new peer connections
+ */
+static void pdht_server_accept(struct ev_loop *loop, ev_io *w, int revents) {
+  pdht_server_t *s = ev_userdata(loop);
+  pdht_sconn_t *sc;
+  int fd, one = 1;
+
+  while ((fd = accept(w->fd, NULL, NULL)) >= 0) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sc = calloc(1, sizeof(pdht_sconn_t));
+    sc->fd   = fd;
+    sc->icap = PDHT_SERVER_READ;
+    sc->ibuf = malloc(sc->icap);
+    ev_io_init(&sc->rw, pdht_server_read, fd, EV_READ);
+    ev_io_init(&sc->ww, pdht_server_write, fd, EV_WRITE);
+    sc->rw.data = sc;
+    sc->ww.data = sc;
+    ev_io_start(loop, &sc->rw);
+
+    sc->next = s->conns;
+    s->conns = sc;
+  }
+}
+
+
+
+/**
+ * pdht_server_read - reads and processes all complete requests on a connection
+ */
+static void pdht_server_read(struct ev_loop *loop, ev_io *w, int revents) {
+  pdht_sconn_t *sc = w->data;
+  pdht_msg_t *msg;
+  size_t off, mlen;
+  ssize_t n;
+
+  // one read per callback, the loop calls back while more data is waiting
+  if (sc->icap - sc->ilen < PDHT_SERVER_READ) {
+    sc->icap *= 2;
+    sc->ibuf = realloc(sc->ibuf, sc->icap);
+  }
+  do {
+    n = read(sc->fd, sc->ibuf + sc->ilen, sc->icap - sc->ilen);
+  } while ((n < 0) && (errno == EINTR));
+
+  if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+    return;
+  if (n <= 0) {
+    // peer went away (normal at pdht_free()), or the connection is broken
+    pdht_server_close(sc);
+    return;
+  }
+  sc->ilen += n;
+
+  // run every complete request in the batch
+  off = 0;
+  while (sc->ilen - off >= sizeof(pdht_msg_t)) {
+    msg  = (pdht_msg_t *)(sc->ibuf + off);
+    mlen = PDHT_MSG_SIZE(msg->len);
+    if (sc->ilen - off < mlen)
+      break;
+    pdht_server_handle(sc, msg);
+    off += mlen;
+  }
+  if (off > 0) {
+    memmove(sc->ibuf, sc->ibuf + off, sc->ilen - off);
+    sc->ilen -= off;
+  }
+
+  // one write for all replies from this batch
+  if (sc->olen > sc->ooff)
+    pdht_server_flush(sc);
+}
+
+
+
+/**
+ * pdht_server_write - write watcher callback, finishes replies a full socket held up
+ */
+static void pdht_server_write(struct ev_loop *loop, ev_io *w, int revents) {
+  pdht_server_flush(w->data);
+}
+
+
+
+/**
+ * pdht_server_flush - writes as much pending output as the socket takes
+ * @param sc server connection
+ * @returns 0 if all output was written, 1 otherwise
+ */
+static int pdht_server_flush(pdht_sconn_t *sc) {
+  struct ev_loop *loop = c->server->loop;
+  ssize_t n;
+
+  while (sc->ooff < sc->olen) {
+    n = write(sc->fd, sc->obuf + sc->ooff, sc->olen - sc->ooff);
+    if (n > 0) {
+      sc->ooff += n;
+    } else if ((n < 0) && (errno == EINTR)) {
+      continue;
+    } else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      if (!ev_is_active(&sc->ww))
+        ev_io_start(loop, &sc->ww);
+      return 1;
+    } else if ((n < 0) && ((errno == EPIPE) || (errno == ECONNRESET))) {
+      break; // nobody left to read the replies
+    } else {
+      pdht_dprintf("pdht_server_flush: write failed: %s\n", strerror(errno));
+      exit(1);
+    }
+  }
+
+  sc->olen = sc->ooff = 0;
+  if (ev_is_active(&sc->ww))
+    ev_io_stop(loop, &sc->ww);
+  return 0;
+}
+
+
+
+/**
+ * pdht_server_close - tears down a connection after the peer closed it
+ * @param sc server connection
+ */
+static void pdht_server_close(pdht_sconn_t *sc) {
+  pdht_server_t *s = c->server;
+  pdht_sconn_t **pp;
+
+  ev_io_stop(s->loop, &sc->rw);
+  ev_io_stop(s->loop, &sc->ww);
+  for (pp = &s->conns; *pp; pp = &(*pp)->next) {
+    if (*pp == sc) {
+      *pp = sc->next;
+      break;
+    }
+  }
+  close(sc->fd);
+  free(sc->ibuf);
+  free(sc->obuf);
+  free(sc);
+}
+
+
+
+/**
+ * pdht_server_reply - appends a reply to a connection's output buffer
+ * @param sc server connection
+ * @param status result of the request
+ * @param ht table index of the request
+ * @param data reply payload
+ * @param len payload length
+ */
+static void pdht_server_reply(pdht_sconn_t *sc, pdht_status_t status, int ht, const void *data, size_t len) {
+  pdht_msg_t *rep;
+  size_t need = sc->olen + PDHT_MSG_SIZE(len);
+
+  if (need > sc->ocap) {
+    sc->ocap = sc->ocap ? sc->ocap : PDHT_SERVER_READ;
+    while (sc->ocap < need)
+      sc->ocap *= 2;
+    sc->obuf = realloc(sc->obuf, sc->ocap);
+  }
+
+  rep = (pdht_msg_t *)(sc->obuf + sc->olen);
+  rep->len  = len;
+  rep->type = status;
+  rep->ht   = ht;
+  rep->arg  = 0;
+  if (len)
+    memcpy(rep->data, data, len);
+  sc->olen = need;
+}
+
+
+
+/**
+ * pdht_server_handle - runs one request against the local table
+ * @param sc connection the request arrived on
+ * @param msg request
+ */
+static void pdht_server_handle(pdht_sconn_t *sc, pdht_msg_t *msg) {
+  pdht_server_t *s = c->server;
+  pdht_t *dht = (msg->ht < PDHT_MAX_TABLES) ? c->hts[msg->ht] : NULL;
+  ptl_match_bits_t mbits;
+  char *key, *val;
+  int64_t cmp, new, old;
+  uint64_t cval;
+  uint32_t counter;
+  size_t rlen;
+
+  if ((!dht) && (msg->type != pdhtFence) && (msg->type != pdhtReduce)) {
+    pdht_dprintf("pdht_server_handle: request for unknown table: %d\n", msg->ht);
+    exit(1);
+  }
+
+  switch (msg->type) {
+
+    case pdhtGet:
+      // mbits | key
+      memcpy(&mbits, msg->data, sizeof(mbits));
+      key = msg->data + sizeof(mbits);
+      val = pdht_table_find(dht, mbits, key);
+      if (val)
+        pdht_server_reply(sc, PdhtStatusOK, msg->ht, val, dht->elemsize);
+      else
+        pdht_server_reply(sc, PdhtStatusNotFound, msg->ht, NULL, 0);
+      break;
+
+    case pdhtPut:
+      // mbits | key | value, no reply
+      memcpy(&mbits, msg->data, sizeof(mbits));
+      key = msg->data + sizeof(mbits);
+      val = pdht_table_insert(dht, mbits, key);
+      memcpy(val, key + dht->keysize, dht->elemsize);
+      break;
+
+    case pdhtCswap:
+      // mbits | key | compare | new, arg is the offset into the value
+      memcpy(&mbits, msg->data, sizeof(mbits));
+      key = msg->data + sizeof(mbits);
+      val = pdht_table_find(dht, mbits, key);
+      if ((!val) || (msg->arg + sizeof(int64_t) > dht->elemsize)) {
+        pdht_server_reply(sc, val ? PdhtStatusError : PdhtStatusNotFound, msg->ht, NULL, 0);
+        break;
+      }
+      memcpy(&cmp, key + dht->keysize, sizeof(cmp));
+      memcpy(&new, key + dht->keysize + sizeof(cmp), sizeof(new));
+      memcpy(&old, val + msg->arg, sizeof(old));
+      if (old == cmp)
+        memcpy(val + msg->arg, &new, sizeof(new));
+      pdht_server_reply(sc, PdhtStatusOK, msg->ht, &old, sizeof(old));
+      break;
+
+    case pdhtFence:
+      // everything sent before this on the connection has been applied
+      pdht_server_reply(sc, PdhtStatusOK, msg->ht, NULL, 0);
+      break;
+
+    case pdhtCounterInc:
+      memcpy(&counter, msg->data, sizeof(counter));
+      cval = __atomic_fetch_add(&dht->counters[counter], msg->arg, __ATOMIC_SEQ_CST);
+      pdht_server_reply(sc, PdhtStatusOK, msg->ht, &cval, sizeof(cval));
+      break;
+
+    case pdhtReduce:
+      // rank 0 only: combine contributions, answer everyone once all ranks are in
+      rlen = msg->len;
+      if (s->rarrived == 0) {
+        s->racc = realloc(s->racc, rlen ? rlen : 1);
+        memcpy(s->racc, msg->data, rlen);
+        s->rlen = rlen;
+      } else {
+        pdht_reduce_op(s->racc, msg->data, PDHT_REDUCE_OP(msg->arg), PDHT_REDUCE_TYPE(msg->arg), PDHT_REDUCE_COUNT(msg->arg));
+      }
+      s->rwaiters[s->rarrived++] = sc;
+
+      if (s->rarrived == c->size) {
+        for (int i=0; i < c->size; i++) {
+          pdht_server_reply(s->rwaiters[i], PdhtStatusOK, msg->ht, s->racc, s->rlen);
+          if (s->rwaiters[i] != sc)
+            pdht_server_flush(s->rwaiters[i]);
+        }
+        s->rarrived = 0;
+      }
+      break;
+
+    default:
+      pdht_dprintf("pdht_server_handle: unknown request type: %d\n", msg->type);
+      exit(1);
+  }
+}
@@ -0,0 +1,215 @@
+/***********************************************************/
+/*                                                         */
+/*  table.c - PDHT TCP backend local open addressing table */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * @file
+ *
+ * the part of a PDHT that lives on this rank is a linear probing table of
+ * fixed size slots: | tag | key | value |. the tag is the key's match bits
+ * (never zero, zero marks an empty slot), entries with the same bits are told
+ * apart by comparing the full key. the table doubles once it is half full.
+ * only the server thread modifies it.
+ */
+
+#define PDHT_SLOT_TAG(s)         (*(uint64_t *)(s))
+#define PDHT_SLOT_KEY(s)         ((s) + sizeof(uint64_t))
+#define PDHT_SLOT_VAL(dht, s)    ((s) + sizeof(uint64_t) + (dht)->keysize)
+#define PDHT_SLOT(dht, i)        ((dht)->slots + (size_t)(i) * (dht)->slotsize)
+
+static inline uint64_t pdht_table_tag(ptl_match_bits_t mbits);
+static inline unsigned pdht_table_start(pdht_t *dht, uint64_t tag);
+static void pdht_table_grow(pdht_t *dht);
+
+
+
+/**
+ * pdht_table_tag - slot tag for a set of match bits
+ */
+static inline uint64_t pdht_table_tag(ptl_match_bits_t mbits) {
+  return mbits ? mbits : 1;
+}
+
+
+
+/**
+ * pdht_table_start - first probe position for a tag
+ *   the rank was picked from the low bits, mix them before masking
+ */
+static inline unsigned pdht_table_start(pdht_t *dht, uint64_t tag) {
+  tag ^= tag >> 33;
+  tag *= 0xff51afd7ed558ccdULL;
+  tag ^= tag >> 33;
+  return tag & dht->slotmask;
+}
+
+
+
+/**
+ * pdht_table_init - allocates the local table for a new PDHT
+ * @param dht hash table
+ */
+void pdht_table_init(pdht_t *dht) {
+  dht->slotsize = (sizeof(uint64_t) + dht->keysize + dht->elemsize + 7) & ~7;
+  dht->slotmask = PDHT_TCP_MIN_SLOTS - 1;
+  dht->used     = 0;
+  dht->slots    = calloc(PDHT_TCP_MIN_SLOTS, dht->slotsize);
+  if (!dht->slots) {
+    pdht_dprintf("pdht_table_init: unable to allocate table\n");
+    exit(1);
+  }
+}
+
+
+
+/**
+ * pdht_table_fini - releases the local table
+ * @param dht hash table
+ */
+void pdht_table_fini(pdht_t *dht) {
+  free(dht->slots);
+  dht->slots = NULL;
+}
+
+
+
+/**
+ * pdht_table_find - looks up a key
+ * @param dht hash table
+ * @param mbits match bits of the key
+ * @param key the key
+ * @returns pointer to the value, or NULL if not present
+ */
+char *pdht_table_find(pdht_t *dht, ptl_match_bits_t mbits, void *key) {
+  uint64_t tag = pdht_table_tag(mbits);
+  unsigned i = pdht_table_start(dht, tag);
+  char *s;
+
+  for (;;) {
+    s = PDHT_SLOT(dht, i);
+    if (PDHT_SLOT_TAG(s) == 0)
+      return NULL;
+    if ((PDHT_SLOT_TAG(s) == tag) && (memcmp(PDHT_SLOT_KEY(s), key, dht->keysize) == 0))
+      return PDHT_SLOT_VAL(dht, s);
+    i = (i + 1) & dht->slotmask;
+  }
+}
+
+
+
+/**
+ * pdht_table_insert - finds or adds the slot for a key
+ * @param dht hash table
+ * @param mbits match bits of the key
+ * @param key the key
+ * @returns pointer to the (possibly uninitialized) value
+ */
+char *pdht_table_insert(pdht_t *dht, ptl_match_bits_t mbits, void *key) {
+  uint64_t tag = pdht_table_tag(mbits);
+  unsigned i;
+  char *s;
+
+  if (2 * (dht->used + 1) > dht->slotmask + 1)
+    pdht_table_grow(dht);
+
+  i = pdht_table_start(dht, tag);
+  for (;;) {
+    s = PDHT_SLOT(dht, i);
+    if (PDHT_SLOT_TAG(s) == 0)
+      break;
+    if ((PDHT_SLOT_TAG(s) == tag) && (memcmp(PDHT_SLOT_KEY(s), key, dht->keysize) == 0))
+      return PDHT_SLOT_VAL(dht, s);
+    i = (i + 1) & dht->slotmask;
+  }
+
+  PDHT_SLOT_TAG(s) = tag;
+  memcpy(PDHT_SLOT_KEY(s), key, dht->keysize);
+  dht->used++;
+  return PDHT_SLOT_VAL(dht, s);
+}
+
+
+
+/**
+ * pdht_table_grow - doubles the table and re-inserts every entry
+ * @param dht hash table
+ */
+static void pdht_table_grow(pdht_t *dht) {
+  char *old = dht->slots, *s, *d;
+  unsigned oldn = dht->slotmask + 1, i;
+
+  dht->slotmask = 2 * oldn - 1;
+  dht->slots    = calloc(2 * oldn, dht->slotsize);
+  if (!dht->slots) {
+    pdht_dprintf("pdht_table_grow: unable to grow table to %u slots\n", 2 * oldn);
+    exit(1);
+  }
+
+  for (unsigned j=0; j < oldn; j++) {
+    s = old + (size_t)j * dht->slotsize;
+    if (PDHT_SLOT_TAG(s) == 0)
+      continue;
+    i = pdht_table_start(dht, PDHT_SLOT_TAG(s));
+    while (PDHT_SLOT_TAG(PDHT_SLOT(dht, i)) != 0)
+      i = (i + 1) & dht->slotmask;
+    d = PDHT_SLOT(dht, i);
+    memcpy(d, s, dht->slotsize);
+  }
+  free(old);
+}
+
+
+
+/**
+ * pdht_iterate() - construct an iterator over the local part of a hash table
+ *  @param dht hash table structure
+ *  @param it a PDHT iterator structure
+ *  @returns status of creation operation
+ */
+pdht_status_t pdht_iterate(pdht_t *dht, pdht_iter_t *it) {
+  __sync_synchronize(); // pick up the server thread's inserts
+  it->dht  = dht;
+  it->slot = 0;
+  return PdhtStatusOK;
+}
+
+
+
+/**
+ * pdht_hasnext - checks to see if there is another local entry
+ * @param it a PDHT iterator structure
+ * @returns 1 if next entry is valid, 0 otherwise
+ */
+int pdht_hasnext(pdht_iter_t *it) {
+  pdht_t *dht = it->dht;
+
+  while ((it->slot <= dht->slotmask) && (PDHT_SLOT_TAG(PDHT_SLOT(dht, it->slot)) == 0))
+    it->slot++;
+  return it->slot <= dht->slotmask;
+}
+
+
+
+/**
+ * pdht_getnext - returns the next local entry
+ * @param it a PDHT iterator structure
+ * @param key if non-NULL, set to the entry's key
+ * @returns pointer to the entry's value, NULL when done
+ */
+void *pdht_getnext(pdht_iter_t *it, void **key) {
+  char *s;
+
+  if (!pdht_hasnext(it))
+    return NULL;
+  s = PDHT_SLOT(it->dht, it->slot++);
+  if (key)
+    *key = PDHT_SLOT_KEY(s);
+  return PDHT_SLOT_VAL(it->dht, s);
+}
@@ -0,0 +1,134 @@
+/***********************************************************/
+/*                                                         */
+/*  util.c - PDHT TCP backend utility functions            */
+/*                                                         */
+/*  author: d. brian larkins                               */
+/*  created: 10/19/26                                      */
+/*                                                         */
+/***********************************************************/
+
+#include <pdht_impl.h>
+
+/**
+ * eprintf - error printing wrapper, only prints on rank 0
+ * @returns number of bytes written to stdout
+ */
+int eprintf(const char *format, ...) {
+  va_list ap;
+  int ret;
+
+  if (c->rank == 0) {
+    va_start(ap, format);
+    ret = vfprintf(stdout, format, ap);
+    va_end(ap);
+    fflush(stdout);
+    return ret;
+  }
+  else
+    return 0;
+}
+
+
+
+/**
+ * pdht_dbg_printf - rank-tagged debug output
+ * @returns number of bytes written to stdout
+ */
+int pdht_dbg_printf(const char *format, ...) {
+  va_list ap;
+  int ret;
+
+  fprintf(stdout, "%d: ", c ? c->rank : -1);
+  va_start(ap, format);
+  ret = vfprintf(stdout, format, ap);
+  va_end(ap);
+  fflush(stdout);
+  return ret;
+}
+
+
+
+/**
+ * pdht_wtime - wall clock time in seconds
+ */
+double pdht_wtime(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+
+/**
+ * pdht_print_stats - prints client side operation counts
+ * @param dht hash table
+ */
+void pdht_print_stats(pdht_t *dht) {
+  uint64_t in[3] = { dht->puts, dht->gets, dht->notfound }, out[3];
+
+  pdht_allreduce(in, out, PdhtReduceOpSum, LongType, 3);
+  eprintf("pdht stats: puts: %lu gets: %lu notfound: %lu\n", out[0], out[1], out[2]);
+}
+
+
+
+/**
+ * pdht_average_time - average of a timer across all ranks
+ * @param dht hash table
+ * @param timer timer to average
+ * @returns average time in milliseconds
+ */
+double pdht_average_time(pdht_t *dht, pdht_timer_t timer) {
+  double global_sum;
+
+  pdht_allreduce(&timer.total, &global_sum, PdhtReduceOpSum, DoubleType, 1);
+  return global_sum * 1000 / c->size;
+}
+
+
+
+/**
+ * pdht_typesize - size of one element of a reduction datatype
+ */
+int pdht_typesize(pdht_datatype_t type) {
+  switch (type) {
+    case IntType:    return sizeof(int);
+    case LongType:   return sizeof(long);
+    case DoubleType: return sizeof(double);
+    case CharType:   return sizeof(char);
+    case BoolType:   return sizeof(char);
+  }
+  return 0;
+}
+
+
+
+#define PDHT_REDUCE_LOOP(T) do {                                       \
+    T *a = (T *)acc, *b = (T *)in;                                     \
+    for (int i=0; i < elems; i++) {                                    \
+      switch (op) {                                                    \
+        case PdhtReduceOpSum: a[i] += b[i]; break;                     \
+        case PdhtReduceOpMin: a[i] = b[i] < a[i] ? b[i] : a[i]; break; \
+        case PdhtReduceOpMax: a[i] = b[i] > a[i] ? b[i] : a[i]; break; \
+      }                                                                \
+    }                                                                  \
+  } while (0)
+
+/**
+ * pdht_reduce_op - combines one contribution into an accumulator
+ * @param acc accumulator (updated)
+ * @param in contribution
+ * @param op reduction operator
+ * @param type element type
+ * @param elems number of elements
+ */
+void pdht_reduce_op(void *acc, void *in, pdht_reduceop_t op, pdht_datatype_t type, int elems) {
+  switch (type) {
+    case IntType:    PDHT_REDUCE_LOOP(int);    break;
+    case LongType:   PDHT_REDUCE_LOOP(long);   break;
+    case DoubleType: PDHT_REDUCE_LOOP(double); break;
+    case CharType:   PDHT_REDUCE_LOOP(char);   break;
+    case BoolType:   PDHT_REDUCE_LOOP(char);   break;
+  }
+}
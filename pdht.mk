@@ -23,6 +23,7 @@ GCFLAGS = --std=c99 -rdynamic -g -O3 -D_POSIX_C_SOURCE=199309L  # development
 CFLAGS = $(GCFLAGS) -I. -I$(PDHT_TOP)/include -I$(PORTALS_INCLUDEDIR)
 CFLAGSMPI = $(GCFLAGS) -I. -I$(PDHT_TOP)/includempi -I$(PORTALS_INCLUDEDIR)
 CFLAGSOSHMEM = $(GCFLAGS) -I. -I$(PDHT_TOP)/includeoshmem 
+CFLAGSTCP = $(GCFLAGS) -I. -I$(PDHT_TOP)/includetcp
 
 #LDFLAGS=-L$(PORTALS_LIBDIR)
 MATH_LIB            = -lm
@@ -34,14 +35,17 @@ PDHT_INSTALL_LIBDIR = $(PDHT_TOP)/lib
 PDHT_LIBPDHT        = $(PDHT_INSTALL_LIBDIR)/libpdht.a
 PDHT_LIBMPIPDHT     = $(PDHT_INSTALL_LIBDIR)/libmpipdht.a
 PDHT_LIBOSHMEMPDHT      = $(PDHT_INSTALL_LIBDIR)/liboshmempdht.a
+PDHT_LIBTCPPDHT     = $(PDHT_INSTALL_LIBDIR)/libtcppdht.a
 
 PDHT_LIBDIRS = $(PDHT_TOP)/libpdht
 PDHT_LIBMPIDIRS = $(PDHT_TOP)/libmpipdht
 PDHT_LIBOSHMEMDIRS = $(PDHT_TOP)/liboshmempdht
+PDHT_LIBTCPDIRS = $(PDHT_TOP)/libtcppdht
 
-PDHT_LIBS = -L$(PORTALS_LIBDIR) -Wl,-rpath=$(PORTALS_LIBDIR) $(PDHT_LIBPDHT) $(PTHREAD_LIB) $(PMI_LIB) $(PORTALS_LIB) $(MATH_LIB)
+PDHT_LIBS = -L$(PORTALS_LIBDIR) -Wl,-rpath=$(PORTALS_LIBDIR) $(PDHT_LIBPDHT) $(PTHREAD_LIB) $(PMI_LIB) $(PORTALS_LIB) $(RT_LIB) $(MATH_LIB)
 PDHT_MPILIBS = $(PDHT_LIBMPIPDHT) $(MATH_LIB)
 PDHT_OSHMEMLIBS = $(PDHT_LIBOSHMEMPDHT) $(MATH_LIB)
+PDHT_TCPLIBS = $(PDHT_LIBTCPPDHT) $(PTHREAD_LIB) $(MATH_LIB)
 
 .PHONY: all
 
@@ -71,6 +75,9 @@ pdhtmpilibs: pdhtheaders $(PDHT_LIBMPIDIRS)
 .PHONY: pdhtlibs $(PDHT_LIBOSHMEMDIRS)
 pdhtoshmemlibs: pdhtheaders $(PDHT_LIBOSHMEMDIRS)
 
+.PHONY: pdhttcplibs $(PDHT_LIBTCPDIRS)
+pdhttcplibs: pdhtheaders $(PDHT_LIBTCPDIRS)
+
 .PHONY: checkflags pdhtheaders
 pdhtheaders: 
 	for dir in $(PDHT_LIBDIRS); do \
@@ -81,6 +88,9 @@ pdhtheaders:
 	done; \
 	for dir in $(PDHT_LIBOSHMEMDIRS); do \
 		$(MAKE) -C $$dir headers; \
+	done; \
+	for dir in $(PDHT_LIBTCPDIRS); do \
+		$(MAKE) -C $$dir headers; \
 	done; 
 
 $(PDHT_LIBDIRS):
@@ -92,6 +102,9 @@ $(PDHT_LIBMPIDIRS):
 $(PDHT_LIBOSHMEMDIRS):
 	$(MAKE) -C $@ GCFLAGS="$(GCFLAGS)" CC="$(OSHCC)"
 
+$(PDHT_LIBTCPDIRS):
+	$(MAKE) -C $@ GCFLAGS="$(GCFLAGS)" CC="$(CC)"
+
 
 .PHONY: pdhtclean
 pdhtclean: 
@@ -101,6 +114,12 @@ pdhtclean:
 	for dir in $(PDHT_LIBMPIDIRS); do \
 		$(MAKE) -C $$dir clean; \
 	done;\
+	for dir in $(PDHT_LIBOSHMEMDIRS); do \
+		$(MAKE) -C $$dir clean; \
+	done;\
+	for dir in $(PDHT_LIBTCPDIRS); do \
+		$(MAKE) -C $$dir clean; \
+	done;\
 	rm -f *~ *.o gmon.out $(LOCAL_EXECS)
 
 .PHONY: clean
@@ -0,0 +1,119 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define offsetof(type, member)  __builtin_offsetof (type, member)
+
+#define NKEYS 1000
+#define NHITS 20
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+struct count_s {
+  int64_t hits;
+  double  weight;
+};
+typedef struct count_s count_t;
+
+
+
+/*
+ * histogram style accumulates: every rank bumps every key NHITS times without
+ * waiting, then checks the totals after the fence. fetching ops are checked
+ * on a couple of keys at the end.
+ */
+int main(int argc, char **argv) {
+  pdht_t *ht, *bt;
+  unsigned long key;
+  count_t val;
+  int32_t bins[4], inc[4] = { 1, 2, 3, 4 };
+  int64_t one = 1;
+  long prior, psum;
+  int32_t label, oldlabel;
+  double w = 0.5;
+  pdht_status_t ret;
+  pdht_timer_t atimer;
+  double aavg;
+  int fails = 0;
+
+  ht = pdht_create(sizeof(unsigned long), sizeof(count_t), PdhtModeStrict);
+  bt = pdht_create(sizeof(unsigned long), sizeof(bins), PdhtModeStrict);
+
+  memset(&val, 0, sizeof(val));
+  memset(bins, 0, sizeof(bins));
+  for (key=c->rank; key < NKEYS; key += c->size) {
+    if ((pdht_put(ht, &key, &val) != PdhtStatusOK) || (pdht_put(bt, &key, bins) != PdhtStatusOK))
+      fails++;
+  }
+  pdht_fence(ht);
+  pdht_fence(bt);
+
+  PDHT_INIT_ATIMER(atimer);
+  PDHT_START_ATIMER(atimer);
+  for (int h=0; h < NHITS; h++) {
+    for (key=0; key < NKEYS; key++) {
+      if (pdht_acc(ht, &key, offsetof(count_t, hits), LongType, AssocOpAdd, &one) != PdhtStatusOK)
+        fails++;
+      if (pdht_nbacc(ht, &key, offsetof(count_t, weight), DoubleType, AssocOpAdd, &w) == PDHT_NULL_HANDLE)
+        fails++;
+    }
+  }
+  pdht_fence(ht);
+  PDHT_STOP_ATIMER(atimer);
+
+  // elementwise into whole entries
+  for (key=0; key < NKEYS; key++) {
+    if (pdht_acc(bt, &key, PDHT_ACC_ALL, IntType, AssocOpAdd, inc) != PdhtStatusOK)
+      fails++;
+  }
+  pdht_fence(bt);
+
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val.hits != NHITS * c->size) || (val.weight != NHITS * c->size * w)) {
+      printf("%d: key %lu: %d hits: %ld weight: %f\n", c->rank, key, ret, val.hits, val.weight);
+      fails++;
+    }
+    ret = pdht_get(bt, &key, bins);
+    if ((ret != PdhtStatusOK) || (bins[0] != c->size) || (bins[3] != 4 * c->size)) {
+      printf("%d: key %lu: %d bins: %d %d\n", c->rank, key, ret, bins[0], bins[3]);
+      fails++;
+    }
+  }
+
+  // accumulates past the end of the entry are refused
+  key = 0;
+  if (pdht_acc(ht, &key, sizeof(count_t), IntType, AssocOpAdd, &one) != PdhtStatusError)
+    fails++;
+  pdht_barrier();
+
+  // fetching ops: every rank sees a different prior count, and the largest label wins
+  key = 1;
+  label = 100 + c->rank;
+  if ((pdht_fetch_op(ht, &key, offsetof(count_t, hits), LongType, AssocOpAdd, &one, &prior) != PdhtStatusOK)
+      || (pdht_fetch_op(bt, &key, 0, IntType, AssocOpMax, &label, &oldlabel) != PdhtStatusOK))
+    fails++;
+  if (pdht_fetch_op(ht, &key, offsetof(count_t, weight), DoubleType, AssocOpBxor, &w, &w) != PdhtStatusError)
+    fails++;
+  pdht_allreduce(&prior, &psum, PdhtReduceOpSum, LongType, 1);
+  pdht_barrier();
+  if ((pdht_get(bt, &key, bins) != PdhtStatusOK) || (bins[0] != 100 + c->size - 1)
+      || (psum != (long)c->size * NHITS * c->size + (long)c->size * (c->size - 1) / 2)) {
+    printf("%d: fetch_op: label: %d prior sum: %ld\n", c->rank, bins[0], psum);
+    fails++;
+  }
+
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+  aavg = pdht_average_time(ht, atimer); // collective
+  if (c->rank == 0)
+    printf("acc: %d accumulates per rank: %.3f ms (average per rank)\n", 2 * NHITS * NKEYS, aavg);
+
+  pdht_barrier();
+  pdht_print_stats(ht);
+  pdht_free(bt);
+  pdht_free(ht);
+  return fails != 0;
+}
@@ -0,0 +1,139 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <pdht.h>
+
+#define NKEYS   4000
+#define NCHAINS 32
+#define CHAINLEN 100
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+// one chain of dependent lookups: each value names the next key to get
+struct chain_s {
+  unsigned long key;
+  unsigned long val;
+  int           steps;
+  int           fails;
+};
+typedef struct chain_s chain_t;
+
+static int putdone = 0, putfails = 0;
+
+
+
+static void put_done(pdht_t *ht, void *key, void *value, pdht_status_t status, void *arg) {
+  if (status != PdhtStatusOK) {
+    printf("%d: async put of key %lu failed : %d\n", c->rank, *(unsigned long *)key, status);
+    __sync_fetch_and_add(&putfails, 1);
+  }
+  __sync_fetch_and_add(&putdone, 1);
+}
+
+
+
+static void walk(pdht_t *ht, void *key, void *value, pdht_status_t status, void *arg) {
+  chain_t *ch = arg;
+
+  if ((status != PdhtStatusOK) || (ch->val != (ch->key * 7 + 1) % NKEYS)) {
+    printf("%d: chain get of key %lu failed : %d\n", c->rank, ch->key, status);
+    ch->fails++;
+    return;
+  }
+
+  // issue the next lookup from the callback
+  if (++ch->steps < CHAINLEN) {
+    ch->key = ch->val;
+    if (pdht_get_async(ht, &ch->key, &ch->val, walk, ch) != PdhtStatusOK)
+      ch->fails++;
+  }
+}
+
+
+
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  chain_t chains[NCHAINS];
+  unsigned long key, val;
+  int fails = 0, opt;
+
+  cfg.nptes            = 2;
+  cfg.pendmode         = PdhtPendingTrig;
+  cfg.maxentries       = 20000;
+  cfg.pendq_size       = 1000;
+  cfg.ptalloc_opts     = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet            = 1;
+  cfg.local_gets       = PdhtRegular;
+  cfg.rank             = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes          = 2;
+  cfg.ptlistmax        = 0;
+  cfg.layout           = PdhtLayoutEntry;
+  cfg.bucketslots      = 0;
+  cfg.progress_spin    = 64;
+  cfg.progress_cpu     = -1;
+  cfg.progress_threads = 1;
+  cfg.progmode         = PdhtProgressThreads;
+
+  // the bucket and direct layouts chain a second read on overflow, see async.c
+  while ((opt = getopt(argc, argv, "bdh")) != -1) {
+    switch (opt) {
+      case 'b':
+        cfg.layout = PdhtLayoutBucket;
+        break;
+      case 'd':
+        cfg.layout = PdhtLayoutDirect;
+        break;
+      case 'h':
+      default:
+        printf("usage: async -bdh\n");
+        printf("\t-b bucket layout\n");
+        printf("\t-d direct layout\n");
+        printf("\t-h this message\n");
+        exit(1);
+    }
+  }
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE | PDHT_TUNE_LAYOUT | PDHT_TUNE_PROGRESS, &cfg);
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  // every rank puts its slice without waiting on each put
+  for (key=c->rank; key < NKEYS; key += c->size) {
+    val = (key * 7 + 1) % NKEYS;
+    if (pdht_put_async(ht, &key, &val, put_done, NULL) != PdhtStatusOK)
+      fails++;
+  }
+  pdht_async_wait(ht);
+  if (putfails)
+    fails++;
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  // keep NCHAINS walks in flight, each callback issues the next step
+  for (int i=0; i < NCHAINS; i++) {
+    chains[i].key   = (c->rank * NCHAINS + i) % NKEYS;
+    chains[i].steps = 0;
+    chains[i].fails = 0;
+    if (pdht_get_async(ht, &chains[i].key, &chains[i].val, walk, &chains[i]) != PdhtStatusOK)
+      fails++;
+  }
+  pdht_async_wait(ht);
+
+  for (int i=0; i < NCHAINS; i++) {
+    if ((chains[i].fails) || (chains[i].steps != CHAINLEN)) {
+      printf("%d: chain %d stopped after %d steps\n", c->rank, i, chains[i].steps);
+      fails++;
+    }
+  }
+
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+}
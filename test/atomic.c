@@ -82,5 +82,25 @@ int main(int argc, char **argv) {
   pdht_barrier();
   pdht_print_active(ht, mkprinter, mvprinter);
 
+  // claim everything again in one batch, each key goes to exactly one rank
+  unsigned long keys[ASIZE];
+  void *kp[ASIZE];
+  int64_t olds[ASIZE], news[ASIZE];
+  int won = 0, total = 0;
+
+  for (unsigned long key=0; key < ASIZE; key++) {
+    keys[key] = key;
+    kp[key]   = &keys[key];
+    olds[key] = 1;
+    news[key] = 2;
+  }
+  if (pdht_atomic_cswap_many(ht, ASIZE, kp, off, olds, news, NULL) != PdhtStatusOK)
+    printf("%d: cswap_many error\n", c->rank);
+  for (int i=0; i < ASIZE; i++)
+    won += (olds[i] == 1);
+  pdht_allreduce(&won, &total, PdhtReduceOpSum, IntType, 1);
+  if (c->rank == 0)
+    printf("cswap_many: %d of %d keys claimed (%s)\n", total, ASIZE, total == ASIZE ? "passed" : "failed");
+
   pdht_free(ht);
 }
@@ -0,0 +1,111 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS 2000
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  pdht_iter_t it;
+  unsigned long key, val, *vp, lsum = 0, gsum = 0;
+  pdht_status_t ret;
+  int fails = 0;
+
+  cfg.nptes        = 1;
+  cfg.pendmode     = PdhtPendingTrig;
+  cfg.maxentries   = 10000;
+  cfg.pendq_size   = 2000;
+  cfg.ptalloc_opts = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet        = 1;
+  cfg.local_gets   = PdhtRegular;
+  cfg.rank         = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes      = 1;
+  cfg.ptlistmax    = 0;
+  cfg.layout       = PdhtLayoutBucket;
+  cfg.bucketslots  = 2; // tiny buckets, so some keys overflow onto their own ME
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE | PDHT_TUNE_LAYOUT, &cfg);
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  if (c->rank == 0) {
+    for (key=0; key < NKEYS; key++) {
+      val = key * 3;
+      ret = pdht_put(ht, &key, &val);
+      if (ret != PdhtStatusOK) {
+        printf("put of key %lu failed : %d\n", key, ret);
+        fails++;
+      }
+    }
+  }
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  // both bucketed and overflowed keys must be reachable
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 3)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  key = NKEYS + 42;
+  ret = pdht_get(ht, &key, &val);
+  if (ret != PdhtStatusNotFound) {
+    printf("%d: get of missing key failed : %d\n", c->rank, ret);
+    fails++;
+  }
+
+  pdht_barrier();
+
+  // updates go straight into the bucket slot
+  if (c->rank == 0) {
+    for (key=0; key < NKEYS; key += 7) {
+      val = key * 5;
+      ret = pdht_update(ht, &key, &val);
+      if (ret != PdhtStatusOK) {
+        printf("update of key %lu failed : %d\n", key, ret);
+        fails++;
+      }
+    }
+  }
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * ((key % 7) ? 3 : 5))) {
+      printf("%d: get of updated key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  // local iteration sees every key exactly once
+  pdht_iterate(ht, &it);
+  while (pdht_hasnext(&it)) {
+    vp = pdht_getnext(&it, NULL);
+    lsum++;
+  }
+  pdht_allreduce(&lsum, &gsum, PdhtReduceOpSum, LongType, 1);
+  if (gsum != NKEYS) {
+    printf("%d: iteration found %lu entries, expected %d\n", c->rank, gsum, NKEYS);
+    fails++;
+  }
+
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+}
@@ -5,89 +5,157 @@
 
 #define ASIZE 10
 
-void pdht_poll(pdht_t *dht);
-
 extern pdht_context_t *c;
 
-void f_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, ptl_process_t *rank);
+void f_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank);
 int main(int argc, char **argv);
 
 
 
-void f_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, ptl_process_t *rank) {
-  // everything hashes to 1,1
-  *mbits = 1;
-  (*rank).rank = 1;
+void f_hash(pdht_t *dht, void *key, ptl_match_bits_t *mbits, uint32_t *ptindex, ptl_process_t *rank) {
+  // everything hashes to the same match bits on the last rank, keys from 100 up to a second set
+  *mbits = (*(unsigned long *)key < 100) ? 1 : 2;
+  *ptindex = 0;
+  (*rank).rank = c->size - 1;
 }
 
 
 
 int main(int argc, char **argv) {
   pdht_t *ht;
-  unsigned long key = 10;
+  unsigned long key;
   double pbuf[ASIZE], gbuf[ASIZE];
   pdht_status_t ret;
+  int fails = 0;
   
   // create hash table
   ht = pdht_create(sizeof(unsigned long), ASIZE * sizeof(double), PdhtModeStrict);
 
-  if (c->size != 2) {
-    if (c->rank == 0) { 
-      printf("requires two (and only two) processes to run\n");
+  pdht_sethash(ht, f_hash);
+
+  // every key below collides on the same match bits
+  if (c->rank == 0) {
+    for (key=10; key < 13; key++) {
+      for (int i=0; i<ASIZE; i++)
+        pbuf[i] = i * 1.1 + key;
+      ret = pdht_put(ht, &key, pbuf);
+      if (ret != PdhtStatusOK) {
+        printf("put of key %lu failed : %d\n", key, ret);
+        fails++;
+      }
     }
-    goto done;
   }
 
-  pdht_sethash(ht, f_hash);
-
+  pdht_fence(ht);
+  pdht_barrier();
 
-  if (c->rank == 0) {
-    for (int i=0; i<ASIZE; i++) {
-       pbuf[i] = i * 1.1 + 13.0;
-       gbuf[i] = i * 2.2 + 13.0;
+  // every process should see all colliding keys
+  for (key=10; key < 13; key++) {
+    ret = pdht_get(ht, &key, gbuf);
+    if ((ret != PdhtStatusOK) || (gbuf[1] != 1.1 + key)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
     }
+  }
 
-    //printf("%d: putting object\n", c->rank);
-    ret = pdht_put(ht, &key, pbuf);
+  // never inserted, same match bits
+  key = 42;
+  ret = pdht_get(ht, &key, gbuf);
+  if (ret != PdhtStatusNotFound) {
+    printf("%d: get of missing key failed : %d\n", c->rank, ret);
+    fails++;
+  }
+
+  pdht_barrier();
+
+  // update a key that lives in the middle of the chain
+  key = 11;
+  if (c->rank == 0) {
+    for (int i=0; i<ASIZE; i++)
+      pbuf[i] = -1.0;
+    ret = pdht_update(ht, &key, pbuf);
     if (ret != PdhtStatusOK) {
-       printf("initial put failed\n");
+      printf("update of key %lu failed : %d\n", key, ret);
+      fails++;
     }
-    pdht_barrier();
-    pdht_barrier();
+  }
 
-    //printf("%d: putting object\n", c->rank);
-    key += 1;
+  pdht_fence(ht);
+  pdht_barrier();
 
-    // try getting with different key, but same match bits (see shitty hash)
-    ret = pdht_get(ht, &key, gbuf);
-    if (ret != PdhtStatusCollision) {
-       printf("failed : %d\n",ret);
-    } else {
-       printf("passed\n");
-    } 
-    pdht_barrier();
+  ret = pdht_get(ht, &key, gbuf);
+  if ((ret != PdhtStatusOK) || (gbuf[0] != -1.0)) {
+    printf("%d: get of updated key failed : %d\n", c->rank, ret);
+    fails++;
+  }
 
+  pdht_barrier();
 
+  // a lone key under its bits, updating a missing key that collides with it must leave it alone
+  key = 100;
+  if (c->rank == 0) {
+    for (int i=0; i<ASIZE; i++)
+      pbuf[i] = i * 1.1 + key;
+    ret = pdht_put(ht, &key, pbuf);
+    if (ret != PdhtStatusOK) {
+      printf("put of key %lu failed : %d\n", key, ret);
+      fails++;
+    }
+  }
 
-  } else {
+  pdht_fence(ht);
+  pdht_barrier();
 
-    pdht_barrier();
+  if (c->rank == 0) {
+    key = 101;
+    for (int i=0; i<ASIZE; i++)
+      pbuf[i] = -2.0;
+    ret = pdht_update(ht, &key, pbuf);
+    if (ret != PdhtStatusNotFound) {
+      printf("update of missing key %lu failed : %d\n", key, ret);
+      fails++;
+    }
+  }
 
-    //printf("%d: calling poll()\n", c->rank); 
-    pdht_poll(ht);
+  pdht_fence(ht);
+  pdht_barrier();
 
-    pdht_barrier();
+  key = 100;
+  ret = pdht_get(ht, &key, gbuf);
+  if ((ret != PdhtStatusOK) || (gbuf[1] != 1.1 + key)) {
+    printf("%d: get of key %lu after colliding update failed : %d\n", c->rank, key, ret);
+    fails++;
+  }
 
-    //printf("%d: calling poll()\n", c->rank); 
-    pdht_poll(ht);
+  pdht_barrier();
 
-    pdht_barrier();
+  // re-put a chained key more often than there are probe slots, the last value wins
+  key = 12;
+  if (c->rank == 0) {
+    for (int r=0; r < 20; r++) {
+      for (int i=0; i<ASIZE; i++)
+        pbuf[i] = r;
+      ret = pdht_put(ht, &key, pbuf);
+      if (ret != PdhtStatusOK) {
+        printf("re-put %d of key %lu failed : %d\n", r, key, ret);
+        fails++;
+      }
+    }
+  }
+
+  pdht_fence(ht);
+  pdht_barrier();
 
+  ret = pdht_get(ht, &key, gbuf);
+  if ((ret != PdhtStatusOK) || (gbuf[0] != 19.0)) {
+    printf("%d: get of re-put key failed : %d (%f)\n", c->rank, ret, gbuf[0]);
+    fails++;
   }
 
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+
   pdht_barrier();
 
-done:
   pdht_print_stats(ht);
   pdht_free(ht);
 }
@@ -0,0 +1,152 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS 4000
+#define NMORE 2000 // keys put while other ranks accumulate
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  pdht_iter_t it;
+  unsigned long key, val, lsum = 0, gsum = 0;
+  int64_t old, one = 1;
+  pdht_status_t ret;
+  int fails = 0;
+
+  cfg.nptes        = 1;
+  cfg.pendmode     = PdhtPendingTrig;
+  cfg.maxentries   = 10000;
+  cfg.pendq_size   = 2000;
+  cfg.ptalloc_opts = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet        = 1;
+  cfg.local_gets   = PdhtRegular;
+  cfg.rank         = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes      = 1;
+  cfg.ptlistmax    = 0;
+  cfg.layout       = PdhtLayoutDirect;
+  cfg.bucketslots  = 0;
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE | PDHT_TUNE_LAYOUT, &cfg);
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  if (c->rank == 0) {
+    for (key=0; key < NKEYS; key++) {
+      val = key * 3;
+      ret = pdht_put(ht, &key, &val);
+      if (ret != PdhtStatusOK) {
+        printf("put of key %lu failed : %d\n", key, ret);
+        fails++;
+      }
+    }
+  }
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  // gets are a single read of the key's neighborhood
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 3)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  key = NKEYS + 42;
+  ret = pdht_get(ht, &key, &val);
+  if (ret != PdhtStatusNotFound) {
+    printf("%d: get of missing key failed : %d\n", c->rank, ret);
+    fails++;
+  }
+
+  pdht_barrier();
+
+  // only the owner writes slots: updates of remote slots are refused and re-put
+  // instead (visible after the fence), atomics go straight into the slot
+  if (c->rank == 0) {
+    for (key=0; key < NKEYS; key += 7) {
+      val = key * 5;
+      ret = pdht_update(ht, &key, &val);
+      if (ret == PdhtStatusError)
+        ret = pdht_put(ht, &key, &val);
+      if (ret != PdhtStatusOK) {
+        printf("update of key %lu failed : %d\n", key, ret);
+        fails++;
+      }
+    }
+    key = 1;
+    old = 3;
+    ret = pdht_atomic_cswap(ht, &key, 0, &old, 11);
+    if ((ret != PdhtStatusOK) || (old != 3)) {
+      printf("cswap of key %lu failed : %d\n", key, ret);
+      fails++;
+    }
+  }
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != ((key == 1) ? 11 : key * ((key % 7) ? 3 : 5)))) {
+      printf("%d: get of updated key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  pdht_barrier();
+
+  // accumulates go straight into the located slot, new keys landing in the
+  // same neighborhoods meanwhile must not move it out from under them
+  for (key=NKEYS; (c->rank == 0) && (key < NKEYS + NMORE); key++) {
+    val = key * 3;
+    if (pdht_put(ht, &key, &val) != PdhtStatusOK)
+      fails++;
+  }
+  for (key=2; key < NKEYS; key += 13) {
+    if (pdht_acc(ht, &key, 0, LongType, AssocOpAdd, &one) != PdhtStatusOK) {
+      printf("%d: accumulate into key %lu failed\n", c->rank, key);
+      fails++;
+    }
+  }
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  for (key=2; key < NKEYS + NMORE; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) ||
+        ((key < NKEYS) && ((key - 2) % 13 == 0) && (val != key * ((key % 7) ? 3 : 5) + c->size)) ||
+        ((key >= NKEYS) && (val != key * 3))) {
+      printf("%d: get of accumulated key %lu failed : %d (%lu)\n", c->rank, key, ret, val);
+      fails++;
+    }
+  }
+
+  // local iteration sees every key exactly once
+  pdht_iterate(ht, &it);
+  while (pdht_hasnext(&it)) {
+    pdht_getnext(&it, NULL);
+    lsum++;
+  }
+  pdht_allreduce(&lsum, &gsum, PdhtReduceOpSum, LongType, 1);
+  if (gsum != NKEYS + NMORE) {
+    printf("%d: iteration found %lu entries, expected %d\n", c->rank, gsum, NKEYS + NMORE);
+    fails++;
+  }
+
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+}
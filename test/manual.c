@@ -0,0 +1,77 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS 4000
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  unsigned long key, val;
+  pdht_status_t ret;
+  int fails = 0, events = 0;
+
+  cfg.nptes            = 2;
+  cfg.pendmode         = PdhtPendingTrig;
+  cfg.maxentries       = 20000;
+  cfg.pendq_size       = 128; // small, so the pending queues need refills from pdht_progress()
+  cfg.ptalloc_opts     = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet            = 1;
+  cfg.local_gets       = PdhtRegular;
+  cfg.rank             = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes          = 2;
+  cfg.ptlistmax        = 0;
+  cfg.layout           = PdhtLayoutEntry;
+  cfg.bucketslots      = 0;
+  cfg.progress_spin    = 0;
+  cfg.progress_cpu     = -1;
+  cfg.progress_threads = 1;
+  cfg.progmode         = PdhtProgressManual; // no progress threads, we drive it ourselves
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE | PDHT_TUNE_LAYOUT | PDHT_TUNE_PROGRESS, &cfg);
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  // every rank inserts its own slice and services its queues between puts
+  for (key=c->rank; key < NKEYS; key += c->size) {
+    val = key * 11;
+    ret = pdht_put(ht, &key, &val);
+    if (ret != PdhtStatusOK) {
+      printf("%d: put of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+    events += pdht_progress(ht);
+  }
+
+  // fence and barrier drive progress while they wait
+  pdht_fence(ht);
+  pdht_barrier();
+
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 11)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  key = NKEYS + 42;
+  ret = pdht_get(ht, &key, &val);
+  if (ret != PdhtStatusNotFound) {
+    printf("%d: get of missing key failed : %d\n", c->rank, ret);
+    fails++;
+  }
+
+  printf("%d: %s (%d events from pdht_progress)\n", c->rank, fails ? "failed" : "passed", events);
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+}
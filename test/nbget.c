@@ -0,0 +1,92 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS  20000
+#define WINDOW 64
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+/*
+ * non-blocking gets on the MPI backend: keeps WINDOW gets in flight and
+ * compares against blocking gets of the same keys
+ */
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  unsigned long key, val, vals[WINDOW];
+  pdht_handle_t h[WINDOW];
+  pdht_status_t ret;
+  pdht_timer_t btimer, nbtimer;
+  double bavg, nbavg;
+  int fails = 0, local, total;
+
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  for (key=c->rank; key < NKEYS; key += c->size) {
+    val = key * 3;
+    pdht_put(ht, &key, &val);
+  }
+  pdht_fence(ht);
+
+  PDHT_INIT_ATIMER(btimer);
+  PDHT_START_ATIMER(btimer);
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 3))
+      fails++;
+  }
+  PDHT_STOP_ATIMER(btimer);
+
+  PDHT_INIT_ATIMER(nbtimer);
+  PDHT_START_ATIMER(nbtimer);
+  for (key=0; key < NKEYS; key += WINDOW) {
+    for (int i=0; (i < WINDOW) && (key + i < NKEYS); i++) {
+      unsigned long k = key + i;
+      h[i] = pdht_nbget(ht, &k, &vals[i]);
+      if (h[i] == PDHT_NULL_HANDLE) {
+        printf("%d: nbget of key %lu got no handle\n", c->rank, k);
+        fails++;
+      }
+    }
+    for (int i=0; (i < WINDOW) && (key + i < NKEYS); i++) {
+      if (h[i] == PDHT_NULL_HANDLE)
+        continue;
+      ret = pdht_wait(h[i]);
+      if ((ret != PdhtStatusOK) || (vals[i] != (key + i) * 3)) {
+        printf("%d: nbget of key %lu failed : %d\n", c->rank, key + i, ret);
+        fails++;
+      }
+    }
+  }
+  PDHT_STOP_ATIMER(nbtimer);
+
+  // misses come back as NotFound, a finished handle is released by pdht_test()
+  key = NKEYS + 42;
+  h[0] = pdht_nbget(ht, &key, &val);
+  while ((ret = pdht_test(h[0])) == PdhtStatusPending)
+    ;
+  if (ret != PdhtStatusNotFound) {
+    printf("%d: nbget of missing key returned %d\n", c->rank, ret);
+    fails++;
+  }
+  if (pdht_test(h[0]) != PdhtStatusError) {
+    printf("%d: released handle still tests\n", c->rank);
+    fails++;
+  }
+
+  local = fails;
+  pdht_allreduce(&local, &total, PdhtReduceOpSum, IntType, 1);
+  bavg  = pdht_average_time(ht, btimer); // collective
+  nbavg = pdht_average_time(ht, nbtimer);
+  if (c->rank == 0)
+    printf("nbget: %s -- blocking: %.3f ms non-blocking: %.3f ms (average per rank)\n",
+        total ? "failed" : "passed", bavg, nbavg);
+
+  pdht_free(ht);
+  return total != 0;
+}
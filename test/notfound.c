@@ -5,7 +5,6 @@
 
 #define ASIZE 10
 
-void pdht_poll(pdht_t *dht);
 
 extern pdht_context_t *c;
 
@@ -51,7 +50,6 @@ int main(int argc, char **argv) {
 
   } else {
 
-    pdht_poll(ht);
     pdht_barrier();
 
   }
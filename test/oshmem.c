@@ -0,0 +1,141 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS  4000
+#define ROUND  50     // puts per PE between fences
+#define ASIZE  4
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+/*
+ * exercises the OpenSHMEM backend, e.g. on one box:
+ *   oshrun -np 4 ./oshmem
+ * tables start small so they have to grow at the fences along the way
+ */
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  pdht_iter_t it;
+  unsigned long key, base, *kp;
+  int64_t val[ASIZE], *vp, old;
+  pdht_status_t ret;
+  pdht_timer_t ptimer, gtimer;
+  int fails = 0, pdhtc, local = 0, total = 0;
+  uint64_t cval, nslots;
+
+  cfg.maxentries = 64;
+  pdht_tune(PDHT_TUNE_ENTRY, &cfg);
+
+  ht = pdht_create(sizeof(unsigned long), ASIZE * sizeof(int64_t), PdhtModeStrict);
+  nslots = ht->nslots;
+
+  // our slice, a fence after every ROUND puts gives the tables a chance to grow
+  PDHT_INIT_ATIMER(ptimer);
+  PDHT_START_ATIMER(ptimer);
+  for (base=0; base < NKEYS; base += ROUND * c->size) {
+    for (key=base+c->rank; (key < base + ROUND * c->size) && (key < NKEYS); key += c->size) {
+      for (int i=0; i < ASIZE; i++)
+        val[i] = key * 10 + i;
+      if (pdht_put(ht, &key, val) != PdhtStatusOK) {
+        printf("%d: put of key %lu failed\n", c->rank, key);
+        fails++;
+      }
+    }
+    pdht_fence(ht); // collective, every PE runs the same number of rounds
+  }
+  PDHT_STOP_ATIMER(ptimer);
+
+  if (ht->nslots <= nslots) {
+    printf("%d: table never grew past %lu slots\n", c->rank, nslots);
+    fails++;
+  }
+
+  // everyone reads everything, keys were moved by every resize
+  PDHT_INIT_ATIMER(gtimer);
+  PDHT_START_ATIMER(gtimer);
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, val);
+    if ((ret != PdhtStatusOK) || (val[0] != key * 10) || (val[ASIZE-1] != key * 10 + ASIZE - 1)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+  PDHT_STOP_ATIMER(gtimer);
+
+  key = NKEYS + 42;
+  if (pdht_get(ht, &key, val) != PdhtStatusNotFound) {
+    printf("%d: get of missing key succeeded\n", c->rank);
+    fails++;
+  }
+
+  // re-put overwrites in place, once everyone is done reading the old value
+  pdht_barrier();
+  if (c->rank == 0) {
+    key = 1;
+    val[0] = -1;
+    pdht_put(ht, &key, val);
+  }
+  pdht_fence(ht);
+  key = 1;
+  if ((pdht_get(ht, &key, val) != PdhtStatusOK) || (val[0] != -1)) {
+    printf("%d: re-put of key 1 not seen : %ld\n", c->rank, (long)val[0]);
+    fails++;
+  }
+  pdht_barrier();
+
+  // everyone races to swap word 1 of key 0, exactly one wins
+  key = 0;
+  old = 1;
+  ret = pdht_atomic_cswap(ht, &key, sizeof(int64_t), &old, 1000 + c->rank);
+  if (ret != PdhtStatusOK) {
+    printf("%d: cswap failed : %d\n", c->rank, ret);
+    fails++;
+  }
+  local = (old == 1);
+  pdht_allreduce(&local, &total, PdhtReduceOpSum, IntType, 1);
+  if (total != 1) {
+    printf("%d: %d PEs won the cswap\n", c->rank, total);
+    fails++;
+  }
+
+  // each PE bumps the counter 100 times
+  pdhtc = pdht_counter_init(ht, 0);
+  pdht_barrier();
+  for (int i=0; i < 100; i++)
+    cval = pdht_counter_inc(ht, pdhtc, 1);
+  pdht_barrier();
+  cval = pdht_counter_inc(ht, pdhtc, 0);
+  if (cval != 100 * c->size) {
+    printf("%d: counter is %lu, expected %d\n", c->rank, cval, 100 * c->size);
+    fails++;
+  }
+
+  // local iteration covers every key exactly once across PEs
+  local = 0;
+  pdht_iterate(ht, &it);
+  while ((vp = pdht_getnext(&it, (void **)&kp)) != NULL) {
+    if ((*kp > 1) && (vp[0] != *kp * 10))
+      fails++;
+    local++;
+  }
+  pdht_allreduce(&local, &total, PdhtReduceOpSum, IntType, 1);
+  if (total != NKEYS) {
+    printf("%d: iteration found %d entries, expected %d\n", c->rank, total, NKEYS);
+    fails++;
+  }
+
+  local = fails;
+  pdht_allreduce(&local, &total, PdhtReduceOpSum, IntType, 1);
+  eprintf("oshmem: %s -- puts: %.3f ms gets: %.3f ms (average per PE)\n", total ? "failed" : "passed",
+      pdht_average_time(ht, ptimer), pdht_average_time(ht, gtimer));
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+  return total != 0;
+}
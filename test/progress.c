@@ -0,0 +1,80 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS  1000
+#define NTABLES 3
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+int main(int argc, char **argv) {
+  pdht_t *ht[NTABLES];
+  pdht_config_t cfg;
+  unsigned long key, val;
+  pdht_status_t ret;
+  int fails = 0;
+
+  cfg.nptes         = 1;
+  cfg.pendmode      = PdhtPendingPoll; // one poller per table used to be the only option here
+  cfg.maxentries    = 10000;
+  cfg.pendq_size    = 2000;
+  cfg.ptalloc_opts  = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet         = 1;
+  cfg.local_gets    = PdhtRegular;
+  cfg.rank          = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes       = 1;
+  cfg.ptlistmax     = 0;
+  cfg.layout        = PdhtLayoutEntry;
+  cfg.bucketslots   = 0;
+  cfg.progress_spin = 64;
+  cfg.progress_cpu  = -1;
+  cfg.progress_threads = 1;
+  cfg.progmode      = PdhtProgressThreads;
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE | PDHT_TUNE_LAYOUT | PDHT_TUNE_PROGRESS, &cfg);
+
+  for (int t=0; t < NTABLES; t++)
+    ht[t] = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  // every table is served by the same progress engine
+  if (c->rank == 0) {
+    for (int t=0; t < NTABLES; t++) {
+      for (key=0; key < NKEYS; key++) {
+        val = key * (t+2);
+        ret = pdht_put(ht[t], &key, &val);
+        if (ret != PdhtStatusOK) {
+          printf("put of key %lu into table %d failed : %d\n", key, t, ret);
+          fails++;
+        }
+      }
+    }
+  }
+
+  for (int t=0; t < NTABLES; t++)
+    pdht_fence(ht[t]);
+  pdht_barrier();
+
+  for (int t=0; t < NTABLES; t++) {
+    for (key=0; key < NKEYS; key++) {
+      ret = pdht_get(ht[t], &key, &val);
+      if ((ret != PdhtStatusOK) || (val != key * (t+2))) {
+        printf("%d: get of key %lu from table %d failed : %d\n", c->rank, key, t, ret);
+        fails++;
+      }
+    }
+  }
+
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+
+  pdht_barrier();
+
+  // tables can go away in any order
+  pdht_free(ht[1]);
+  pdht_free(ht[0]);
+  pdht_free(ht[2]);
+}
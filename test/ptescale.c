@@ -0,0 +1,74 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS 4000
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  unsigned long key, val;
+  pdht_status_t ret;
+  int fails = 0;
+
+  cfg.nptes        = 1;
+  cfg.pendmode     = PdhtPendingTrig;
+  cfg.maxentries   = 40000;
+  cfg.pendq_size   = 2000;
+  cfg.ptalloc_opts = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet        = 1;
+  cfg.local_gets   = PdhtRegular;
+  cfg.rank         = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes      = 4;
+  cfg.ptlistmax    = 256; // small enough that NKEYS forces scaling on a few ranks
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE, &cfg);
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  // fill the table in rounds, each fence may scale the PTE set
+  for (int round=0; round < 4; round++) {
+    if (c->rank == 0) {
+      for (key=round*(NKEYS/4); key < (round+1)*(NKEYS/4); key++) {
+        val = key * 3;
+        ret = pdht_put(ht, &key, &val);
+        if (ret != PdhtStatusOK) {
+          printf("put of key %lu failed : %d\n", key, ret);
+          fails++;
+        }
+      }
+    }
+    pdht_fence(ht);
+    if (c->rank == 0)
+      printf("round %d: %u PTEs\n", round, ht->ptl.nptes);
+  }
+
+  pdht_barrier();
+
+  if (ht->ptl.nptes == 1) {
+    printf("%d: PTE set never scaled\n", c->rank);
+    fails++;
+  }
+
+  // entries put before (and after) scaling must still be reachable
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 3)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+}
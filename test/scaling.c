@@ -192,12 +192,7 @@ int main(int argc, char **argv) {
 
   // fix up averages
   for (int i=0; i<3; i++)  {
-#ifndef MPI
     avg[i] = avg[i] / (double)c->size;
-#else
-    int mpisize = c->size / 2;
-    avg[i] = avg[i] / (double)(mpisize);
-#endif
   }
 
   eprintf("put times         : %12.7f / %12.7f / %12.7f  ms (avg/min/max)\n", 
@@ -0,0 +1,68 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS 8000
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  unsigned long key, val;
+  pdht_status_t ret;
+  int fails = 0;
+
+  cfg.nptes            = 4;
+  cfg.pendmode         = PdhtPendingTrig;
+  cfg.maxentries       = 40000;
+  cfg.pendq_size       = 64;  // tiny pending queues, shards refill all the time
+  cfg.ptalloc_opts     = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet            = 1;
+  cfg.local_gets       = PdhtRegular;
+  cfg.rank             = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes          = 4;
+  cfg.ptlistmax        = 0;
+  cfg.layout           = PdhtLayoutEntry;
+  cfg.bucketslots      = 0;
+  cfg.progress_spin    = 64;
+  cfg.progress_cpu     = -1;
+  cfg.progress_threads = 3;   // uneven shards: thread 0 owns PTEs 0 and 3
+  cfg.progmode         = PdhtProgressThreads;
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE | PDHT_TUNE_LAYOUT | PDHT_TUNE_PROGRESS, &cfg);
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  // every rank inserts its own slice, so all shards on all targets stay busy
+  for (key=c->rank; key < NKEYS; key += c->size) {
+    val = key * 3;
+    ret = pdht_put(ht, &key, &val);
+    if (ret != PdhtStatusOK) {
+      printf("%d: put of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 3)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+
+  printf("%d: %s\n", c->rank, fails ? "failed" : "passed");
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+}
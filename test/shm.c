@@ -0,0 +1,103 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS 20000
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+/*
+ * same-node gets and updates through shared memory, run several ranks per node
+ * (and ideally more than one node, so both paths get used)
+ */
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_config_t cfg;
+  unsigned long key, val;
+  pdht_status_t ret;
+  pdht_timer_t gtimer, utimer;
+  double gavg, uavg;
+  int fails = 0;
+
+  cfg.nptes            = 1;
+  cfg.pendmode         = PdhtPendingTrig;
+  cfg.maxentries       = 50000;
+  cfg.pendq_size       = 20000;
+  cfg.ptalloc_opts     = PTL_PT_MATCH_UNORDERED;
+  cfg.quiet            = 1;
+  cfg.local_gets       = PdhtRegular;
+  cfg.rank             = PDHT_DEFAULT_RANK_HINT;
+  cfg.maxptes          = 1;
+  cfg.ptlistmax        = 0;
+  cfg.layout           = PdhtLayoutEntry;
+  cfg.bucketslots      = 0;
+  cfg.progress_spin    = 1024;
+  cfg.progress_cpu     = -1;
+  cfg.progress_threads = 1;
+  cfg.progmode         = PdhtProgressThreads;
+  cfg.shmmode          = PdhtShmNode;
+
+  pdht_tune(PDHT_TUNE_ALL | PDHT_TUNE_SCALE | PDHT_TUNE_LAYOUT | PDHT_TUNE_PROGRESS | PDHT_TUNE_SHM, &cfg);
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+
+  for (key=c->rank; key < NKEYS; key += c->size) {
+    val = key * 7;
+    if (pdht_put(ht, &key, &val) != PdhtStatusOK)
+      fails++;
+  }
+  pdht_fence(ht);
+
+  PDHT_INIT_ATIMER(gtimer);
+  PDHT_START_ATIMER(gtimer);
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 7)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+  PDHT_STOP_ATIMER(gtimer);
+
+  key = NKEYS + 42;
+  if (pdht_get(ht, &key, &val) != PdhtStatusNotFound) {
+    printf("%d: get of missing key succeeded\n", c->rank);
+    fails++;
+  }
+  pdht_barrier();
+
+  // rank r rewrites keys congruent to r + 1, then everyone checks the new values
+  PDHT_INIT_ATIMER(utimer);
+  PDHT_START_ATIMER(utimer);
+  for (key=(c->rank + 1) % c->size; key < NKEYS; key += c->size) {
+    val = key * 13;
+    if (pdht_update(ht, &key, &val) != PdhtStatusOK)
+      fails++;
+  }
+  pdht_fence(ht);
+  PDHT_STOP_ATIMER(utimer);
+
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 13)) {
+      printf("%d: get of updated key %lu failed : %d (%lu)\n", c->rank, key, ret, val);
+      fails++;
+    }
+  }
+
+  printf("%d: %s (%lu ops through shared memory)\n", c->rank, fails ? "failed" : "passed", ht->stats.shmops);
+  gavg = pdht_average_time(ht, gtimer); // collective
+  uavg = pdht_average_time(ht, utimer);
+  if (c->rank == 0)
+    printf("shm: gets: %.3f ms updates: %.3f ms (average per rank)\n", gavg, uavg);
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+  return fails != 0;
+}
@@ -267,10 +267,6 @@ int main(int argc, char **argv) {
     for (int row = 0; row < BLOCKS_PER_ROW; row++) {
         for (int col = 0; col < BLOCKS_PER_ROW; col++) {
             mine = (row * BLOCKS_PER_ROW + col) % c->size;
-#ifdef MPI
-            if(mine % 2 == 1)
-              mine--;
-#endif
             if (mine == c->rank) {
                 KeyOut = KEY2_OUT(row, col);
 
@@ -0,0 +1,113 @@
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NKEYS 20000
+#define ASIZE 4
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+
+
+
+/*
+ * exercises the TCP backend, e.g. on one box:
+ *   for r in 0 1 2 3; do PDHT_RANK=$r PDHT_SIZE=4 ./tcp & done; wait
+ */
+int main(int argc, char **argv) {
+  pdht_t *ht;
+  pdht_iter_t it;
+  unsigned long key, *kp;
+  int64_t val[ASIZE], *vp, old;
+  pdht_status_t ret;
+  pdht_timer_t ptimer, gtimer;
+  int fails = 0, pdhtc, local = 0, total = 0;
+  uint64_t cval;
+
+  ht = pdht_create(sizeof(unsigned long), ASIZE * sizeof(int64_t), PdhtModeStrict);
+
+  // batched puts of our slice
+  PDHT_INIT_ATIMER(ptimer);
+  PDHT_START_ATIMER(ptimer);
+  for (key=c->rank; key < NKEYS; key += c->size) {
+    for (int i=0; i < ASIZE; i++)
+      val[i] = key * 10 + i;
+    if (pdht_put(ht, &key, val) != PdhtStatusOK) {
+      printf("%d: put of key %lu failed\n", c->rank, key);
+      fails++;
+    }
+  }
+  pdht_fence(ht);
+  PDHT_STOP_ATIMER(ptimer);
+
+  // everyone reads everything
+  PDHT_INIT_ATIMER(gtimer);
+  PDHT_START_ATIMER(gtimer);
+  for (key=0; key < NKEYS; key++) {
+    ret = pdht_get(ht, &key, val);
+    if ((ret != PdhtStatusOK) || (val[0] != key * 10) || (val[ASIZE-1] != key * 10 + ASIZE - 1)) {
+      printf("%d: get of key %lu failed : %d\n", c->rank, key, ret);
+      fails++;
+    }
+  }
+  PDHT_STOP_ATIMER(gtimer);
+
+  key = NKEYS + 42;
+  if (pdht_get(ht, &key, val) != PdhtStatusNotFound) {
+    printf("%d: get of missing key succeeded\n", c->rank);
+    fails++;
+  }
+  pdht_barrier();
+
+  // everyone races to swap word 1 of key 0, exactly one wins
+  key = 0;
+  old = 1;
+  ret = pdht_atomic_cswap(ht, &key, sizeof(int64_t), &old, 1000 + c->rank);
+  if (ret != PdhtStatusOK) {
+    printf("%d: cswap failed : %d\n", c->rank, ret);
+    fails++;
+  }
+  local = (old == 1);
+  pdht_allreduce(&local, &total, PdhtReduceOpSum, IntType, 1);
+  if (total != 1) {
+    printf("%d: %d ranks won the cswap\n", c->rank, total);
+    fails++;
+  }
+
+  // each rank bumps the counter 100 times, nobody sees a value twice
+  pdhtc = pdht_counter_init(ht, 0);
+  pdht_barrier();
+  for (int i=0; i < 100; i++)
+    cval = pdht_counter_inc(ht, pdhtc, 1);
+  pdht_barrier();
+  cval = pdht_counter_inc(ht, pdhtc, 0);
+  if (cval != 100 * c->size) {
+    printf("%d: counter is %lu, expected %d\n", c->rank, cval, 100 * c->size);
+    fails++;
+  }
+
+  // local iteration covers every key exactly once across ranks
+  local = 0;
+  pdht_iterate(ht, &it);
+  while ((vp = pdht_getnext(&it, (void **)&kp)) != NULL) {
+    if ((*kp != 0) && (vp[0] != *kp * 10))
+      fails++;
+    local++;
+  }
+  pdht_allreduce(&local, &total, PdhtReduceOpSum, IntType, 1);
+  if (total != NKEYS) {
+    printf("%d: iteration found %d entries, expected %d\n", c->rank, total, NKEYS);
+    fails++;
+  }
+
+  local = fails;
+  pdht_allreduce(&local, &total, PdhtReduceOpSum, IntType, 1);
+  eprintf("tcp: %s -- puts: %.3f ms gets: %.3f ms (average per rank)\n", total ? "failed" : "passed",
+      pdht_average_time(ht, ptimer), pdht_average_time(ht, gtimer));
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+  return total != 0;
+}
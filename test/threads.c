@@ -0,0 +1,126 @@
+#define _XOPEN_SOURCE 600
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pdht.h>
+
+#define NTHREADS 4
+#define NKEYS    1000 // per thread
+#define NINCS    50   // counter increments per thread
+#define CHUNK    8    // values a thread claims at once from the chunked counter
+
+extern pdht_context_t *c;
+
+int main(int argc, char **argv);
+static void *putter(void *arg);
+static void *getter(void *arg);
+
+static pdht_t *ht;
+static int counter, chunked;
+static int fails[NTHREADS];
+
+
+
+// each thread on each rank puts a disjoint slice of the keys
+static void *putter(void *arg) {
+  int t = (int)(long)arg;
+  unsigned long key, val;
+  pdht_status_t ret;
+
+  for (int i=0; i < NKEYS; i++) {
+    key = ((unsigned long)i * c->size * NTHREADS) + (c->rank * NTHREADS) + t;
+    val = key * 3;
+    ret = pdht_put(ht, &key, &val);
+    if (ret != PdhtStatusOK) {
+      printf("%d/%d: put of key %lu failed : %d\n", c->rank, t, key, ret);
+      fails[t]++;
+    }
+  }
+  return NULL;
+}
+
+
+
+// every thread reads every key, so completions of concurrent gets interleave
+static void *getter(void *arg) {
+  int t = (int)(long)arg;
+  unsigned long key, val;
+  uint64_t prev, next;
+  pdht_status_t ret;
+
+  for (key=0; key < (unsigned long)NKEYS * c->size * NTHREADS; key++) {
+    ret = pdht_get(ht, &key, &val);
+    if ((ret != PdhtStatusOK) || (val != key * 3)) {
+      printf("%d/%d: get of key %lu failed : %d\n", c->rank, t, key, ret);
+      fails[t]++;
+    }
+  }
+
+  for (int i=0; i < NINCS; i++)
+    pdht_counter_inc(ht, counter, 1);
+
+  // values from the local run still come back in order within a thread
+  prev = 0;
+  for (int i=0; i < NINCS; i++) {
+    next = pdht_counter_inc(ht, chunked, 1);
+    if ((i > 0) && (next <= prev)) {
+      printf("%d/%d: chunked counter went from %lu to %lu\n", c->rank, t, (unsigned long)prev, (unsigned long)next);
+      fails[t]++;
+    }
+    prev = next;
+  }
+  return NULL;
+}
+
+
+
+int main(int argc, char **argv) {
+  pthread_t tids[NTHREADS];
+  uint64_t total;
+  int nfails = 0;
+
+  ht = pdht_create(sizeof(unsigned long), sizeof(unsigned long), PdhtModeStrict);
+  counter = pdht_counter_init(ht, 0);
+  chunked = pdht_counter_init_chunked(ht, 0, CHUNK);
+
+  pdht_barrier();
+
+  for (long t=0; t < NTHREADS; t++)
+    pthread_create(&tids[t], NULL, putter, (void *)t);
+  for (int t=0; t < NTHREADS; t++)
+    pthread_join(tids[t], NULL);
+
+  pdht_fence(ht);
+  pdht_barrier();
+
+  for (long t=0; t < NTHREADS; t++)
+    pthread_create(&tids[t], NULL, getter, (void *)t);
+  for (int t=0; t < NTHREADS; t++)
+    pthread_join(tids[t], NULL);
+
+  pdht_barrier();
+
+  // an increment of zero returns the total without changing it
+  total = pdht_counter_inc(ht, counter, 0);
+  if (total != (uint64_t)c->size * NTHREADS * NINCS) {
+    printf("%d: counter is %lu, expected %d\n", c->rank, (unsigned long)total, c->size * NTHREADS * NINCS);
+    nfails++;
+  }
+
+  // every thread claimed whole chunks, the unused tail of its last one is skipped
+  total = pdht_counter_inc(ht, chunked, 0);
+  if (total != (uint64_t)c->size * NTHREADS * ((NINCS + CHUNK - 1) / CHUNK * CHUNK)) {
+    printf("%d: chunked counter is %lu\n", c->rank, (unsigned long)total);
+    nfails++;
+  }
+
+  for (int t=0; t < NTHREADS; t++)
+    nfails += fails[t];
+  printf("%d: %s\n", c->rank, nfails ? "failed" : "passed");
+
+  pdht_barrier();
+
+  pdht_print_stats(ht);
+  pdht_free(ht);
+}